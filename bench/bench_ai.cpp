@@ -0,0 +1,217 @@
+// CPU opponent benchmark: the analytic prediction against the simulation
+// (where the ball really crosses the CPU paddle's face, over random serves
+// at up to 4x the normal speed), its cost against stepping the ball tick by
+// tick, and One Player matches against a simulated player at each level
+// (timed per tick, simulation included).
+//
+// Usage: bench_ai [trajectories] [matches]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "match.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#define TICK_HZ 120
+#define MAX_ERROR 0.5f // Pixels
+#define MATCH_TICKS (10 * 60 * TICK_HZ) // Rallies can last forever
+
+// The analytic levels, AI_LEARNED is bench_nn's
+static const char* levelNames[AI_HARD + 1] = { "easy", "normal", "hard" };
+
+// A random throw towards the right, at 1x to 4x the normal speed
+static void throwBall (Rng& rng, glm::vec2& p, glm::vec2& v) {
+    float theta = rng.uniform(-1.3f, 1.3f);
+    float speed = BALL_SPEED * rng.uniform(1.0f, 4.0f);
+    p = glm::vec2(rng.uniform(100.0f, 500.0f), rng.uniform(0.0f, SCREEN_H - 2 * BALL_R));
+    v = speed * glm::vec2(cosf(theta), sinf(theta));
+}
+
+// The same prediction, moving the ball one tick at a time
+static float predictByStepping (glm::vec2 p, glm::vec2 v, float r, float x, float dt) {
+    float bottom = SCREEN_H - 2 * r;
+    while (p.x + v.x * dt < x) {
+        p += v * dt;
+        if (p.y < 0.0f) {
+            p.y = -p.y;
+            v.y = -v.y;
+        } else if (p.y > bottom) {
+            p.y = 2 * bottom - p.y;
+            v.y = -v.y;
+        }
+    }
+    return aiFoldY(p.y, v.y, r, (x - p.x) / v.x);
+}
+
+// Compares the prediction with the simulation. Returns the number of
+// predictions off by more than MAX_ERROR.
+static unsigned int checkAccuracy (unsigned int n) {
+    Rng rng(7);
+    Simulation sim;
+    sim.setTickRate(TICK_HZ);
+
+    const float face = SCREEN_W - 10 - PADDLE_W;
+    const float x = face - 2 * BALL_R;
+    unsigned int checked = 0, skipped = 0, bad = 0;
+    double sum = 0.0, worst = 0.0;
+
+    for (unsigned int i = 0; i < n; ++i) {
+        sim.restart();
+        // The CPU paddle out of the way: the ball goes through its face
+        sim.cpu.x() = SCREEN_W + 200;
+        throwBall(rng, sim.ball.p, sim.ball.v);
+
+        float predicted;
+        aiPredictY(sim.ball.p, sim.ball.v, BALL_R, x, predicted);
+
+        // Step to the tick that crosses the face
+        glm::vec2 p0 = sim.ball.p, v0 = sim.ball.v;
+        while (sim.ball.x() < x) {
+            p0 = sim.ball.p;
+            v0 = sim.ball.v;
+            sim.step();
+        }
+
+        // Where in that tick, unless it also bounced off a wall
+        if (sim.ball.v.y != v0.y) {
+            ++skipped;
+            continue;
+        }
+        float f = (x - p0.x) / (sim.ball.x() - p0.x);
+        float actual = p0.y + f * (sim.ball.y() - p0.y);
+
+        double e = fabs(actual - predicted);
+        sum += e;
+        worst = e > worst ? e : worst;
+        bad += e > MAX_ERROR;
+        ++checked;
+    }
+
+    printf("Accuracy over %u trajectories (%u with a wall bounce in the last tick skipped):\n", checked, skipped);
+    printf("  error %.4f px on average, %.4f px at worst\n", checked ? sum / checked : 0.0, worst);
+    return bad;
+}
+
+static void timePredictions (unsigned int n) {
+    Rng rng(11);
+    const unsigned int batch = 1024;
+    glm::vec2 p[batch], v[batch];
+    for (unsigned int i = 0; i < batch; ++i) {
+        throwBall(rng, p[i], v[i]);
+    }
+
+    const float x = SCREEN_W - 10 - PADDLE_W - 2 * BALL_R;
+    const float dt = float(SIM_REFERENCE_HZ) / TICK_HZ;
+    volatile float sink = 0.0f;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) {
+        float y;
+        aiPredictY(p[i % batch], v[i % batch], BALL_R, x, y);
+        sink = sink + y;
+    }
+    double analytic = seconds(start);
+
+    unsigned int m = n / 100;
+    start = Clock::now();
+    for (unsigned int i = 0; i < m; ++i) {
+        sink = sink + predictByStepping(p[i % batch], v[i % batch], BALL_R, x, dt);
+    }
+    double stepping = seconds(start);
+
+    printf("Predictions: %.1f M/s analytic (%.1f ns), %.2f M/s stepping ticks (%.1f ns)\n",
+           n / analytic / 1e6, 1e9 * analytic / n, m / stepping / 1e6, 1e9 * stepping / m);
+}
+
+// The player: follows the ball with some error, with the d-pad
+struct Player {
+    TickInput frame (Match const& m) {
+        TickInput in;
+        Ball const& ball = m.sim.ball;
+        bool coming = ball.v.x < 0.0f;
+        if (coming && ! wasComing) {
+            error = rng.uniform(-errorPx, errorPx);
+        }
+        wasComing = coming;
+
+        float target = coming ? ball.y() + ball.r + error : SCREEN_H / 2;
+        float d = target - (m.sim.player.y() + PADDLE_H / 2);
+        moving = fabsf(d) > (moving ? 8.0f : 24.0f);
+        if (moving) {
+            in.buttons = d < 0.0f ? MATCH_UP : MATCH_DOWN;
+        }
+        return in;
+    }
+
+    Rng rng;
+    float errorPx = 60.0f;
+    float error = 0.0f;
+    bool wasComing = false, moving = false;
+};
+
+int main (int argc, char** argv) {
+    unsigned int trajectories = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    unsigned int matches = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20;
+    int failures = 0;
+
+    unsigned int bad = checkAccuracy(trajectories);
+    if (bad) {
+        printf("FAIL: %u predictions off by more than %.1f px\n", bad, MAX_ERROR);
+        ++failures;
+    }
+
+    timePredictions(10000000);
+
+    printf("One Player, %u matches per level against a simulated player:\n", matches);
+    printf("%8s %10s %12s %12s %14s\n", "level", "cpu wins", "cpu points", "rally s", "ns/tick");
+
+    float previous = -1.0f;
+    for (unsigned int level = 0; level <= AI_HARD; ++level) {
+        unsigned int wins = 0, points = 0, total = 0, rallyTicks = 0;
+        double aiSeconds = 0.0;
+        unsigned long updates = 0;
+        Player player;
+        player.rng.seed(1000 + level);
+
+        for (unsigned int i = 0; i < matches; ++i) {
+            Match match;
+            match.setTickRate(TICK_HZ);
+            match.start(GameMode::OnePlayer, 1 + i, level);
+
+            TickInput in;
+            Clock::time_point start = Clock::now();
+            while (! match.over() && match.ticks < MATCH_TICKS) {
+                if (match.ticks % 2 == 0) {
+                    in = player.frame(match);
+                }
+                rallyTicks += ! match.serving();
+                match.tick(in);
+            }
+            aiSeconds += seconds(start);
+            updates += match.ticks;
+
+            wins += match.sim.cpu.score > match.sim.player.score;
+            points += match.sim.cpu.score;
+            total += match.sim.cpu.score + match.sim.player.score;
+        }
+
+        float share = float(points) / total;
+        printf("%8s %9u%% %11.0f%% %12.1f %14.1f\n", levelNames[level], 100 * wins / matches, 100 * share,
+               float(rallyTicks) / TICK_HZ / total, 1e9 * aiSeconds / updates);
+
+        if (share <= previous) {
+            printf("FAIL: %s does not score more than the level below\n", levelNames[level]);
+            ++failures;
+        }
+        previous = share;
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
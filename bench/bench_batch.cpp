@@ -0,0 +1,174 @@
+// Batch renderer benchmark: the shapes of a multiball frame (paddles, ball
+// and N balls) collected into one triangle stream, against one draw per
+// shape with each circle tessellated again, as vita2d_draw_fill_circle does
+// (a fan of 100 segments). Checks the geometry and the draw counts.
+//
+// Usage: bench_batch [frames]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "batch.h"
+#include "multiball.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#define LEGACY_CIRCLE_SEGMENTS 100
+
+// Stands in for the GPU: copies the vertices out, as the Vita submit does
+struct Sink {
+    std::vector<BatchVertex> copy;
+    unsigned int calls = 0;
+    bool full = false;
+    float checksum = 0.0f;
+
+    static bool submit (BatchVertex const* vertices, unsigned int count, void* user) {
+        Sink* sink = static_cast<Sink*>(user);
+        if (sink->full) {
+            return false;
+        }
+        sink->copy.resize(count);
+        memcpy(sink->copy.data(), vertices, count * sizeof(BatchVertex));
+        sink->checksum += sink->copy[count - 1].x;
+        ++sink->calls;
+        return true;
+    }
+};
+
+// One call per shape, circles tessellated on every draw
+static void drawLegacy (Sink& sink, MultiBall const& balls, Paddle const& player, Paddle const& cpu) {
+    BatchVertex v[LEGACY_CIRCLE_SEGMENTS + 2];
+
+    Paddle const* paddles[] = { &player, &cpu };
+    for (Paddle const* p : paddles) {
+        v[0] = { p->x(), p->y(), 0.5f, 0xFFFFFFFF };
+        v[1] = { p->right(), p->y(), 0.5f, 0xFFFFFFFF };
+        v[2] = { p->x(), p->bottom(), 0.5f, 0xFFFFFFFF };
+        v[3] = { p->right(), p->bottom(), 0.5f, 0xFFFFFFFF };
+        Sink::submit(v, 4, &sink);
+    }
+
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        float x = balls.x[i], y = balls.y[i], r = balls.r[i];
+        v[0] = { x, y, 0.5f, 0xFFFFFFFF };
+        for (unsigned int s = 0; s <= LEGACY_CIRCLE_SEGMENTS; ++s) {
+            float a = 2.0f * float(M_PI) * s / LEGACY_CIRCLE_SEGMENTS;
+            v[s + 1] = { x + r * cosf(a), y + r * sinf(a), 0.5f, 0xFFFFFFFF };
+        }
+        Sink::submit(v, LEGACY_CIRCLE_SEGMENTS + 2, &sink);
+    }
+}
+
+static void drawBatched (Batch& batch, MultiBall const& balls, Paddle const& player, Paddle const& cpu) {
+    batch.rect(player.x(), player.y(), player.width(), player.height(), 0xFFFFFFFF);
+    batch.rect(cpu.x(), cpu.y(), cpu.width(), cpu.height(), 0xFFFFFFFF);
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        batch.circle(balls.x[i], balls.y[i], balls.r[i], 0xFFFFFFFF);
+    }
+    batch.flush();
+}
+
+static int checkGeometry () {
+    int failures = 0;
+    Sink sink;
+    Batch batch;
+    batch.init(Sink::submit, &sink);
+
+    // Order is kept, circle points lie on the circle
+    batch.rect(10, 20, 30, 40, 1);
+    batch.circle(100, 100, 8, 2);
+    batch.flush();
+    batch.beginFrame();
+    unsigned int circle = 3 * (8u << Batch::circleLevel(8));
+    if (batch.drawCallsLastFrame != 1 || batch.verticesLastFrame != 6 + circle ||
+        sink.copy[0].x != 10 || sink.copy[4].x != 40 || sink.copy[4].y != 60 || sink.copy[6].color != 2) {
+        printf("FAIL: batch contents\n");
+        ++failures;
+    }
+    for (unsigned int i = 6; i < sink.copy.size(); ++i) {
+        float d = hypotf(sink.copy[i].x - 100, sink.copy[i].y - 100);
+        if ((i % 3) != 0 && fabsf(d - 8) > 1e-3f) {
+            printf("FAIL: circle vertex %u at distance %f\n", i, d);
+            ++failures;
+            break;
+        }
+    }
+
+    // Split when full, counted when the frame memory is out
+    for (unsigned int i = 0; i < BATCH_MAX_VERTICES / 6 + 1; ++i) {
+        batch.rect(i, 0, 1, 1, 3);
+    }
+    batch.flush();
+    sink.full = true;
+    batch.rect(0, 0, 1, 1, 3);
+    batch.flush();
+    batch.beginFrame();
+    if (batch.drawCallsLastFrame != 2 || batch.dropped != 6) {
+        printf("FAIL: %u draws for %u rectangles, %llu dropped\n", batch.drawCallsLastFrame,
+               BATCH_MAX_VERTICES / 6 + 1, (unsigned long long) batch.dropped);
+        ++failures;
+    }
+
+    return failures;
+}
+
+int main (int argc, char** argv) {
+    unsigned int frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 500;
+    const unsigned int counts[] = { 1, 64, 1024, 4096 };
+
+    int failures = checkGeometry();
+
+    Paddle player, cpu;
+    player.init(glm::vec2(10, SCREEN_H / 2 - PADDLE_H / 2), glm::vec2(PADDLE_W, PADDLE_H));
+    cpu.init(glm::vec2(SCREEN_W - 10 - PADDLE_W, SCREEN_H / 2 - PADDLE_H / 2), glm::vec2(PADDLE_W, PADDLE_H));
+
+    printf("%8s %10s %12s %12s %10s %12s %12s %8s\n",
+           "balls", "old draws", "old verts", "old us/f", "draws", "verts", "us/f", "speedup");
+
+    for (unsigned int n : counts) {
+        Rng rng(n);
+        MultiBall balls;
+        balls.spawn(rng, n);
+
+        Sink legacy;
+        Clock::time_point start = Clock::now();
+        for (unsigned int f = 0; f < frames; ++f) {
+            drawLegacy(legacy, balls, player, cpu);
+        }
+        double legacyTime = seconds(start);
+        unsigned int legacyDraws = legacy.calls / frames;
+        unsigned int legacyVerts = 2 * 4 + n * (LEGACY_CIRCLE_SEGMENTS + 2);
+
+        Sink sink;
+        Batch batch;
+        batch.init(Sink::submit, &sink);
+        start = Clock::now();
+        for (unsigned int f = 0; f < frames; ++f) {
+            drawBatched(batch, balls, player, cpu);
+            batch.beginFrame();
+        }
+        double batchTime = seconds(start);
+
+        printf("%8u %10u %12u %12.2f %10u %12u %12.2f %7.1fx\n", n,
+               legacyDraws, legacyVerts, 1e6 * legacyTime / frames,
+               batch.drawCallsLastFrame, batch.verticesLastFrame, 1e6 * batchTime / frames,
+               legacyTime / batchTime);
+
+        unsigned int expected = (batch.verticesLastFrame + BATCH_MAX_VERTICES - 1) / BATCH_MAX_VERTICES;
+        if (batch.drawCallsLastFrame > expected + 1 || batch.dropped || sink.checksum == 0.0f) {
+            printf("FAIL: %u draws for %u vertices\n", batch.drawCallsLastFrame, batch.verticesLastFrame);
+            ++failures;
+        }
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+// Swept collision benchmark and tunneling check.
+//
+// 1. Throughput of sweep() (circle vs rectangle) against the discrete
+//    Sprite::intersects overlap test, half of the balls starting on the paddle.
+// 2. Agreement of sweep() with a brute-force sub-stepped reference.
+// 3. Tunneling: balls fired at the player's paddle at up to 200 px/tick, with
+//    the swept Simulation::step and with the old move() + collide() step,
+//    straight at it and off the wall it stands against within a single tick.
+//
+// Usage: bench_collision [sweeps] [trials per speed]
+// Exits with a non-zero status if the swept path ever misses or tunnels.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "simulation.h"
+#include "collision.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static float distanceToRect (glm::vec2 const& c, Rectangle const& rect) {
+    float dx = fmaxf(fmaxf(rect.left() - c.x, 0.0f), c.x - rect.right()),
+          dy = fmaxf(fmaxf(rect.top() - c.y, 0.0f), c.y - rect.bottom());
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+struct Sweep {
+    Circle circle;
+    glm::vec2 d;
+};
+
+// Starts around the rectangle and aims roughly at it, a fraction of the
+// circles already overlapping it
+static std::vector<Sweep> randomSweeps (Rng& rng, Rectangle const& rect, unsigned int n,
+                                        float overlapping = 0.0f) {
+    std::vector<Sweep> sweeps(n);
+
+    for (unsigned int i = 0; i < n; ++i) {
+        bool overlap = rng.uniform(0.0f, 1.0f) < overlapping;
+        glm::vec2 c;
+        do {
+            c = glm::vec2(rect.left() + rng.uniform(-250.0f, 250.0f),
+                          rect.top() + rng.uniform(-250.0f, 370.0f));
+        } while ((distanceToRect(c, rect) <= BALL_R) != overlap);
+
+        glm::vec2 target(rng.uniform(rect.left() - 30.0f, rect.right() + 30.0f),
+                         rng.uniform(rect.top() - 30.0f, rect.bottom() + 30.0f));
+        glm::vec2 dir = target - c;
+        float len = glm::length(dir);
+        if (len < 1e-3f) {
+            dir = glm::vec2(1.0f, 0.0f);
+            len = 1.0f;
+        }
+
+        sweeps[i].circle.init(c.x - BALL_R, c.y - BALL_R, BALL_R);
+        sweeps[i].d = dir * (rng.uniform(1.0f, 400.0f) / len);
+    }
+
+    return sweeps;
+}
+
+static void throughput (unsigned long count) {
+    Rng rng(7);
+    Rectangle paddle(SCREEN_W / 2, SCREEN_H / 2 - PADDLE_H / 2, PADDLE_W, PADDLE_H);
+    std::vector<Sweep> sweeps = randomSweeps(rng, paddle, 4096, 0.5f);
+    unsigned long hits = 0, overlaps = 0;
+    float sum = 0.0f;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned long i = 0; i < count; ++i) {
+        Sweep const& s = sweeps[i & 4095];
+        Contact contact;
+        if (sweep(s.circle, s.d, paddle, contact)) {
+            ++hits;
+            sum += contact.t;
+        }
+    }
+    double sweepSecs = seconds(start);
+
+    start = Clock::now();
+    for (unsigned long i = 0; i < count; ++i) {
+        Sweep const& s = sweeps[i & 4095];
+        if (s.circle.intersects(paddle)) {
+            ++overlaps;
+        }
+    }
+    double overlapSecs = seconds(start);
+
+    printf("swept:    %lu tests, %.0f tests/sec, %.2f ns/test (%lu hits, mean t %.3f)\n",
+           count, count / sweepSecs, sweepSecs * 1e9 / count, hits, hits ? sum / hits : 0.0f);
+    printf("discrete: %lu tests, %.0f tests/sec, %.2f ns/test (%lu overlaps)\n",
+           count, count / overlapSecs, overlapSecs * 1e9 / count, overlaps);
+}
+
+// Sub-steps every displacement and compares with sweep()
+static unsigned long agreement (unsigned int count) {
+    Rng rng(11);
+    Rectangle paddle(SCREEN_W / 2, SCREEN_H / 2 - PADDLE_H / 2, PADDLE_W, PADDLE_H);
+    std::vector<Sweep> sweeps = randomSweeps(rng, paddle, count);
+    const int substeps = 2000;
+    const float tolerance = 1e-2f;
+    unsigned long failures = 0;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        Sweep const& s = sweeps[i];
+        glm::vec2 c = s.circle.p + glm::vec2(BALL_R, BALL_R);
+
+        // Reference: first sub-step where the circle overlaps the paddle
+        float tRef = -1.0f, closest = 1e30f;
+        for (int k = 0; k <= substeps; ++k) {
+            float t = float(k) / substeps,
+                  dist = distanceToRect(c + s.d * t, paddle);
+            closest = fminf(closest, dist);
+            if (tRef < 0.0f && dist < BALL_R - tolerance) {
+                tRef = t;
+            }
+        }
+
+        Contact contact;
+        bool hit = sweep(s.circle, s.d, paddle, contact);
+
+        if (tRef >= 0.0f && ! hit) {
+            ++failures; // Missed contact: this is tunneling
+        } else if (hit && closest > BALL_R + tolerance) {
+            ++failures; // Phantom contact
+        } else if (hit) {
+            // The circle must be touching the paddle at the time of impact
+            float dist = distanceToRect(c + s.d * contact.t, paddle);
+            if (fabsf(dist - BALL_R) > tolerance && contact.t > 0.0f) {
+                ++failures;
+            }
+        }
+    }
+
+    printf("agreement with sub-stepping: %u sweeps, %lu failures\n", count, failures);
+    return failures;
+}
+
+// Old per-frame step: move, then test overlaps
+static unsigned int legacyStep (Simulation& sim) {
+    Ball& ball = sim.ball;
+    ball.move(sim.dt);
+
+    if (ball.y() < 0.0f) {
+        ball.y() = 0.0f;
+        ball.speed().y = -ball.speed().y;
+    } else if (ball.y() + 2 * ball.radius() > SCREEN_H) {
+        ball.y() = SCREEN_H - 2 * ball.radius();
+        ball.speed().y = -ball.speed().y;
+    } else if (ball.x() < 0.0f) {
+        return SIM_SCORE_CPU;
+    }
+
+    return ball.collide(sim.player) ? SIM_HIT_PLAYER : 0;
+}
+
+static void serve (Simulation& sim, glm::vec2 const& c, glm::vec2 const& v) {
+    sim.ball.init(c - glm::vec2(BALL_R, BALL_R), BALL_R, sim.rng);
+    sim.ball.v0 = v;
+    sim.ball.v = v;
+}
+
+// Every ball is aimed at the face of the player's paddle, so any that reaches
+// the left goal went through it. Straight shots come from anywhere in the
+// field; bounce shots hit the wall the paddle stands against first, both
+// within the first tick.
+static unsigned long tunneling (float speed, unsigned int trials, bool swept, bool bounce) {
+    Rng rng(uint32_t(speed * 1000) + (bounce ? 5 : 3));
+    unsigned long tunnels = 0;
+
+    for (unsigned int i = 0; i < trials; ++i) {
+        Simulation sim(rng.next());
+        sim.cpu.init(glm::vec2(SCREEN_W + 100.0f, 0.0f), glm::vec2(PADDLE_W, PADDLE_H));
+        float face = 10.0f + PADDLE_W + BALL_R; // Centre of the ball against it
+
+        if (! bounce) {
+            sim.player.init(glm::vec2(10.0f, rng.uniform(0.0f, SCREEN_H - PADDLE_H)),
+                            glm::vec2(PADDLE_W, PADDLE_H));
+            glm::vec2 c(rng.uniform(SCREEN_W / 4, SCREEN_W - 40.0f),
+                        rng.uniform(BALL_R, SCREEN_H - BALL_R)),
+                      target(face, rng.uniform(sim.player.top(), sim.player.bottom()));
+            serve(sim, c, speed * glm::normalize(target - c));
+        } else {
+            // Unfolded path: straight from the start to the mirror image of
+            // the hit point across the line the centre bounces on
+            bool top = rng.range(0, 1);
+            float theta = rng.uniform(M_PI / 12, 5 * M_PI / 12),
+                  length = speed * rng.uniform(0.5f, 0.95f),
+                  reach = fminf(length * sinf(theta), PADDLE_H - BALL_R),
+                  offset = rng.uniform(1.0f, reach - 1.0f); // From the wall line
+            glm::vec2 dir(cosf(theta), sinf(theta)),
+                      image(face, BALL_R - offset),
+                      c = image + dir * length;
+
+            sim.player.init(glm::vec2(10.0f, 0.0f), glm::vec2(PADDLE_W, PADDLE_H));
+            if (! top) {
+                sim.player.y() = SCREEN_H - PADDLE_H;
+                c.y = SCREEN_H - c.y;
+                dir.y = -dir.y;
+            }
+            serve(sim, c, -speed * dir);
+        }
+
+        for (int k = 0; k < 1000; ++k) {
+            unsigned int events = swept ? sim.step() : legacyStep(sim);
+
+            if (events & SIM_HIT_PLAYER) {
+                break;
+            } else if (events & SIM_SCORE_CPU) {
+                ++tunnels;
+                break;
+            }
+        }
+    }
+
+    return tunnels;
+}
+
+int main (int argc, char** argv) {
+    unsigned long count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 20000000;
+    unsigned int trials = argc > 2 ? strtoul(argv[2], nullptr, 10) : 20000;
+    unsigned long failures = 0;
+
+    throughput(count);
+    failures += agreement(100000);
+
+    const float speeds[] = { 5.0f, 10.0f, 20.0f, 30.0f, 50.0f, 100.0f, 150.0f, 200.0f };
+    printf("tunneling (%u balls per speed):\n", trials);
+    printf("  px/tick    swept    discrete\n");
+    for (float speed : speeds) {
+        unsigned long swept = tunneling(speed, trials, true, false),
+                      discrete = tunneling(speed, trials, false, false);
+        failures += swept;
+        printf("  %7.0f %8lu %11lu\n", speed, swept, discrete);
+    }
+
+    const float bounceSpeeds[] = { 100.0f, 150.0f, 200.0f };
+    printf("tunneling off a wall (%u balls per speed):\n", trials);
+    printf("  px/tick    swept    discrete\n");
+    for (float speed : bounceSpeeds) {
+        unsigned long swept = tunneling(speed, trials, true, true),
+                      discrete = tunneling(speed, trials, false, true);
+        failures += swept;
+        printf("  %7.0f %8lu %11lu\n", speed, swept, discrete);
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
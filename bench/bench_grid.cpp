@@ -0,0 +1,142 @@
+// Grid broadphase benchmark: incremental updates, candidate pairs and ball
+// queries at 100, 1k and 10k objects, against testing every pair.
+//
+// Usage: bench_grid [frames]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "grid.h"
+#include "rng.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Body {
+    Rectangle box;
+    glm::vec2 v;
+    unsigned int id;
+};
+
+static std::vector<Body> makeBodies (Rng& rng, unsigned int n) {
+    std::vector<Body> bodies(n);
+    // Keep the coverage of the screen roughly constant
+    float size = 400.0f / std::sqrt(float(n));
+
+    for (unsigned int i = 0; i < n; ++i) {
+        float w = rng.uniform(2.0f, 2.0f + size), h = rng.uniform(2.0f, 2.0f + size);
+        bodies[i].box.init(rng.uniform(0.0f, SCREEN_W - w), rng.uniform(0.0f, SCREEN_H - h), w, h);
+        // Half of them move
+        bodies[i].v = (i & 1) ? glm::vec2(rng.uniform(-3.0f, 3.0f), rng.uniform(-3.0f, 3.0f)) : glm::vec2(0.0f, 0.0f);
+    }
+
+    return bodies;
+}
+
+static void move (Body& b) {
+    b.box.move(b.v);
+    if (b.box.left() < 0.0f || b.box.right() > SCREEN_W) {
+        b.v.x = -b.v.x;
+    }
+    if (b.box.top() < 0.0f || b.box.bottom() > SCREEN_H) {
+        b.v.y = -b.v.y;
+    }
+}
+
+static unsigned long bruteForce (std::vector<Body> const& bodies) {
+    unsigned long n = 0;
+    for (unsigned int i = 0; i < bodies.size(); ++i) {
+        for (unsigned int j = i + 1; j < bodies.size(); ++j) {
+            n += bodies[i].box.intersects(bodies[j].box);
+        }
+    }
+    return n;
+}
+
+int main (int argc, char** argv) {
+    unsigned int frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200;
+    const unsigned int counts[] = { 100, 1000, 10000 };
+    int failures = 0;
+
+    printf("%7s %6s %11s %11s %11s %11s %11s %9s %9s\n",
+           "objects", "cell", "update us", "pairs us", "query us", "grid us", "brute us",
+           "cand.", "overlaps");
+
+    for (unsigned int n : counts) {
+        const float cells[] = { 16.0f, 32.0f, 64.0f };
+
+        for (float cell : cells) {
+            Rng rng(n);
+            std::vector<Body> bodies = makeBodies(rng, n);
+            Grid grid(cell);
+            for (Body& b : bodies) {
+                b.id = grid.insert(b.box);
+            }
+
+            std::vector<std::pair<unsigned int, unsigned int> > pairs;
+            std::vector<unsigned int> found;
+            double update = 0.0, pairing = 0.0, querying = 0.0;
+            unsigned long candidates = 0, overlaps = 0;
+
+            for (unsigned int f = 0; f < frames; ++f) {
+                // Incremental update of the moving half
+                Clock::time_point start = Clock::now();
+                for (Body& b : bodies) {
+                    if (b.v.x != 0.0f || b.v.y != 0.0f) {
+                        move(b);
+                        grid.update(b.id, b.box);
+                    }
+                }
+                update += seconds(start);
+
+                // All candidate pairs, then the narrow phase
+                start = Clock::now();
+                pairs.clear();
+                grid.pairs(pairs);
+                unsigned long hits = 0;
+                for (unsigned int k = 0; k < pairs.size(); ++k) {
+                    hits += bodies[pairs[k].first].box.intersects(bodies[pairs[k].second].box);
+                }
+                pairing += seconds(start);
+                candidates += pairs.size();
+                overlaps += hits;
+
+                // 64 balls looking for obstacles around them
+                start = Clock::now();
+                for (unsigned int k = 0; k < 64; ++k) {
+                    float x = (k * 151) % SCREEN_W, y = (k * 89) % SCREEN_H;
+                    found.clear();
+                    grid.query(x, y, x + 20.0f, y + 20.0f, found);
+                }
+                querying += seconds(start);
+            }
+
+            // Brute force on the final frame, and check that no overlap was missed
+            Clock::time_point start = Clock::now();
+            unsigned long brute = bruteForce(bodies);
+            double bruteSecs = seconds(start);
+
+            unsigned long last = 0;
+            for (unsigned int k = 0; k < pairs.size(); ++k) {
+                last += bodies[pairs[k].first].box.intersects(bodies[pairs[k].second].box);
+            }
+            if (last != brute) {
+                ++failures;
+            }
+
+            double grid_us = (update + pairing) * 1e6 / frames;
+            printf("%7u %6.0f %11.2f %11.2f %11.2f %11.2f %11.2f %9lu %9lu%s\n",
+                   n, cell, update * 1e6 / frames, pairing * 1e6 / frames, querying * 1e6 / frames,
+                   grid_us, bruteSecs * 1e6, candidates / frames, overlaps / frames,
+                   last != brute ? "  MISMATCH" : "");
+        }
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
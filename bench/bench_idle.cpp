@@ -0,0 +1,176 @@
+// Idle throttling benchmark: a simulated session (menu, a menu move, play,
+// pause) run through IdleThrottle with a fake clock. Draws are paced by
+// vblank, skipped iterations sleep until the next one. Reports wakeups and
+// draws per second in idle and active states, the delay from an input to
+// the frame that shows it, and the rendering CPU time saved, with a menu
+// frame drawn by the software vita2d backend.
+//
+// Usage: bench_idle [seconds]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "idle.h"
+#include <vita2d.h>
+#include "graphics_constants.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#define VBLANK_MICROS 16667
+
+enum { MENU, PLAY, PAUSE };
+
+// The scripted session, second by second
+struct Session {
+    unsigned int length;
+
+    int state (uint64_t t) const {
+        unsigned int s = t / 1000000 % length;
+        if (s < length * 4 / 10) return MENU;
+        if (s < length * 7 / 10) return PLAY;
+        return PAUSE;
+    }
+
+    // A menu move halfway through the menu, and the Start presses between
+    // states (one poll long, as a button edge)
+    bool input (uint64_t t, uint64_t last) const {
+        uint64_t cycle = uint64_t(length) * 1000000;
+        uint64_t events[] = { cycle * 2 / 10, cycle * 4 / 10, cycle * 7 / 10 };
+        uint64_t c = t / cycle * cycle;
+        for (uint64_t e : events) {
+            if (last < c + e && c + e <= t) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Cost of one menu frame on the software backend
+static double menuFrameMicros () {
+    vita2d_init();
+    vita2d_set_clear_color(BLACK);
+    vita2d_pgf* pgf = vita2d_load_default_pgf();
+
+    const unsigned int n = 200;
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) {
+        vita2d_start_drawing();
+        vita2d_clear_screen();
+        vita2d_pgf_draw_text(pgf, SCREEN_W / 2 - 40, SCREEN_H / 2 - 100, WHITE, 2.0f, "Pong");
+        const char* choices[] = { "One Player", "Two Players", "Multiball", "Arena", "Quit" };
+        for (unsigned int c = 0; c < 5; ++c) {
+            vita2d_pgf_draw_text(pgf, SCREEN_W / 2 - 50, SCREEN_H / 2 - 50 + 20 * c, c ? WHITE : RED, 1.0f, choices[c]);
+        }
+        vita2d_end_drawing();
+        vita2d_swap_buffers();
+    }
+    double t = 1e6 * seconds(start) / n;
+
+    vita2d_free_pgf(pgf);
+    vita2d_fini();
+    return t;
+}
+
+int main (int argc, char** argv) {
+    unsigned int length = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10;
+    if (length < 10) {
+        length = 10;
+    }
+
+    Session session = { length };
+    IdleThrottle throttle;
+    int failures = 0;
+
+    // Four runs of the session, on the fake clock
+    uint64_t t = 1000000, last = t, end = t + 4ull * length * 1000000;
+    unsigned int menuMove = 0;
+    uint64_t pending = 0, worstDelay = 0;
+    unsigned int idleSeconds = 0, activeSeconds = 0;
+    unsigned int maxIdleWakeups = 0, maxIdleDraws = 0, minActiveDraws = ~0u;
+    uint64_t publishedAt = 0;
+
+    while (t < end) {
+        bool in = session.input(t, last);
+        if (in && ! pending) {
+            // The input's time: somewhere since the last poll
+            pending = last + 1;
+            menuMove += session.state(t) == MENU;
+        }
+        last = t;
+
+        int state = session.state(t);
+        bool draw = throttle.frame(t, state != PLAY, (uint64_t(state) << 32) | menuMove, in);
+
+        if (draw) {
+            if (pending) {
+                uint64_t delay = t - pending;
+                if (delay > worstDelay) {
+                    worstDelay = delay;
+                }
+                pending = 0;
+            }
+            t += VBLANK_MICROS;
+        } else {
+            // A skipped frame never leaves an input unanswered
+            if (pending) {
+                printf("FAIL: input at %llu us not drawn\n", (unsigned long long) pending);
+                ++failures;
+                pending = 0;
+            }
+            // Up to the next vblank
+            t = (t / VBLANK_MICROS + 1) * VBLANK_MICROS;
+        }
+
+        // One reading of the per-second counters per second
+        if (t / 1000000 != publishedAt / 1000000) {
+            publishedAt = t;
+            if (throttle.wakeups) {
+                if (throttle.wakeups == throttle.idleWakeups && throttle.draws == throttle.idleDraws &&
+                    session.state(t - 1000000) != PLAY && session.state(t - 2000000) != PLAY) {
+                    ++idleSeconds;
+                    maxIdleWakeups = throttle.idleWakeups > maxIdleWakeups ? throttle.idleWakeups : maxIdleWakeups;
+                    maxIdleDraws = throttle.idleDraws > maxIdleDraws ? throttle.idleDraws : maxIdleDraws;
+                } else if (session.state(t - 1000000) == PLAY && session.state(t - 2000000) == PLAY &&
+                           session.state(t) == PLAY) {
+                    ++activeSeconds;
+                    minActiveDraws = throttle.draws < minActiveDraws ? throttle.draws : minActiveDraws;
+                }
+            }
+        }
+    }
+
+    double frameMicros = menuFrameMicros();
+    unsigned int fullRate = (1000000 + VBLANK_MICROS / 2) / VBLANK_MICROS;
+
+    printf("%u s session x 4, polling every vblank when idle\n", length);
+    printf("  idle:   %3u wakeups/s, %u draws/s (without throttling: %u and %u), over %u s\n",
+           maxIdleWakeups, maxIdleDraws, fullRate, fullRate, idleSeconds);
+    printf("  active: %3u draws/s at least, over %u s\n", minActiveDraws, activeSeconds);
+    printf("  input to frame: %.1f ms at worst\n", worstDelay / 1000.0);
+    printf("  frames drawn %llu, skipped %llu\n",
+           (unsigned long long) throttle.framesDrawn, (unsigned long long) throttle.framesSkipped);
+    printf("  menu frame on the software backend: %.1f us, idle render CPU %.2f -> %.2f ms/s\n",
+           frameMicros, fullRate * frameMicros / 1000.0, maxIdleDraws * frameMicros / 1000.0);
+
+    if (! idleSeconds || maxIdleWakeups > fullRate + 1 || maxIdleDraws > 1) {
+        printf("FAIL: idle states not throttled\n");
+        ++failures;
+    }
+    if (! activeSeconds || minActiveDraws + 1 < fullRate) {
+        printf("FAIL: play not at full rate\n");
+        ++failures;
+    }
+    if (worstDelay > VBLANK_MICROS) {
+        printf("FAIL: input took more than a display frame to show\n");
+        ++failures;
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,139 @@
+// Buffered input benchmark: a controller sampled every vblank, with short
+// taps, read by a game whose frames take longer than a vblank (as with
+// multiball on screen). Counts the presses seen by reading only the latest
+// sample against draining every buffered one with InputBuffer, and checks
+// the game-clock timestamps the latency measure relies on.
+//
+// Usage: bench_input [seconds]
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+
+#include "input_buffer.h"
+#include "rng.h"
+
+#define SAMPLE_MICROS 16667
+#define BUTTON 0x10
+
+// The driver's ring: the last INPUT_BUFFERS samples, oldest first
+struct Controller {
+    std::deque<PadSample> ring;
+    uint64_t offset; // Controller clock minus game clock
+
+    void sample (uint64_t now, uint32_t buttons) {
+        PadSample s = {};
+        s.buttons = buttons;
+        s.stamp = now + offset;
+        ring.push_back(s);
+        if (ring.size() > INPUT_BUFFERS) {
+            ring.pop_front();
+        }
+    }
+
+    unsigned int peek (PadSample* out, unsigned int n) const {
+        unsigned int count = ring.size() < n ? ring.size() : n;
+        for (unsigned int i = 0; i < count; ++i) {
+            out[i] = ring[ring.size() - count + i];
+        }
+        return count;
+    }
+};
+
+int main (int argc, char** argv) {
+    unsigned int length = argc > 1 ? strtoul(argv[1], nullptr, 10) : 600;
+    const uint64_t frameMicros[] = { 16667, 33333, 50000 };
+    int failures = 0;
+
+    printf("%10s %8s %10s %10s %10s %14s\n", "frame ms", "presses", "latest", "buffered", "recovered", "stamp error");
+
+    for (uint64_t frame : frameMicros) {
+        Rng rng(frame);
+        Controller pad;
+        pad.offset = 123456789;
+        InputBuffer buffer;
+
+        uint64_t end = uint64_t(length) * 1000000;
+        uint64_t nextSample = 0, nextFrame = frame;
+        uint64_t nextTap = 500000, tapEnd = 0, tapStart = 0;
+        unsigned int presses = 0, seenLatest = 0, seenBuffered = 0;
+        uint32_t lastLatest = 0;
+        uint64_t worstError = 0;
+        bool pressSampled = false;
+
+        for (uint64_t t = 0; t < end; t += 1000) {
+            // Taps of 1 to 3 samples, every 100 to 600 ms
+            if (t >= nextTap && ! tapEnd) {
+                tapStart = t;
+                tapEnd = t + (1 + rng.next() % 3) * SAMPLE_MICROS;
+                pressSampled = false;
+            }
+            if (tapEnd && t >= tapEnd) {
+                tapEnd = 0;
+                nextTap = t + 100000 + rng.next() % 500000;
+            }
+
+            if (t >= nextSample) {
+                bool down = tapEnd != 0;
+                if (down && ! pressSampled) {
+                    pressSampled = true;
+                    ++presses;
+                    tapStart = t;
+                }
+                pad.sample(t, down ? BUTTON : 0);
+                nextSample += SAMPLE_MICROS;
+            }
+
+            if (t >= nextFrame) {
+                PadSample samples[INPUT_BUFFERS];
+                unsigned int n = pad.peek(samples, INPUT_BUFFERS);
+
+                // Latest sample only, as sceCtrlPeekBufferPositive(0, &pad, 1)
+                uint32_t latest = n ? samples[n - 1].buttons : 0;
+                seenLatest += (latest & BUTTON) && ! (lastLatest & BUTTON);
+                lastLatest = latest;
+
+                buffer.feed(samples, n, t);
+                if (buffer.pressed & BUTTON) {
+                    ++seenBuffered;
+
+                    // The press is dated on the game clock from its age
+                    uint64_t stamp = buffer.firstPress(BUTTON);
+                    uint64_t error = stamp > tapStart ? stamp - tapStart : tapStart - stamp;
+                    worstError = error > worstError ? error : worstError;
+                }
+                buffer.endFrame();
+
+                nextFrame += frame;
+            }
+        }
+
+        printf("%10.1f %8u %10u %10u %10llu %11.1f ms\n", frame / 1000.0, presses, seenLatest, seenBuffered,
+               (unsigned long long) buffer.tapsRecovered, worstError / 1000.0);
+
+        // A tap still down at the end may not have been read yet
+        if (seenBuffered + 1 < presses || seenBuffered > presses) {
+            printf("FAIL: %u of %u presses seen with the buffer\n", seenBuffered, presses);
+            ++failures;
+        }
+        if (worstError > SAMPLE_MICROS) {
+            printf("FAIL: press stamps off by %.1f ms\n", worstError / 1000.0);
+            ++failures;
+        }
+    }
+
+    // Latency: from the press to the frame that shows it
+    InputLatency latency;
+    latency.input(1000);
+    latency.input(2000); // Ignored, the first is pending
+    latency.acted();
+    latency.shown(17000);
+    latency.shown(34000); // Nothing acting
+    if (latency.count != 1 || latency.last != 16000) {
+        printf("FAIL: latency %u over %llu inputs\n", latency.last, (unsigned long long) latency.count);
+        ++failures;
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
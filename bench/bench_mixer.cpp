@@ -0,0 +1,407 @@
+// Mixer benchmark: cost of one VITA_NUM_AUDIO_SAMPLES buffer at 1, 8, 32 and
+// 128 voices, for vitaMixerMix and for the former per-sample loop over
+// every slot (reproduced below). Also checks that both produce the same
+// samples, that plays are offset by their tick, and that commands sent from
+// another thread while mixing are all applied.
+//
+// Then weighs converting sounds to the native format at load time against
+// what it saves on every buffer they are mixed in, and simulates the audio
+// thread at each period to report trigger to output latency, underruns and
+// how much of the period mixing takes.
+//
+// Usage: bench_mixer [buffers]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "vita_mixer.h"
+#include "rng.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// Former wavout_snd_callback
+namespace legacy {
+    static vitaWav info[VITA_WAV_MAX_SLOTS];
+    static int playing[VITA_WAV_MAX_SLOTS];
+
+    static void play (vitaWav const& wav) {
+        for (int i = 0; i < VITA_WAV_MAX_SLOTS; ++i) {
+            if (! playing[i]) {
+                info[i] = wav;
+                info[i].playPtr = 0;
+                info[i].playPtr_frac = 0;
+                playing[i] = 1;
+                return;
+            }
+        }
+    }
+
+    static void mix (short* buf, unsigned int reqn) {
+        for (unsigned int i = 0; i < reqn; i++) {
+            int outr = 0, outl = 0;
+
+            for (int slot = 0; slot < VITA_WAV_MAX_SLOTS; slot++) {
+                if (! playing[slot]) continue;
+
+                vitaWav* wi = &info[slot];
+                unsigned long frac = wi->playPtr_frac + wi->rateRatio;
+                unsigned long ptr;
+                wi->playPtr = ptr = wi->playPtr + (frac >> 16);
+                wi->playPtr_frac = (frac & 0xffff);
+
+                if (ptr >= wi->sampleCount) {
+                    if (wi->loop) {
+                        wi->playPtr = 0;
+                        wi->playPtr_frac = 0;
+                        ptr = 0;
+                    } else {
+                        playing[slot] = 0;
+                        break;
+                    }
+                }
+
+                short* src16 = (short*) wi->data;
+                unsigned char* src8 = (unsigned char*) wi->data;
+
+                if (wi->channels == 1) {
+                    if (wi->bitPerSample == 8) {
+                        outl += (src8[ptr] * 256) - 32768;
+                        outr += (src8[ptr] * 256) - 32768;
+                    } else {
+                        outl += src16[ptr];
+                        outr += src16[ptr];
+                    }
+                } else {
+                    if (wi->bitPerSample == 8) {
+                        outl += (src8[ptr * 2] * 256) - 32768;
+                        outr += (src8[ptr * 2 + 1] * 256) - 32768;
+                    } else {
+                        outl += src16[ptr * 2];
+                        outr += src16[ptr * 2 + 1];
+                    }
+                }
+            }
+
+            if (outl < -32768) outl = -32768;
+            else if (outl > 32767) outl = 32767;
+            if (outr < -32768) outr = -32768;
+            else if (outr > 32767) outr = 32767;
+
+            *(buf++) = outl;
+            *(buf++) = outr;
+        }
+    }
+}
+
+// Synthetic looping sound in one of the four formats
+static vitaWav makeWav (Rng& rng, std::vector<unsigned char>& storage,
+                        unsigned long channels, unsigned int bits, unsigned long rate, unsigned long frames) {
+    storage.resize(frames * channels * bits / 8);
+    for (unsigned int i = 0; i < storage.size(); ++i) {
+        // Quiet enough that a few voices do not saturate
+        storage[i] = (bits == 8) ? 128 + rng.range(-8, 8) : rng.range(0, 255);
+        if (bits == 16 && (i & 1)) {
+            storage[i] = rng.range(-3, 3);
+        }
+    }
+
+    vitaWav wav;
+    memset(&wav, 0, sizeof(wav));
+    wav.channels = channels;
+    wav.sampleRate = rate;
+    wav.sampleCount = frames;
+    wav.dataLength = storage.size();
+    wav.rateRatio = (rate * 0x4000) / 11025;
+    wav.loop = 1;
+    wav.data = storage.data();
+    wav.bitPerSample = bits;
+    return wav;
+}
+
+// A sound played one tick after the first command of its buffer starts one
+// tick's worth of frames into it
+static bool checkTickOffset (vitaWav wav) {
+    const unsigned int hz = 120;
+    const unsigned int offset = VITA_AUDIO_FREQUENCY / hz;
+    std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+
+    vitaMixerReset();
+    vitaMixerSetTick(0);
+    vitaMixerSetTickRate(hz);
+    vitaMixerSetTick(1);
+    vitaMixerPlay(&wav, VITA_VOLUME_MAX);
+    vitaMixerMix(out.data(), VITA_NUM_AUDIO_SAMPLES);
+
+    for (unsigned int i = 0; i < 2 * offset; ++i) {
+        if (out[i] != 0) return false;
+    }
+    return out[2 * offset] != 0;
+}
+
+// The game thread plays and stops sounds while the audio thread mixes:
+// every voice started must be stopped in the end
+static bool checkThreaded (vitaWav wav, unsigned int commands) {
+    std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+    std::atomic<bool> done(false);
+    unsigned long retries = 0;
+
+    vitaMixerReset();
+    std::thread game([&] {
+        for (unsigned int i = 0; i < commands; ++i) {
+            wav.id = 1 + (i % 64);
+            vitaMixerSetTick(i);
+            while (! vitaMixerPlay(&wav, VITA_VOLUME_MAX)) { ++retries; std::this_thread::yield(); }
+            while (! vitaMixerStop(wav.id)) { ++retries; std::this_thread::yield(); }
+        }
+        done = true;
+    });
+
+    unsigned int buffers = 0;
+    while (! done) {
+        vitaMixerMix(out.data(), 64);
+        ++buffers;
+        std::this_thread::yield(); // Stands for the blocking output
+    }
+    game.join();
+    vitaMixerMix(out.data(), 64);
+
+    printf("threaded: %u play/stop pairs over %u buffers, %lu full-queue retries, %d voices left\n",
+           commands, buffers, retries, vitaMixerActiveVoices());
+    return vitaMixerActiveVoices() == 0 && vitaMixerDroppedCommands() == retries;
+}
+
+// Time to run the mixer for the given buffers with n voices of a sound
+static double mixSeconds (vitaWav const& wav, int n, unsigned int buffers) {
+    std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+
+    vitaMixerReset();
+    for (int v = 0; v < n; ++v) {
+        vitaMixerPlay(&wav, VITA_VOLUME_MAX);
+    }
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int b = 0; b < buffers; ++b) {
+        vitaMixerMix(out.data(), VITA_NUM_AUDIO_SAMPLES);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static vitaWav convert (vitaWav const& wav, std::vector<short>& storage) {
+    storage.resize(vitaMixerConvertedFrames(&wav) * 2);
+    vitaMixerConvert(&wav, storage.data());
+
+    vitaWav native = wav;
+    native.channels = 2;
+    native.bitPerSample = 16;
+    native.sampleRate = VITA_AUDIO_FREQUENCY;
+    native.sampleCount = storage.size() / 2;
+    native.dataLength = storage.size() * sizeof(short);
+    native.rateRatio = 0x10000;
+    native.data = (unsigned char*) storage.data();
+    return native;
+}
+
+// Converted at the output rate, a sound must mix to the very same samples
+static bool checkSameRate (vitaWav const& wav) {
+    const unsigned int samples = 20 * VITA_NUM_AUDIO_SAMPLES * 2;
+    std::vector<short> storage, a(samples), b(samples);
+    vitaWav native = convert(wav, storage);
+
+    vitaMixerReset();
+    vitaMixerPlay(&wav, VITA_VOLUME_MAX);
+    for (unsigned int i = 0; i < samples; i += VITA_NUM_AUDIO_SAMPLES * 2) {
+        vitaMixerMix(&a[i], VITA_NUM_AUDIO_SAMPLES);
+    }
+
+    vitaMixerReset();
+    vitaMixerPlay(&native, VITA_VOLUME_MAX);
+    for (unsigned int i = 0; i < samples; i += VITA_NUM_AUDIO_SAMPLES * 2) {
+        vitaMixerMix(&b[i], VITA_NUM_AUDIO_SAMPLES);
+    }
+
+    return a == b;
+}
+
+static void benchConversion (Rng& rng, unsigned int buffers) {
+    const unsigned long rates[] = { 22050, 32000 };
+    const int voices = 32;
+
+    printf("\n%-18s %11s %15s %15s %14s\n",
+           "1 s sound", "convert us", "mix us/voice", "native us/voice", "payback bufs");
+
+    for (unsigned long rate : rates) {
+        for (int f = 0; f < 4; ++f) {
+            unsigned long channels = 1 + (f & 1);
+            unsigned int bits = (f & 2) ? 16 : 8;
+            std::vector<unsigned char> data;
+            vitaWav wav = makeWav(rng, data, channels, bits, rate, rate);
+
+            std::vector<short> storage;
+            const int reps = 20;
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < reps; ++i) {
+                convert(wav, storage);
+            }
+            double convertUs = std::chrono::duration<double>(Clock::now() - start).count() * 1e6 / reps;
+            vitaWav native = convert(wav, storage);
+
+            double mixUs = mixSeconds(wav, voices, buffers) * 1e6 / buffers / voices;
+            double nativeUs = mixSeconds(native, voices, buffers) * 1e6 / buffers / voices;
+
+            char name[32];
+            snprintf(name, sizeof(name), "%s %2u bit %5lu", channels == 1 ? "mono  " : "stereo", bits, rate);
+            printf("%-18s %11.1f %15.3f %15.3f %14.0f\n", name, convertUs, mixUs, nativeUs,
+                   mixUs > nativeUs ? convertUs / (mixUs - nativeUs) : -1.0);
+        }
+    }
+}
+
+static unsigned long long simulatedMicros = 0;
+
+static unsigned long long simulatedClock () {
+    return simulatedMicros;
+}
+
+// Ten simulated seconds: the game plays a sound on a quarter of its 120 Hz
+// ticks, the port starts a buffer every period (one of them late), and the
+// audio thread mixes the next buffer as soon as the port takes one
+static bool benchLatency (vitaWav const& wav, unsigned int buffers) {
+    const unsigned int periods[] = { 1024, 512, 256, 128 };
+    const unsigned int hz = 120;
+    bool ok = true;
+
+    printf("\n%6s %10s %12s %12s %10s %18s\n",
+           "period", "plays", "latency avg", "latency max", "underruns", "mix 32 voices");
+
+    for (unsigned int period : periods) {
+        Rng rng(period);
+        std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+        unsigned long long periodMicros = (unsigned long long) period * 1000000 / VITA_AUDIO_FREQUENCY;
+        unsigned long long nextTick = 0, nextBuffer = 0;
+        unsigned int tick = 0, buffer = 0;
+
+        simulatedMicros = 0;
+        vitaMixerReset();
+        vitaMixerSetClock(simulatedClock);
+        vitaMixerSetTickRate(hz);
+
+        while (simulatedMicros < 10000000) {
+            if (nextTick <= nextBuffer) {
+                simulatedMicros = nextTick;
+                vitaMixerSetTick(tick++);
+                if (rng.range(0, 3) == 0) {
+                    vitaMixerPlay(&wav, VITA_VOLUME_MAX);
+                }
+                nextTick = (unsigned long long) tick * 1000000 / hz;
+            } else {
+                simulatedMicros = nextBuffer;
+                vitaMixerOutput(simulatedMicros, period);
+                vitaMixerMix(out.data(), period);
+                nextBuffer += periodMicros + (++buffer == 100 ? periodMicros : 0);
+            }
+        }
+
+        vitaAudioStats stats;
+        vitaMixerGetStats(&stats);
+        vitaMixerSetClock(nullptr);
+
+        // Real cost of a buffer, against the time it lasts
+        vitaWav looped = wav;
+        looped.loop = 1;
+        double mixUs = mixSeconds(looped, 32, buffers) * 1e6 / buffers * period / VITA_NUM_AUDIO_SAMPLES;
+
+        printf("%6u %10lu %9.2f ms %9.2f ms %10lu %8.1f us %5.1f%%\n", period, stats.plays,
+               stats.latencySum / 1000.0 / stats.plays, stats.latencyMax / 1000.0,
+               stats.underruns, mixUs, 100.0 * mixUs / periodMicros);
+
+        // A play waits for at most the buffer being mixed, the one playing
+        // while its own waits at the port, and its tick offset within it
+        ok = ok && stats.underruns == 1 && stats.latencyMax <= 3 * periodMicros + 1000000 / hz;
+    }
+
+    printf("latency bounds and underrun detection: %s\n", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main (int argc, char** argv) {
+    unsigned int buffers = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+    const int voices[] = { 1, 8, 32, 128 };
+    const unsigned long rates[] = { 44100, 22050, 32000 };
+    const unsigned int frames = VITA_NUM_AUDIO_SAMPLES;
+
+    Rng rng(9);
+    std::vector<std::vector<unsigned char> > storage(12);
+    std::vector<vitaWav> wavs;
+    for (int i = 0; i < 12; ++i) {
+        wavs.push_back(makeWav(rng, storage[i], 1 + (i & 1), (i & 2) ? 16 : 8, rates[i % 3],
+                               5000 + 777 * i));
+        wavs.back().id = i + 1;
+    }
+
+    std::vector<short> out(frames * 2), ref(frames * 2);
+    int failures = 0;
+
+    printf("%6s %14s %14s %8s %10s\n", "voices", "legacy us/buf", "mixer us/buf", "speedup", "identical");
+
+    for (int n : voices) {
+        memset(legacy::playing, 0, sizeof(legacy::playing));
+        vitaMixerReset();
+        for (int v = 0; v < n; ++v) {
+            legacy::play(wavs[v % wavs.size()]);
+            vitaMixerPlay(&wavs[v % wavs.size()], VITA_VOLUME_MAX);
+        }
+
+        // Same output, buffer after buffer (across loop points)
+        bool identical = true;
+        for (int b = 0; b < 50; ++b) {
+            legacy::mix(ref.data(), frames);
+            vitaMixerMix(out.data(), frames);
+            identical = identical && memcmp(ref.data(), out.data(), out.size() * sizeof(short)) == 0;
+        }
+        failures += ! identical;
+
+        Clock::time_point start = Clock::now();
+        for (unsigned int b = 0; b < buffers; ++b) {
+            legacy::mix(ref.data(), frames);
+        }
+        double legacySecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        start = Clock::now();
+        for (unsigned int b = 0; b < buffers; ++b) {
+            vitaMixerMix(out.data(), frames);
+        }
+        double mixerSecs = std::chrono::duration<double>(Clock::now() - start).count();
+
+        printf("%6d %14.2f %14.2f %7.1fx %10s\n", n,
+               legacySecs * 1e6 / buffers, mixerSecs * 1e6 / buffers,
+               legacySecs / mixerSecs, identical ? "yes" : "NO");
+    }
+
+    bool offset = checkTickOffset(wavs[2]);
+    printf("tick offset: %s\n", offset ? "ok" : "FAILED");
+    failures += ! offset;
+
+    failures += ! checkThreaded(wavs[0], 200000);
+
+    bool sameRate = true;
+    for (unsigned int i = 0; i < wavs.size(); i += 3) {
+        sameRate = sameRate && checkSameRate(wavs[i]);
+    }
+    printf("same-rate conversion: %s\n", sameRate ? "exact" : "DIFFERS");
+    failures += ! sameRate;
+
+    benchConversion(rng, buffers / 4 + 1);
+
+    std::vector<unsigned char> beepData;
+    std::vector<short> beepStorage;
+    vitaWav beep = convert(makeWav(rng, beepData, 1, 16, 22050, 2205), beepStorage);
+    beep.loop = 0;
+    failures += ! benchLatency(beep, buffers / 4 + 1);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
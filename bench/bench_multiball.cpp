@@ -0,0 +1,117 @@
+// Multiball benchmark: SoA/SIMD MultiBall::step against a vector of Ball
+// objects stepped with Ball::move and Ball::collide. Fails unless both end
+// with the same hits and the same balls, to the bit.
+//
+// Usage: bench_multiball [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "multiball.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void setupPaddles (Paddle& player, Paddle& cpu) {
+    player.init(glm::vec2(10, SCREEN_H / 2 - PADDLE_H / 2), glm::vec2(PADDLE_W, PADDLE_H));
+    player.player = true;
+    cpu.init(glm::vec2(SCREEN_W - 10 - PADDLE_W, SCREEN_H / 2 - PADDLE_H / 2), glm::vec2(PADDLE_W, PADDLE_H));
+    cpu.player = false;
+}
+
+// Per-object path, as Simulation::step did before swept collisions
+static unsigned int stepObjects (std::vector<Ball>& balls, Paddle const& player, Paddle const& cpu) {
+    unsigned int hits = 0;
+
+    for (Ball& ball : balls) {
+        ball.move();
+
+        if (ball.y() < 0.0f) {
+            ball.y() = 0.0f;
+            ball.speed().y = -ball.speed().y;
+        } else if (ball.y() + 2 * ball.radius() > SCREEN_H) {
+            ball.y() = SCREEN_H - 2 * ball.radius();
+            ball.speed().y = -ball.speed().y;
+        } else if (ball.x() < 0.0f || ball.x() + 2 * ball.radius() > SCREEN_W) {
+            ball.x() = SCREEN_W / 2;
+            ball.y() = SCREEN_H / 2;
+            ball.speed().x = -ball.speed().x;
+        }
+
+        if (ball.collide(player) || ball.collide(cpu)) {
+            ++hits;
+        }
+    }
+
+    return hits;
+}
+
+static bool same (std::vector<Ball> const& balls, MultiBall const& multi) {
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        float a[4] = { balls[i].x(), balls[i].y(), balls[i].speed().x, balls[i].speed().y },
+              b[4] = { multi.x[i], multi.y[i], multi.vx[i], multi.vy[i] };
+        if (memcmp(a, b, sizeof(a)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main (int argc, char** argv) {
+    unsigned int frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000;
+    const unsigned int counts[] = { 16, 256, 1024, 4096, 16384 };
+    const double frameBudget = 1.0 / 60.0;
+
+    Paddle player, cpu;
+    setupPaddles(player, cpu);
+    bool ok = true;
+
+    printf("%8s %14s %14s %16s %16s %8s\n",
+           "balls", "objects ns/b", "soa ns/b", "objects b/frame", "soa b/frame", "speedup");
+
+    for (unsigned int n : counts) {
+        Rng rng(n);
+        MultiBall multi;
+        multi.spawn(rng, n);
+
+        std::vector<Ball> balls(n);
+        for (unsigned int i = 0; i < n; ++i) {
+            balls[i].init(glm::vec2(multi.x[i], multi.y[i]), multi.r[i], rng);
+            balls[i].v0 = balls[i].v = glm::vec2(multi.vx[i], multi.vy[i]);
+        }
+
+        unsigned long hitsObjects = 0, hitsSoa = 0;
+
+        Clock::time_point start = Clock::now();
+        for (unsigned int f = 0; f < frames; ++f) {
+            hitsObjects += stepObjects(balls, player, cpu);
+        }
+        double objects = seconds(start);
+
+        start = Clock::now();
+        for (unsigned int f = 0; f < frames; ++f) {
+            multi.step(player, cpu, 1.0f);
+            hitsSoa += multi.hitsPlayer + multi.hitsCpu;
+        }
+        double soa = seconds(start);
+
+        double nsObjects = objects * 1e9 / (double(frames) * n),
+               nsSoa = soa * 1e9 / (double(frames) * n);
+
+        printf("%8u %14.2f %14.2f %16.0f %16.0f %7.1fx   (hits %lu / %lu)\n",
+               n, nsObjects, nsSoa,
+               frameBudget * 1e9 / nsObjects, frameBudget * 1e9 / nsSoa,
+               nsObjects / nsSoa, hitsObjects, hitsSoa);
+
+        ok = ok && hitsObjects == hitsSoa && same(balls, multi);
+    }
+
+    printf("\nsame as Ball::collide: %s\n", ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,341 @@
+// Rollback netcode harness: two RollbackSessions in one process playing a
+// Two Players match, simulated players on both sides, over a link with
+// latency, jitter and loss on the simulated 120 Hz clock (in memory, or
+// real UDP sockets on the loopback with -u). For each network and input
+// delay: how often and how deep the sessions roll back, the ticks played
+// again and the time advance() takes per frame, the waits for the other
+// side, and the bytes sent. Both sides must agree on every checksum, the
+// confirmed inputs played again from scratch must give the same states,
+// and a state changed on one side only must be told as a desync.
+//
+// Usage: bench_netplay [seconds per network] [-u]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "netplay.h"
+#include "udp.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#define TICK_HZ 120
+#define SEED 2024
+
+struct Datagram {
+    unsigned int due; // Frame it arrives at
+    std::vector<uint8_t> data;
+};
+
+// One way of the in-memory link
+struct Wire {
+    std::deque<Datagram> queue;
+};
+
+struct Network {
+    const char* name;
+    float latency, jitter; // One way, ms
+    float loss;            // Fraction of the packets
+};
+
+// Delays, drops and reorders what one side sends, on the simulated clock,
+// then hands it to the wire, or to the socket that really sends it
+struct LagTransport : NetTransport {
+    void send (const uint8_t* data, size_t size) override {
+        if (rng.uniform(0.0f, 1.0f) < network.loss) {
+            return;
+        }
+        float ms = network.latency + rng.uniform(-network.jitter, network.jitter);
+        Datagram d;
+        d.due = *now + (unsigned int) lroundf(fmaxf(ms, 0.0f) * TICK_HZ / 1000.0f);
+        d.data.assign(data, data + size);
+        pending.push_back(d);
+    }
+
+    size_t receive (uint8_t* data, size_t size) override {
+        // Whatever is due on both ways: ours to the socket, theirs to us
+        for (size_t i = 0; i < pending.size();) {
+            if (pending[i].due <= *now) {
+                if (udp) {
+                    udp->send(&pending[i].data[0], pending[i].data.size());
+                } else {
+                    out->queue.push_back(pending[i]);
+                }
+                pending.erase(pending.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+
+        if (udp) {
+            return udp->receive(data, size);
+        }
+        if (in->queue.empty() || in->queue.front().data.size() > size) {
+            return 0;
+        }
+        size_t n = in->queue.front().data.size();
+        memcpy(data, &in->queue.front().data[0], n);
+        in->queue.pop_front();
+        return n;
+    }
+
+    Network network;
+    Rng rng;
+    const unsigned int* now = nullptr;
+    std::deque<Datagram> pending;
+    Wire *out = nullptr, *in = nullptr;
+    UdpTransport* udp = nullptr;
+};
+
+// Follows the ball with its own paddle, in the state its session shows: with
+// the d-pad, or on some rallies the left stick, which changes every tick
+struct Bot {
+    TickInput frame (RollbackSession const& session) {
+        TickInput in;
+        Simulation const& sim = session.match.sim;
+        Paddle const& paddle = session.side ? sim.cpu : sim.player;
+        bool coming = session.side ? sim.ball.v.x > 0.0f : sim.ball.v.x < 0.0f;
+        if (coming && ! wasComing) {
+            error = rng.uniform(-60.0f, 60.0f);
+            stick = rng.range(0, 2) == 0;
+        }
+        wasComing = coming;
+
+        float target = coming ? sim.ball.y() + sim.ball.r + error : SCREEN_H / 2;
+        float d = target - (paddle.y() + PADDLE_H / 2);
+        if (stick) {
+            in.ly = TickInput::stick(int(fmaxf(-127.0f, fminf(127.0f, d))));
+            return in;
+        }
+        moving = fabsf(d) > (moving ? 8.0f : 24.0f);
+        if (moving) {
+            in.buttons = d < 0.0f ? MATCH_UP : MATCH_DOWN;
+        }
+        return in;
+    }
+
+    Rng rng;
+    float error = 0.0f;
+    bool wasComing = false, moving = false, stick = false;
+};
+
+// What one side saw
+struct Peer {
+    RollbackSession session;
+    LagTransport transport;
+    Bot bot;
+    std::vector<TickInput> log;  // Confirmed inputs
+    std::vector<uint32_t> sums;  // Confirmed checksums, by index
+    double seconds = 0.0, worst = 0.0, rollbackSeconds = 0.0;
+    uint64_t rollbackFrames = 0;
+
+    void frame () {
+        uint64_t rollbacks = session.stats.rollbacks;
+        TickInput in = bot.frame(session);
+
+        Clock::time_point start = Clock::now();
+        session.advance(in, transport);
+        double s = ::seconds(start);
+
+        seconds += s;
+        worst = s > worst ? s : worst;
+        if (session.stats.rollbacks != rollbacks) {
+            rollbackSeconds += s;
+            ++rollbackFrames;
+        }
+
+        while (log.size() < session.confirmed()) {
+            log.push_back(session.played(log.size()));
+        }
+        while (sums.size() < session.checksums()) {
+            sums.push_back(session.checksum(sums.size() + 1));
+        }
+    }
+};
+
+// Plays the confirmed inputs again in a plain Match: the same checksums, or
+// the index of the first that differs. Times the plain tick on the way.
+static unsigned int replay (Peer const& peer, double& tickSeconds) {
+    Match match;
+    match.setTickRate(TICK_HZ);
+    match.start(GameMode::TwoPlayers, SEED);
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int t = 0; t < peer.log.size(); ++t) {
+        if (t && t % NET_CHECK_TICKS == 0 && t / NET_CHECK_TICKS <= peer.sums.size() &&
+            match.checksum() != peer.sums[t / NET_CHECK_TICKS - 1]) {
+            return t / NET_CHECK_TICKS;
+        }
+        match.tick(peer.log[t]);
+    }
+    tickSeconds = seconds(start) / (peer.log.size() ? peer.log.size() : 1);
+    return 0;
+}
+
+// Both sides for frames frames. corrupt: changes the right side's ball once,
+// past the middle, at a frame all its inputs are known so that no rollback
+// undoes it. Returns the number of failures.
+static int run (Network const& network, unsigned int delay, unsigned int frames, bool udp, bool corrupt) {
+    unsigned int now = 0;
+    Wire wires[2];
+    UdpTransport sockets[2];
+    Peer* peers = new Peer[2];
+
+    if (udp) {
+        if (! sockets[0].open(0) || ! sockets[1].open(0) || ! sockets[0].connect("127.0.0.1", sockets[1].port()) ||
+            ! sockets[1].connect("127.0.0.1", sockets[0].port())) {
+            printf("FAIL: cannot open UDP sockets on the loopback\n");
+            delete[] peers;
+            return 1;
+        }
+    }
+
+    for (unsigned int p = 0; p < 2; ++p) {
+        Peer& peer = peers[p];
+        peer.session.start(GameMode::TwoPlayers, SEED, p, delay, TICK_HZ);
+        peer.transport.network = network;
+        peer.transport.rng.seed(100 + p);
+        peer.transport.now = &now;
+        peer.transport.out = &wires[p];
+        peer.transport.in = &wires[1 - p];
+        peer.transport.udp = udp ? &sockets[p] : nullptr;
+        peer.bot.rng.seed(200 + p);
+        peer.log.reserve(frames);
+    }
+
+    bool corrupted = false;
+    for (now = 0; now < frames; ++now) {
+        peers[0].frame();
+        peers[1].frame();
+
+        RollbackSession& right = peers[1].session;
+        if (corrupt && ! corrupted && now >= frames / 2 && right.confirmed() == right.ticks) {
+            right.match.sim.ball.p.y += 0.5f;
+            corrupted = true;
+        }
+    }
+
+    // Both report, without a tick
+    for (unsigned int i = 0; i < 4 * TICK_HZ; ++i, ++now) {
+        peers[0].session.poll(peers[0].transport);
+        peers[1].session.poll(peers[1].transport);
+    }
+
+    NetStats const& a = peers[0].session.stats;
+    NetStats const& b = peers[1].session.stats;
+    uint64_t rollbacks = a.rollbacks + b.rollbacks, resimulated = a.resimulated + b.resimulated;
+    uint64_t ticks = a.ticks + b.ticks, desyncs = a.desyncs + b.desyncs;
+    uint64_t rollbackFrames = peers[0].rollbackFrames + peers[1].rollbackFrames;
+    double playSeconds = double(frames) / TICK_HZ;
+
+    printf("%-9s %5.0f %4.0f %4.0f%% %3u %6.1f %5.1f %4llu %6.2f %7.2f %7.2f %7.1f %6llu %5.1f %4llu/%-4llu\n",
+           network.name, network.latency, network.jitter, 100 * network.loss, delay,
+           rollbacks / 2 / playSeconds, rollbacks ? double(resimulated) / rollbacks : 0.0,
+           (unsigned long long) std::max(a.maxDepth, b.maxDepth), double(resimulated) / (2 * frames),
+           1e6 * (peers[0].seconds + peers[1].seconds) / (2 * frames),
+           rollbackFrames ? 1e6 * (peers[0].rollbackSeconds + peers[1].rollbackSeconds) / rollbackFrames : 0.0,
+           1e6 * std::max(peers[0].worst, peers[1].worst), (unsigned long long) (a.stalls + b.stalls),
+           (a.bytesSent + b.bytesSent) / 2 / playSeconds / 1000, (unsigned long long) desyncs,
+           (unsigned long long) (a.checks + b.checks));
+
+    int failures = 0;
+    if (ticks < frames) {
+        printf("FAIL: %s: %llu ticks played in %u frames\n", network.name, (unsigned long long) ticks, frames);
+        ++failures;
+    }
+    if (std::max(a.maxDepth, b.maxDepth) > NET_MAX_ROLLBACK) {
+        printf("FAIL: %s: rolled back past the snapshots\n", network.name);
+        ++failures;
+    }
+
+    // The same confirmed inputs on both sides
+    size_t common = std::min(peers[0].log.size(), peers[1].log.size());
+    bool same = common >= frames / 2;
+    for (size_t t = 0; same && t < common; ++t) {
+        same = peers[0].log[t] == peers[1].log[t];
+    }
+    if (! same) {
+        printf("FAIL: %s: the sides confirmed different inputs\n", network.name);
+        ++failures;
+    }
+
+    // The left side was never touched: its states are those of a plain run
+    double tickSeconds = 0.0;
+    unsigned int bad = replay(peers[0], tickSeconds);
+    if (bad) {
+        printf("FAIL: %s: checksum %u differs from the match played without rollbacks\n", network.name, bad);
+        ++failures;
+    }
+
+    if (corrupt) {
+        if (! corrupted || ! desyncs) {
+            printf("FAIL: %s: the changed state went unnoticed\n", network.name);
+            ++failures;
+        }
+    } else {
+        bad = replay(peers[1], tickSeconds);
+        if (bad || desyncs || ! a.checks || ! b.checks) {
+            printf("FAIL: %s: the sides desynced\n", network.name);
+            ++failures;
+        }
+    }
+
+    delete[] peers;
+    return failures;
+}
+
+int main (int argc, char** argv) {
+    float duration = 60.0f;
+    bool udp = false;
+    for (int i = 1; i < argc; ++i) {
+        if (! strcmp(argv[i], "-u")) {
+            udp = true;
+        } else {
+            duration = strtof(argv[i], nullptr);
+        }
+    }
+    unsigned int frames = (unsigned int) (duration * TICK_HZ);
+    int failures = 0;
+
+    const Network lan = { "lan", 2.0f, 1.0f, 0.0f };
+    const Network wifi = { "wifi", 20.0f, 8.0f, 0.01f };
+    const Network internet = { "internet", 50.0f, 15.0f, 0.02f };
+    const Network bad = { "bad", 90.0f, 40.0f, 0.08f };
+    const Network awful = { "awful", 250.0f, 50.0f, 0.1f };
+
+    printf("Two Players, %.0f s per network at %u Hz, %s link\n", duration, TICK_HZ,
+           udp ? "UDP loopback" : "in-memory");
+    printf("%-9s %5s %4s %5s %3s %6s %5s %4s %6s %7s %7s %7s %6s %5s %10s\n", "network", "ms", "+-", "loss",
+           "dly", "rb/s", "depth", "max", "re/fr", "us/fr", "us/rb", "max us", "stalls", "kB/s", "desync/chk");
+
+    const struct {
+        Network network;
+        unsigned int delay;
+    } runs[] = {
+        { lan, 0 }, { lan, 1 },
+        { wifi, 0 }, { wifi, 2 },
+        { internet, 0 }, { internet, 3 }, { internet, 6 },
+        { bad, 3 }, { bad, 8 },
+        { awful, 0 }, { awful, 4 },
+    };
+    for (unsigned int r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+        failures += run(runs[r].network, runs[r].delay, frames, udp, false);
+    }
+
+    // Input delay covering the latency: nothing to roll back, the change stays
+    printf("A state changed on the right side:\n");
+    const Network change = { "changed", 2.0f, 0.0f, 0.0f };
+    failures += run(change, 2, frames, udp, true);
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+// Learned CPU benchmark: the int8 matrix-vector kernel against plain C++
+// (the same sums, and the time per call at the network's sizes), the
+// network of pkg/data as the game reads it from the pack (its output
+// against float activations, the time per inference), and Demo matches of
+// it against each analytic level, next to the prediction it learned from.
+//
+// Usage: bench_nn [matches per level]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "nn_train.h"
+#include "selfplay.h"
+#include "vita_pack.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static const char* levelNames[AI_LEVELS] = { "easy", "normal", "hard", "learned" };
+
+static volatile int32_t sink;
+
+// Same sums from both kernels, at random, and at the extremes
+static unsigned int checkKernel (unsigned int rows, unsigned int cols, Rng& rng) {
+    std::vector<int8_t> w(rows * cols), x(cols);
+    std::vector<int32_t> a(rows), b(rows);
+    unsigned int bad = 0;
+
+    for (int pass = 0; pass < 3; ++pass) {
+        for (unsigned int i = 0; i < w.size(); ++i) {
+            w[i] = pass == 0 ? rng.range(-127, 127) : (pass == 1 ? 127 : -127);
+        }
+        for (unsigned int j = 0; j < cols; ++j) {
+            x[j] = pass == 0 ? rng.range(-127, 127) : 127;
+        }
+
+        nnMatVec(&w[0], &x[0], &a[0], rows, cols);
+        nnMatVecScalar(&w[0], &x[0], &b[0], rows, cols);
+        bad += memcmp(&a[0], &b[0], rows * sizeof(int32_t)) != 0;
+    }
+    return bad;
+}
+
+// The same int8 inputs from the SIMD rounding as from nnQuantize
+static unsigned int checkQuantize (Rng& rng) {
+    float a[4 * NN_LANES];
+    int8_t x[4 * NN_LANES];
+    unsigned int bad = 0;
+
+    for (int pass = 0; pass < 1000; ++pass) {
+        float inverse = rng.uniform(1.0f, 200.0f);
+        for (unsigned int j = 0; j < 4 * NN_LANES; ++j) {
+            // Some exactly half-way between two steps
+            a[j] = j % 8 ? rng.uniform(-2.0f, 2.0f) : (rng.range(-300, 300) + 0.5f) / inverse;
+        }
+        nnQuantizeRow(a, inverse, x, 4 * NN_LANES);
+        for (unsigned int j = 0; j < 4 * NN_LANES; ++j) {
+            bad += x[j] != nnQuantize(a[j], inverse);
+        }
+    }
+    return bad;
+}
+
+static void timeKernel (unsigned int rows, unsigned int cols, Rng& rng) {
+    std::vector<int8_t> w(rows * cols), x(cols);
+    std::vector<int32_t> y(rows);
+    for (unsigned int i = 0; i < w.size(); ++i) {
+        w[i] = rng.range(-127, 127);
+    }
+    for (unsigned int j = 0; j < cols; ++j) {
+        x[j] = rng.range(-127, 127);
+    }
+
+    const unsigned int n = 20000000 / (rows * cols) + 1;
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) {
+        x[i % cols] = int8_t(i & 63);
+        nnMatVec(&w[0], &x[0], &y[0], rows, cols);
+        sink = sink + y[0];
+    }
+    double simd = seconds(start);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < n; ++i) {
+        x[i % cols] = int8_t(i & 63);
+        nnMatVecScalar(&w[0], &x[0], &y[0], rows, cols);
+        sink = sink + y[0];
+    }
+    double scalar = seconds(start);
+
+    printf("%4u x %-4u %10.1f ns %10.1f ns %8.1fx %10.2f GMAC/s\n", rows, cols, 1e9 * simd / n, 1e9 * scalar / n,
+           scalar / simd, double(rows) * cols * n / simd / 1e9);
+}
+
+int main (int argc, char** argv) {
+    uint64_t matches = argc > 1 ? strtoull(argv[1], nullptr, 10) : 200;
+    int failures = 0;
+
+    // Kernel
+    printf("Kernel: %s\n", nnKernelName());
+    printf("%11s %13s %13s %9s %17s\n", "rows x cols", nnKernelName(), "scalar", "speedup", "");
+    Rng rng(7);
+    const unsigned int sizes[][2] = { { 32, 16 }, { 32, 32 }, { 1, 32 }, { 7, 48 }, { 64, 64 } };
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        if (checkKernel(sizes[s][0], sizes[s][1], rng)) {
+            printf("FAIL: %u x %u sums differ from the scalar kernel\n", sizes[s][0], sizes[s][1]);
+            ++failures;
+        }
+        timeKernel(sizes[s][0], sizes[s][1], rng);
+    }
+
+    unsigned int rounding = checkQuantize(rng);
+    if (rounding) {
+        printf("FAIL: %u inputs quantized differently from nnQuantize\n", rounding);
+        ++failures;
+    }
+
+    // The network, from the pack as in the game, and from its file
+    vitaPack pack;
+    NeuralNet net, file;
+    const vitaPackEntry* entry = nullptr;
+    if (! vitaPackLoad(&pack, VITAPONG_PACK_FILE) || ! (entry = vitaPackFind(&pack, "opponent.nn")) ||
+        ! net.read(vitaPackData(&pack, entry), entry->size) || ! file.load(VITAPONG_DATA_DIR "/opponent.nn")) {
+        printf("FAIL: cannot read opponent.nn\nFAILED\n");
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> bytes, fromFile;
+    net.write(bytes);
+    file.write(fromFile);
+    if (bytes.size() != entry->size || memcmp(&bytes[0], vitaPackData(&pack, entry), bytes.size())) {
+        printf("FAIL: the network does not write back as it was read\n");
+        ++failures;
+    }
+    if (bytes != fromFile) {
+        printf("FAIL: the pack holds another network than pkg/data\n");
+        ++failures;
+    }
+    vitaPackClose(&pack);
+
+    printf("Network: %zu bytes,", bytes.size());
+    unsigned int macs = 0;
+    for (unsigned int l = 0; l < net.layers.size(); ++l) {
+        NeuralLayer const& layer = net.layers[l];
+        printf(" %u%s", l ? layer.inputs : NN_FEATURES, l ? "" : " (padded)");
+        macs += layer.inputs * layer.outputs;
+    }
+    printf(" -> 1, %u multiply-adds\n", macs);
+
+    // What it sees in play
+    ThreadPool pool;
+    NnTrainConfig collect;
+    collect.matches = 8;
+    collect.seed = 12345;
+    std::vector<NnSample> samples;
+    nnCollect(pool, collect, collect.seed, &net, samples);
+
+    double diff = 0.0, worst = 0.0, error = 0.0;
+    for (unsigned int s = 0; s < samples.size(); ++s) {
+        float q = net.forward(samples[s].f);
+        double d = fabs(q - net.forwardFloat(samples[s].f));
+        diff += d;
+        worst = d > worst ? d : worst;
+        error += fabs(q - samples[s].label);
+    }
+    diff /= samples.size();
+    error /= samples.size();
+    printf("%zu states: int8 against float activations %.4f on average, %.4f at most; %.4f off the teacher\n",
+           samples.size(), diff, worst, error);
+    if (diff > 0.05 || error > 0.08) {
+        printf("FAIL: the quantized network is too far off\n");
+        ++failures;
+    }
+
+    const unsigned int n = 2000000;
+    Clock::time_point start = Clock::now();
+    float total = 0.0f;
+    for (unsigned int i = 0; i < n; ++i) {
+        total += net.forward(samples[i % samples.size()].f);
+    }
+    double quantized = seconds(start);
+
+    start = Clock::now();
+    for (unsigned int i = 0; i < n / 10; ++i) {
+        total += net.forwardFloat(samples[i % samples.size()].f);
+    }
+    double reference = seconds(start) * 10;
+    sink = sink + int32_t(total);
+    printf("Inference: %.1f ns int8, %.1f ns float reference\n", 1e9 * quantized / n, 1e9 * reference / n);
+
+    // Against each analytic level, the learned CPU (on either side, see
+    // selfplay.h), then the prediction it learned from in its place, with
+    // the same settings
+    printf("Demo, %llu matches per level:\n", (unsigned long long) matches);
+    printf("%8s %13s %15s %12s %18s\n", "against", "learned wins", "learned points", "rally s", "prediction points");
+    SelfPlayConfig config;
+    config.matches = matches;
+    config.levels[1] = AI_LEARNED;
+
+    float shares[AI_HARD + 1];
+    for (unsigned int level = 0; level <= AI_HARD; ++level) {
+        config.levels[0] = level;
+        SelfPlayStats stats, prediction;
+        config.net = &net;
+        selfPlay(pool, config, stats);
+        config.net = nullptr;
+        selfPlay(pool, config, prediction);
+        SelfPlayTotals t = stats.totals(), p = prediction.totals();
+
+        shares[level] = t.points[1] / std::max(1.0f, float(t.points[0] + t.points[1]));
+        printf("%8s %12.0f%% %14.0f%% %12.1f %17.0f%%\n", levelNames[level], 100.0 * t.wins[1] / t.matches,
+               100 * shares[level], t.rallies ? t.rallyTicks / double(config.tickHz) / t.rallies : 0.0,
+               100 * p.points[1] / std::max(1.0f, float(p.points[0] + p.points[1])));
+    }
+
+    // Its settings put it between the two
+    if (shares[AI_NORMAL] <= 0.5f || shares[AI_HARD] >= 0.5f) {
+        printf("FAIL: the learned CPU does not play between the normal and the hard ones\n");
+        ++failures;
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+// Asset loading benchmark: the sounds loaded one file at a time, as
+// vitaWavLoad with conversion on load did (open, seek, allocate, read,
+// then convert into a second allocation), against reading the pack once
+// and describing them in place. Reports load time, allocations and
+// resident bytes, and checks both give the same samples.
+//
+// The files are in the host's page cache after the first run: this
+// measures the work of loading, not the storage.
+//
+// Usage: bench_pack [runs] [pack] [wav...]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vita_pack.h"
+#include "vita_mixer.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct Loaded {
+    std::vector<vitaWav> wavs;
+    std::vector<void*> blocks;
+    unsigned long bytes = 0;
+
+    void* alloc (unsigned long size) {
+        void* block = malloc(size);
+        blocks.push_back(block);
+        bytes += size;
+        return block;
+    }
+
+    void release () {
+        for (void* block : blocks) free(block);
+        blocks.clear();
+        wavs.clear();
+        bytes = 0;
+    }
+};
+
+// The former path, per file
+static bool loadFiles (std::vector<std::string> const& paths, Loaded& out) {
+    for (std::string const& path : paths) {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (! file) return false;
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+
+        unsigned char* block = (unsigned char*) out.alloc(size + sizeof(vitaWav));
+        unsigned char* data = block + sizeof(vitaWav);
+        bool ok = fread(data, 1, size, file) == (size_t) size;
+        fclose(file);
+
+        vitaWav wav;
+        if (! ok || ! vitaPackParseWav(&wav, data, size)) return false;
+
+        // Converted into a new block, the file's is freed
+        unsigned long frames = vitaMixerConvertedFrames(&wav);
+        short* native = (short*) out.alloc(frames * 2 * sizeof(short) + sizeof(vitaWav));
+        vitaMixerConvert(&wav, native);
+        out.bytes -= size + sizeof(vitaWav);
+        free(out.blocks[out.blocks.size() - 2]);
+        out.blocks.erase(out.blocks.end() - 2);
+
+        wav.channels = 2;
+        wav.bitPerSample = 16;
+        wav.sampleRate = VITA_AUDIO_FREQUENCY;
+        wav.sampleCount = frames;
+        wav.dataLength = frames * 2 * sizeof(short);
+        wav.rateRatio = 0x10000;
+        wav.data = (unsigned char*) native;
+        out.wavs.push_back(wav);
+    }
+    return true;
+}
+
+static bool loadPack (const char* path, std::vector<std::string> const& names, vitaPack& pack, std::vector<vitaWav>& wavs) {
+    if (! vitaPackLoad(&pack, path)) return false;
+
+    wavs.resize(names.size());
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        const vitaPackEntry* entry = vitaPackFind(&pack, names[i].c_str());
+        if (! entry || ! vitaPackParseWav(&wavs[i], vitaPackData(&pack, entry), entry->size)) return false;
+    }
+    return true;
+}
+
+int main (int argc, char** argv) {
+    int runs = argc > 1 ? atoi(argv[1]) : 200;
+    const char* packPath = argc > 2 ? argv[2] : VITAPONG_PACK_FILE;
+    std::vector<std::string> paths, names;
+
+    for (int i = 3; i < argc; ++i) paths.push_back(argv[i]);
+    if (paths.empty()) {
+        paths.push_back(VITAPONG_DATA_DIR "/beep.wav");
+        paths.push_back(VITAPONG_DATA_DIR "/boop.wav");
+    }
+    for (std::string const& path : paths) {
+        names.push_back(path.substr(path.find_last_of('/') + 1));
+    }
+
+    // Per file
+    Loaded files;
+    double filesSecs = 0;
+    for (int r = 0; r < runs; ++r) {
+        files.release();
+        Clock::time_point start = Clock::now();
+        if (! loadFiles(paths, files)) {
+            fprintf(stderr, "cannot load the WAV files\n");
+            return EXIT_FAILURE;
+        }
+        filesSecs += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Pack
+    vitaPack pack;
+    std::vector<vitaWav> views;
+    double packSecs = 0;
+    for (int r = 0; r < runs; ++r) {
+        if (r > 0) vitaPackClose(&pack);
+        Clock::time_point start = Clock::now();
+        if (! loadPack(packPath, names, pack, views)) {
+            fprintf(stderr, "cannot load %s\n", packPath);
+            return EXIT_FAILURE;
+        }
+        packSecs += std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    printf("%-28s %10s %8s %10s\n", "", "load us", "allocs", "bytes");
+    printf("%-28s %10.1f %8u %10lu\n", "files + convert on load",
+           filesSecs * 1e6 / runs, (unsigned int) files.blocks.size(), files.bytes);
+    printf("%-28s %10.1f %8u %10lu\n", "pack, in place",
+           packSecs * 1e6 / runs, 1u, pack.size);
+
+    // Same samples either way
+    bool same = true;
+    for (unsigned int i = 0; i < names.size(); ++i) {
+        same = same && views[i].sampleCount == files.wavs[i].sampleCount &&
+               views[i].channels == 2 && views[i].bitPerSample == 16 &&
+               memcmp(views[i].data, files.wavs[i].data, views[i].dataLength) == 0;
+    }
+    printf("same samples: %s\n", same ? "yes" : "NO");
+
+    files.release();
+    vitaPackClose(&pack);
+    return same ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+// Frame profiler benchmark: the cost of timing a frame's phases and of the
+// percentiles behind the debug overlay, and checks of the ring, the
+// percentiles and the CSV dump against a plain recording.
+//
+// Usage: bench_profiler [frames]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "profiler.h"
+#include "rng.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main (int argc, char** argv) {
+    unsigned int frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    if (frames < PROFILER_FRAMES) {
+        frames = PROFILER_FRAMES;
+    }
+
+    Rng rng(7);
+    FrameProfiler profiler;
+    std::vector<uint32_t> phases[PHASES + 1];
+    int failures = 0;
+
+    // Frames of random phase lengths, with a spike now and then
+    uint64_t now = 1000;
+    Clock::time_point start = Clock::now();
+    for (unsigned int f = 0; f < frames; ++f) {
+        profiler.beginFrame(now);
+        uint32_t total = 0;
+        for (unsigned int p = 0; p < PHASES; ++p) {
+            uint32_t d = rng.next() % 2000 + (rng.next() % 100 == 0 ? 20000 : 0);
+            now += d;
+            total += d;
+            profiler.mark(p, now);
+            if (f >= frames - PROFILER_FRAMES) {
+                phases[p].push_back(d);
+            }
+        }
+        now += 3;
+        profiler.endFrame(now);
+        if (f >= frames - PROFILER_FRAMES) {
+            phases[PHASES].push_back(total + 3);
+        }
+    }
+    double markTime = seconds(start);
+
+    // The ring holds the last frames, oldest first
+    for (unsigned int p = 0; p <= PHASES; ++p) {
+        for (unsigned int i = 0; i < PROFILER_FRAMES; ++i) {
+            if (profiler.at(p, i) != phases[p][i]) {
+                printf("FAIL: phase %u frame %u: %u, expected %u\n", p, i, profiler.at(p, i), phases[p][i]);
+                ++failures;
+                break;
+            }
+        }
+    }
+
+    // Nearest-rank percentiles
+    const float ps[3] = { 50.0f, 95.0f, 99.0f };
+    uint32_t stats[PHASES + 1][3];
+    const unsigned int rounds = 10000;
+    start = Clock::now();
+    for (unsigned int r = 0; r < rounds; ++r) {
+        for (unsigned int p = 0; p <= PHASES; ++p) {
+            profiler.percentiles(p, ps, stats[p], 3);
+        }
+    }
+    double percentileTime = seconds(start);
+
+    for (unsigned int p = 0; p <= PHASES; ++p) {
+        std::vector<uint32_t> sorted = phases[p];
+        std::sort(sorted.begin(), sorted.end());
+        unsigned int ranks[3] = { 128, 244, 254 }; // ceil(p / 100 * 256)
+        for (unsigned int k = 0; k < 3; ++k) {
+            if (stats[p][k] != sorted[ranks[k] - 1]) {
+                printf("FAIL: phase %u p%.0f: %u, expected %u\n", p, ps[k], stats[p][k], sorted[ranks[k] - 1]);
+                ++failures;
+            }
+        }
+    }
+
+    // CSV: a header, then one line per frame with the phases and the total
+    FILE* f = tmpfile();
+    if (! f || ! profiler.writeCsv(f)) {
+        printf("FAIL: cannot write the CSV\n");
+        ++failures;
+    } else {
+        rewind(f);
+        char line[256];
+        unsigned int lines = 0;
+        unsigned long long frame = 0;
+        unsigned int values[PHASES + 1];
+        while (fgets(line, sizeof(line), f)) {
+            if (lines == 0 && strcmp(line, "frame,input_us,update_us,render_us,wait_us,swap_us,total_us\n")) {
+                printf("FAIL: CSV header %s", line);
+                ++failures;
+            }
+            if (lines == PROFILER_FRAMES) {
+                sscanf(line, "%llu,%u,%u,%u,%u,%u,%u", &frame, &values[0], &values[1], &values[2],
+                       &values[3], &values[4], &values[5]);
+            }
+            ++lines;
+        }
+        fclose(f);
+
+        if (lines != PROFILER_FRAMES + 1 || frame != frames - 1 || values[PHASES] != phases[PHASES].back()) {
+            printf("FAIL: CSV has %u lines, last frame %llu\n", lines, frame);
+            ++failures;
+        }
+    }
+
+    printf("%u frames\n", frames);
+    printf("  begin + %u marks + end: %6.1f ns/frame\n", PHASES, 1e9 * markTime / frames);
+    printf("  p50/p95/p99 of %u phases over %u frames: %6.1f us\n", PHASES + 1, PROFILER_FRAMES,
+           1e6 * percentileTime / rounds);
+    printf("  frame p50 %.2f p95 %.2f p99 %.2f ms\n",
+           stats[PHASES][0] / 1000.0f, stats[PHASES][1] / 1000.0f, stats[PHASES][2] / 1000.0f);
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,318 @@
+// Rendering benchmark and golden images, on the software vita2d backend:
+// the frames Game::render draws (menu, play with the debug overlay, arena,
+// multiball) through the same batch and text atlas code, timed and hashed.
+//
+// The hashes below were produced on x86-64 with glibc; another libm may
+// round a few edge pixels differently. Run with -u to print new ones after
+// an intended change, and -o <dir> to write the frames as PPM images.
+//
+// Usage: bench_render [-u] [-o dir] [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "graphics.h"
+#include "text_atlas.h"
+#include "simulation.h"
+#include "multiball.h"
+#include "arena.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// FNV-1a over the visible frame
+static uint64_t hashFrame () {
+    const uint32_t* fb = vita2d_soft_framebuffer();
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned int i = 0; i < SCREEN_W * SCREEN_H; ++i) {
+        h = (h ^ fb[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static bool writePpm (const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (! f) {
+        return false;
+    }
+
+    const uint32_t* fb = vita2d_soft_framebuffer();
+    fprintf(f, "P6\n%d %d\n255\n", SCREEN_W, SCREEN_H);
+    for (unsigned int i = 0; i < SCREEN_W * SCREEN_H; ++i) {
+        unsigned char rgb[3] = { (unsigned char) fb[i], (unsigned char) (fb[i] >> 8), (unsigned char) (fb[i] >> 16) };
+        fwrite(rgb, 1, 3, f);
+    }
+
+    fclose(f);
+    return true;
+}
+
+enum Scene {
+    SCENE_MENU,
+    SCENE_PLAY,
+    SCENE_ARENA,
+    SCENE_MULTIBALL,
+    SCENES
+};
+
+static const char* sceneNames[SCENES] = { "menu", "play", "arena", "multiball" };
+
+static const uint64_t golden[SCENES] = {
+    0xd65879e0452ffc93ull,
+    0x4b703f4d16c4a62full,
+    0x074825f6610edac5ull,
+    0x61ca90fcfb17b184ull,
+};
+
+// What Game holds for rendering, set up as Game does
+struct Renderer {
+    void init () {
+        vita2d_init();
+        vita2d_set_clear_color(BLACK);
+
+        pgf = vita2d_load_default_pgf();
+        const float textScales[] = { 1.0f, 2.0f };
+        atlas.init(pgf, textScales, 2);
+        text.init(&atlas.atlas);
+        batch.init(vita2d_submit_batch);
+
+        // A game in progress
+        sim.player.score = 3;
+        sim.cpu.score = 7;
+        sim.ball.p = glm::vec2(400.0f, 200.0f);
+        arena.spawn(sim.rng, 200);
+        balls.spawn(sim.rng, 1024);
+    }
+
+    void fini () {
+        atlas.fini();
+        vita2d_free_pgf(pgf);
+        vita2d_fini();
+    }
+
+    // Menu::render
+    void menu () {
+        static const char* choices[] = { "One Player", "Two Players", "Multiball", "Arena" };
+        int x = SCREEN_W / 2, y = SCREEN_H / 2 - 100;
+
+        atlas.draw(text.get("Pong", 2.0f), x, y, WHITE, TEXT_CENTER, TEXT_CENTER);
+        y += 50;
+        for (unsigned int i = 0; i < 4; ++i) {
+            atlas.draw(text.get(choices[i], 1.0f), x, y, i == 1 ? RED : WHITE, TEXT_CENTER, TEXT_CENTER);
+            y += 20;
+        }
+    }
+
+    // GameState::Play in Game::render
+    void play (bool withArena, bool withBalls) {
+        sim.ball.render(batch, WHITE);
+        sim.player.render(batch, WHITE);
+        sim.cpu.render(batch, WHITE);
+
+        if (withArena) {
+            for (unsigned int i = 0; i < arena.obstacles.size(); ++i) {
+                arena.obstacles[i].render(batch, PURP);
+            }
+        }
+
+        if (withBalls) {
+            for (unsigned int i = 0; i < balls.size(); ++i) {
+                batch.circle(balls.x[i], balls.y[i], balls.r[i], WHITE);
+            }
+        }
+
+        batch.flush();
+
+        static const char* debug[] = {
+            "FPS: 59.94", "Tick: 120 Hz", "Caught up: 0", "Dropped: 0", "Audio: 256 smp",
+            "Latency: 8.7/11.6 ms", "Underruns: 0", "Assets: 0.1 ms 40 KB", "Text layouts: 0",
+        };
+        for (unsigned int i = 0; i < sizeof(debug) / sizeof(debug[0]); ++i) {
+            atlas.draw(text.get(debug[i], 1.0f), SCREEN_W - 160, 30 + 20 * i, GREEN);
+        }
+
+        atlas.draw(scores[1].number(text, sim.cpu.score, 2.0f), SCREEN_W / 2 + 20, 30, WHITE);
+        atlas.draw(scores[0].number(text, sim.player.score, 2.0f), SCREEN_W / 2 - 20, 30, WHITE);
+    }
+
+    // Game::run's frame
+    void frame (Scene scene) {
+        text.beginFrame();
+        batch.beginFrame();
+        vita2d_start_drawing();
+        vita2d_clear_screen();
+
+        switch (scene) {
+            case SCENE_MENU:      menu(); break;
+            case SCENE_PLAY:      play(false, false); break;
+            case SCENE_ARENA:     play(true, false); break;
+            case SCENE_MULTIBALL: play(false, true); break;
+            default: break;
+        }
+
+        vita2d_end_drawing();
+        vita2d_swap_buffers();
+    }
+
+    vita2d_pgf* pgf;
+    TextAtlas atlas;
+    TextCache text;
+    TextSlot scores[2];
+    Batch batch;
+
+    Simulation sim;
+    Arena arena;
+    MultiBall balls;
+};
+
+// The same pixels through different paths
+static int checkEquivalence (Renderer& r) {
+    int failures = 0;
+
+    // Atlas text and PGF text
+    vita2d_start_drawing();
+    vita2d_clear_screen();
+    r.atlas.draw(r.text.get("Press Start to restart, 0123456789 gjpqy", 1.0f), 100, 100, WHITE);
+    r.atlas.draw(r.text.get("Pong", 2.0f), 100, 200, RED);
+    vita2d_end_drawing();
+    vita2d_swap_buffers();
+    uint64_t atlasHash = hashFrame();
+
+    vita2d_start_drawing();
+    vita2d_clear_screen();
+    vita2d_pgf_draw_text(r.pgf, 100, 100, WHITE, 1.0f, "Press Start to restart, 0123456789 gjpqy");
+    vita2d_pgf_draw_text(r.pgf, 100, 200, RED, 2.0f, "Pong");
+    vita2d_end_drawing();
+    vita2d_swap_buffers();
+    if (hashFrame() != atlasHash) {
+        printf("FAIL: atlas text differs from PGF text\n");
+        ++failures;
+    }
+
+    // Batched rectangles (two triangles) and vita2d_draw_rectangle, at
+    // fractional positions and translucent
+    const float rects[][4] = { { 10.3f, 20.7f, 100.5f, 50.2f }, { 60.5f, 40.5f, 33.3f, 90.9f }, { -5, -5, 20, 20 } };
+    const int colors[] = { PURP, RGBA8(255, 0, 0, 128), RGBA8(0, 255, 0, 77) };
+
+    vita2d_start_drawing();
+    vita2d_clear_screen();
+    for (unsigned int i = 0; i < 3; ++i) {
+        r.batch.rect(rects[i][0], rects[i][1], rects[i][2], rects[i][3], colors[i]);
+    }
+    r.batch.flush();
+    vita2d_end_drawing();
+    vita2d_swap_buffers();
+    uint64_t batchHash = hashFrame();
+
+    vita2d_start_drawing();
+    vita2d_clear_screen();
+    for (unsigned int i = 0; i < 3; ++i) {
+        vita2d_draw_rectangle(rects[i][0], rects[i][1], rects[i][2], rects[i][3], colors[i]);
+    }
+    vita2d_end_drawing();
+    vita2d_swap_buffers();
+    if (hashFrame() != batchHash) {
+        printf("FAIL: batched rectangles differ from vita2d_draw_rectangle\n");
+        ++failures;
+    }
+
+    // SIMD and scalar spans, translucent over opaque
+    uint64_t hashes[2];
+    for (int simd = 0; simd < 2; ++simd) {
+        vita2d_soft_set_simd(simd);
+        vita2d_start_drawing();
+        vita2d_clear_screen();
+        for (unsigned int i = 0; i < 64; ++i) {
+            vita2d_draw_fill_circle(15.0f * i, 8.0f * i, 3.0f + i, RGBA8(4 * i, 255 - 4 * i, 128, 255));
+            vita2d_draw_rectangle(7.0f * i, 300.0f, 13.0f + i, 100.0f, RGBA8(255, 2 * i, 3 * i, 3 * i + 30));
+        }
+        vita2d_end_drawing();
+        vita2d_swap_buffers();
+        hashes[simd] = hashFrame();
+    }
+    if (hashes[0] != hashes[1]) {
+        printf("FAIL: SIMD spans differ from scalar ones\n");
+        ++failures;
+    }
+
+    return failures;
+}
+
+int main (int argc, char** argv) {
+    bool update = false;
+    const char* dir = nullptr;
+    unsigned int frames = 200;
+
+    for (int i = 1; i < argc; ++i) {
+        if (! strcmp(argv[i], "-u")) {
+            update = true;
+        } else if (! strcmp(argv[i], "-o") && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            frames = strtoul(argv[i], nullptr, 10);
+        }
+    }
+
+    Renderer r;
+    r.init();
+
+    int failures = checkEquivalence(r);
+
+    printf("%10s %10s %10s %12s %12s %18s\n", "scene", "us/frame", "frames/s", "Mpixels/s", "draws", "hash");
+
+    for (int s = 0; s < SCENES; ++s) {
+        Scene scene = Scene(s);
+
+        // Golden image from the first frame
+        r.frame(scene);
+        uint64_t hash = hashFrame();
+        if (dir) {
+            std::string path = std::string(dir) + "/" + sceneNames[s] + ".ppm";
+            if (! writePpm(path.c_str())) {
+                printf("cannot write %s\n", path.c_str());
+            }
+        }
+
+        unsigned long long pixels = vita2d_soft_pixels();
+        Clock::time_point start = Clock::now();
+        for (unsigned int f = 0; f < frames; ++f) {
+            r.frame(scene);
+        }
+        double t = seconds(start);
+        pixels = vita2d_soft_pixels() - pixels;
+
+        printf("%10s %10.1f %10.1f %12.1f %12u 0x%016llx\n", sceneNames[s],
+               1e6 * t / frames, frames / t, pixels / t / 1e6, r.batch.drawCalls,
+               (unsigned long long) hash);
+
+        if (hashFrame() != hash) {
+            printf("FAIL: %s is not the same from frame to frame\n", sceneNames[s]);
+            ++failures;
+        }
+        if (! update && hash != golden[s]) {
+            printf("FAIL: %s differs from its golden image (0x%016llx)\n", sceneNames[s],
+                   (unsigned long long) golden[s]);
+            ++failures;
+        }
+    }
+
+    if (update) {
+        printf("static const uint64_t golden[SCENES] = {\n");
+        for (int s = 0; s < SCENES; ++s) {
+            r.frame(Scene(s));
+            printf("    0x%016llxull,\n", (unsigned long long) hashFrame());
+        }
+        printf("};\n");
+    }
+
+    r.fini();
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
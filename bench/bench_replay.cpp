@@ -0,0 +1,235 @@
+// Replay benchmark: long matches of each mode played by two simulated
+// players, recorded, written to a file and read back, then played through
+// Match::tick as fast as possible. Reports the recording size per second of
+// play, the playback speed as a multiple of real time and the cost of
+// seeking, and checks that playback ends on the recorded state, that seeks
+// land on the state the match had at that tick, and that a wrong seed is
+// caught as a desync.
+//
+// Usage: bench_replay [minutes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "replay.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+#define TICK_HZ 120
+#define FRAME_TICKS 2 // Input changes once per 60 Hz frame
+#define SEEKS 32
+
+// Two players following the ball with some error, idle while it goes away.
+// They use the d-pad, or switch between it and the sticks every 20 s or so:
+// a stick held off centre changes value nearly every frame.
+struct Players {
+    Players (uint32_t seed, bool withSticks, bool touch) : rng(seed), withSticks(withSticks), touch(touch) {
+    }
+
+    TickInput frame (Match const& m) {
+        if (rng.range(0, 60) == 0) {
+            for (int side = 0; side < 2; ++side) {
+                error[side] = rng.uniform(-80.0f, 80.0f);
+            }
+        }
+        if (withSticks && rng.range(0, 1200) == 0) {
+            sticks = ! sticks;
+        }
+
+        TickInput in;
+        float ballY = m.sim.ball.y() + m.sim.ball.r;
+        Paddle const* paddles[2] = { &m.sim.player, &m.sim.cpu };
+        const uint32_t up[2] = { MATCH_UP, MATCH_TRIANGLE }, down[2] = { MATCH_DOWN, MATCH_CROSS };
+
+        for (int side = 0; side < 2; ++side) {
+            bool coming = side ? m.sim.ball.v.x > 0.0f : m.sim.ball.v.x < 0.0f;
+            float d = ballY + error[side] - (paddles[side]->y() + PADDLE_H / 2);
+            // Start moving when off by 30 pixels, stop within 10
+            moving[side] = coming && fabsf(d) > (moving[side] ? 10.0f : 30.0f);
+            if (! moving[side]) {
+                continue;
+            }
+
+            if (sticks) {
+                int v = d > 127.0f ? 127 : d < -127.0f ? -127 : int(d);
+                (side ? in.ry : in.ly) = TickInput::stick(v);
+            } else {
+                in.buttons |= d < 0.0f ? up[side] : down[side];
+            }
+        }
+
+        // A finger on the front panel, now and then
+        if (touch && sticks) {
+            in.touches = 1;
+            in.tx = uint16_t(m.sim.ball.x() * 2);
+            in.ty = uint16_t(ballY * 2);
+        }
+
+        return in;
+    }
+
+    Rng rng;
+    bool withSticks, touch;
+    bool sticks = false;
+    float error[2] = {};
+    bool moving[2] = {};
+};
+
+struct Result {
+    unsigned int ticks = 0;
+    size_t bytes = 0;
+    double recordSeconds = 0, playSeconds = 0, seekMicros = 0;
+    unsigned int desyncs = 0, seekFailures = 0, fileFailures = 0;
+    bool badSeedCaught = false;
+};
+
+static Result run (GameMode mode, uint32_t seed, unsigned int maxTicks, bool sticks, unsigned int flags) {
+    Result r;
+
+    // Seek targets, and the state the match has there
+    Rng targets(seed * 7 + 1);
+    unsigned int seekTicks[SEEKS];
+    uint32_t seekSums[SEEKS] = {};
+    for (unsigned int i = 0; i < SEEKS; ++i) {
+        seekTicks[i] = targets.range(0, maxTicks);
+    }
+
+    // Record
+    Match match;
+    match.setTickRate(TICK_HZ);
+    match.start(mode, seed);
+
+    ReplayRecorder recorder;
+    recorder.begin(match, flags);
+    Players players(seed, sticks, flags & REPLAY_TOUCH);
+    TickInput in;
+
+    Clock::time_point start = Clock::now();
+    while (match.ticks < maxTicks && ! match.over()) {
+        for (unsigned int i = 0; i < SEEKS; ++i) {
+            if (seekTicks[i] == match.ticks) {
+                seekSums[i] = match.checksum();
+            }
+        }
+
+        if (match.ticks % FRAME_TICKS == 0) {
+            in = players.frame(match);
+        }
+        recorder.record(in, match);
+        match.tick(in);
+    }
+    for (unsigned int i = 0; i < SEEKS; ++i) {
+        if (seekTicks[i] >= match.ticks) {
+            seekTicks[i] = match.ticks;
+            seekSums[i] = match.checksum();
+        }
+    }
+    recorder.finish(match);
+    r.recordSeconds = seconds(start);
+    r.ticks = match.ticks;
+    r.bytes = recorder.replay.bytes();
+
+    // Through a file
+    Replay replay;
+    FILE* f = tmpfile();
+    if (! f || ! recorder.replay.write(f) || fseek(f, 0, SEEK_SET) || ! replay.read(f) ||
+        replay.stream != recorder.replay.stream || replay.keyframes.size() != recorder.replay.keyframes.size()) {
+        ++r.fileFailures;
+        replay = recorder.replay;
+    }
+    if (f) {
+        fclose(f);
+    }
+
+    // Play it back at full speed
+    ReplayPlayer player;
+    player.open(&replay);
+    start = Clock::now();
+    while (! player.finished()) {
+        player.step(1000);
+    }
+    r.playSeconds = seconds(start);
+    r.desyncs = player.desyncs;
+
+    // Seek around, back and forth
+    start = Clock::now();
+    for (unsigned int i = 0; i < SEEKS; ++i) {
+        player.seek(seekTicks[i]);
+        if (player.match.ticks != seekTicks[i] || player.match.checksum() != seekSums[i]) {
+            ++r.seekFailures;
+        }
+    }
+    r.seekMicros = 1e6 * seconds(start) / SEEKS;
+    r.desyncs += player.desyncs;
+
+    // Another seed plays another match: caught at the first keyframe
+    Replay wrong = replay;
+    wrong.header.seed ^= 1;
+    ReplayPlayer check;
+    check.open(&wrong);
+    check.step(wrong.header.ticks);
+    r.badSeedCaught = check.desyncs > 0;
+
+    return r;
+}
+
+int main (int argc, char** argv) {
+    unsigned int minutes = argc > 1 ? strtoul(argv[1], nullptr, 10) : 10;
+    if (! minutes) {
+        minutes = 1;
+    }
+    unsigned int maxTicks = minutes * 60 * TICK_HZ;
+
+    struct { const char* name; GameMode mode; bool sticks; unsigned int flags; } modes[] = {
+        { "d-pad", GameMode::TwoPlayers, false, 0 },
+        { "one player", GameMode::OnePlayer, false, 0 },
+        { "two players", GameMode::TwoPlayers, true, 0 },
+        { "multiball", GameMode::Multiball, true, 0 },
+        { "arena", GameMode::Arena, true, 0 },
+        { "arena+touch", GameMode::Arena, true, REPLAY_TOUCH },
+    };
+
+    int failures = 0;
+    printf("Up to %u min per match at %u Hz, raw input: %u bytes/s\n", minutes, TICK_HZ,
+           unsigned(TICK_HZ * 8));
+    printf("%12s %9s %9s %9s %10s %10s %10s\n", "mode", "seconds", "bytes", "bytes/s", "record x", "replay x", "seek ms");
+
+    for (auto const& m : modes) {
+        Result r = run(m.mode, 12345, maxTicks, m.sticks, m.flags);
+        double played = double(r.ticks) / TICK_HZ;
+        double speed = played / r.playSeconds;
+
+        printf("%12s %9.1f %9zu %9.1f %10.0f %10.0f %10.2f\n", m.name, played, r.bytes, r.bytes / played,
+               played / r.recordSeconds, speed, r.seekMicros / 1000.0);
+
+        if (r.fileFailures) {
+            printf("FAIL: %s: the file does not read back\n", m.name);
+            ++failures;
+        }
+        if (r.desyncs) {
+            printf("FAIL: %s: %u desyncs in playback\n", m.name, r.desyncs);
+            ++failures;
+        }
+        if (r.seekFailures) {
+            printf("FAIL: %s: %u seeks off\n", m.name, r.seekFailures);
+            ++failures;
+        }
+        if (! r.badSeedCaught) {
+            printf("FAIL: %s: a wrong seed was not caught\n", m.name);
+            ++failures;
+        }
+        if (speed < 100.0) {
+            printf("FAIL: %s: playback under 100x real time\n", m.name);
+            ++failures;
+        }
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+// Self-play harness: CPU against CPU matches over every core, with the
+// rules and levels given on the command line, for balancing. Prints win
+// rates of the decided matches with their 95% intervals, the draws apart,
+// rally lengths and final scores, then the matches per second with 1, 2,
+// 4... threads up to the hardware's (4 at least), checking that every
+// thread count gives the same totals. A level against itself must win as
+// often as it loses.
+//
+// Usage: bench_selfplay [-n matches] [-t threads] [-l left level] [-r right level]
+//                       [-p paddle speed] [-b ball speed] [-a max bounce angle (degrees)]
+//                       [-s seed] [-w network of the learned level] [-x (no scaling run)]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "selfplay.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static const char* levelNames[AI_LEVELS] = { "easy", "normal", "hard", "learned" };
+
+static bool same (SelfPlayTotals const& a, SelfPlayTotals const& b) {
+    return a.matches == b.matches && a.draws == b.draws && a.ticks == b.ticks &&
+           a.wins[0] == b.wins[0] && a.wins[1] == b.wins[1] &&
+           a.sideWins[0] == b.sideWins[0] && a.sideWins[1] == b.sideWins[1] &&
+           a.points[0] == b.points[0] && a.points[1] == b.points[1] &&
+           a.hits[0] == b.hits[0] && a.hits[1] == b.hits[1] &&
+           a.rallies == b.rallies && a.rallyTicks == b.rallyTicks && a.maxRallyTicks == b.maxRallyTicks &&
+           ! memcmp(a.loserPoints, b.loserPoints, sizeof(a.loserPoints));
+}
+
+static double run (ThreadPool& pool, SelfPlayConfig const& config, SelfPlayTotals& t) {
+    SelfPlayStats stats;
+
+    Clock::time_point start = Clock::now();
+    selfPlay(pool, config, stats);
+    double s = seconds(start);
+
+    t = stats.totals();
+    return s;
+}
+
+// Wilson score interval of k successes out of n, at 95%
+static void interval (uint64_t k, uint64_t n, double& low, double& high) {
+    const double z = 1.96;
+    double m = double(std::max<uint64_t>(n, 1)), p = k / m, z2 = z * z / m,
+           centre = (p + z2 / 2) / (1 + z2),
+           half = z * std::sqrt(p * (1 - p) / m + z2 / (4 * m)) / (1 + z2);
+    low = centre - half;
+    high = centre + half;
+}
+
+static void printRate (const char* name, uint64_t k, uint64_t n) {
+    double low, high;
+    interval(k, n, low, high);
+    printf("  %s wins %.1f%% of decided matches (95%%: %.1f%% - %.1f%%)\n",
+           name, n ? 100.0 * k / n : 0.0, 100 * low, 100 * high);
+}
+
+// Standard score of the difference between two win counts, if the two
+// were equally likely to win
+static double asymmetry (uint64_t a, uint64_t b) {
+    return a + b ? (double(a) - double(b)) / std::sqrt(double(a + b)) : 0.0;
+}
+
+static void report (SelfPlayConfig const& config, SelfPlayTotals const& t, double s, unsigned int threads) {
+    double n = double(t.matches), hz = config.tickHz;
+    uint64_t decided = t.matches - t.draws;
+    double d = double(std::max<uint64_t>(decided, 1));
+    char name[64];
+
+    printf("%llu matches in %.2f s on %u threads: %.0f matches/s, %.1f M ticks/s\n",
+           (unsigned long long) t.matches, s, threads, n / s, t.ticks / s / 1e6);
+    printf("  %llu decided, %llu draws (%.1f%%) still going after %u s\n",
+           (unsigned long long) decided, (unsigned long long) t.draws, 100 * t.draws / n, config.maxSeconds);
+    for (int k = 0; k < 2; ++k) {
+        snprintf(name, sizeof(name), "%s (%s)", levelNames[config.levels[k]], k ? "second" : "first");
+        printRate(name, t.wins[k], decided);
+    }
+    printRate("left side", t.sideWins[0], decided);
+    printf("  points per match %.2f - %.2f, decided match %.1f s\n", t.points[0] / n, t.points[1] / n,
+           (t.ticks - double(t.draws) * config.maxSeconds * hz) / hz / d);
+    if (t.rallies) {
+        printf("  rally %.1f s on average, %.1f s at most, %.1f returns per point\n",
+               t.rallyTicks / hz / t.rallies, t.maxRallyTicks / hz,
+               double(t.hits[0] + t.hits[1]) / t.rallies);
+    }
+
+    printf("  final scores of decided matches:");
+    for (int s = 0; s < SCORE_WIN; ++s) {
+        printf(" %d-%d %.1f%%", SCORE_WIN, s, 100 * t.loserPoints[s] / d);
+    }
+    printf("\n");
+}
+
+int main (int argc, char** argv) {
+    SelfPlayConfig config;
+    config.matches = 2000;
+    unsigned int threads = 0;
+    bool scaling = true;
+    NeuralNet net;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (! strcmp(a, "-x")) {
+            scaling = false;
+            continue;
+        }
+        if (! v || a[0] != '-') {
+            printf("bad argument %s\n", a);
+            return EXIT_FAILURE;
+        }
+        ++i;
+
+        switch (a[1]) {
+            case 'n': config.matches = strtoull(v, nullptr, 10); break;
+            case 't': threads = strtoul(v, nullptr, 10); break;
+            case 'l': config.levels[0] = strtoul(v, nullptr, 10) % AI_LEVELS; break;
+            case 'r': config.levels[1] = strtoul(v, nullptr, 10) % AI_LEVELS; break;
+            case 'p': config.rules.paddleSpeed = strtof(v, nullptr); break;
+            case 'b': config.rules.ballSpeed = strtof(v, nullptr); break;
+            case 'a': config.rules.maxBounceAngle = strtof(v, nullptr) * float(M_PI) / 180.0f; break;
+            case 's': config.seed = strtoul(v, nullptr, 10); break;
+            case 'w':
+                if (! net.load(v)) {
+                    printf("cannot read %s\n", v);
+                    return EXIT_FAILURE;
+                }
+                config.net = &net;
+                break;
+            default:
+                printf("bad argument %s\n", a);
+                return EXIT_FAILURE;
+        }
+    }
+
+    printf("Rules: paddle speed %.2f, ball speed %.2f, max bounce angle %.1f deg, %u Hz\n",
+           config.rules.paddleSpeed, config.rules.ballSpeed, config.rules.maxBounceAngle * 180.0f / float(M_PI),
+           config.tickHz);
+
+    SelfPlayTotals totals;
+    ThreadPool pool(threads);
+    double s = run(pool, config, totals);
+    report(config, totals, s, pool.size());
+
+    // Mirror matchup: the two sides play the same, so one winning more is
+    // the harness or the game favouring a side (more than 3 sigma)
+    int failures = 0;
+    double z = asymmetry(totals.wins[0], totals.wins[1]);
+    if (config.levels[0] == config.levels[1] && std::fabs(z) > 3.0) {
+        printf("FAIL: %s against itself is asymmetric, %.1f sigma\n", levelNames[config.levels[0]], z);
+        ++failures;
+    }
+
+    if (scaling) {
+        // Fewer matches, at each thread count: the same totals every time,
+        // also with more threads than cores
+        SelfPlayConfig small = config;
+        small.matches = config.matches / 4 ? config.matches / 4 : 1;
+        unsigned int hardware = std::thread::hardware_concurrency();
+        unsigned int most = hardware > 4 ? hardware : 4;
+        std::vector<unsigned int> counts;
+        for (unsigned int n = 2; n < most; n *= 2) {
+            counts.push_back(n);
+        }
+        counts.push_back(most);
+
+        uint64_t steals = 0;
+        printf("%8s %12s %10s %12s\n", "threads", "matches/s", "speedup", "efficiency");
+        SelfPlayTotals reference;
+        ThreadPool single(1);
+        double one = run(single, small, reference);
+        printf("%8u %12.0f %10.2f %11.0f%%\n", 1, small.matches / one, 1.0, 100.0);
+
+        for (unsigned int n : counts) {
+            SelfPlayTotals t;
+            ThreadPool several(n);
+            double sn = run(several, small, t);
+            steals += several.steals;
+            printf("%8u %12.0f %10.2f %11.0f%%%s\n", n, small.matches / sn, one / sn, 100 * one / sn / n,
+                   n > hardware ? " (more threads than cores)" : "");
+            if (! same(t, reference)) {
+                printf("FAIL: %u threads do not give the totals of one\n", n);
+                ++failures;
+            }
+        }
+        printf("%u hardware threads, %llu chunks stolen\n", hardware, (unsigned long long) steals);
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,564 @@
+// Dedicated server load test: a PongServer shard on its own thread, fed by
+// fake clients on another one (two per match, each following the ball it
+// is sent and sending its input every tick over the loopback), at growing
+// numbers of matches. For each load: the server's share of a core, the
+// matches a core would hold at that rate, the tick processing time (median
+// and tail), late ticks, and the states the clients got. Before that, the
+// step alone over a flat array of matches, a check that a server match
+// plays like Match in Two Players mode, and one that a player leaving or
+// timing out loses a match counted as finished.
+//
+// Usage: bench_server [seconds per load] [matches ...]
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "server.h"
+#include "udp.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double threadSeconds () {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+#define CLIENTS_PER_SOCKET 256
+#define JOIN_RETRY (SERVER_TICK_HZ / 2) // Ticks between two JOINs
+
+// The same inputs into a ServerMatch and a Two Players Match, with the same
+// rules: the same ball, paddles and scores every tick
+static bool checkRules (uint32_t seed, MatchRules const& rules) {
+    Match match;
+    match.setTickRate(SERVER_TICK_HZ);
+    match.rules = rules;
+    match.start(GameMode::TwoPlayers, seed);
+    ServerMatch m = ServerMatch();
+    m.start(seed, SERVER_TICK_HZ, rules);
+    m.state = ServerMatch::Playing;
+
+    Rng rng(seed);
+    for (unsigned int t = 0; t < 60 * 60 * SERVER_TICK_HZ && ! match.over(); ++t) {
+        for (unsigned int side = 0; side < 2; ++side) {
+            NetInput& in = m.players[side].input;
+            if (rng.range(0, 15) == 0) {
+                in.buttons = rng.range(0, 2) == 0 ? 0 : (rng.range(0, 1) ? NET_UP : NET_DOWN);
+                in.stick = rng.range(0, 3) == 0 ? TickInput::stick(rng.range(-127, 127)) : 0;
+            }
+        }
+        match.tick(netTickInput(m.players[0].input, m.players[1].input));
+        m.step(SERVER_TICK_HZ);
+
+        Simulation const& a = match.sim;
+        Simulation const& b = m.sim;
+        if (a.ball.p != b.ball.p || a.ball.v != b.ball.v || a.player.p != b.player.p || a.cpu.p != b.cpu.p ||
+            a.player.score != b.player.score || a.cpu.score != b.cpu.score) {
+            printf("FAIL: seed %u: the server match differs from Match at tick %u\n", seed, t);
+            return false;
+        }
+    }
+    return match.over() && m.state == ServerMatch::Over;
+}
+
+// The next packet a client gets, polling the server for up to a second
+static bool receiveUpdate (PongServer& server, UdpTransport& client, ServerUpdate& update) {
+    uint8_t data[SERVER_PACKET_MAX];
+    for (int i = 0; i < 1000; ++i) {
+        server.poll(1);
+        size_t n = client.receive(data, sizeof(data));
+        if (n && serverRead(data, n, update)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// A player leaves a match, then one goes silent in another: both matches
+// are won by the other player, who is told, and counted as finished
+static bool checkForfeits () {
+    PongServer server;
+    if (! server.open(0, 4)) {
+        return false;
+    }
+
+    uint8_t packet[SERVER_PACKET_MAX];
+    for (unsigned int round = 0; round < 2; ++round) {
+        UdpTransport clients[2];
+        ServerUpdate welcome[2];
+        const uint64_t nonces[2] = { 0x100 + 2 * round, 0x101 + 2 * round };
+        for (unsigned int c = 0; c < 2; ++c) {
+            if (! clients[c].open(0) || ! clients[c].connect("127.0.0.1", server.port())) {
+                return false;
+            }
+            clients[c].send(packet, serverJoin(nonces[c], packet));
+            do {
+                if (! receiveUpdate(server, clients[c], welcome[c])) {
+                    return false;
+                }
+            } while (welcome[c].type != SERVER_WELCOME);
+        }
+
+        // The first client is gone, the second one still plays
+        if (round == 0) {
+            clients[0].send(packet, serverLeave(nonces[0], welcome[0].match, welcome[0].side, packet));
+        } else {
+            for (uint32_t t = 0; t <= SERVER_TIMEOUT * SERVER_TICK_HZ + 1; ++t) {
+                clients[1].send(packet, serverInput(nonces[1], welcome[1].match, welcome[1].side, t, NetInput(),
+                                                    packet));
+                server.poll(0);
+                server.tick();
+            }
+        }
+
+        ServerUpdate u;
+        do {
+            if (! receiveUpdate(server, clients[1], u)) {
+                return false;
+            }
+        } while (u.type != SERVER_STATE || ! (u.flags & SERVER_OVER));
+        if (u.scores[welcome[1].side] != SCORE_WIN) {
+            return false;
+        }
+    }
+
+    ServerStats const& st = server.stats;
+    return st.finished == 2 && st.left == 1 && st.timeouts == 1;
+}
+
+// Steps n matches together, as a server tick does without the network
+static void timeStep (unsigned int n, unsigned int ticks) {
+    std::vector<ServerMatch> matches(n);
+    Rng rng(3);
+    for (unsigned int i = 0; i < n; ++i) {
+        matches[i].start(1 + i, SERVER_TICK_HZ);
+        matches[i].state = ServerMatch::Playing;
+        matches[i].serveTicks = 0;
+    }
+
+    uint64_t events = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned int t = 0; t < ticks; ++t) {
+        for (unsigned int i = 0; i < n; ++i) {
+            ServerMatch& m = matches[i];
+            // Both players follow the ball
+            float y = m.sim.ball.y() + BALL_R;
+            m.players[0].input.buttons = y < m.sim.player.y() + PADDLE_H / 2 ? NET_UP : NET_DOWN;
+            m.players[1].input.buttons = y < m.sim.cpu.y() + PADDLE_H / 2 ? NET_UP : NET_DOWN;
+            if (m.state == ServerMatch::Over) {
+                m.start(rng.next(), SERVER_TICK_HZ);
+                m.state = ServerMatch::Playing;
+            }
+            events += m.step(SERVER_TICK_HZ) != 0;
+        }
+    }
+    double s = seconds(start);
+    double perMatch = s / (double(n) * ticks);
+
+    printf("Step only: %u matches of %zu bytes, %.1f ns a match a tick, %.0f matches a core at %u Hz "
+           "(%llu events)\n",
+           n, sizeof(ServerMatch), 1e9 * perMatch, 1.0 / SERVER_TICK_HZ / perMatch, SERVER_TICK_HZ,
+           (unsigned long long) events);
+}
+
+struct FakeClient {
+    uint64_t nonce = 0;
+    uint32_t match = 0;
+    unsigned int side = 0;
+    bool welcomed = false, moving = false;
+    uint32_t sequence = 0;
+    ServerUpdate last;
+    uint64_t states = 0;
+    uint32_t firstTick = 0, lastTick = 0; // Of the states of the match
+};
+
+// Thousands of players over a few sockets, every one of them sending its
+// input each tick, in batches
+struct LoadGenerator {
+    ~LoadGenerator () {
+        for (unsigned int s = 0; s < sockets.size(); ++s) {
+            close(sockets[s]);
+        }
+        if (epoll >= 0) {
+            close(epoll);
+        }
+        if (timer >= 0) {
+            close(timer);
+        }
+    }
+
+    bool open (unsigned short port, unsigned int n) {
+        server = sockaddr_in();
+        server.sin_family = AF_INET;
+        server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        server.sin_port = htons(port);
+
+        epoll = epoll_create1(0);
+        timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+        itimerspec period = itimerspec();
+        period.it_interval.tv_nsec = 1000000000L / SERVER_TICK_HZ;
+        period.it_value = period.it_interval;
+        timerfd_settime(timer, 0, &period, nullptr);
+
+        epoll_event event = epoll_event();
+        event.events = EPOLLIN;
+        event.data.u32 = ~0u;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+
+        for (unsigned int s = 0; s < (n + CLIENTS_PER_SOCKET - 1) / CLIENTS_PER_SOCKET; ++s) {
+            int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+            int buffer = 4 << 20;
+            setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+            sockaddr_in local = sockaddr_in();
+            local.sin_family = AF_INET;
+            local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            if (fd < 0 || bind(fd, (sockaddr*) &local, sizeof(local)) < 0) {
+                return false;
+            }
+            sockets.push_back(fd);
+            event.data.u32 = s;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        clients.assign(n, FakeClient());
+        for (unsigned int i = 0; i < n; ++i) {
+            clients[i].nonce = newNonce(i);
+        }
+        return epoll >= 0 && timer >= 0;
+    }
+
+    // The client's index in the low bits, random high ones
+    uint64_t newNonce (unsigned int i) {
+        return uint64_t(rng.next() | 1) << 32 | i;
+    }
+
+    // Matches whose two players are in, counted each second
+    void count () {
+        unsigned int n = 0;
+        for (unsigned int i = 0; i < clients.size(); ++i) {
+            n += clients[i].welcomed && clients[i].last.type == SERVER_STATE &&
+                 ! (clients[i].last.flags & SERVER_WAITING);
+        }
+        paired = n / 2;
+    }
+
+    // Counts from now on
+    void reset () {
+        for (unsigned int i = 0; i < clients.size(); ++i) {
+            clients[i].states = 0;
+            clients[i].firstTick = clients[i].lastTick = 0;
+        }
+        received = expected = 0;
+    }
+
+    // States missed: those between the first and the last one of a match
+    void tally (FakeClient& c) {
+        if (c.states) {
+            received += c.states;
+            expected += c.lastTick - c.firstTick + 1;
+        }
+        c.states = 0;
+    }
+
+    void finish () {
+        for (unsigned int i = 0; i < clients.size(); ++i) {
+            tally(clients[i]);
+        }
+    }
+
+    void run (std::atomic<int> const& phase) {
+        int seen = 0;
+        while (phase < 2) {
+            if (phase != seen) {
+                seen = phase;
+                reset();
+            }
+
+            epoll_event events[16];
+            int n = epoll_wait(epoll, events, 16, 5);
+            for (int e = 0; e < n; ++e) {
+                if (events[e].data.u32 == ~0u) {
+                    uint64_t due;
+                    if (read(timer, &due, sizeof(due)) == sizeof(due)) {
+                        frame();
+                    }
+                } else {
+                    receive(events[e].data.u32);
+                }
+            }
+        }
+    }
+
+    void frame () {
+        if (++ticks % SERVER_TICK_HZ == 0) {
+            count();
+        }
+        uint8_t packets[CLIENTS_PER_SOCKET][SERVER_PACKET_MAX];
+        iovec iov[CLIENTS_PER_SOCKET];
+        mmsghdr msgs[CLIENTS_PER_SOCKET];
+
+        for (unsigned int s = 0; s < sockets.size(); ++s) {
+            unsigned int count = 0;
+            for (unsigned int i = s * CLIENTS_PER_SOCKET; i < clients.size() && i < (s + 1) * CLIENTS_PER_SOCKET; ++i) {
+                FakeClient& c = clients[i];
+                size_t size;
+                if (! c.welcomed) {
+                    if ((ticks + i) % JOIN_RETRY) {
+                        continue;
+                    }
+                    size = serverJoin(c.nonce, packets[count]);
+                } else {
+                    size = serverInput(c.nonce, c.match, c.side, ++c.sequence, input(c), packets[count]);
+                }
+
+                iov[count].iov_base = packets[count];
+                iov[count].iov_len = size;
+                msgs[count].msg_hdr = msghdr();
+                msgs[count].msg_hdr.msg_name = &server;
+                msgs[count].msg_hdr.msg_namelen = sizeof(server);
+                msgs[count].msg_hdr.msg_iov = &iov[count];
+                msgs[count].msg_hdr.msg_iovlen = 1;
+                ++count;
+            }
+
+            unsigned int sent = 0;
+            while (sent < count) {
+                int k = sendmmsg(sockets[s], msgs + sent, count - sent, MSG_DONTWAIT);
+                if (k <= 0) {
+                    break;
+                }
+                sent += k;
+            }
+        }
+    }
+
+    // Follows the ball with the d-pad, from the last state
+    NetInput input (FakeClient& c) {
+        NetInput in;
+        if (c.last.type != SERVER_STATE) {
+            return in;
+        }
+        float d = c.last.ball.y + BALL_R - (c.last.paddles[c.side] + PADDLE_H / 2);
+        c.moving = fabsf(d) > (c.moving ? 8.0f : 24.0f);
+        if (c.moving) {
+            in.buttons = d < 0.0f ? NET_UP : NET_DOWN;
+        }
+        return in;
+    }
+
+    void receive (unsigned int s) {
+        uint8_t packets[CLIENTS_PER_SOCKET][SERVER_PACKET_MAX];
+        iovec iov[CLIENTS_PER_SOCKET];
+        mmsghdr msgs[CLIENTS_PER_SOCKET];
+
+        for (;;) {
+            for (unsigned int i = 0; i < CLIENTS_PER_SOCKET; ++i) {
+                iov[i].iov_base = packets[i];
+                iov[i].iov_len = SERVER_PACKET_MAX;
+                msgs[i].msg_hdr = msghdr();
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(sockets[s], msgs, CLIENTS_PER_SOCKET, MSG_DONTWAIT, nullptr);
+            if (n <= 0) {
+                return;
+            }
+
+            for (int k = 0; k < n; ++k) {
+                ServerUpdate u;
+                if (! serverRead(packets[k], msgs[k].msg_len, u) || uint32_t(u.nonce) >= clients.size() ||
+                    clients[uint32_t(u.nonce)].nonce != u.nonce) {
+                    continue;
+                }
+
+                FakeClient& c = clients[uint32_t(u.nonce)];
+                if (u.type == SERVER_WELCOME) {
+                    c.welcomed = true;
+                    c.match = u.match;
+                    c.side = u.side;
+                    continue;
+                }
+
+                if (! (u.flags & SERVER_WAITING) && u.tick > c.lastTick) {
+                    c.firstTick = c.states ? c.firstTick : u.tick;
+                    c.lastTick = u.tick;
+                    ++c.states;
+                }
+                c.last = u;
+
+                // Once over, another match
+                if (u.flags & SERVER_OVER) {
+                    tally(c);
+                    c = FakeClient();
+                    c.nonce = newNonce(&c - &clients[0]);
+                    ++rejoins;
+                }
+            }
+            if (n < CLIENTS_PER_SOCKET) {
+                return;
+            }
+        }
+    }
+
+    std::vector<FakeClient> clients;
+    std::vector<int> sockets;
+    sockaddr_in server;
+    int epoll = -1, timer = -1;
+    uint32_t ticks = 0;
+    Rng rng = Rng(99);
+    uint64_t received = 0, expected = 0, rejoins = 0;
+    std::atomic<unsigned int> paired = ATOMIC_VAR_INIT(0);
+};
+
+struct LoadResult {
+    unsigned int matches = 0, paired = 0;
+    double cpu = 0.0; // Share of a core
+    uint64_t ticks = 0, late = 0, skipped = 0, dropped = 0;
+    uint64_t p50 = 0, p99 = 0, p999 = 0, max = 0;
+    double delivered = 0.0, packetsIn = 0.0, packetsOut = 0.0;
+};
+
+static bool load (unsigned int matches, double duration, LoadResult& r) {
+    PongServer* server = new PongServer;
+    LoadGenerator* clients = new LoadGenerator;
+    r.matches = matches;
+    if (! server->open(0, matches + 16) || ! clients->open(server->port(), 2 * matches)) {
+        printf("FAIL: cannot open the sockets\n");
+        delete clients;
+        delete server;
+        return false;
+    }
+
+    std::atomic<int> phase(0);
+    std::thread serving([&] {
+        while (phase == 0) {
+            server->poll(5);
+        }
+
+        ServerStats before = server->stats;
+        server->stats.tickMicros.clear();
+        double cpu = threadSeconds();
+        Clock::time_point start = Clock::now();
+        while (phase == 1) {
+            server->poll(5);
+        }
+
+        double wall = seconds(start);
+        ServerStats const& after = server->stats;
+        r.cpu = (threadSeconds() - cpu) / wall;
+        r.ticks = after.ticks - before.ticks;
+        r.late = after.late - before.late;
+        r.skipped = after.skipped - before.skipped;
+        r.dropped = after.dropped - before.dropped;
+        r.packetsIn = (after.packetsIn - before.packetsIn) / wall;
+        r.packetsOut = (after.packetsOut - before.packetsOut) / wall;
+        r.p50 = after.tickMicros.percentile(50.0);
+        r.p99 = after.tickMicros.percentile(99.0);
+        r.p999 = after.tickMicros.percentile(99.9);
+        r.max = after.tickMicros.max;
+    });
+    std::thread playing([&] {
+        clients->run(phase);
+    });
+
+    // Everyone in, then measured
+    Clock::time_point start = Clock::now();
+    while (seconds(start) < 10.0 && clients->paired < matches) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    r.paired = clients->paired;
+    phase = 1;
+    std::this_thread::sleep_for(std::chrono::duration<double>(duration));
+    phase = 2;
+    serving.join();
+    playing.join();
+
+    clients->finish();
+    r.delivered = clients->expected ? double(clients->received) / clients->expected : 0.0;
+    delete clients;
+    delete server;
+    return true;
+}
+
+int main (int argc, char** argv) {
+    double duration = argc > 1 ? strtod(argv[1], nullptr) : 3.0;
+    std::vector<unsigned int> loads;
+    for (int i = 2; i < argc; ++i) {
+        loads.push_back(strtoul(argv[i], nullptr, 10));
+    }
+    if (loads.empty()) {
+        const unsigned int defaults[] = { 250, 500, 1000, 2000, 4000 };
+        loads.assign(defaults, defaults + sizeof(defaults) / sizeof(defaults[0]));
+    }
+    int failures = 0;
+
+    MatchRules fast;
+    fast.paddleSpeed = 9.5f;
+    fast.ballSpeed = 12.0f;
+    fast.maxBounceAngle = M_PI / 4;
+    for (uint32_t seed = 1; seed <= 5; ++seed) {
+        failures += ! checkRules(seed, MatchRules());
+        failures += ! checkRules(seed, fast);
+    }
+
+    bool forfeits = checkForfeits();
+    printf("Leaving or timing out forfeits the match: %s\n", forfeits ? "ok" : "FAILED");
+    failures += ! forfeits;
+
+    timeStep(10000, 600);
+
+    printf("Loopback, %u Hz, %.0f s per load, %u hardware threads (clients included)\n", SERVER_TICK_HZ, duration,
+           std::thread::hardware_concurrency());
+    printf("%7s %7s %6s %10s %7s %7s %7s %7s %6s %9s %9s %6s\n", "matches", "paired", "core", "per core", "p50 us",
+           "p99 us", "p99.9", "max us", "late", "in/s", "out/s", "recv");
+
+    double perCore = 0.0;
+    unsigned int from = 0;
+    for (unsigned int l = 0; l < loads.size(); ++l) {
+        LoadResult r;
+        if (! load(loads[l], duration, r)) {
+            ++failures;
+            break;
+        }
+
+        printf("%7u %7u %5.0f%% %10.0f %7llu %7llu %7llu %7llu %6llu %9.0f %9.0f %5.1f%%\n", r.matches, r.paired,
+               100 * r.cpu, r.cpu > 0.0 ? r.matches / r.cpu : 0.0, (unsigned long long) r.p50,
+               (unsigned long long) r.p99, (unsigned long long) r.p999, (unsigned long long) r.max,
+               (unsigned long long) r.late, r.packetsIn, r.packetsOut, 100 * r.delivered);
+
+        // Kept up: every tick on time but a few, within its budget
+        bool kept = r.paired == r.matches && ! r.skipped && r.late * 100 <= r.ticks &&
+                    r.p99 < 1000000 / SERVER_TICK_HZ;
+        if (kept && r.cpu > 0.0) {
+            perCore = r.matches / r.cpu;
+            from = r.matches;
+        }
+
+        if (l == 0 && (! kept || r.delivered < 0.95)) {
+            printf("FAIL: the server does not keep up with %u matches\n", r.matches);
+            ++failures;
+        }
+    }
+
+    if (from) {
+        printf("About %.0f matches per core at %u Hz (from the %u matches load)\n", perCore, SERVER_TICK_HZ, from);
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+// Shape microbenchmark: the former virtual Sprite hierarchy against the
+// statically dispatched one (shapes.h), in object size and intersection tests.
+//
+// Usage: bench_shapes [tests]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "shapes.h"
+#include "rng.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// The hierarchy as it was: virtual bounds, bounding box test for every pair
+namespace legacy {
+    struct Sprite {
+        Sprite (float x0, float y0) : p(x0, y0) {
+        }
+
+        virtual float left () const = 0;
+        virtual float right () const = 0;
+        virtual float top () const = 0;
+        virtual float bottom () const = 0;
+
+        bool intersects (Sprite const& other) const {
+            return right()  >= other.left() && left() <= other.right() &&
+                   bottom() >= other.top()  && top()  <= other.bottom();
+        }
+
+        glm::vec2 p;
+    };
+
+    struct Rectangle : Sprite {
+        Rectangle (float x0, float y0, float w, float h) : Sprite(x0, y0), dims(w, h) {
+        }
+
+        float left () const { return p.x; }
+        float right () const { return p.x + dims.x; }
+        float top () const { return p.y; }
+        float bottom () const { return p.y + dims.y; }
+
+        glm::vec2 dims;
+    };
+
+    struct Circle : Sprite {
+        Circle (float x0, float y0, float r) : Sprite(x0, y0), r(r) {
+        }
+
+        float left () const { return p.x; }
+        float right () const { return p.x + 2 * r; }
+        float top () const { return p.y; }
+        float bottom () const { return p.y + 2 * r; }
+
+        float r;
+    };
+}
+
+static const unsigned int N = 1024;
+
+struct Scene {
+    Scene () : rng(5) {
+        for (unsigned int i = 0; i < N; ++i) {
+            float x = rng.uniform(0.0f, 900.0f), y = rng.uniform(0.0f, 500.0f),
+                  w = rng.uniform(5.0f, 120.0f), h = rng.uniform(5.0f, 120.0f),
+                  r = rng.uniform(3.0f, 40.0f);
+
+            rects.push_back(Rectangle(x, y, w, h));
+            circles.push_back(Circle(y, x * 0.5f, r));
+            legacyRectStore.push_back(legacy::Rectangle(x, y, w, h));
+            legacyCircleStore.push_back(legacy::Circle(y, x * 0.5f, r));
+        }
+
+        // Reached through base pointers, as a scene of mixed shapes would be
+        for (unsigned int i = 0; i < N; ++i) {
+            legacyRects.push_back(&legacyRectStore[i]);
+            legacyCircles.push_back(&legacyCircleStore[i]);
+        }
+    }
+
+    Rng rng;
+    std::vector<Rectangle> rects;
+    std::vector<Circle> circles;
+    std::vector<legacy::Rectangle> legacyRectStore;
+    std::vector<legacy::Circle> legacyCircleStore;
+    std::vector<legacy::Sprite*> legacyRects, legacyCircles;
+};
+
+// Runs count tests of f(a[i], b[j]) over pseudo-random pairs, returns ns/test
+template <typename A, typename B, typename F>
+static double run (std::vector<A> const& a, std::vector<B> const& b, unsigned long count,
+                   F f, unsigned long& hits) {
+    hits = 0;
+    Clock::time_point start = Clock::now();
+    for (unsigned long k = 0; k < count; ++k) {
+        unsigned int i = k & (N - 1), j = (k * 7 + (k >> 10)) & (N - 1);
+        hits += f(a[i], b[j]);
+    }
+    return std::chrono::duration<double>(Clock::now() - start).count() * 1e9 / count;
+}
+
+static bool virtualTest (legacy::Sprite* const& a, legacy::Sprite* const& b) {
+    return a->intersects(*b);
+}
+
+template <typename A, typename B>
+static bool boundsTest (A const& a, B const& b) {
+    return overlaps(a, b);
+}
+
+template <typename A, typename B>
+static bool exactTest (A const& a, B const& b) {
+    return a.intersects(b);
+}
+
+template <typename A, typename B>
+static void pair (const char* name, std::vector<legacy::Sprite*> const& la, std::vector<legacy::Sprite*> const& lb,
+                  std::vector<A> const& a, std::vector<B> const& b, unsigned long count) {
+    unsigned long hv, hb, he;
+    double v = run(la, lb, count, virtualTest, hv),
+           s = run(a, b, count, boundsTest<A, B>, hb),
+           e = run(a, b, count, exactTest<A, B>, he);
+
+    printf("%-14s %10.2f %10.2f %10.2f %8.1fx   (hits %lu / %lu / %lu)\n",
+           name, v, s, e, v / s, hv, hb, he);
+}
+
+int main (int argc, char** argv) {
+    unsigned long count = argc > 1 ? strtoul(argv[1], nullptr, 10) : 50000000;
+    Scene scene;
+
+    printf("sizeof    virtual  static\n");
+    printf("rectangle %7u %7u\n", unsigned(sizeof(legacy::Rectangle)), unsigned(sizeof(Rectangle)));
+    printf("circle    %7u %7u\n\n", unsigned(sizeof(legacy::Circle)), unsigned(sizeof(Circle)));
+
+    printf("ns/test        %10s %10s %10s %9s\n", "virtual", "bounds", "exact", "speedup");
+    pair("rect-rect", scene.legacyRects, scene.legacyRects, scene.rects, scene.rects, count);
+    pair("circle-rect", scene.legacyCircles, scene.legacyRects, scene.circles, scene.rects, count);
+    pair("circle-circle", scene.legacyCircles, scene.legacyCircles, scene.circles, scene.circles, count);
+
+    return 0;
+}
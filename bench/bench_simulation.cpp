@@ -0,0 +1,119 @@
+// Headless throughput benchmark of the simulation core.
+//
+// Both paddles are driven by a noisy ball-tracking bot so that rallies have
+// realistic lengths, optionally with obstacles in the field (see Arena), in
+// which case it also checks that the ball never ends up inside one.
+//
+// Usage: bench_simulation [rallies] [seed] [obstacles]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "simulation.h"
+#include "arena.h"
+
+static void track (Paddle& paddle, Ball const& ball, float error) {
+    float target = ball.y() + ball.radius() + error,
+          centre = paddle.y() + paddle.height() / 2,
+          dy = target - centre;
+
+    if (dy > PADDLE_SPEED) {
+        dy = PADDLE_SPEED;
+    } else if (dy < -PADDLE_SPEED) {
+        dy = -PADDLE_SPEED;
+    }
+
+    paddle.moveY(dy);
+}
+
+// Steps that leave the centre of the ball inside an obstacle, which the
+// moving ones would cause if the ball were swept against them as if static
+// (serves, which may start on one, are left out)
+static unsigned long buried (Simulation& sim, Arena const& arena, unsigned long steps) {
+    unsigned long count = 0;
+    for (unsigned long i = 0; i < steps; ++i) {
+        track(sim.player, sim.ball, 0.0f);
+        track(sim.cpu, sim.ball, 0.0f);
+        unsigned int events = sim.step();
+        if (sim.finished()) {
+            sim.restart();
+        }
+
+        if (events & SIM_SCORE) {
+            continue;
+        }
+
+        glm::vec2 c = sim.ball.p + glm::vec2(sim.ball.radius());
+        for (unsigned int j = 0; j < arena.obstacles.size(); ++j) {
+            Obstacle const& o = arena.obstacles[j];
+            if (c.x > o.left() && c.x < o.right() && c.y > o.top() && c.y < o.bottom()) {
+                ++count;
+                break;
+            }
+        }
+    }
+
+    return count;
+}
+
+int main (int argc, char** argv) {
+    unsigned long rallies = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    uint32_t seed = argc > 2 ? strtoul(argv[2], nullptr, 10) : 42;
+    unsigned int obstacles = argc > 3 ? strtoul(argv[3], nullptr, 10) : 0;
+
+    Simulation sim(seed);
+    Arena arena;
+    if (obstacles) {
+        arena.spawn(sim.rng, obstacles);
+        sim.arena = &arena;
+    }
+    Rng noise(seed + 1);
+    float errorPlayer = 0.0f, errorCpu = 0.0f;
+
+    unsigned long steps = 0, hits = 0, played = 0, matches = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    while (played < rallies) {
+        track(sim.player, sim.ball, errorPlayer);
+        track(sim.cpu, sim.ball, errorCpu);
+
+        unsigned int events = sim.step();
+        ++steps;
+
+        if (events & SIM_HIT) {
+            ++hits;
+            // Aim somewhere else on the paddle for the next return
+            errorPlayer = noise.uniform(-PADDLE_H * 0.8f, PADDLE_H * 0.8f);
+            errorCpu = noise.uniform(-PADDLE_H * 0.8f, PADDLE_H * 0.8f);
+        }
+
+        if (events & SIM_SCORE) {
+            ++played;
+        }
+
+        if (sim.finished()) {
+            ++matches;
+            sim.restart();
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+
+    printf("rallies:      %lu (%lu matches)\n", played, matches);
+    printf("steps:        %lu (%.1f per rally, %.2f hits per rally)\n",
+           steps, double(steps) / played, double(hits) / played);
+    printf("time:         %.3f s\n", secs);
+    printf("steps/sec:    %.0f\n", steps / secs);
+    printf("ns/step:      %.2f\n", secs * 1e9 / steps);
+
+    if (obstacles) {
+        unsigned long inside = buried(sim, arena, 1000000);
+        printf("ball inside an obstacle: %lu steps in 1000000: %s\n", inside, inside ? "FAILED" : "ok");
+        return inside ? 1 : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+// Streaming benchmark: decode throughput per format, then checks that a
+// looped stream plays its samples back to back with no gap, that a stream
+// plays to its end and detaches, and how the ring holds up when filled by
+// another thread with a slow reader.
+//
+// Usage: bench_stream [seconds]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "vita_mixer.h"
+#include "vita_stream.h"
+#include "rng.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct MemoryFile {
+    std::vector<unsigned char> bytes;
+    unsigned int slowEvery = 0; // Stall one read in slowEvery
+    unsigned int stallMs = 0;
+    unsigned int reads = 0;
+};
+
+static int readMemory (void* file, void* buf, unsigned int size, unsigned long offset) {
+    MemoryFile* f = (MemoryFile*) file;
+    if (f->slowEvery && ++f->reads % f->slowEvery == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(f->stallMs));
+    }
+    if (offset >= f->bytes.size()) return 0;
+    if (size > f->bytes.size() - offset) size = f->bytes.size() - offset;
+    memcpy(buf, &f->bytes[offset], size);
+    return size;
+}
+
+static void put32 (std::vector<unsigned char>& b, unsigned int at, unsigned int v) {
+    memcpy(&b[at], &v, 4);
+}
+
+static void put16 (std::vector<unsigned char>& b, unsigned int at, unsigned short v) {
+    memcpy(&b[at], &v, 2);
+}
+
+// A RIFF WAV file holding frames of random samples
+static MemoryFile makeFile (Rng& rng, unsigned int channels, unsigned int bits, unsigned int rate, unsigned int frames) {
+    unsigned int length = frames * channels * bits / 8;
+    MemoryFile f;
+    f.bytes.assign(0x2c + length, 0);
+    memcpy(&f.bytes[0], "RIFF", 4);
+    put32(f.bytes, 4, 0x24 + length);
+    memcpy(&f.bytes[8], "WAVEfmt ", 8);
+    put32(f.bytes, 0x10, 16);
+    put16(f.bytes, 0x14, 1);
+    put16(f.bytes, 0x16, channels);
+    put32(f.bytes, 0x18, rate);
+    put32(f.bytes, 0x1c, rate * channels * bits / 8);
+    put16(f.bytes, 0x20, channels * bits / 8);
+    put16(f.bytes, 0x22, bits);
+    memcpy(&f.bytes[0x24], "data", 4);
+    put32(f.bytes, 0x28, length);
+    for (unsigned int i = 0; i < length; ++i) {
+        f.bytes[0x2c + i] = rng.range(0, 255);
+    }
+    return f;
+}
+
+static bool open (vitaStream& stream, MemoryFile& file) {
+    return vitaStreamOpen(&stream, file.bytes.data(), file.bytes.size(), readMemory, &file);
+}
+
+static void benchDecode (Rng& rng) {
+    const unsigned int rates[] = { 44100, 22050 };
+    static vitaStream stream;
+
+    printf("%-18s %14s\n", "format", "decode Mframe/s");
+    for (unsigned int rate : rates) {
+        for (int f = 0; f < 4; ++f) {
+            unsigned int channels = 1 + (f & 1), bits = (f & 2) ? 16 : 8;
+            MemoryFile file = makeFile(rng, channels, bits, rate, rate * 4);
+            open(stream, file);
+            vitaStreamRewind(&stream, 1);
+
+            unsigned long long frames = 0;
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < 200; ++i) {
+                frames += vitaStreamFill(&stream, VITA_STREAM_RING_FRAMES);
+                stream.head = stream.tail; // Consumed
+            }
+            double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+            printf("%s %2u bit %5u %14.1f\n", channels == 1 ? "mono  " : "stereo", bits, rate, frames / secs / 1e6);
+        }
+    }
+}
+
+// Same-rate stereo s16 loops must come out as the source, repeated
+static bool checkGapless (Rng& rng) {
+    const unsigned int frames = 1000, buffers = 50;
+    static vitaStream stream;
+    MemoryFile file = makeFile(rng, 2, 16, VITA_AUDIO_FREQUENCY, frames);
+    const short* source = (const short*) &file.bytes[0x2c];
+    std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+
+    open(stream, file);
+    vitaStreamRewind(&stream, 1);
+    vitaStreamFill(&stream, VITA_STREAM_RING_FRAMES);
+
+    vitaMixerReset();
+    vitaMixerPlayStream(&stream);
+
+    for (unsigned int b = 0; b < buffers; ++b) {
+        vitaMixerMix(out.data(), VITA_NUM_AUDIO_SAMPLES);
+        vitaStreamFill(&stream, VITA_STREAM_RING_FRAMES);
+        for (unsigned int i = 0; i < VITA_NUM_AUDIO_SAMPLES * 2; ++i) {
+            unsigned int at = (b * VITA_NUM_AUDIO_SAMPLES * 2 + i) % (frames * 2);
+            if (out[i] != source[at]) return false;
+        }
+    }
+
+    vitaStreamStats stats = stream.stats;
+    printf("gapless loop: %lu loops over %u buffers, %lu starvations\n", stats.loops, buffers, stats.starvations);
+    return stats.starvations == 0 && stats.loops >= buffers * VITA_NUM_AUDIO_SAMPLES / frames;
+}
+
+// A stream plays once then lets go; resampled, it lasts as long
+static bool checkEnd (Rng& rng) {
+    static vitaStream stream;
+    MemoryFile file = makeFile(rng, 1, 8, 22050, 22050);
+    std::vector<short> out(VITA_NUM_AUDIO_SAMPLES * 2);
+    unsigned int mixed = 0;
+
+    open(stream, file);
+    vitaStreamRewind(&stream, 0);
+
+    vitaMixerReset();
+    vitaMixerPlayStream(&stream);
+    while (mixed < 4 * VITA_AUDIO_FREQUENCY) {
+        vitaStreamFill(&stream, VITA_STREAM_RING_FRAMES);
+        vitaMixerMix(out.data(), VITA_NUM_AUDIO_SAMPLES);
+        mixed += VITA_NUM_AUDIO_SAMPLES;
+        if (vitaMixerStreamIdle(&stream)) break;
+    }
+
+    unsigned long long decoded = stream.stats.decoded;
+    printf("one shot: 1 s at 22050 Hz -> %llu frames, idle after %u frames\n", decoded, mixed);
+    return vitaMixerStreamIdle(&stream) && decoded >= VITA_AUDIO_FREQUENCY - 2 && decoded <= VITA_AUDIO_FREQUENCY;
+}
+
+// The I/O thread fills while the audio thread mixes 256 frame buffers in
+// real time, with a reader that stalls now and then, then on every read
+// for longer than the 64 ms of sound a read brings
+static void benchThreaded (Rng& rng, double seconds) {
+    static vitaStream stream;
+    MemoryFile file = makeFile(rng, 2, 16, 32000, 32000 * 2);
+    std::vector<short> out(256 * 2);
+    std::atomic<bool> done(false);
+
+    const unsigned int stalls[][2] = { { 0, 0 }, { 8, 100 }, { 1, 100 } };
+
+    for (auto const& stall : stalls) {
+        file.slowEvery = stall[0];
+        file.stallMs = stall[1];
+        open(stream, file);
+        vitaStreamRewind(&stream, 1);
+        vitaStreamFill(&stream, VITA_NUM_AUDIO_SAMPLES * 4);
+
+        vitaMixerReset();
+        vitaMixerPlayStream(&stream);
+
+        done = false;
+        std::thread io([&] {
+            while (! done) {
+                if (vitaStreamFill(&stream, VITA_STREAM_RING_FRAMES / 4) == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+        });
+
+        const std::chrono::microseconds period(256 * 1000000 / VITA_AUDIO_FREQUENCY);
+        Clock::time_point next = Clock::now();
+        Clock::time_point end = next + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+        while (Clock::now() < end) {
+            vitaMixerMix(out.data(), 256);
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        done = true;
+        io.join();
+
+        vitaStreamStats stats = stream.stats;
+        printf("stall %3u ms every %u reads: %lu buffers, min fill %5u/%u frames, %lu starvations\n",
+               stall[1], stall[0], stats.buffers, stats.minFill, stats.capacity, stats.starvations);
+    }
+}
+
+int main (int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    Rng rng(3);
+    int failures = 0;
+
+    printf("memory per stream: %u bytes\n\n", (unsigned int) sizeof(vitaStream));
+
+    benchDecode(rng);
+    printf("\n");
+
+    bool gapless = checkGapless(rng);
+    printf("gapless: %s\n", gapless ? "ok" : "FAILED");
+    failures += ! gapless;
+
+    bool end = checkEnd(rng);
+    printf("end: %s\n\n", end ? "ok" : "FAILED");
+    failures += ! end;
+
+    benchThreaded(rng, seconds);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
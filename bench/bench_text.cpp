@@ -0,0 +1,166 @@
+// Text layout benchmark: the menu and HUD strings of a frame laid out every
+// frame, as the PGF path does, against the layout cache and text slots.
+// Checks that nothing is laid out again in steady state.
+//
+// Usage: bench_text [frames]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "text.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Stand-in metrics, close to the default PGF font at scales 1 and 2
+static GlyphAtlas makeAtlas () {
+    GlyphAtlas atlas;
+    for (int s = 1; s <= 2; ++s) {
+        GlyphSet set;
+        set.scale = float(s);
+        set.lineHeight = 17.0f * s;
+        set.pad = 5.0f * s;
+        for (int i = 0; i < TEXT_GLYPHS; ++i) {
+            float advance = (7.0f + (i % 5)) * s;
+            set.glyphs[i] = { float(i * 16 % 1024), float(i / 64 * 32), advance + 2 * set.pad,
+                              set.lineHeight + 2 * set.pad, advance };
+        }
+        atlas.sets.push_back(set);
+    }
+    return atlas;
+}
+
+static const char* menu[] = { "Pong", "One Player", "Two Players", "Multiball", "Arena" };
+
+// What a frame draws: the menu, both scores and the debug overlay
+struct Frame {
+    TextCache* cache;
+    TextSlot scores[2];
+    TextSlot debug[4];
+    float checksum = 0.0f;
+
+    void draw (TextLayout const& layout) {
+        checksum += layout.width + layout.quads.size();
+    }
+
+    void cached (unsigned int f) {
+        draw(cache->get(menu[0], 2.0f));
+        for (unsigned int i = 1; i < 5; ++i) {
+            draw(cache->get(menu[i], 1.0f));
+        }
+        draw(scores[0].number(*cache, f / 600, 2.0f));
+        draw(scores[1].number(*cache, f / 900, 2.0f));
+        draw(debug[0].format(*cache, 1.0f, "FPS: %.2f", 60.0f - (f / 60) % 2));
+        draw(debug[1].format(*cache, 1.0f, "Tick: %u Hz", 120u));
+        draw(debug[2].format(*cache, 1.0f, "Caught up: %llu", 0ull));
+        draw(debug[3].format(*cache, 1.0f, "Dropped: %llu", 0ull));
+    }
+
+    // Every string measured and laid out again, every frame
+    void uncached (unsigned int f) {
+        TextLayout layout;
+        char buf[128];
+
+        cache->layout(menu[0], 2.0f, layout);
+        draw(layout);
+        for (unsigned int i = 1; i < 5; ++i) {
+            cache->layout(menu[i], 1.0f, layout);
+            draw(layout);
+        }
+        snprintf(buf, sizeof(buf), "%u", f / 600);
+        cache->layout(buf, 2.0f, layout);
+        draw(layout);
+        snprintf(buf, sizeof(buf), "%u", f / 900);
+        cache->layout(buf, 2.0f, layout);
+        draw(layout);
+        snprintf(buf, sizeof(buf), "FPS: %.2f", 60.0f - (f / 60) % 2);
+        cache->layout(buf, 1.0f, layout);
+        draw(layout);
+        snprintf(buf, sizeof(buf), "Tick: %u Hz", 120u);
+        cache->layout(buf, 1.0f, layout);
+        draw(layout);
+        snprintf(buf, sizeof(buf), "Caught up: %llu", 0ull);
+        cache->layout(buf, 1.0f, layout);
+        draw(layout);
+        snprintf(buf, sizeof(buf), "Dropped: %llu", 0ull);
+        cache->layout(buf, 1.0f, layout);
+        draw(layout);
+    }
+};
+
+int main (int argc, char** argv) {
+    unsigned int frames = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+
+    GlyphAtlas atlas = makeAtlas();
+    int failures = 0;
+
+    // Alignment and set selection
+    TextCache cache;
+    cache.init(&atlas);
+    TextLayout const& title = cache.get("Pong", 2.0f);
+    TextLayout const& small = cache.get("Pong", 0.5f);
+    float x = 100.0f, y = 100.0f;
+    title.align(x, y, TEXT_CENTER, TEXT_BOTTOM);
+    if (title.set->scale != 2.0f || small.set->scale != 1.0f || small.ratio != 0.5f ||
+        x != 100.0f - 0.5f * title.width || y != 100.0f - title.height) {
+        printf("FAIL: layout metrics\n");
+        ++failures;
+    }
+    if (&cache.get("Pong", 2.0f) != &title || cache.totalLayouts != 2) {
+        printf("FAIL: cache hit laid out again\n");
+        ++failures;
+    }
+
+    // Steady state: only the strings whose content changed are laid out
+    Frame frame;
+    frame.cache = &cache;
+    cache.init(&atlas);
+    cache.totalLayouts = 0;
+    frame.cached(0);
+    cache.beginFrame();
+    uint64_t first = cache.totalLayouts;
+    unsigned int busy = 0;
+
+    Clock::time_point start = Clock::now();
+    for (unsigned int f = 1; f <= frames; ++f) {
+        frame.cached(f);
+        busy += cache.layouts != 0;
+        cache.beginFrame();
+    }
+    double cachedTime = seconds(start);
+    uint64_t steady = cache.totalLayouts - first;
+
+    // Score and FPS changes: 1/600 + 1/900 + 1/60 of the frames at most
+    uint64_t expected = frames / 600 + frames / 900 + frames / 60 + 3;
+    if (first != 11 || steady > expected) {
+        printf("FAIL: %llu layouts on the first frame, %llu after (expected <= %llu)\n",
+               (unsigned long long) first, (unsigned long long) steady, (unsigned long long) expected);
+        ++failures;
+    }
+
+    Frame legacy;
+    legacy.cache = &cache;
+    start = Clock::now();
+    for (unsigned int f = 1; f <= frames; ++f) {
+        legacy.uncached(f);
+    }
+    double uncachedTime = seconds(start);
+
+    printf("%u frames, 11 strings per frame\n", frames);
+    printf("  uncached: %8.3f us/frame, 11 layouts per frame\n", 1e6 * uncachedTime / frames);
+    printf("  cached:   %8.3f us/frame, %llu layouts in total, on %u frames (%.2f%%)\n",
+           1e6 * cachedTime / frames, (unsigned long long) steady, busy, 100.0 * busy / frames);
+    printf("  speedup:  %.1fx\n", uncachedTime / cachedTime);
+
+    if (frame.checksum == 0.0f || legacy.checksum == 0.0f) {
+        printf("FAIL: nothing drawn\n");
+        ++failures;
+    }
+
+    printf(failures ? "FAILED\n" : "OK\n");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,93 @@
+#include "ai.h"
+
+const AiSettings aiLevels[AI_LEVELS] = {
+    // Reaction (ms), error (px), speed
+    { 300.0f, 100.0f, 0.5f },  // AI_EASY
+    { 150.0f, 75.0f,  0.75f }, // AI_NORMAL
+    { 60.0f,  40.0f,  1.0f },  // AI_HARD
+    { 100.0f, 70.0f,  1.0f },  // AI_LEARNED
+};
+
+float aiFoldY (float y, float vy, float r, float t) {
+    // The ball bounces between 0 and l: on the unfolded line, every period
+    // of 2 l goes down then up again
+    float l = SCREEN_H - 2 * r;
+    float m = fmodf(y + vy * t, 2 * l);
+    if (m < 0.0f) {
+        m += 2 * l;
+    }
+    return m > l ? 2 * l - m : m;
+}
+
+bool aiPredictY (glm::vec2 const& p, glm::vec2 const& v, float r, float x, float& y) {
+    if (v.x == 0.0f) {
+        return false;
+    }
+
+    float t = (x - p.x) / v.x;
+    if (t < 0.0f) {
+        return false;
+    }
+
+    y = aiFoldY(p.y, v.y, r, t);
+    return true;
+}
+
+void CpuPlayer::reset (AiSettings const& settings, unsigned int hz, uint32_t seed, bool left) {
+    this->settings = settings;
+    this->left = left;
+    delay = (unsigned int) (settings.reactionMs * hz / 1000.0f + 0.5f);
+    if (delay >= AI_HISTORY) {
+        delay = AI_HISTORY - 1;
+    }
+
+    rng.seed(seed ^ (left ? 0x1B873593u : 0x5BD1E995u));
+    ticks = 0;
+    seen = 0;
+    offset = 0.0f;
+    coming = false;
+    target = SCREEN_H / 2;
+}
+
+float CpuPlayer::update (Simulation const& sim) {
+    unsigned int i = ticks++ % AI_HISTORY;
+    p[i] = sim.ball.p;
+    v[i] = sim.ball.v;
+
+    // What it saw delay ticks ago, or the oldest state it has
+    unsigned int age = delay < ticks ? delay : ticks - 1;
+    unsigned int j = seen = (ticks - 1 - age) % AI_HISTORY;
+
+    Paddle const& paddle = left ? sim.player : sim.cpu;
+    float r = sim.ball.radius(), y;
+    float face = left ? paddle.right() : paddle.left() - 2 * r;
+    bool now = aiPredictY(p[j], v[j], r, face, y);
+
+    // A new error for each approach of the ball
+    if (now && ! coming) {
+        offset = rng.uniform(-settings.error, settings.error);
+    }
+    coming = now;
+
+    float step = settings.speed * paddleSpeed * sim.dt;
+    if (net) {
+        float f[NN_FEATURES];
+        features(sim, f);
+        return net->forward(f) * step;
+    }
+
+    if (now) {
+        target = y + r + offset;
+        ++predictions;
+    } else {
+        // Back to the middle while the ball goes away
+        target = SCREEN_H / 2;
+    }
+
+    float d = target - (paddle.y() + paddle.height() / 2);
+    return d > step ? step : (d < -step ? -step : d);
+}
+
+void CpuPlayer::features (Simulation const& sim, float* f) const {
+    nnFeatures(p[seen], v[seen], sim.ball.radius(), left ? sim.player : sim.cpu, left, coming ? offset : 0.0f, f);
+}
@@ -0,0 +1,75 @@
+#ifndef _AI_H_
+#define _AI_H_
+
+#include <stdint.h>
+
+#include "simulation.h"
+#include "nn.h"
+
+// Ticks of ball states kept for the reaction delay, power of two
+#define AI_HISTORY 64
+
+enum {
+    AI_EASY,
+    AI_NORMAL,
+    AI_HARD,
+    AI_LEARNED, // A NeuralNet, see nn.h
+    AI_LEVELS,
+};
+
+// How well the CPU plays
+struct AiSettings {
+    float reactionMs; // Age of the ball state it acts on
+    float error;      // Pixels, at most, off the predicted point
+    float speed;      // Fraction of the paddle speed
+};
+
+extern const AiSettings aiLevels[AI_LEVELS];
+
+// Where a ball moving freely between the walls is when it reaches x:
+// reflections off the top and bottom are folded into the straight line, so
+// the cost does not depend on the distance or the speed. Positions are the
+// top-left corner of the ball (see Circle), the walls bound the ball between
+// y = 0 and y = SCREEN_H. Returns false if the ball does not move towards x.
+bool aiPredictY (glm::vec2 const& p, glm::vec2 const& v, float r, float x, float& y);
+
+// y after t reference frames, the same way
+float aiFoldY (float y, float vy, float r, float t);
+
+// A paddle played by the CPU: the right one in One Player mode, both in
+// Demo mode. Platform-free and deterministic, its state is part of the
+// match: it can be recorded and replayed with it.
+struct CpuPlayer {
+    // Forgets the past ball states, at the start of a match. The left
+    // paddle is Simulation::player, the right one Simulation::cpu.
+    void reset (AiSettings const& settings, unsigned int hz, uint32_t seed, bool left = false);
+
+    // Pixels to move the paddle this tick, from the ball reactionMs ago:
+    // towards where it will cross the paddle, or as the network says
+    float update (Simulation const& sim);
+
+    // The network's inputs, from the ball state and the error the last
+    // update acted on
+    void features (Simulation const& sim, float* f) const;
+
+    AiSettings settings;
+    Rng rng;
+    bool left = false;
+    float paddleSpeed = PADDLE_SPEED;
+    unsigned int delay = 0; // reactionMs in ticks
+    NeuralNet const* net = nullptr; // Plays instead of the prediction if set
+
+    // Ball states of the last ticks, in a ring
+    glm::vec2 p[AI_HISTORY], v[AI_HISTORY];
+    unsigned int ticks = 0;
+    unsigned int seen = 0; // The state acted on, in the ring
+
+    float offset = 0.0f;  // Current error
+    bool coming = false;  // The ball, as seen, moves towards the paddle
+    float target = 0.0f;  // Paddle centre aimed at
+
+    // Stats
+    unsigned long predictions = 0;
+};
+
+#endif
@@ -0,0 +1,104 @@
+#include "arena.h"
+
+#include <cmath>
+
+void Arena::clear () {
+    obstacles.clear();
+    owner.clear();
+    grid.clear();
+    maxMove = 0.0f;
+}
+
+void Arena::add (Rectangle const& box, glm::vec2 const& v) {
+    Obstacle o;
+    o.init(box.p, box.dims);
+    o.v = v;
+    o.p0 = o.p;
+    o.id = grid.insert(o);
+
+    if (o.id >= owner.size()) {
+        owner.resize(o.id + 1);
+    }
+    owner[o.id] = obstacles.size();
+
+    obstacles.push_back(o);
+}
+
+void Arena::spawn (Rng& rng, unsigned int n) {
+    Rectangle serve(SCREEN_W / 2 - 60, SCREEN_H / 2 - 60, 120, 120);
+
+    for (unsigned int i = 0; i < n; ++i) {
+        Rectangle box;
+        do {
+            float w = rng.uniform(8.0f, 24.0f), h = rng.uniform(8.0f, 40.0f);
+            box.init(rng.uniform(SCREEN_W / 5, 4 * SCREEN_W / 5 - w),
+                     rng.uniform(0.0f, SCREEN_H - h), w, h);
+        } while (box.intersects(serve));
+
+        glm::vec2 v(0.0f, 0.0f);
+        if (i & 1) {
+            v.y = rng.uniform(1.0f, 3.0f) * (rng.range(0, 1) ? 1.0f : -1.0f);
+        }
+
+        add(box, v);
+    }
+}
+
+void Arena::step (float dt, Circle const& ball) {
+    maxMove = 0.0f;
+    for (unsigned int i = 0; i < obstacles.size(); ++i) {
+        Obstacle& o = obstacles[i];
+        o.p0 = o.p;
+        if (o.v.y == 0.0f) {
+            continue;
+        }
+
+        o.moveY(o.v.y * dt);
+        if (o.top() < 0.0f) {
+            o.y() = 0.0f;
+            o.v.y = -o.v.y;
+        } else if (o.bottom() > SCREEN_H) {
+            o.y() = SCREEN_H - o.height();
+            o.v.y = -o.v.y;
+        }
+
+        // Only towards the ball, so that one already on it (after a serve)
+        // still moves off
+        float towards = (o.y() - o.p0.y) *
+                        (ball.y() + ball.radius() - o.y() - o.height() / 2);
+        if (towards > 0.0f && o.intersects(ball)) {
+            o.p = o.p0;
+            o.v.y = -o.v.y;
+        }
+
+        grid.update(o.id, o);
+        maxMove = maxf(maxMove, std::fabs(o.y() - o.p0.y));
+    }
+}
+
+bool Arena::sweep (Circle const& circle, glm::vec2 const& d, float remaining,
+                   Contact& contact, glm::vec2& moved) const {
+    float r2 = 2 * circle.radius(), pad = maxMove * remaining;
+    candidates.clear();
+    grid.query(minf(circle.x(), circle.x() + d.x) - pad, minf(circle.y(), circle.y() + d.y) - pad,
+               maxf(circle.x(), circle.x() + d.x) + r2 + pad, maxf(circle.y(), circle.y() + d.y) + r2 + pad,
+               candidates);
+
+    bool hit = false;
+    for (unsigned int i = 0; i < candidates.size(); ++i) {
+        Obstacle const& o = obstacles[owner[candidates[i]]];
+
+        // Relative to the obstacle, which moves by m while the circle moves by d
+        glm::vec2 m = (o.p - o.p0) * remaining;
+        Rectangle from(o.p - m, o.dims);
+
+        Contact c;
+        if (::sweep(circle, d - m, from, c) && (! hit || c.t < contact.t)) {
+            contact = c;
+            moved = o.p - o.p0;
+            hit = true;
+        }
+    }
+
+    return hit;
+}
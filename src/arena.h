@@ -0,0 +1,51 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <vector>
+
+#include "collision.h"
+#include "grid.h"
+#include "rng.h"
+
+// Static and moving obstacles in the middle of the field, found through a
+// Grid broadphase so that the ball only sweeps against its neighbours.
+struct Obstacle : Rectangle {
+    glm::vec2 v;     // Pixels per reference frame, (0, 0) when static
+    glm::vec2 p0;    // Position before the last step
+    unsigned int id; // In the grid
+};
+
+struct Arena {
+    Arena () : grid(64.0f) {
+    }
+
+    void clear ();
+
+    // Adds n obstacles between the paddles, half of them moving up and down,
+    // keeping the serve area free
+    void spawn (Rng& rng, unsigned int n);
+
+    void add (Rectangle const& box, glm::vec2 const& v);
+
+    // Moves the moving obstacles by dt reference frames. One that would step
+    // into the ball turns back instead, as it does at the screen edges, so
+    // that it can neither pass through the ball nor pin it against a wall
+    void step (float dt, Circle const& ball);
+
+    // Earliest swept contact of the circle against the obstacles, d being
+    // its motion over the last remaining fraction of the step. Each obstacle
+    // is swept in its own frame, from where it was when d starts, so that one
+    // moving into the circle cannot pass through it; moved is how far the one
+    // hit moved over the whole step.
+    bool sweep (Circle const& circle, glm::vec2 const& d, float remaining,
+                Contact& contact, glm::vec2& moved) const;
+
+    std::vector<Obstacle> obstacles;
+    Grid grid;
+    float maxMove = 0.0f; // Over the last step, pads the broadphase query
+
+    mutable std::vector<unsigned int> candidates;
+    std::vector<unsigned int> owner; // Grid id -> obstacle index
+};
+
+#endif
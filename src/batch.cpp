@@ -0,0 +1,84 @@
+#include <cmath>
+
+#include "batch.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+void Batch::init (BatchSubmit submit, void* user) {
+    this->submit = submit;
+    this->user = user;
+    pending.resize(BATCH_MAX_VERTICES);
+    used = 0;
+
+    for (unsigned int level = 0; level < BATCH_CIRCLE_LEVELS; ++level) {
+        unsigned int segments = 8u << level;
+        cosines[level].resize(segments + 1);
+        sines[level].resize(segments + 1);
+        for (unsigned int i = 0; i <= segments; ++i) {
+            float a = 2.0f * float(M_PI) * (i % segments) / segments;
+            cosines[level][i] = cosf(a);
+            sines[level][i] = sinf(a);
+        }
+    }
+}
+
+unsigned int Batch::circleLevel (float r) {
+    unsigned int level = 0;
+    float segments = 8.0f;
+    while (level + 1 < BATCH_CIRCLE_LEVELS && 2.0f * float(M_PI) * r > 3.0f * segments) {
+        ++level;
+        segments *= 2.0f;
+    }
+    return level;
+}
+
+BatchVertex* Batch::reserve (unsigned int count) {
+    if (used + count > BATCH_MAX_VERTICES) {
+        flush();
+    }
+
+    BatchVertex* v = &pending[used];
+    used += count;
+    return v;
+}
+
+void Batch::rect (float x, float y, float w, float h, uint32_t color) {
+    BatchVertex* v = reserve(6);
+    v[0] = { x,     y,     0.5f, color };
+    v[1] = { x + w, y,     0.5f, color };
+    v[2] = { x,     y + h, 0.5f, color };
+    v[3] = { x + w, y,     0.5f, color };
+    v[4] = { x + w, y + h, 0.5f, color };
+    v[5] = { x,     y + h, 0.5f, color };
+}
+
+void Batch::circle (float x, float y, float r, uint32_t color) {
+    unsigned int level = circleLevel(r);
+    unsigned int segments = 8u << level;
+    float const* c = cosines[level].data();
+    float const* s = sines[level].data();
+
+    // A fan, as a list of triangles so that it joins the rest of the batch
+    BatchVertex* v = reserve(3 * segments);
+    for (unsigned int i = 0; i < segments; ++i, v += 3) {
+        v[0] = { x,                y,                0.5f, color };
+        v[1] = { x + r * c[i],     y + r * s[i],     0.5f, color };
+        v[2] = { x + r * c[i + 1], y + r * s[i + 1], 0.5f, color };
+    }
+}
+
+void Batch::flush () {
+    if (! used) {
+        return;
+    }
+
+    if (submit && submit(pending.data(), used, user)) {
+        ++drawCalls;
+        vertices += used;
+    } else {
+        dropped += used;
+    }
+    used = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdint.h>
+#include <vector>
+
+// Same layout as vita2d_color_vertex
+struct BatchVertex {
+    float x, y, z;
+    uint32_t color;
+};
+
+// Hands a full batch of triangles to the GPU. Returns false if it could
+// not be drawn (out of frame memory).
+typedef bool (*BatchSubmit)(BatchVertex const* vertices, unsigned int count, void* user);
+
+// Most vertices per draw: 256 KB of frame memory
+#define BATCH_MAX_VERTICES 16384
+
+// Circle meshes are cached for 8, 16, 32 and 64 segments
+#define BATCH_CIRCLE_LEVELS 4
+
+// Collects the frame's rectangles and filled circles into one stream of
+// coloured triangles, drawn in as few calls as possible: one per
+// BATCH_MAX_VERTICES, and before anything drawn outside of the batch
+// (text) with flush(). Drawing order is kept.
+//
+// Circles are stamped from unit meshes computed once, with fewer segments
+// for smaller radii, instead of being tessellated again for every draw.
+struct Batch {
+    void init (BatchSubmit submit, void* user = nullptr);
+
+    void rect (float x, float y, float w, float h, uint32_t color);
+
+    // Centred on (x, y), as vita2d_draw_fill_circle
+    void circle (float x, float y, float r, uint32_t color);
+
+    // Draws what has been collected so far
+    void flush ();
+
+    // Starts counting the draws of a new frame
+    void beginFrame () {
+        drawCallsLastFrame = drawCalls;
+        verticesLastFrame = vertices;
+        drawCalls = vertices = 0;
+    }
+
+    // Segments used for a circle of radius r: about one per 3 pixels of
+    // circumference
+    static unsigned int circleLevel (float r);
+
+    // This frame and the previous one
+    unsigned int drawCalls = 0, vertices = 0;
+    unsigned int drawCallsLastFrame = 0, verticesLastFrame = 0;
+    // Vertices that could not be drawn
+    uint64_t dropped = 0;
+
+private:
+    BatchVertex* reserve (unsigned int count);
+
+    BatchSubmit submit = nullptr;
+    void* user = nullptr;
+    std::vector<BatchVertex> pending;
+    unsigned int used = 0;
+
+    // Unit circle points, for each level
+    std::vector<float> cosines[BATCH_CIRCLE_LEVELS], sines[BATCH_CIRCLE_LEVELS];
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "collision.h"
+
+#include <cmath>
+
+static float clampf (float x, float m, float M) {
+    return maxf(m, minf(x, M));
+}
+
+bool sweep (Circle const& circle, glm::vec2 const& d, Rectangle const& rect, Contact& contact) {
+    float r = circle.radius();
+    glm::vec2 c = circle.p + glm::vec2(r, r);
+
+    // Cheap reject: bounding box of the whole motion
+    if (maxf(c.x, c.x + d.x) + r < rect.left() || minf(c.x, c.x + d.x) - r > rect.right() ||
+        maxf(c.y, c.y + d.y) + r < rect.top()  || minf(c.y, c.y + d.y) - r > rect.bottom()) {
+        return false;
+    }
+
+    // Already touching: only report it if moving further in
+    glm::vec2 q(clampf(c.x, rect.left(), rect.right()),
+                clampf(c.y, rect.top(), rect.bottom()));
+    glm::vec2 cq = c - q;
+    float dist2 = glm::dot(cq, cq);
+
+    if (dist2 < r * r) {
+        glm::vec2 n;
+
+        if (dist2 > 0.0f) {
+            n = cq / std::sqrt(dist2);
+        } else {
+            // Centre inside the rectangle: push out along the closest side
+            float dl = c.x - rect.left(), dr = rect.right() - c.x,
+                  dt = c.y - rect.top(),  db = rect.bottom() - c.y,
+                  m = minf(minf(dl, dr), minf(dt, db));
+
+            if (m == dl) {
+                n = glm::vec2(-1.0f, 0.0f);
+            } else if (m == dr) {
+                n = glm::vec2(1.0f, 0.0f);
+            } else if (m == dt) {
+                n = glm::vec2(0.0f, -1.0f);
+            } else {
+                n = glm::vec2(0.0f, 1.0f);
+            }
+        }
+
+        if (glm::dot(d, n) >= 0.0f) {
+            return false;
+        }
+
+        contact.t = 0.0f;
+        contact.normal = n;
+        return true;
+    }
+
+    // Ray (the centre) against the rectangle grown by r (slab test)
+    float lo[2] = { rect.left() - r, rect.top() - r },
+          hi[2] = { rect.right() + r, rect.bottom() + r },
+          o[2]  = { c.x, c.y },
+          v[2]  = { d.x, d.y };
+    float tmin = 0.0f, tmax = 1.0f;
+    int axis = -1;
+
+    for (int i = 0; i < 2; ++i) {
+        if (v[i] == 0.0f) {
+            if (o[i] < lo[i] || o[i] > hi[i]) {
+                return false;
+            }
+            continue;
+        }
+
+        float t0 = (lo[i] - o[i]) / v[i],
+              t1 = (hi[i] - o[i]) / v[i];
+        if (t0 > t1) {
+            float tmp = t0; t0 = t1; t1 = tmp;
+        }
+
+        if (t0 > tmin) {
+            tmin = t0;
+            axis = i;
+        }
+        tmax = minf(tmax, t1);
+
+        if (tmin >= tmax) {
+            return false;
+        }
+    }
+
+    glm::vec2 h = c + d * tmin;
+    bool inX = h.x >= rect.left() && h.x <= rect.right(),
+         inY = h.y >= rect.top()  && h.y <= rect.bottom();
+
+    if (axis < 0) {
+        // Started inside the grown rectangle, exactly at distance r
+        axis = inX ? 1 : 0;
+    }
+
+    if ((axis == 0 && inY) || (axis == 1 && inX)) {
+        // Face
+        glm::vec2 n(0.0f, 0.0f);
+        if (axis == 0) {
+            n.x = d.x > 0.0f ? -1.0f : 1.0f;
+        } else {
+            n.y = d.y > 0.0f ? -1.0f : 1.0f;
+        }
+
+        contact.t = tmin;
+        contact.normal = n;
+        return true;
+    }
+
+    // Rounded corner: ray against the circle of radius r around it
+    glm::vec2 k(h.x < rect.left() ? rect.left() : rect.right(),
+                h.y < rect.top()  ? rect.top()  : rect.bottom());
+    glm::vec2 m = c - k;
+    float a = glm::dot(d, d),
+          b = glm::dot(m, d),
+          cc = glm::dot(m, m) - r * r;
+
+    if (b >= 0.0f) {
+        return false;
+    }
+
+    float disc = b * b - a * cc;
+    if (disc < 0.0f) {
+        return false;
+    }
+
+    float t = (-b - std::sqrt(disc)) / a;
+    if (t > 1.0f) {
+        return false;
+    }
+    t = maxf(t, 0.0f);
+
+    contact.t = t;
+    contact.normal = glm::normalize(m + d * t);
+    return true;
+}
+
+bool sweepWalls (Circle const& circle, glm::vec2 const& d, float top, float bottom, Contact& contact) {
+    if (d.y < 0.0f) {
+        float t = (top - circle.top()) / d.y;
+        if (t <= 1.0f) {
+            contact.t = maxf(t, 0.0f);
+            contact.normal = glm::vec2(0.0f, 1.0f);
+            return true;
+        }
+    } else if (d.y > 0.0f) {
+        float t = (bottom - circle.bottom()) / d.y;
+        if (t <= 1.0f) {
+            contact.t = maxf(t, 0.0f);
+            contact.normal = glm::vec2(0.0f, -1.0f);
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,22 @@
+#ifndef _COLLISION_H_
+#define _COLLISION_H_
+
+#include "shapes.h"
+
+// Continuous (swept) collision detection, so that fast balls cannot tunnel
+// through thin paddles between two ticks.
+
+struct Contact {
+    float t;          // Time of impact, as a fraction of the displacement [0, 1]
+    glm::vec2 normal; // Contact normal, pointing away from the obstacle
+};
+
+// Sweeps a circle (whose position is the top-left corner of its bounding box,
+// see Circle) by d against a rectangle. Returns true and fills contact if the
+// circle touches the rectangle while moving towards it.
+bool sweep (Circle const& circle, glm::vec2 const& d, Rectangle const& rect, Contact& contact);
+
+// Same against the horizontal lines y = top and y = bottom (circle in between)
+bool sweepWalls (Circle const& circle, glm::vec2 const& d, float top, float bottom, Contact& contact);
+
+#endif
@@ -0,0 +1,148 @@
+#include "grid.h"
+
+static int clampi (int x, int m, int M) {
+    return x < m ? m : (x > M ? M : x);
+}
+
+void Grid::init (float cellSize) {
+    this->cellSize = cellSize;
+    invCellSize = 1.0f / cellSize;
+    cols = int(SCREEN_W * invCellSize) + 1;
+    rows = int(SCREEN_H * invCellSize) + 1;
+    cells.assign(cols * rows, std::vector<unsigned int>());
+    ranges.clear();
+    freeIds.clear();
+    marks.clear();
+    mark = 0;
+}
+
+void Grid::clear () {
+    for (unsigned int i = 0; i < cells.size(); ++i) {
+        cells[i].clear();
+    }
+
+    ranges.clear();
+    freeIds.clear();
+    marks.clear();
+}
+
+Grid::Range Grid::range (float left, float top, float right, float bottom) const {
+    Range r;
+    r.x0 = clampi(int(left * invCellSize), 0, cols - 1);
+    r.y0 = clampi(int(top * invCellSize), 0, rows - 1);
+    r.x1 = clampi(int(right * invCellSize), 0, cols - 1);
+    r.y1 = clampi(int(bottom * invCellSize), 0, rows - 1);
+    return r;
+}
+
+void Grid::link (unsigned int id, Range const& r) {
+    for (int y = r.y0; y <= r.y1; ++y) {
+        for (int x = r.x0; x <= r.x1; ++x) {
+            cells[y * cols + x].push_back(id);
+        }
+    }
+}
+
+void Grid::unlink (unsigned int id, Range const& r) {
+    for (int y = r.y0; y <= r.y1; ++y) {
+        for (int x = r.x0; x <= r.x1; ++x) {
+            std::vector<unsigned int>& cell = cells[y * cols + x];
+            for (unsigned int i = 0; i < cell.size(); ++i) {
+                if (cell[i] == id) {
+                    cell[i] = cell.back();
+                    cell.pop_back();
+                    break;
+                }
+            }
+        }
+    }
+}
+
+unsigned int Grid::insert (Rectangle const& box) {
+    unsigned int id;
+
+    if (! freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = ranges.size();
+        ranges.push_back(Range());
+        marks.push_back(0);
+    }
+
+    ranges[id] = range(box.left(), box.top(), box.right(), box.bottom());
+    link(id, ranges[id]);
+
+    return id;
+}
+
+void Grid::update (unsigned int id, Rectangle const& box) {
+    Range r = range(box.left(), box.top(), box.right(), box.bottom());
+    ++updates;
+
+    if (r == ranges[id]) {
+        return;
+    }
+
+    unlink(id, ranges[id]);
+    link(id, r);
+    ranges[id] = r;
+    ++moves;
+}
+
+void Grid::remove (unsigned int id) {
+    unlink(id, ranges[id]);
+    ranges[id].x0 = 1;
+    ranges[id].x1 = 0;
+    freeIds.push_back(id);
+}
+
+void Grid::query (float left, float top, float right, float bottom, std::vector<unsigned int>& out) const {
+    Range r = range(left, top, right, bottom);
+
+    if (++mark == 0) {
+        // Wrapped around: forget the old marks
+        marks.assign(marks.size(), 0);
+        mark = 1;
+    }
+
+    for (int y = r.y0; y <= r.y1; ++y) {
+        for (int x = r.x0; x <= r.x1; ++x) {
+            std::vector<unsigned int> const& cell = cells[y * cols + x];
+            for (unsigned int i = 0; i < cell.size(); ++i) {
+                unsigned int id = cell[i];
+                if (marks[id] != mark) {
+                    marks[id] = mark;
+                    out.push_back(id);
+                }
+            }
+        }
+    }
+}
+
+void Grid::pairs (std::vector<std::pair<unsigned int, unsigned int> >& out) const {
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            std::vector<unsigned int> const& cell = cells[y * cols + x];
+
+            for (unsigned int i = 0; i < cell.size(); ++i) {
+                Range const& a = ranges[cell[i]];
+
+                for (unsigned int j = i + 1; j < cell.size(); ++j) {
+                    Range const& b = ranges[cell[j]];
+
+                    // Two objects can share several cells: only report the
+                    // pair from the first cell of their common range
+                    int ox = a.x0 > b.x0 ? a.x0 : b.x0,
+                        oy = a.y0 > b.y0 ? a.y0 : b.y0;
+                    if (ox != x || oy != y) {
+                        continue;
+                    }
+
+                    unsigned int p = cell[i], q = cell[j];
+                    out.push_back(p < q ? std::make_pair(p, q) : std::make_pair(q, p));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include <vector>
+#include <utility>
+
+#include "shapes.h"
+#include "graphics_constants.h"
+
+// Uniform grid broadphase over the screen: every object is stored in the
+// cells covered by its bounding box. Moving an object only touches the grid
+// when the range of cells it covers changes.
+//
+// The grid only returns candidates: the caller does the narrow phase.
+struct Grid {
+    Grid (float cellSize = 64.0f) {
+        init(cellSize);
+    }
+
+    // Cell size in pixels, the grid covers SCREEN_W x SCREEN_H (objects
+    // outside are clamped to the border cells)
+    void init (float cellSize);
+
+    // Removes every object
+    void clear ();
+
+    // Returns the id of the new object
+    unsigned int insert (Rectangle const& box);
+
+    void update (unsigned int id, Rectangle const& box);
+
+    void remove (unsigned int id);
+
+    // Appends the ids of the objects that may overlap the given box
+    void query (float left, float top, float right, float bottom, std::vector<unsigned int>& out) const;
+
+    void query (Rectangle const& box, std::vector<unsigned int>& out) const {
+        query(box.left(), box.top(), box.right(), box.bottom(), out);
+    }
+
+    // Appends every pair (a < b) of objects sharing at least one cell, once
+    void pairs (std::vector<std::pair<unsigned int, unsigned int> >& out) const;
+
+    struct Range {
+        int x0, y0, x1, y1;
+
+        bool operator== (Range const& o) const {
+            return x0 == o.x0 && y0 == o.y0 && x1 == o.x1 && y1 == o.y1;
+        }
+    };
+
+    Range range (float left, float top, float right, float bottom) const;
+
+    void link (unsigned int id, Range const& r);
+    void unlink (unsigned int id, Range const& r);
+
+    float cellSize, invCellSize;
+    int cols, rows;
+
+    std::vector<std::vector<unsigned int> > cells;
+    std::vector<Range> ranges; // Per object, empty (x0 > x1) once removed
+    std::vector<unsigned int> freeIds;
+
+    // Query deduplication
+    mutable std::vector<unsigned int> marks;
+    mutable unsigned int mark = 0;
+
+    // Stats
+    unsigned long moves = 0;   // update() calls that changed cells
+    unsigned long updates = 0; // update() calls
+};
+
+#endif
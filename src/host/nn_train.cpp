@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "nn_train.h"
+#include "selfplay.h"
+
+// Distance to its target, in pixels, under which the label slows the
+// paddle down. The prediction stops within one tick's move, but the
+// network sees the ball in int8 steps of a few pixels: too coarse a view
+// for such a sharp turn.
+#define NN_TRAIN_SLOWDOWN (24.0f)
+
+static void collectMatch (NnTrainConfig const& config, uint32_t seed, uint64_t i, NeuralNet const* net,
+                          Match& match, std::vector<NnSample>& out) {
+    uint32_t s = selfPlaySeed(seed, i);
+    Rng pick(s);
+    unsigned int left = pick.range(AI_EASY, AI_HARD);
+    unsigned int right = net ? AI_LEARNED : pick.range(AI_EASY, AI_HARD);
+
+    match.net = net;
+    match.setTickRate(config.tickHz);
+    match.start(GameMode::Demo, s, right, left);
+
+    // The teachers watch both paddles, with the reaction time and the error
+    // of the network
+    AiSettings settings = aiLevels[AI_LEARNED];
+    settings.speed = 1.0f;
+    CpuPlayer teachers[2];
+    teachers[0].reset(settings, config.tickHz, ~s, true);
+    teachers[1].reset(settings, config.tickHz, ~s);
+
+    const unsigned int maxTicks = config.maxSeconds * config.tickHz;
+    const TickInput none;
+
+    while (! match.over() && match.ticks < maxTicks) {
+        if (! match.serving()) {
+            bool keep = match.ticks % config.stride == 0;
+            for (int side = 0; side < 2; ++side) {
+                CpuPlayer& teacher = teachers[side];
+                teacher.update(match.sim);
+                if (keep) {
+                    Paddle const& paddle = side ? match.sim.cpu : match.sim.player;
+                    float d = (teacher.target - (paddle.y() + paddle.height() / 2)) / NN_TRAIN_SLOWDOWN;
+
+                    NnSample sample;
+                    teacher.features(match.sim, sample.f);
+                    sample.label = d > 1.0f ? 1.0f : (d < -1.0f ? -1.0f : d);
+                    out.push_back(sample);
+                }
+            }
+        }
+        match.tick(none);
+    }
+}
+
+void nnCollect (ThreadPool& pool, NnTrainConfig const& config, uint32_t seed, NeuralNet const* net,
+                std::vector<NnSample>& samples) {
+    std::vector<std::vector<NnSample>> matches(config.matches);
+
+    pool.parallelFor(0, config.matches, 4, [&] (uint64_t first, uint64_t last, unsigned int) {
+        Match match;
+        for (uint64_t i = first; i < last; ++i) {
+            collectMatch(config, seed, i, net, match, matches[i]);
+        }
+    });
+
+    for (uint64_t i = 0; i < matches.size(); ++i) {
+        samples.insert(samples.end(), matches[i].begin(), matches[i].end());
+    }
+}
+
+// Trainer
+
+void NnTrainer::init (NnTrainConfig const& config, uint32_t seed) {
+    const unsigned int widths[] = { NN_FEATURES, config.hidden[0], config.hidden[1], 1 };
+    rng.seed(seed);
+    batch = config.batch;
+    steps = 0;
+    layers.resize(3);
+    for (unsigned int l = 0; l < NN_MAX_LAYERS; ++l) {
+        inScales[l] = 0.0f;
+    }
+
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        Layer& layer = layers[l];
+        layer.inputs = widths[l];
+        layer.outputs = widths[l + 1];
+
+        // He initialization, for the ReLUs
+        float a = sqrtf(6.0f / layer.inputs);
+        layer.w.resize(layer.inputs * layer.outputs);
+        for (unsigned int i = 0; i < layer.w.size(); ++i) {
+            layer.w[i] = rng.uniform(-a, a);
+        }
+        layer.b.assign(layer.outputs, 0.0f);
+
+        layer.gw.assign(layer.w.size(), 0.0f);
+        layer.mw.assign(layer.w.size(), 0.0f);
+        layer.vw.assign(layer.w.size(), 0.0f);
+        layer.gb.assign(layer.outputs, 0.0f);
+        layer.mb.assign(layer.outputs, 0.0f);
+        layer.vb.assign(layer.outputs, 0.0f);
+    }
+}
+
+float NnTrainer::forward (const float* f, float* a) const {
+    // a holds the input, then the output of each layer
+    memcpy(a, f, NN_FEATURES * sizeof(float));
+    float* in = a;
+    float* out = a + NN_FEATURES;
+
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        Layer const& layer = layers[l];
+        bool last = l + 1 == layers.size();
+
+        // Rounded the way the int8 network will see them, in place: the
+        // gradients go through as if they were not
+        if (inScales[l] > 0.0f) {
+            for (unsigned int j = 0; j < layer.inputs; ++j) {
+                in[j] = nnQuantize(in[j], 1.0f / inScales[l]) * inScales[l];
+            }
+        }
+
+        for (unsigned int i = 0; i < layer.outputs; ++i) {
+            float y = layer.b[i];
+            for (unsigned int j = 0; j < layer.inputs; ++j) {
+                y += layer.w[i * layer.inputs + j] * in[j];
+            }
+            out[i] = last || y > 0.0f ? y : 0.0f;
+        }
+
+        in = out;
+        out += layer.outputs;
+    }
+
+    return in[0];
+}
+
+static void adam (std::vector<float>& p, std::vector<float>& g, std::vector<float>& m, std::vector<float>& v,
+                  float rate, float c1, float c2) {
+    const float b1 = 0.9f, b2 = 0.999f;
+    for (unsigned int i = 0; i < p.size(); ++i) {
+        m[i] = b1 * m[i] + (1 - b1) * g[i];
+        v[i] = b2 * v[i] + (1 - b2) * g[i] * g[i];
+        p[i] -= rate * (m[i] / c1) / (sqrtf(v[i] / c2) + 1e-8f);
+        g[i] = 0.0f;
+    }
+}
+
+float NnTrainer::epoch (std::vector<NnSample>& samples, float rate) {
+    // Fisher-Yates
+    for (unsigned int i = samples.size(); i > 1; --i) {
+        unsigned int j = rng.next() % i;
+        NnSample t = samples[i - 1];
+        samples[i - 1] = samples[j];
+        samples[j] = t;
+    }
+
+    float a[NN_FEATURES + 3 * NN_MAX_WIDTH], d[2][NN_MAX_WIDTH];
+    double total = 0.0;
+
+    for (unsigned int first = 0; first < samples.size(); first += batch) {
+        unsigned int last = first + batch < samples.size() ? first + batch : samples.size();
+
+        for (unsigned int s = first; s < last; ++s) {
+            float e = forward(samples[s].f, a) - samples[s].label;
+            total += e * e;
+
+            // Back from the output: d[0] is the gradient of the current
+            // layer's outputs, d[1] that of its inputs
+            d[0][0] = 2 * e / (last - first);
+            unsigned int offset = NN_FEATURES;
+            for (unsigned int l = 0; l + 1 < layers.size(); ++l) {
+                offset += layers[l].outputs;
+            }
+
+            for (int l = layers.size() - 1; l >= 0; --l) {
+                Layer& layer = layers[l];
+                const float* in = a + offset - layer.inputs;
+
+                memset(d[1], 0, layer.inputs * sizeof(float));
+                for (unsigned int i = 0; i < layer.outputs; ++i) {
+                    float g = d[0][i];
+                    if (g == 0.0f) {
+                        continue;
+                    }
+                    layer.gb[i] += g;
+                    for (unsigned int j = 0; j < layer.inputs; ++j) {
+                        layer.gw[i * layer.inputs + j] += g * in[j];
+                        d[1][j] += g * layer.w[i * layer.inputs + j];
+                    }
+                }
+
+                // Through the ReLU of the layer below
+                for (unsigned int j = 0; j < layer.inputs; ++j) {
+                    d[0][j] = in[j] > 0.0f ? d[1][j] : 0.0f;
+                }
+                offset -= layer.inputs;
+            }
+        }
+
+        ++steps;
+        float c1 = 1 - powf(0.9f, steps), c2 = 1 - powf(0.999f, steps);
+        for (unsigned int l = 0; l < layers.size(); ++l) {
+            Layer& layer = layers[l];
+            adam(layer.w, layer.gw, layer.mw, layer.vw, rate, c1, c2);
+            adam(layer.b, layer.gb, layer.mb, layer.vb, rate, c1, c2);
+        }
+    }
+
+    return samples.empty() ? 0.0f : float(total / samples.size());
+}
+
+float NnTrainer::loss (std::vector<NnSample> const& samples) const {
+    float a[NN_FEATURES + 3 * NN_MAX_WIDTH];
+    double total = 0.0;
+    for (unsigned int s = 0; s < samples.size(); ++s) {
+        float e = forward(samples[s].f, a) - samples[s].label;
+        total += e * e;
+    }
+    return samples.empty() ? 0.0f : float(total / samples.size());
+}
+
+void NnTrainer::calibrate (std::vector<NnSample> const& samples) {
+    for (unsigned int l = 0; l < NN_MAX_LAYERS; ++l) {
+        inScales[l] = 0.0f;
+    }
+
+    // Top of the inputs of each layer, the features are within [-1, 1]. A
+    // few outliers are clipped, rather than coarser steps for all the rest.
+    float a[NN_FEATURES + 3 * NN_MAX_WIDTH];
+    std::vector<float> values[NN_MAX_LAYERS];
+    for (unsigned int s = 0; s < samples.size(); s += 7) {
+        forward(samples[s].f, a);
+        const float* out = a + NN_FEATURES;
+        for (unsigned int l = 0; l + 1 < layers.size(); ++l) {
+            for (unsigned int i = 0; i < layers[l].outputs; ++i) {
+                if (out[i] > 0.0f) {
+                    values[l + 1].push_back(out[i]);
+                }
+            }
+            out += layers[l].outputs;
+        }
+    }
+
+    inScales[0] = 1.0f / 127.0f;
+    for (unsigned int l = 1; l < layers.size(); ++l) {
+        std::vector<float>& v = values[l];
+        float top = 1.0f;
+        if (! v.empty()) {
+            size_t k = v.size() - 1 - v.size() / 10000;
+            std::nth_element(v.begin(), v.begin() + k, v.end());
+            top = v[k];
+        }
+        inScales[l] = top / 127.0f;
+    }
+}
+
+void NnTrainer::quantize (NeuralNet& net) const {
+    net.layers.resize(layers.size());
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        Layer const& from = layers[l];
+        NeuralLayer& to = net.layers[l];
+        to.inputs = (from.inputs + NN_LANES - 1) / NN_LANES * NN_LANES;
+        to.outputs = from.outputs;
+        to.inScale = inScales[l] > 0.0f ? inScales[l] : 1.0f / 127.0f;
+        to.weights.assign(to.inputs * to.outputs, 0);
+        to.scales.resize(to.outputs);
+        to.biases = from.b;
+
+        for (unsigned int i = 0; i < to.outputs; ++i) {
+            float largest = 0.0f;
+            for (unsigned int j = 0; j < from.inputs; ++j) {
+                largest = fmaxf(largest, fabsf(from.w[i * from.inputs + j]));
+            }
+            to.scales[i] = largest > 0.0f ? largest / 127.0f : 1.0f;
+            for (unsigned int j = 0; j < from.inputs; ++j) {
+                to.weights[i * to.inputs + j] = nnQuantize(from.w[i * from.inputs + j], 1.0f / to.scales[i]);
+            }
+        }
+    }
+}
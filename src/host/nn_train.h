@@ -0,0 +1,75 @@
+#ifndef _NN_TRAIN_H_
+#define _NN_TRAIN_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "nn.h"
+#include "rng.h"
+#include "thread_pool.h"
+
+// Offline training of the AI_LEARNED network (see nn.h), from headless
+// self-play: the paddles are played by CPUs of every level, and each tick
+// is labelled with what the prediction of ai.h would do, at full speed,
+// slowing down close to its target. The error it aims with is an input, so
+// the network misses as often as the analytic CPU of its settings. The
+// network learns to imitate it in float, then is quantized. Later rounds
+// let the network play one side, so that it also learns from the states it
+// gets itself into.
+
+struct NnSample {
+    float f[NN_FEATURES];
+    float label; // Paddle speed, as a fraction of the top one
+};
+
+struct NnTrainConfig {
+    uint64_t matches = 150;       // Per round
+    uint32_t seed = 1;
+    unsigned int tickHz = 120;    // The game's
+    unsigned int maxSeconds = 120;
+    unsigned int stride = 4;      // One tick in stride is kept
+    unsigned int hidden[2] = { 32, 32 };
+    unsigned int epochs = 8;      // Per round
+    unsigned int tuning = 2;      // Of them, on int8 inputs at the end
+    unsigned int batch = 64;
+    float rate = 0.002f;          // Of Adam, halved every 4 epochs
+};
+
+// Samples of config.matches matches, in match order whatever the threads.
+// With a network, it plays the right paddle.
+void nnCollect (ThreadPool& pool, NnTrainConfig const& config, uint32_t seed, NeuralNet const* net,
+                std::vector<NnSample>& samples);
+
+// The float network being trained, with its Adam moments
+struct NnTrainer {
+    struct Layer {
+        unsigned int inputs, outputs;
+        std::vector<float> w, b;                   // w: outputs rows of inputs
+        std::vector<float> gw, gb, mw, mb, vw, vb; // Gradients, moments
+    };
+
+    void init (NnTrainConfig const& config, uint32_t seed);
+
+    // One pass over the shuffled samples. Returns the mean squared error.
+    float epoch (std::vector<NnSample>& samples, float rate);
+
+    float loss (std::vector<NnSample> const& samples) const;
+
+    // Input scales of the layers, from the activations of the samples.
+    // From then on, training rounds the inputs to them, as the int8
+    // network does.
+    void calibrate (std::vector<NnSample> const& samples);
+
+    // int8 weights, one scale per row, with the calibrated input scales
+    void quantize (NeuralNet& net) const;
+
+    float forward (const float* f, float* activations) const;
+
+    std::vector<Layer> layers;
+    float inScales[NN_MAX_LAYERS]; // 0 until calibrated
+    Rng rng;
+    unsigned int batch = 64;
+    unsigned long steps = 0;
+};
+
+#endif
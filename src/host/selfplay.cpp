@@ -0,0 +1,143 @@
+#include "selfplay.h"
+
+void SelfPlayTotals::add (SelfPlayTotals const& o) {
+    matches += o.matches;
+    draws += o.draws;
+    ticks += o.ticks;
+    for (int side = 0; side < 2; ++side) {
+        wins[side] += o.wins[side];
+        points[side] += o.points[side];
+        hits[side] += o.hits[side];
+        sideWins[side] += o.sideWins[side];
+    }
+    rallies += o.rallies;
+    rallyTicks += o.rallyTicks;
+    maxRallyTicks = o.maxRallyTicks > maxRallyTicks ? o.maxRallyTicks : maxRallyTicks;
+    for (int s = 0; s < SCORE_WIN; ++s) {
+        loserPoints[s] += o.loserPoints[s];
+    }
+}
+
+SelfPlayStats::SelfPlayStats () :
+    matches(0), draws(0), ticks(0), rallies(0), rallyTicks(0), maxRallyTicks(0) {
+    for (int side = 0; side < 2; ++side) {
+        wins[side] = 0;
+        points[side] = 0;
+        hits[side] = 0;
+        sideWins[side] = 0;
+    }
+    for (int s = 0; s < SCORE_WIN; ++s) {
+        loserPoints[s] = 0;
+    }
+}
+
+void SelfPlayStats::add (SelfPlayTotals const& t) {
+    // Counters only need atomicity, not ordering
+    const std::memory_order relaxed = std::memory_order_relaxed;
+
+    matches.fetch_add(t.matches, relaxed);
+    draws.fetch_add(t.draws, relaxed);
+    ticks.fetch_add(t.ticks, relaxed);
+    for (int side = 0; side < 2; ++side) {
+        wins[side].fetch_add(t.wins[side], relaxed);
+        points[side].fetch_add(t.points[side], relaxed);
+        hits[side].fetch_add(t.hits[side], relaxed);
+        sideWins[side].fetch_add(t.sideWins[side], relaxed);
+    }
+    rallies.fetch_add(t.rallies, relaxed);
+    rallyTicks.fetch_add(t.rallyTicks, relaxed);
+    for (int s = 0; s < SCORE_WIN; ++s) {
+        if (t.loserPoints[s]) {
+            loserPoints[s].fetch_add(t.loserPoints[s], relaxed);
+        }
+    }
+
+    uint64_t longest = maxRallyTicks.load(relaxed);
+    while (t.maxRallyTicks > longest && ! maxRallyTicks.compare_exchange_weak(longest, t.maxRallyTicks, relaxed)) {
+    }
+}
+
+SelfPlayTotals SelfPlayStats::totals () const {
+    SelfPlayTotals t;
+    t.matches = matches;
+    t.draws = draws;
+    t.ticks = ticks;
+    for (int side = 0; side < 2; ++side) {
+        t.wins[side] = wins[side];
+        t.points[side] = points[side];
+        t.hits[side] = hits[side];
+        t.sideWins[side] = sideWins[side];
+    }
+    t.rallies = rallies;
+    t.rallyTicks = rallyTicks;
+    t.maxRallyTicks = maxRallyTicks;
+    for (int s = 0; s < SCORE_WIN; ++s) {
+        t.loserPoints[s] = loserPoints[s];
+    }
+    return t;
+}
+
+uint32_t selfPlaySeed (uint32_t seed, uint64_t i) {
+    // splitmix64
+    uint64_t z = (uint64_t(seed) << 32 | seed) + (i + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return uint32_t(z ^ (z >> 31));
+}
+
+void selfPlayMatch (SelfPlayConfig const& config, uint64_t i, Match& match, SelfPlayTotals& t) {
+    match.rules = config.rules;
+    match.net = config.net;
+    match.setTickRate(config.tickHz);
+
+    // Level index of the left paddle: the right one is the other
+    const unsigned int left = i & 1, right = 1 - left;
+    match.start(GameMode::Demo, selfPlaySeed(config.seed, i), config.levels[right], config.levels[left]);
+
+    const unsigned int maxTicks = config.maxSeconds * config.tickHz;
+    const TickInput none;
+    uint64_t rally = 0;
+
+    while (! match.over() && match.ticks < maxTicks) {
+        rally += ! match.serving();
+        unsigned int events = match.tick(none);
+
+        t.hits[left] += (events & SIM_HIT_PLAYER) != 0;
+        t.hits[right] += (events & SIM_HIT_CPU) != 0;
+
+        if (events & SIM_SCORE) {
+            ++t.rallies;
+            t.rallyTicks += rally;
+            t.maxRallyTicks = rally > t.maxRallyTicks ? rally : t.maxRallyTicks;
+            rally = 0;
+        }
+    }
+
+    int leftScore = match.sim.player.score, rightScore = match.sim.cpu.score;
+    ++t.matches;
+    t.ticks += match.ticks;
+    t.points[left] += leftScore;
+    t.points[right] += rightScore;
+
+    if (! match.over()) {
+        ++t.draws;
+    } else {
+        ++t.wins[leftScore > rightScore ? left : right];
+        ++t.sideWins[leftScore > rightScore ? 0 : 1];
+        int loser = leftScore < rightScore ? leftScore : rightScore;
+        if (loser < SCORE_WIN) {
+            ++t.loserPoints[loser];
+        }
+    }
+}
+
+void selfPlay (ThreadPool& pool, SelfPlayConfig const& config, SelfPlayStats& stats) {
+    pool.parallelFor(0, config.matches, config.grain, [&] (uint64_t first, uint64_t last, unsigned int) {
+        Match match;
+        SelfPlayTotals t;
+        for (uint64_t i = first; i < last; ++i) {
+            selfPlayMatch(config, i, match, t);
+        }
+        stats.add(t);
+    });
+}
@@ -0,0 +1,64 @@
+#ifndef _SELFPLAY_H_
+#define _SELFPLAY_H_
+
+#include <stdint.h>
+#include <atomic>
+
+#include "match.h"
+#include "thread_pool.h"
+
+// Headless CPU against CPU matches (GameMode::Demo), for balancing the
+// rules and the AI levels over many games. Every match is seeded from the
+// base seed and its index alone, and only touches its own Match: the totals
+// do not depend on the number of threads or on which one played what. The
+// two levels swap sides from one match to the next, so that neither gets
+// whatever edge the left or the right side has.
+
+struct SelfPlayConfig {
+    uint64_t matches = 10000;
+    uint32_t seed = 1;
+    unsigned int levels[2] = { AI_NORMAL, AI_NORMAL }; // Left, then right in odd matches
+    MatchRules rules;
+    NeuralNet const* net = nullptr; // Of AI_LEARNED
+    unsigned int tickHz = 120;
+    unsigned int maxSeconds = 600; // A match still going then is a draw
+    uint64_t grain = 16; // Matches per chunk of work
+};
+
+// Sums over matches, 0 is levels[0], 1 levels[1], on either side. Draws
+// are the matches still going at maxSeconds, out of the wins.
+struct SelfPlayTotals {
+    uint64_t matches = 0, draws = 0, ticks = 0;
+    uint64_t wins[2] = {}, points[2] = {}, hits[2] = {};
+    uint64_t sideWins[2] = {}; // Left, right
+    uint64_t rallies = 0, rallyTicks = 0, maxRallyTicks = 0;
+    uint64_t loserPoints[SCORE_WIN] = {}; // Matches won SCORE_WIN to n
+
+    void add (SelfPlayTotals const& other);
+};
+
+// The same, shared by the workers: each one sums a chunk of matches on its
+// own, then adds it in with atomic operations, no lock
+struct SelfPlayStats {
+    SelfPlayStats ();
+
+    void add (SelfPlayTotals const& t);
+
+    SelfPlayTotals totals () const;
+
+    std::atomic<uint64_t> matches, draws, ticks;
+    std::atomic<uint64_t> wins[2], points[2], hits[2], sideWins[2];
+    std::atomic<uint64_t> rallies, rallyTicks, maxRallyTicks;
+    std::atomic<uint64_t> loserPoints[SCORE_WIN];
+};
+
+// Seed of match i
+uint32_t selfPlaySeed (uint32_t seed, uint64_t i);
+
+// Plays match i from the start, in the given Match, into t
+void selfPlayMatch (SelfPlayConfig const& config, uint64_t i, Match& match, SelfPlayTotals& t);
+
+// Plays config.matches matches over the pool
+void selfPlay (ThreadPool& pool, SelfPlayConfig const& config, SelfPlayStats& stats);
+
+#endif
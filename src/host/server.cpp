@@ -0,0 +1,567 @@
+#include <chrono>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <type_traits>
+#include <unistd.h>
+
+#include "server.h"
+
+static_assert(std::is_trivially_copyable<ServerMatch>::value, "ServerMatch is stored and copied as plain data");
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint8_t serverMagic[2] = { 'V', 'S' };
+
+static void put16 (uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+}
+
+static void put32 (uint8_t* p, uint32_t v) {
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static void put64 (uint8_t* p, uint64_t v) {
+    put32(p, uint32_t(v));
+    put32(p + 4, uint32_t(v >> 32));
+}
+
+static uint32_t get16 (const uint8_t* p) {
+    return p[0] | uint32_t(p[1]) << 8;
+}
+
+static uint32_t get32 (const uint8_t* p) {
+    return get16(p) | get16(p + 2) << 16;
+}
+
+static uint64_t get64 (const uint8_t* p) {
+    return get32(p) | uint64_t(get32(p + 4)) << 32;
+}
+
+// In steps of 1 / scale, within int16
+static void putFixed (uint8_t* p, float v, float scale) {
+    float q = v * scale;
+    q = q > 32767.0f ? 32767.0f : (q < -32767.0f ? -32767.0f : q);
+    put16(p, uint16_t(int16_t(lroundf(q))));
+}
+
+static float getFixed (const uint8_t* p, float scale) {
+    return int16_t(get16(p)) / scale;
+}
+
+// "VS", type, side, nonce
+static void header (uint8_t* p, unsigned int type, unsigned int side, uint64_t nonce) {
+    p[0] = serverMagic[0];
+    p[1] = serverMagic[1];
+    p[2] = uint8_t(type);
+    p[3] = uint8_t(side);
+    put64(p + 4, nonce);
+}
+
+#define JOIN_SIZE 12
+#define WELCOME_SIZE 18
+#define INPUT_SIZE 22
+#define LEAVE_SIZE 16
+#define STATE_SIZE 40
+
+size_t serverJoin (uint64_t nonce, uint8_t* packet) {
+    header(packet, SERVER_JOIN, 0, nonce);
+    return JOIN_SIZE;
+}
+
+size_t serverInput (uint64_t nonce, uint32_t match, unsigned int side, uint32_t sequence, NetInput const& in,
+                    uint8_t* packet) {
+    header(packet, SERVER_INPUT, side, nonce);
+    put32(packet + 12, match);
+    put32(packet + 16, sequence);
+    packet[20] = in.buttons;
+    packet[21] = uint8_t(in.stick);
+    return INPUT_SIZE;
+}
+
+size_t serverLeave (uint64_t nonce, uint32_t match, unsigned int side, uint8_t* packet) {
+    header(packet, SERVER_LEAVE, side, nonce);
+    put32(packet + 12, match);
+    return LEAVE_SIZE;
+}
+
+bool serverRead (const uint8_t* data, size_t size, ServerUpdate& update) {
+    if (size < WELCOME_SIZE || data[0] != serverMagic[0] || data[1] != serverMagic[1]) {
+        return false;
+    }
+
+    update.type = data[2];
+    update.side = data[3] & 1;
+    update.nonce = get64(data + 4);
+    update.match = get32(data + 12);
+
+    if (update.type == SERVER_WELCOME && size == WELCOME_SIZE) {
+        update.hz = get16(data + 16);
+        return true;
+    }
+    if (update.type != SERVER_STATE || size != STATE_SIZE) {
+        return false;
+    }
+
+    update.flags = data[16];
+    update.tick = get32(data + 18);
+    update.sequence = get32(data + 22);
+    update.ball = glm::vec2(getFixed(data + 26, 8.0f), getFixed(data + 28, 8.0f));
+    update.speed = glm::vec2(getFixed(data + 30, 64.0f), getFixed(data + 32, 64.0f));
+    update.paddles[0] = getFixed(data + 34, 8.0f);
+    update.paddles[1] = getFixed(data + 36, 8.0f);
+    update.scores[0] = data[38];
+    update.scores[1] = data[39];
+    return true;
+}
+
+void ServerMatch::start (uint32_t seed, unsigned int hz, MatchRules const& rules) {
+    // As Match::start in Two Players mode
+    this->rules = rules;
+    sim.arena = nullptr;
+    sim.setTickRate(hz);
+    matchApplyRules(sim, rules);
+    sim.rng.seed(seed);
+    sim.restart();
+
+    ticks = 0;
+    serveTicks = matchServeTicks(hz, false);
+    overTicks = 0;
+}
+
+unsigned int ServerMatch::step (unsigned int hz) {
+    ++ticks;
+    if (state == Over) {
+        ++overTicks;
+        return 0;
+    }
+
+    if (matchServing(serveTicks)) {
+        return 0;
+    }
+
+    NetInput const& left = players[0].input;
+    NetInput const& right = players[1].input;
+    matchMovePaddle(sim.player, sim, rules, left.stick, left.buttons & NET_UP, left.buttons & NET_DOWN);
+    matchMovePaddle(sim.cpu, sim, rules, right.stick, right.buttons & NET_UP, right.buttons & NET_DOWN);
+
+    unsigned int events = sim.step();
+    if (events & SIM_SCORE) {
+        serveTicks = matchServeTicks(hz, true);
+    }
+    if (sim.finished()) {
+        state = Over;
+    }
+    return events;
+}
+
+void ServerMatch::forfeit (unsigned int side) {
+    (side ? sim.player : sim.cpu).score = SCORE_WIN;
+    state = Over;
+}
+
+void LatencyHistogram::add (uint64_t micros) {
+    ++buckets[micros < SERVER_LATENCY_US ? micros : SERVER_LATENCY_US];
+    ++count;
+    max = micros > max ? micros : max;
+}
+
+uint64_t LatencyHistogram::percentile (double p) const {
+    uint64_t rank = uint64_t(p / 100.0 * count + 0.5), seen = 0;
+    rank = rank ? rank : 1;
+    for (unsigned int us = 0; us < SERVER_LATENCY_US; ++us) {
+        seen += buckets[us];
+        if (seen >= rank) {
+            return us;
+        }
+    }
+    return max;
+}
+
+void LatencyHistogram::clear () {
+    memset(buckets, 0, sizeof(buckets));
+    count = max = 0;
+}
+
+PongServer::~PongServer () {
+    close();
+}
+
+void PongServer::close () {
+    int* fds[3] = { &fd, &epoll, &timer };
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (*fds[i] >= 0) {
+            ::close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+}
+
+bool PongServer::open (unsigned short port, unsigned int maxMatches, unsigned int hz) {
+    close();
+    this->hz = hz;
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    epoll = epoll_create1(0);
+    timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (fd < 0 || epoll < 0 || timer < 0) {
+        close();
+        return false;
+    }
+
+    // Shards share the port; a full buffer loses packets like the network
+    int one = 1, buffer = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buffer, sizeof(buffer));
+
+    sockaddr_in local = sockaddr_in();
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(fd, (sockaddr*) &local, sizeof(local)) < 0) {
+        close();
+        return false;
+    }
+
+    itimerspec period = itimerspec();
+    long nanos = 1000000000L / (hz ? hz : 1);
+    period.it_interval.tv_sec = nanos / 1000000000L;
+    period.it_interval.tv_nsec = nanos % 1000000000L;
+    period.it_value = period.it_interval;
+    timerfd_settime(timer, 0, &period, nullptr);
+
+    epoll_event event = epoll_event();
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    event.data.fd = timer;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event);
+
+    // Never reallocated: the send headers point into it
+    matches.assign(maxMatches, ServerMatch());
+    for (unsigned int i = 0; i < maxMatches; ++i) {
+        matches[i].state = ServerMatch::Free;
+    }
+    freed.clear();
+    used = 0;
+    waiting = -1;
+    live = 0;
+    nonces.clear();
+
+    out.assign(SERVER_BATCH * SERVER_PACKET_MAX, 0);
+    headers.assign(SERVER_BATCH, mmsghdr());
+    vectors.assign(SERVER_BATCH, iovec());
+    pending = 0;
+    return true;
+}
+
+unsigned short PongServer::port () const {
+    sockaddr_in local = sockaddr_in();
+    socklen_t size = sizeof(local);
+    if (fd < 0 || getsockname(fd, (sockaddr*) &local, &size) < 0) {
+        return 0;
+    }
+    return ntohs(local.sin_port);
+}
+
+void PongServer::poll (int timeoutMs) {
+    epoll_event events[2];
+    int n = epoll_wait(epoll, events, 2, timeoutMs);
+
+    for (int i = 0; i < n; ++i) {
+        if (events[i].data.fd == fd) {
+            receive();
+        } else {
+            uint64_t due = 0;
+            if (read(timer, &due, sizeof(due)) != sizeof(due) || ! due) {
+                continue;
+            }
+
+            // Catch up a little, then let go: the players see a jump
+            stats.late += due - 1;
+            uint64_t run = due < 4 ? due : 4;
+            stats.skipped += due - run;
+            while (run--) {
+                tick();
+            }
+        }
+    }
+}
+
+void PongServer::receive () {
+    uint8_t packets[SERVER_BATCH][SERVER_PACKET_MAX];
+    sockaddr_in from[SERVER_BATCH];
+    iovec iov[SERVER_BATCH];
+    mmsghdr msgs[SERVER_BATCH];
+
+    for (;;) {
+        for (unsigned int i = 0; i < SERVER_BATCH; ++i) {
+            iov[i].iov_base = packets[i];
+            iov[i].iov_len = SERVER_PACKET_MAX;
+            msgs[i].msg_hdr = msghdr();
+            msgs[i].msg_hdr.msg_name = &from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int n = recvmmsg(fd, msgs, SERVER_BATCH, MSG_DONTWAIT, nullptr);
+        if (n <= 0) {
+            break;
+        }
+        stats.packetsIn += n;
+        for (int i = 0; i < n; ++i) {
+            handle(packets[i], msgs[i].msg_len, from[i]);
+        }
+        if (n < SERVER_BATCH) {
+            break;
+        }
+    }
+
+    // Welcomes
+    flush();
+}
+
+void PongServer::handle (const uint8_t* data, size_t size, sockaddr_in const& from) {
+    if (size < JOIN_SIZE || data[0] != serverMagic[0] || data[1] != serverMagic[1]) {
+        ++stats.rejected;
+        return;
+    }
+
+    unsigned int type = data[2], side = data[3] & 1;
+    uint64_t nonce = get64(data + 4);
+    if (type == SERVER_JOIN && size == JOIN_SIZE) {
+        join(nonce, from);
+        return;
+    }
+
+    // The player of this match and side, nobody else
+    uint32_t match = size >= LEAVE_SIZE ? get32(data + 12) : used;
+    ServerMatch* m = match < used ? &matches[match] : nullptr;
+    if (! m || m->state == ServerMatch::Free || (m->state == ServerMatch::Waiting && side) ||
+        m->players[side].nonce != nonce) {
+        ++stats.rejected;
+        return;
+    }
+
+    ServerPlayer& player = m->players[side];
+    if (type == SERVER_INPUT && size == INPUT_SIZE) {
+        uint32_t sequence = get32(data + 16);
+        // Reordered packets: the newest input stays
+        if (sequence >= player.sequence) {
+            player.sequence = sequence;
+            player.input.buttons = data[20] & (NET_UP | NET_DOWN);
+            player.input.stick = int8_t(data[21]);
+        }
+    } else if (type == SERVER_LEAVE && size == LEAVE_SIZE) {
+        ++stats.left;
+        if (m->state == ServerMatch::Playing) {
+            // The other one wins, and is told
+            m->forfeit(side);
+            ++stats.finished;
+        } else if (m->state == ServerMatch::Waiting) {
+            end(match);
+            return;
+        }
+    } else {
+        ++stats.rejected;
+        return;
+    }
+
+    // From wherever they are now
+    player.addr = from;
+    player.heard = stats.ticks;
+}
+
+void PongServer::join (uint64_t nonce, sockaddr_in const& from) {
+    // WELCOME lost: again
+    std::unordered_map<uint64_t, uint32_t>::const_iterator known = nonces.find(nonce);
+    if (known != nonces.end()) {
+        welcome(known->second / 2, known->second % 2);
+        return;
+    }
+
+    uint32_t match;
+    unsigned int side;
+    if (waiting >= 0) {
+        match = uint32_t(waiting);
+        side = 1;
+        waiting = -1;
+    } else if (! freed.empty() || used < matches.size()) {
+        if (freed.empty()) {
+            match = used++;
+        } else {
+            match = freed.back();
+            freed.pop_back();
+        }
+        side = 0;
+        waiting = match;
+    } else {
+        // Full
+        ++stats.rejected;
+        return;
+    }
+
+    ServerMatch& m = matches[match];
+    ServerPlayer& player = m.players[side];
+    player = ServerPlayer();
+    player.nonce = nonce;
+    player.addr = from;
+    player.heard = stats.ticks;
+    nonces[nonce] = match * 2 + side;
+    ++stats.joins;
+
+    if (side) {
+        m.start(seeds++ * 2654435761u, hz, rules);
+        m.state = ServerMatch::Playing;
+        ++stats.started;
+        ++live;
+    } else {
+        m.state = ServerMatch::Waiting;
+    }
+    welcome(match, side);
+}
+
+void PongServer::end (uint32_t match) {
+    ServerMatch& m = matches[match];
+    if (m.state == ServerMatch::Free) {
+        return;
+    }
+
+    nonces.erase(m.players[0].nonce);
+    if (m.state == ServerMatch::Waiting) {
+        waiting = -1;
+    } else {
+        nonces.erase(m.players[1].nonce);
+        --live;
+    }
+    m.state = ServerMatch::Free;
+    freed.push_back(match);
+}
+
+uint8_t* PongServer::queue (sockaddr_in const& to, size_t size) {
+    if (pending == SERVER_BATCH) {
+        flush();
+    }
+
+    uint8_t* packet = &out[pending * SERVER_PACKET_MAX];
+    vectors[pending].iov_base = packet;
+    vectors[pending].iov_len = size;
+
+    msghdr& h = headers[pending].msg_hdr;
+    h = msghdr();
+    h.msg_name = (void*) &to;
+    h.msg_namelen = sizeof(to);
+    h.msg_iov = &vectors[pending];
+    h.msg_iovlen = 1;
+    ++pending;
+    return packet;
+}
+
+void PongServer::flush () {
+    unsigned int sent = 0;
+    while (sent < pending) {
+        int n = sendmmsg(fd, &headers[sent], pending - sent, MSG_DONTWAIT);
+        if (n <= 0) {
+            // Buffer full, or no socket: lost like on the way
+            stats.dropped += pending - sent;
+            break;
+        }
+        sent += n;
+        stats.packetsOut += n;
+    }
+    pending = 0;
+}
+
+void PongServer::welcome (uint32_t match, unsigned int side) {
+    ServerPlayer const& player = matches[match].players[side];
+    uint8_t* p = queue(player.addr, WELCOME_SIZE);
+    header(p, SERVER_WELCOME, side, player.nonce);
+    put32(p + 12, match);
+    put16(p + 16, hz);
+}
+
+void PongServer::state (uint32_t match, unsigned int side) {
+    ServerMatch const& m = matches[match];
+    ServerPlayer const& player = m.players[side];
+    uint8_t* p = queue(player.addr, STATE_SIZE);
+
+    header(p, SERVER_STATE, side, player.nonce);
+    put32(p + 12, match);
+    p[16] = (m.state == ServerMatch::Waiting ? SERVER_WAITING : 0) | (m.serveTicks ? SERVER_SERVING : 0) |
+            (m.state == ServerMatch::Over ? SERVER_OVER : 0);
+    p[17] = 0;
+    put32(p + 18, m.ticks);
+    put32(p + 22, player.sequence);
+    putFixed(p + 26, m.sim.ball.x(), 8.0f);
+    putFixed(p + 28, m.sim.ball.y(), 8.0f);
+    putFixed(p + 30, m.sim.ball.v.x, 64.0f);
+    putFixed(p + 32, m.sim.ball.v.y, 64.0f);
+    putFixed(p + 34, m.sim.player.y(), 8.0f);
+    putFixed(p + 36, m.sim.cpu.y(), 8.0f);
+    p[38] = uint8_t(m.sim.player.score);
+    p[39] = uint8_t(m.sim.cpu.score);
+}
+
+void PongServer::tick () {
+    Clock::time_point start = Clock::now();
+    ++stats.ticks;
+    const uint32_t timeout = SERVER_TIMEOUT * hz;
+
+    // One pass over the flat array: each match stepped, its states queued,
+    // sent SERVER_BATCH at a time
+    for (uint32_t i = 0; i < used; ++i) {
+        ServerMatch& m = matches[i];
+        switch (m.state) {
+            case ServerMatch::Free:
+                break;
+
+            case ServerMatch::Waiting:
+                if (stats.ticks - m.players[0].heard > timeout) {
+                    ++stats.timeouts;
+                    end(i);
+                } else if (stats.ticks % hz == 0) {
+                    // Still there, once a second
+                    state(i, 0);
+                }
+                break;
+
+            case ServerMatch::Playing:
+            case ServerMatch::Over:
+                if (stats.ticks - m.players[0].heard > timeout && stats.ticks - m.players[1].heard > timeout) {
+                    ++stats.timeouts;
+                    end(i);
+                    break;
+                }
+                if (m.overTicks > SERVER_LINGER * hz) {
+                    end(i);
+                    break;
+                }
+
+                // A player gone loses: the other one wins, and is told.
+                // Finished either way, counted below.
+                bool playing = m.state == ServerMatch::Playing;
+                if (playing) {
+                    for (unsigned int side = 0; side < 2; ++side) {
+                        if (stats.ticks - m.players[side].heard > timeout) {
+                            ++stats.timeouts;
+                            m.forfeit(side);
+                            break;
+                        }
+                    }
+                }
+
+                m.step(hz);
+                stats.finished += playing && m.state == ServerMatch::Over;
+                state(i, 0);
+                state(i, 1);
+                break;
+        }
+    }
+    flush();
+
+    stats.tickMicros.add(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+}
@@ -0,0 +1,196 @@
+#ifndef _SERVER_H_
+#define _SERVER_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unordered_map>
+#include <vector>
+
+#include "netplay.h"
+
+// Dedicated server for online Two Players: many independent matches in one
+// Linux process, each played by the server from both players' inputs and
+// sent back to them as it goes. One PongServer is single-threaded: an epoll
+// loop over its UDP socket and a timerfd at the tick rate. Every tick steps
+// all the matches in one pass over a flat array, then sends every state with
+// as few sendmmsg calls as the batch allows. More cores run more shards on
+// the same port (SO_REUSEPORT): the kernel sends each player's packets to
+// one shard, by address, and each shard pairs its own players.
+
+#define SERVER_TICK_HZ (60)
+#define SERVER_TIMEOUT (5)     // Seconds without a packet before a player is dropped
+#define SERVER_LINGER (3)      // Seconds a finished match is still sent
+#define SERVER_BATCH (256)     // Datagrams per recvmmsg or sendmmsg call
+#define SERVER_PACKET_MAX (40)
+#define SERVER_LATENCY_US (100000) // Tick times kept to the microsecond, slower ones lumped
+
+// Packets, little endian, all starting with "VS" and the type:
+//
+//   JOIN    client: "VS", type, 0, nonce (uint64)
+//   WELCOME server: "VS", type, side, nonce, match (uint32), tick rate (uint16)
+//   INPUT   client: "VS", type, side, nonce, match, sequence (uint32),
+//                   buttons (uint8), stick (int8)
+//   LEAVE   client: "VS", type, side, nonce, match
+//   STATE   server: "VS", type, side, nonce, match, flags (uint8), 0,
+//                   tick (uint32), last input sequence (uint32), ball position
+//                   (int16, 1/8 px), ball speed (int16, 1/64 px a reference
+//                   frame), left and right paddle heights (int16, 1/8 px),
+//                   left and right scores (uint8)
+//
+// The nonce, random, is the player's for one match: it comes back with
+// every packet, so a player is found from the match and side without a
+// lookup, and a stray packet does not move anyone else's paddle. JOIN is
+// sent until WELCOME comes back; the match starts with two players. A
+// player who leaves or goes silent for SERVER_TIMEOUT loses: the other one
+// is sent SCORE_WIN points and SERVER_OVER.
+enum {
+    SERVER_JOIN = 1,
+    SERVER_WELCOME,
+    SERVER_INPUT,
+    SERVER_LEAVE,
+    SERVER_STATE,
+};
+
+// STATE flags
+enum {
+    SERVER_WAITING = 1 << 0, // For an opponent
+    SERVER_SERVING = 1 << 1,
+    SERVER_OVER    = 1 << 2,
+};
+
+// A packet from the server, as a client reads it
+struct ServerUpdate {
+    uint8_t type = 0, side = 0, flags = 0;
+    uint64_t nonce = 0;
+    uint32_t match = 0;
+    uint32_t hz = 0;                  // WELCOME
+    uint32_t tick = 0, sequence = 0;  // STATE
+    glm::vec2 ball, speed;
+    float paddles[2] = {};
+    uint8_t scores[2] = {};
+};
+
+// The client's packets, into packet (SERVER_PACKET_MAX bytes): their size
+size_t serverJoin (uint64_t nonce, uint8_t* packet);
+size_t serverInput (uint64_t nonce, uint32_t match, unsigned int side, uint32_t sequence, NetInput const& in,
+                    uint8_t* packet);
+size_t serverLeave (uint64_t nonce, uint32_t match, unsigned int side, uint8_t* packet);
+
+// WELCOME or STATE, false for anything else
+bool serverRead (const uint8_t* data, size_t size, ServerUpdate& update);
+
+struct ServerPlayer {
+    uint64_t nonce;
+    sockaddr_in addr;
+    NetInput input;    // Held until the next one
+    uint32_t sequence; // Of that input
+    uint32_t heard;    // Tick of the last packet
+};
+
+// One match: the simulation's ball and paddles and a few counters, plain
+// data, copied and stored flat
+struct ServerMatch {
+    enum State : uint8_t { Free, Waiting, Playing, Over };
+
+    void start (uint32_t seed, unsigned int hz, MatchRules const& rules = MatchRules());
+
+    // One tick from the players' held inputs, the rules of Match in Two
+    // Players mode (see matchMovePaddle). Returns the SIM_* events.
+    unsigned int step (unsigned int hz);
+
+    // The player on side is gone: the other one wins
+    void forfeit (unsigned int side);
+
+    Simulation sim;
+    MatchRules rules;
+    ServerPlayer players[2];
+    uint32_t ticks;
+    uint32_t serveTicks;
+    uint32_t overTicks; // Since the end
+    State state;
+};
+
+// Tick processing times, to the microsecond up to SERVER_LATENCY_US
+struct LatencyHistogram {
+    void add (uint64_t micros);
+
+    // p from 0 to 100
+    uint64_t percentile (double p) const;
+
+    void clear ();
+
+    uint64_t count = 0, max = 0;
+    uint32_t buckets[SERVER_LATENCY_US + 1] = {};
+};
+
+struct ServerStats {
+    uint64_t ticks = 0;
+    uint64_t late = 0;    // Ticks run behind the timer, to catch up
+    uint64_t skipped = 0; // Ticks dropped when too far behind
+    uint64_t joins = 0, started = 0, finished = 0, timeouts = 0, left = 0;
+    uint64_t packetsIn = 0, packetsOut = 0, dropped = 0, rejected = 0;
+    LatencyHistogram tickMicros; // Step and send of each tick
+};
+
+struct PongServer {
+    PongServer () {
+    }
+
+    ~PongServer ();
+
+    PongServer (PongServer const&) = delete;
+    PongServer& operator= (PongServer const&) = delete;
+
+    // Binds the port (0: any free one) with SO_REUSEPORT, for maxMatches
+    // matches at most, ticking at hz
+    bool open (unsigned short port, unsigned int maxMatches, unsigned int hz = SERVER_TICK_HZ);
+
+    void close ();
+
+    // The port bound
+    unsigned short port () const;
+
+    // Waits up to timeoutMs for packets or the timer, and handles them:
+    // every tick due is run
+    void poll (int timeoutMs);
+
+    // All the matches one tick on, then their states sent
+    void tick ();
+
+    // Matches with two players, finished ones still sent
+    unsigned int playing () const {
+        return live;
+    }
+
+    ServerStats stats;
+    unsigned int hz = SERVER_TICK_HZ;
+    MatchRules rules; // Of the matches started from now
+
+private:
+    void receive ();
+    void handle (const uint8_t* data, size_t size, sockaddr_in const& from);
+    void join (uint64_t nonce, sockaddr_in const& from);
+    void welcome (uint32_t match, unsigned int side);
+    void end (uint32_t match);
+    void state (uint32_t match, unsigned int side);
+    uint8_t* queue (sockaddr_in const& to, size_t size);
+    void flush ();
+
+    int fd = -1, epoll = -1, timer = -1;
+    std::vector<ServerMatch> matches;
+    std::vector<uint32_t> freed;  // Free matches, the last one taken first
+    uint32_t used = 0;            // Matches ever taken: the others are free
+    int64_t waiting = -1;         // The match with one player, if any
+    unsigned int live = 0;        // Playing or Over
+    std::unordered_map<uint64_t, uint32_t> nonces; // To match * 2 + side
+    uint32_t seeds = 1;
+
+    // Datagrams to send, SERVER_BATCH at a time
+    std::vector<uint8_t> out;
+    std::vector<mmsghdr> headers;
+    std::vector<iovec> vectors;
+    unsigned int pending = 0;
+};
+
+#endif
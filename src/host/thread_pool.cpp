@@ -0,0 +1,107 @@
+#include "thread_pool.h"
+
+static unsigned int threadCount (unsigned int threads) {
+    if (! threads) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return threads ? threads : 1;
+}
+
+ThreadPool::ThreadPool (unsigned int threads) : chunks(0), steals(0), queues(threadCount(threads)), pending(0) {
+    for (unsigned int i = 0; i < queues.size(); ++i) {
+        workers.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool () {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+}
+
+void ThreadPool::parallelFor (uint64_t begin, uint64_t end, uint64_t grain,
+                              std::function<void (uint64_t, uint64_t, unsigned int)> const& fn) {
+    if (begin >= end) {
+        return;
+    }
+    if (! grain) {
+        grain = 1;
+    }
+
+    job = &fn;
+    pending = (end - begin + grain - 1) / grain;
+
+    unsigned int n = 0;
+    for (uint64_t first = begin; first < end; first += grain, ++n) {
+        Chunk chunk = { first, end - first > grain ? first + grain : end };
+        Queue& q = queues[n % queues.size()];
+
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.chunks.push_back(chunk);
+    }
+
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    ++generation;
+    wake.notify_all();
+    done.wait(lock, [this] { return pending == 0; });
+    job = nullptr;
+}
+
+bool ThreadPool::take (unsigned int worker, Chunk& chunk) {
+    // Its own chunks first, newest first
+    {
+        Queue& q = queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (! q.chunks.empty()) {
+            chunk = q.chunks.back();
+            q.chunks.pop_back();
+            return true;
+        }
+    }
+
+    // Then the oldest of someone else's
+    for (unsigned int i = 1; i < queues.size(); ++i) {
+        Queue& q = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (! q.chunks.empty()) {
+            chunk = q.chunks.front();
+            q.chunks.pop_front();
+            ++steals;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::work (unsigned int worker) {
+    uint64_t seen = 0;
+
+    while (true) {
+        Chunk chunk;
+        if (take(worker, chunk)) {
+            (*job)(chunk.first, chunk.last, worker);
+            ++chunks;
+
+            if (--pending == 0) {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                done.notify_all();
+            }
+            continue;
+        }
+
+        // Nothing left: sleep until the next loop
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wake.wait(lock, [&] { return stop || generation != seen; });
+        if (stop) {
+            return;
+        }
+        seen = generation;
+    }
+}
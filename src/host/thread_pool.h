@@ -0,0 +1,64 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool for the host tools. A parallel loop is cut into
+// chunks dealt round robin to the workers' own queues: a worker takes its
+// chunks from the back of its queue, and once it runs dry steals from the
+// front of the others'. Chunks of uneven cost (matches of any length) even
+// out without a shared queue everyone waits on.
+struct ThreadPool {
+    // One worker per hardware thread by default
+    explicit ThreadPool (unsigned int threads = 0);
+    ~ThreadPool ();
+
+    ThreadPool (ThreadPool const&) = delete;
+    ThreadPool& operator= (ThreadPool const&) = delete;
+
+    unsigned int size () const {
+        return workers.size();
+    }
+
+    // Calls fn(first, last, worker) for consecutive ranges of at most grain
+    // indices covering [begin, end), and returns once they are all done.
+    // worker is below size(): per-worker state needs no locking.
+    void parallelFor (uint64_t begin, uint64_t end, uint64_t grain,
+                      std::function<void (uint64_t, uint64_t, unsigned int)> const& fn);
+
+    // Stats
+    std::atomic<uint64_t> chunks, steals;
+
+private:
+    struct Chunk {
+        uint64_t first, last;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    void work (unsigned int worker);
+    bool take (unsigned int worker, Chunk& chunk);
+
+    std::vector<std::thread> workers;
+    std::vector<Queue> queues;
+    std::function<void (uint64_t, uint64_t, unsigned int)> const* job = nullptr;
+    std::atomic<uint64_t> pending;
+
+    // Sleeping workers are woken by a new generation of work
+    std::mutex wakeMutex;
+    std::condition_variable wake, done;
+    uint64_t generation = 0;
+    bool stop = false;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include <cstring>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "udp.h"
+
+UdpTransport::~UdpTransport () {
+    close();
+}
+
+void UdpTransport::close () {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+bool UdpTransport::open (unsigned short port) {
+    close();
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    sockaddr_in local = sockaddr_in();
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(port);
+    if (bind(fd, (sockaddr*) &local, sizeof(local)) < 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool UdpTransport::connect (const char* host, unsigned short port) {
+    addrinfo hints = addrinfo(), *found = nullptr;
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, nullptr, &hints, &found) || ! found) {
+        return false;
+    }
+
+    peer = *(sockaddr_in*) found->ai_addr;
+    peer.sin_port = htons(port);
+    freeaddrinfo(found);
+    return true;
+}
+
+unsigned short UdpTransport::port () const {
+    sockaddr_in local = sockaddr_in();
+    socklen_t size = sizeof(local);
+    if (fd < 0 || getsockname(fd, (sockaddr*) &local, &size) < 0) {
+        return 0;
+    }
+    return ntohs(local.sin_port);
+}
+
+void UdpTransport::send (const uint8_t* data, size_t size) {
+    // Lost like any datagram if the buffer is full
+    if (fd >= 0 && peer.sin_port) {
+        sendto(fd, data, size, MSG_DONTWAIT, (sockaddr*) &peer, sizeof(peer));
+    }
+}
+
+size_t UdpTransport::receive (uint8_t* data, size_t size) {
+    while (fd >= 0) {
+        sockaddr_in from = sockaddr_in();
+        socklen_t length = sizeof(from);
+        ssize_t n = recvfrom(fd, data, size, MSG_DONTWAIT, (sockaddr*) &from, &length);
+        if (n <= 0) {
+            return 0;
+        }
+        if (from.sin_addr.s_addr == peer.sin_addr.s_addr && from.sin_port == peer.sin_port) {
+            return size_t(n);
+        }
+    }
+    return 0;
+}
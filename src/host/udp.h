@@ -0,0 +1,39 @@
+#ifndef _UDP_H_
+#define _UDP_H_
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+#include "netplay.h"
+
+// NetTransport over a POSIX UDP socket, for the host tools: one peer, non
+// blocking. The Vita would do the same with sceNet.
+struct UdpTransport : NetTransport {
+    UdpTransport () {
+    }
+
+    ~UdpTransport ();
+
+    UdpTransport (UdpTransport const&) = delete;
+    UdpTransport& operator= (UdpTransport const&) = delete;
+
+    // Binds to the port on every interface, any free one for 0
+    bool open (unsigned short port);
+
+    // Where packets go, and the only address they are taken from
+    bool connect (const char* host, unsigned short port);
+
+    // The port bound
+    unsigned short port () const;
+
+    void send (const uint8_t* data, size_t size) override;
+    size_t receive (uint8_t* data, size_t size) override;
+
+    void close ();
+
+private:
+    int fd = -1;
+    sockaddr_in peer = sockaddr_in();
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef _IDLE_H_
+#define _IDLE_H_
+
+#include <stdint.h>
+
+// Redraw skipping for screens that only change on input (menu, pause, game
+// over). Platform-free, like FixedTimestep: each loop iteration the caller
+// says whether the game is in such a state, what the screen depends on and
+// whether the input changed. Once a frame of an unchanged screen has been
+// shown, render() and the swap are skipped (the last frame stays on the
+// display) and the caller only waits for the next vblank before polling
+// again. Any input or screen change draws on the next wakeup, within a
+// frame, and returns to full rate.
+struct IdleThrottle {
+    IdleThrottle () {
+        init();
+    }
+
+    void init () {
+        drawn = false;
+        idle = false;
+    }
+
+    // Whether to render and swap this iteration
+    bool frame (uint64_t nowMicros, bool idleState, uint64_t screenKey, bool inputChanged) {
+        bool draw = ! idleState || inputChanged || ! drawn || screenKey != lastKey;
+        lastKey = screenKey;
+        drawn = true;
+        idle = ! draw;
+
+        if (draw) {
+            ++framesDrawn;
+        } else {
+            ++framesSkipped;
+        }
+        count(nowMicros, draw, ! idleState);
+
+        return draw;
+    }
+
+    bool drawn, idle; // idle: the last frame was skipped
+    uint64_t lastKey = 0;
+
+    // Stats
+    uint64_t framesDrawn = 0, framesSkipped = 0;
+    // Loop iterations and draws in the last second spent entirely in idle
+    // states, and in the last second overall
+    unsigned int idleWakeups = 0, idleDraws = 0;
+    unsigned int wakeups = 0, draws = 0;
+
+private:
+    void count (uint64_t nowMicros, bool draw, bool active) {
+        if (nowMicros >= windowStart + 1000000) {
+            if (windowStart && ! windowActive) {
+                idleWakeups = windowWakeups;
+                idleDraws = windowDraws;
+            }
+            if (windowStart) {
+                wakeups = windowWakeups;
+                draws = windowDraws;
+            }
+
+            windowStart = nowMicros;
+            windowWakeups = windowDraws = 0;
+            windowActive = false;
+        }
+
+        ++windowWakeups;
+        windowDraws += draw;
+        windowActive |= active;
+    }
+
+    uint64_t windowStart = 0;
+    unsigned int windowWakeups = 0, windowDraws = 0;
+    bool windowActive = false;
+};
+
+#endif
@@ -3,32 +3,64 @@
 
 #include <psp2/ctrl.h>
 #include <psp2/touch.h>
+#include <psp2/kernel/processmgr.h>
 #include <glm/glm.hpp>
 #include "utils.h" // for lerp
+#include "input_buffer.h"
 
 struct InputState {
     InputState () {
         firstUpdate = true;
 
-        // Enable analog sticks
+        // Enable analog sticks. The touchscreens are off until asked for.
         sceCtrlSetSamplingMode(SCE_CTRL_MODE_ANALOG);
 
-        // Enable front and back touchscreen
-        sceTouchSetSamplingState(SCE_TOUCH_PORT_FRONT, SCE_TOUCH_SAMPLING_STATE_START);
-        sceTouchSetSamplingState(SCE_TOUCH_PORT_BACK, SCE_TOUCH_SAMPLING_STATE_START);
-
         memset(&pad, 0, sizeof(pad));
         memset(&oldpad, 0, sizeof(oldpad));
         memset(&touchpad_front, 0, sizeof(touchpad_front));
         memset(&touchpad_back, 0, sizeof(touchpad_back));
     }
 
+    // Front and back touchscreen sampling, only while something reads them
+    void setTouch (bool enable) {
+        if (enable == touch) {
+            return;
+        }
+
+        int state = enable ? SCE_TOUCH_SAMPLING_STATE_START : SCE_TOUCH_SAMPLING_STATE_STOP;
+        sceTouchSetSamplingState(SCE_TOUCH_PORT_FRONT, state);
+        sceTouchSetSamplingState(SCE_TOUCH_PORT_BACK, state);
+        touch = enable;
+
+        memset(&touchpad_front, 0, sizeof(touchpad_front));
+        memset(&touchpad_back, 0, sizeof(touchpad_back));
+    }
+
     void update () {
-        // Read controls, touchscreens and analog sticks
-        sceCtrlPeekBufferPositive(0, &pad, 1);
+        // Read every controller sample buffered since the last update, so
+        // that presses shorter than a frame are not lost, then the
+        // touchscreens if they are on
+        int n = sceCtrlPeekBufferPositive(0, samples, INPUT_BUFFERS);
+        uint64_t now = sceKernelGetProcessTimeWide();
+
+        if (n > 0) {
+            PadSample s[INPUT_BUFFERS];
+            for (int i = 0; i < n; ++i) {
+                s[i].buttons = samples[i].buttons;
+                s[i].lx = samples[i].lx;
+                s[i].ly = samples[i].ly;
+                s[i].rx = samples[i].rx;
+                s[i].ry = samples[i].ry;
+                s[i].stamp = samples[i].timeStamp;
+            }
+            buffer.feed(s, n, now);
+            memcpy(&pad, &samples[n - 1], sizeof(pad));
+        }
 
-        sceTouchPeek(SCE_TOUCH_PORT_FRONT, &touchpad_front, 1);
-        sceTouchPeek(SCE_TOUCH_PORT_BACK, &touchpad_back, 1);
+        if (touch) {
+            sceTouchPeek(SCE_TOUCH_PORT_FRONT, &touchpad_front, 1);
+            sceTouchPeek(SCE_TOUCH_PORT_BACK, &touchpad_back, 1);
+        }
 
         lx = (signed char) pad.lx - 128;
         ly = (signed char) pad.ly - 128;
@@ -43,20 +75,31 @@ struct InputState {
 
     void endUpdate () {
         memcpy(&oldpad, &pad, sizeof(pad));
+        buffer.endFrame();
     }
 
     bool isButtonPressed (int button) const {
         return pad.buttons & button;
     }
 
+    // Pressed at any sample since the last update, even if already released
     bool isButtonPressedOnce (int button) const {
-        return isButtonPressed(button) && !(oldpad.buttons & button);
+        return buffer.pressed & button;
     }
 
     bool isButtonReleased (int button) const {
         return ! isButtonPressed(button);
     }
 
+    // Anything pressed, released, touched or moved past the stick noise
+    // since the last update
+    bool changed () const {
+        return pad.buttons != oldpad.buttons || buffer.pressed || buffer.released ||
+               touchpad_front.reportNum > 0 || touchpad_back.reportNum > 0 ||
+               abs(pad.lx - oldpad.lx) > 8 || abs(pad.ly - oldpad.ly) > 8 ||
+               abs(pad.rx - oldpad.rx) > 8 || abs(pad.ry - oldpad.ry) > 8;
+    }
+
     int numberTouches (int touchpad) const {
         return touchpad == 0 ? touchpad_front.reportNum : touchpad_back.reportNum;
     }
@@ -78,13 +121,14 @@ struct InputState {
     }
 
     ~InputState () {
-        // Enable front and back touchscreen
-        sceTouchSetSamplingState(SCE_TOUCH_PORT_FRONT, SCE_TOUCH_SAMPLING_STATE_STOP);
-        sceTouchSetSamplingState(SCE_TOUCH_PORT_BACK, SCE_TOUCH_SAMPLING_STATE_STOP);
+        setTouch(false);
     }
 
     bool firstUpdate = true;
+    bool touch = false;
     SceCtrlData oldpad, pad;
+    SceCtrlData samples[INPUT_BUFFERS];
+    InputBuffer buffer;
     SceTouchData touchpad_front, touchpad_back;
     signed char lx, ly, rx, ry;
 };
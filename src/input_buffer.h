@@ -0,0 +1,149 @@
+#ifndef _INPUT_BUFFER_H_
+#define _INPUT_BUFFER_H_
+
+#include <stdint.h>
+
+// Samples kept by the controller driver, all read back every frame
+#define INPUT_BUFFERS 64
+
+// One controller sample, as SceCtrlData without the Vita types
+struct PadSample {
+    uint32_t buttons;
+    uint8_t lx, ly, rx, ry;
+    uint64_t stamp;  // Controller timestamp (microseconds)
+    uint64_t micros; // The same on the game clock, set by InputBuffer::feed
+};
+
+// Every sample since the last frame, not just the latest: a press and its
+// release between two frames are both seen. Platform-free, InputState
+// feeds it what sceCtrlPeekBufferPositive returns.
+struct InputBuffer {
+    // Takes the samples of one read, oldest first. Samples seen by an
+    // earlier read (by controller timestamp) are skipped. They are moved to
+    // the game clock by their age relative to the newest one, which is
+    // taken as read at readMicros. Returns the number of new samples.
+    unsigned int feed (PadSample* samples, unsigned int n, uint64_t readMicros) {
+        if (! n) {
+            return 0;
+        }
+
+        uint64_t newest = samples[n - 1].stamp;
+        unsigned int fresh = 0;
+
+        for (unsigned int i = 0; i < n; ++i) {
+            PadSample& s = samples[i];
+            if (started && s.stamp <= lastStamp) {
+                continue;
+            }
+            s.micros = readMicros - (newest - s.stamp);
+
+            if (! started) {
+                // Nothing to compare the first sample to
+                started = true;
+                current = s;
+            }
+
+            uint32_t down = s.buttons & ~current.buttons;
+            uint32_t up = current.buttons & ~s.buttons;
+
+            for (unsigned int b = 0; b < 32; ++b) {
+                if ((down >> b) & 1 && ! ((pressed >> b) & 1)) {
+                    pressedAt[b] = s.micros;
+                }
+            }
+
+            pressed |= down;
+            released |= up;
+
+            current = s;
+            lastStamp = s.stamp;
+            ++fresh;
+        }
+
+        frameSamples += fresh;
+        totalSamples += fresh;
+        return fresh;
+    }
+
+    // Forgets the edges of the frame
+    void endFrame () {
+        tapsRecovered += countBits(pressed & ~current.buttons);
+        pressed = released = 0;
+        samplesLastFrame = frameSamples;
+        frameSamples = 0;
+    }
+
+    // Game time of the first press of any of the buttons this frame, or 0
+    uint64_t firstPress (uint32_t buttons) const {
+        uint64_t t = 0;
+        for (unsigned int b = 0; b < 32; ++b) {
+            if ((buttons & pressed) >> b & 1 && (! t || pressedAt[b] < t)) {
+                t = pressedAt[b];
+            }
+        }
+        return t;
+    }
+
+    static unsigned int countBits (uint32_t x) {
+        unsigned int n = 0;
+        for (; x; x &= x - 1) {
+            ++n;
+        }
+        return n;
+    }
+
+    bool started = false;
+    PadSample current = {};
+    uint64_t lastStamp = 0;
+
+    // Edges since the last endFrame()
+    uint32_t pressed = 0, released = 0;
+    uint64_t pressedAt[32] = {};
+
+    // Stats
+    unsigned int samplesLastFrame = 0;
+    uint64_t totalSamples = 0;
+    // Presses released before the frame ended: lost when reading only the
+    // latest sample
+    uint64_t tapsRecovered = 0;
+
+private:
+    unsigned int frameSamples = 0;
+};
+
+// Time from an input to the first frame that shows its effect
+struct InputLatency {
+    // An input happened at t; ignored while an earlier one is pending
+    void input (uint64_t t) {
+        if (! pending && t) {
+            pending = t;
+        }
+    }
+
+    // The pending input changed the game: the next frame shows it
+    void acted () {
+        if (pending) {
+            acting = pending;
+            pending = 0;
+        }
+    }
+
+    // A frame was displayed at t
+    void shown (uint64_t t) {
+        if (! acting) {
+            return;
+        }
+
+        last = uint32_t(t - acting);
+        max = last > max ? last : max;
+        sum += last;
+        ++count;
+        acting = 0;
+    }
+
+    uint64_t pending = 0, acting = 0;
+    uint32_t last = 0, max = 0;
+    uint64_t sum = 0, count = 0;
+};
+
+#endif
@@ -1,150 +1,56 @@
+#include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <ctime>
 #define M_PI 3.14159265358979323846
 #include <cmath>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include <psp2/display.h>
+
 #include "vita2dpp.h"
 #include "vita_audio.h"
+#include "vita_pack.h"
+#include "text_atlas.h"
+#include "match.h"
+#include "replay.h"
+#include "timestep.h"
+#include "idle.h"
+#include "profiler.h"
 
-enum {
-    TEXT_TOP    = 0,
-    TEXT_CENTER = 1,
-    TEXT_BOTTOM = 2,
-    TEXT_LEFT   = 3,
-    TEXT_RIGHT  = 4,
-};
-
-int vita2d_pgf_draw_aligned_text (vita2d_pgf* font, int x, int y,
-                                  unsigned int color, float scale,
-                                  int horiz, int vert,
-                                  const char* text) {
-    int width = -1, height = -1;
-    vita2d_pgf_text_dimensions(font, scale, text, &width, &height);
-
-    // left (horizontal) and top (vertical) do not need any processing
-    if (horiz == TEXT_CENTER) {
-        x -= 0.5 * width;
-    } else if (horiz == TEXT_RIGHT) {
-        x -= width;
-    }
-
-    if (vert == TEXT_CENTER) {
-        y -= 0.5 * height;
-    } else if (vert == TEXT_BOTTOM) {
-        y -= height;
-    }
-
-    return vita2d_pgf_draw_text(font, x, y, color, scale, text);
-}
-
-// Constants
-#define PADDLE_W (20.0f)
-#define PADDLE_H (120.0f)
-#define PADDLE_SPEED (7.5f)
-#define BALL_SPEED (10.0f)
-#define SCORE_WIN (10)
 #define EXIT_COMBO (SCE_CTRL_LTRIGGER | SCE_CTRL_RTRIGGER)
-
-struct Paddle : Rectangle {
-    Paddle () : Rectangle() {
-    }
-
-    Paddle (glm::vec2 const& p0, glm::vec2 const& dims0) : Rectangle(p0, dims0) {
-    }
-
-    void clear () {
-        score = 0;
-    }
-
-    bool player = true;
-    int score = 0;
-};
-
-struct Ball : Circle {
-    Ball () : Circle() {
-    }
-
-    Ball (glm::vec2 const& p0, float r) : Circle(p0, r) {
-        setRandomSpeed();
-    }
-
-    void init (glm::vec2 const& p0, float r) {
-        this->p = p0;
-        this->r = r;
-        setRandomSpeed();
-    }
-
-    void clear () {
-        x() = SCREEN_W / 2;
-        y() = SCREEN_H / 2;
-
-        setRandomSpeed();
-    }
-
-    void setRandomSpeed () {
-        float theta = 0.0f;
-        if (ri(0, 1) == 0) {
-            theta = rf(-M_PI / 4, M_PI / 4);
-        } else {
-            theta = rf(3 * M_PI / 4, 5 * M_PI / 4);
-        }
-        v0 = BALL_SPEED * glm::vec2(cos(theta), sin(theta));
-        v = v0;
-    }
-
-    void move () {
-        Circle::move(v);
-    }
-
-    glm::vec2 speed () const {
-        return v;
-    }
-
-    glm::vec2& speed () {
-        return v;
-    }
-
-    bool collide (Paddle const& paddle) {
-        if (intersects(paddle)) {
-            // Y coordinate of the intersection point (between -1 and 1)
-            float interY = y() + radius() / 2,
-                  relativeInterY = interY - paddle.top(),
-                  normalizedInterY = relativeInterY / paddle.height();
-            normalizedInterY = 2 * normalizedInterY - 1;
-
-            // Angle
-            float bounceAngle = normalizedInterY * maxBounceAngle;
-            float n0 = glm::length(v0);
-
-            // Update speed
-            v.x = (paddle.player ? n0 : -n0) * cos(bounceAngle);
-            v.y = n0 * sin(bounceAngle);
-
-            return true;
-        }
-
-        return false;
-    }
-
-    glm::vec2 v0, v;
-    float maxBounceAngle = M_PI / 6;
-};
+#define TICK_HZ (120)
+#define PROFILE_CSV "ux0:data/vitapong_frames.csv"
+#define PROFILE_REFRESH (30) // Frames between two updates of the percentiles
+#define PROFILE_GRAPH_H (100)
+#define PROFILE_GRAPH_MICROS (33333) // Frame time at the top of the graph
+#define REPLAY_FILE "ux0:data/vitapong_last.vpr" // The last match played
+#define AUDIO_PERIOD (256) // Low latency: ~6 ms per buffer at 44.1 kHz
 
 enum class GameState {
     Menu,
+    Serve, // Counting down to the serve, the game drawn but frozen
     Play,
     Pause,
     GameOver,
+    Replay, // The last match, played back from REPLAY_FILE
 };
 
-enum class GameMode {
-    OnePlayer,
-    TwoPlayers,
+// One Player, at each level of the CPU (Left / Right in the menu)
+static const char* const onePlayerNames[AI_LEVELS] = {
+    "One Player: Easy",
+    "One Player: Normal",
+    "One Player: Hard",
+    "One Player: Learned",
 };
 
+// Fast-forward steps of the replay, in ticks per tick
+static const unsigned int replaySpeeds[] = { 1, 10, 100, 1000 };
+#define REPLAY_SPEEDS (sizeof(replaySpeeds) / sizeof(replaySpeeds[0]))
+
 struct Menu {
     Menu () {
     }
@@ -167,7 +73,7 @@ struct Menu {
 
     void render (int x  = SCREEN_W / 2, int y = SCREEN_H / 2,
                  int horiz = TEXT_CENTER, int vert = TEXT_CENTER) const {
-        vita2d_pgf_draw_aligned_text(pgf, x, y, WHITE, 2.0f, horiz, vert, title);
+        atlas->draw(text->get(title, 2.0f), x, y, WHITE, horiz, vert);
         y += 50;
 
         for (unsigned int i = 0; i < choices.size(); ++i) {
@@ -176,12 +82,13 @@ struct Menu {
                 c = RED;
             }
 
-            vita2d_pgf_draw_aligned_text(pgf, x, y, c, 1.0f, horiz, vert, choices[i].name);
+            atlas->draw(text->get(choices[i].name, 1.0f), x, y, c, horiz, vert);
             y += 20;
         }
     }
 
-    vita2d_pgf* pgf;
+    TextAtlas const* atlas;
+    TextCache* text;
 
     struct Choice {
         Choice (const char* name) : name(name) {
@@ -197,32 +104,62 @@ struct Menu {
 
 struct Game {
     Game () {
-        srand(time(nullptr));
+        seeds.seed(time(nullptr));
+
+        // Simulation rate
+        timestep.init(TICK_HZ);
+        match.setTickRate(TICK_HZ);
 
         // vita2d initialization
         vita2d_init();
         vita2d_set_clear_color(BLACK);
 
-        // Load PGF font
+        // Load PGF font, and rasterize it at the scales used by the game
         pgf = vita2d_load_default_pgf();
+        const float textScales[] = { 1.0f, 2.0f };
+        atlas.init(pgf, textScales, 2);
+        text.init(&atlas.atlas);
+
+        // Shapes are drawn in batches
+        batch.init(vita2d_submit_batch);
 
         // Objects
         restart();
 
         // Menu
         menu.init("Pong");
-        menu.pgf = pgf;
-        menu.add("One Player");
+        menu.atlas = &atlas;
+        menu.text = &text;
+        menu.add(onePlayerNames[level]);
         menu.add("Two Players");
+        menu.add("Multiball");
+        menu.add("Arena");
+        menu.add("Replay");
         menu.add("Quit");
 
         // Audio
         // Library
         vitaWavInit();
+        vitaWavSetTickRate(TICK_HZ);
+        vitaWavSetPeriod(AUDIO_PERIOD);
+
+        // Sounds: played in place from the pack, already in the native format
+        uint64_t start = sceKernelGetProcessTimeWide();
+        vitaPackLoad(&assets, "app0:data/assets.pak");
+        vitaWavLoadPack(&beep, &assets, "beep.wav");
+        vitaWavLoadPack(&boop, &assets, "boop.wav");
+
+        // The learned CPU, copied out of the pack; the prediction plays
+        // instead without it
+        const vitaPackEntry* weights = vitaPackFind(&assets, "opponent.nn");
+        if (weights && opponent.read(vitaPackData(&assets, weights), weights->size)) {
+            match.net = &opponent;
+            player.match.net = &opponent;
+        }
+        assetMicros = sceKernelGetProcessTimeWide() - start;
 
-        // Sounds
-        beep = vitaWavLoad("app0:data/beep.wav");
-        boop = vitaWavLoad("app0:data/boop.wav");
+        // Music is streamed, and optional
+        music = vitaWavStreamOpen("app0:data/music.wav");
     }
 
     void restart () {
@@ -230,20 +167,34 @@ struct Game {
         exit = false;
         debug = false;
 
-        // Ball
-        ball.init(glm::vec2(SCREEN_W / 2, SCREEN_H / 2),
-                  10);
+        stopRecording();
+        if (music) {
+            vitaWavStreamStop(music);
+        }
+    }
 
-        // Paddles
-        player.init(glm::vec2(10, SCREEN_H / 2 - PADDLE_H / 2),
-                    glm::vec2(PADDLE_W, PADDLE_H));
-        player.player = true;
-        player.clear();
+    // Serves the first ball of a new match, recording it
+    void startMatch (GameMode mode) {
+        match.start(mode, seeds.next(), level);
+        recorder.begin(match, input.touch ? REPLAY_TOUCH : 0);
+        state = GameState::Serve;
+    }
 
-        cpu.init(glm::vec2(SCREEN_W - 10 - PADDLE_W, SCREEN_H / 2 - PADDLE_H / 2),
-                 glm::vec2(PADDLE_W, PADDLE_H));
-        cpu.player = false;
-        cpu.clear();
+    // Keeps the match that just ended for the replay menu
+    void stopRecording () {
+        if (recorder.recording()) {
+            recorder.finish(match);
+            recorder.replay.save(REPLAY_FILE);
+        }
+    }
+
+    // Plays the last match back from the start
+    void openReplay () {
+        if (replay.load(REPLAY_FILE) && player.open(&replay)) {
+            state = GameState::Replay;
+            replaySpeed = 0;
+            replayPaused = false;
+        }
     }
 
     void handleInput () {
@@ -257,6 +208,14 @@ struct Game {
             debug = !debug;
         }
 
+        // Cycle the audio period to find the shortest one without underruns
+        if (debug && input.isButtonPressedOnce(SCE_CTRL_SQUARE)) {
+            vitaAudioStats stats;
+            vitaWavGetStats(&stats);
+            vitaWavSetPeriod(stats.period > 128 ? stats.period / 2 : 1024);
+            vitaWavResetStats();
+        }
+
         switch (state) {
             case GameState::Menu:
                 if (input.isButtonPressedOnce(SCE_CTRL_UP)) {
@@ -265,69 +224,70 @@ struct Game {
                     menu.down();
                 }
 
+                if (menu.current == 0 && input.isButtonPressedOnce(SCE_CTRL_LEFT)) {
+                    level = (level + AI_LEVELS - 1) % AI_LEVELS;
+                    menu.choices[0].name = onePlayerNames[level];
+                } else if (menu.current == 0 && input.isButtonPressedOnce(SCE_CTRL_RIGHT)) {
+                    level = (level + 1) % AI_LEVELS;
+                    menu.choices[0].name = onePlayerNames[level];
+                }
+
                 if (input.isButtonPressed(SCE_CTRL_CROSS)) {
                     switch (menu.current) {
                         case 0:
-                            state = GameState::Play;
-                            mode = GameMode::OnePlayer;
+                            startMatch(GameMode::OnePlayer);
                             break;
 
                         case 1:
-                            state = GameState::Play;
-                            mode = GameMode::TwoPlayers;
+                            startMatch(GameMode::TwoPlayers);
                             break;
 
                         case 2:
+                            startMatch(GameMode::Multiball);
+                            break;
+
+                        case 3:
+                            startMatch(GameMode::Arena);
+                            break;
+
+                        case 4:
+                            openReplay();
+                            break;
+
+                        case 5:
                             exit = true;
                             break;
 
                         default:
                             break;
                     }
+
+                    if (state == GameState::Serve) {
+                        if (music) {
+                            vitaWavStreamPlay(music, 1);
+                        }
+                    }
                 }
                 break;
 
+            case GameState::Serve:
             case GameState::Play:
-                // Pause
+                // Pause, and come back to the countdown if it was running
                 if (input.isButtonPressedOnce(SCE_CTRL_START)) {
+                    pausedFrom = state;
                     state = GameState::Pause;
                 }
 
-                // Player moves with the left analog stick or Up / Down arrows
-                if (abs(input.ly) > 50) {
-                    player.moveY(PADDLE_SPEED * input.ly / 50.0f);
-                }
-
-                if (input.isButtonPressed(SCE_CTRL_UP)) {
-                    player.moveY(-PADDLE_SPEED);
-                } else if (input.isButtonPressed(SCE_CTRL_DOWN)) {
-                    player.moveY(PADDLE_SPEED);
-                }
-
-                switch (mode) {
-                    case GameMode::OnePlayer:
-                        // TODO
-                        break;
-
-                    case GameMode::TwoPlayers:
-                        // CPU (or Player 2) moves with the right analog stick or Triangle / Cross
-                        if (abs(input.ry) > 50) {
-                            cpu.moveY(PADDLE_SPEED * input.ry / 50.0f);
-                        }
-
-                        if (input.isButtonPressed(SCE_CTRL_TRIANGLE)) {
-                            cpu.moveY(-PADDLE_SPEED);
-                        } else if (input.isButtonPressed(SCE_CTRL_CROSS)) {
-                            cpu.moveY(PADDLE_SPEED);
-                        }
-                        break;
+                // Dump the frame timings
+                if (debug && input.isButtonPressedOnce(SCE_CTRL_CIRCLE)) {
+                    profileSaved = profiler.writeCsv(PROFILE_CSV) ? 1 : -1;
                 }
                 break;
 
             case GameState::Pause:
                 // Resume
                 if (input.isButtonPressedOnce(SCE_CTRL_START)) {
-                    state = GameState::Play;
+                    state = pausedFrom;
                 }
 
                 // Go back to menu
@@ -341,61 +301,88 @@ struct Game {
                     restart();
                 }
                 break;
-        }
-    }
 
-    void update () {
-        handleInput();
+            case GameState::Replay:
+                // Right: faster, Left: back one keyframe, Start: pause,
+                // Circle: back to the menu
+                if (input.isButtonPressedOnce(SCE_CTRL_RIGHT)) {
+                    replaySpeed = (replaySpeed + 1) % REPLAY_SPEEDS;
+                }
 
-        if (state != GameState::Play)
-            return;
+                if (input.isButtonPressedOnce(SCE_CTRL_LEFT)) {
+                    unsigned int back = replay.header.keyframeTicks;
+                    player.seek(player.match.ticks > back ? player.match.ticks - back : 0);
+                }
 
-        // Move ball
-        ball.move();
+                if (input.isButtonPressedOnce(SCE_CTRL_START)) {
+                    replayPaused = ! replayPaused;
+                }
 
-        // Check collisions
-        // Player with screen boundaries
-        if (player.y() < 0.0f) {
-            player.y() = 0.0f;
-        } else if (player.y() + player.height() > SCREEN_H) {
-            player.y() = SCREEN_H - player.height();
+                if (input.isButtonPressedOnce(SCE_CTRL_CIRCLE)) {
+                    restart();
+                }
+                break;
         }
+    }
 
-        // CPU with screen boundaries
-        if (cpu.y() < 0.0f) {
-            cpu.y() = 0.0f;
-        } else if (cpu.y() + cpu.height() > SCREEN_H) {
-            cpu.y() = SCREEN_H - cpu.height();
+    // What the match reads this tick, from the latest input
+    TickInput tickInput () const {
+        TickInput in;
+        in.buttons = input.pad.buttons;
+        in.lx = TickInput::stick(input.lx);
+        in.ly = TickInput::stick(input.ly);
+        in.rx = TickInput::stick(input.rx);
+        in.ry = TickInput::stick(input.ry);
+
+        if (input.touch && input.numberTouches(0) > 0) {
+            in.touches = input.numberTouches(0);
+            in.tx = input.touchpad_front.report[0].x;
+            in.ty = input.touchpad_front.report[0].y;
         }
+        return in;
+    }
 
-        // Ball with screen boundaries
-        if (ball.y() < 0.0f) {
-            ball.y() = 0.0f;
-            ball.speed().y = -ball.speed().y;
-        } else if (ball.y() + 2 * ball.radius() > SCREEN_H) {
-            ball.y() = SCREEN_H - 2 * ball.radius();
-            ball.speed().y = -ball.speed().y;
-        } else if (ball.x() < 0.0f) {
-            cpu.score++;
-            ball.clear();
-            sleep(1);
-        } else if (ball.x() + 2 * ball.radius() > SCREEN_W) {
-            player.score++;
-            ball.clear();
-            sleep(1);
+    void playSounds (unsigned int events) {
+        // Ball with the paddles
+        if (events & SIM_HIT_PLAYER) {
+            vitaWavPlay(&beep);
+        } else if (events & SIM_HIT_CPU) {
+            vitaWavPlay(&boop);
+        } else if (events & SIM_HIT_OBSTACLE) {
+            vitaWavPlay(&beep);
         }
+    }
 
-        // Ball with the paddles
-        if (ball.collide(player)) {
-            vitaWavPlay(beep);
-        } else if (ball.collide(cpu)) {
-            vitaWavPlay(boop);
+    // One simulation tick
+    void update () {
+        if (state == GameState::Replay) {
+            if (! replayPaused) {
+                // Sounds only make sense at normal speed
+                unsigned int events = player.step(replaySpeeds[replaySpeed]);
+                if (replaySpeed == 0) {
+                    playSounds(events);
+                }
+            }
+            return;
         }
 
-        if (player.score >= SCORE_WIN) {
-            state = GameState::GameOver;
-        } else if (cpu.score >= SCORE_WIN) {
+        if (state != GameState::Serve && state != GameState::Play)
+            return;
+
+        TickInput in = tickInput();
+        recorder.record(in, match);
+
+        // Only a tick that moved the paddle shows the press
+        float paddleY = match.sim.player.y();
+        playSounds(match.tick(in));
+        if (match.sim.player.y() != paddleY) {
+            latency.acted();
+        }
+
+        if (match.over()) {
             state = GameState::GameOver;
+        } else {
+            state = match.serving() ? GameState::Serve : GameState::Play;
         }
     }
 
@@ -405,45 +392,205 @@ struct Game {
                 menu.render(SCREEN_W / 2, SCREEN_H / 2 - 100);
                 break;
 
+            case GameState::Serve:
             case GameState::Play:
-                ball.render(WHITE);
-                player.render(WHITE);
-                cpu.render(WHITE);
+            case GameState::Replay: {
+                Match const& m = state == GameState::Replay ? player.match : match;
+
+                // Interpolate between the last two simulation ticks
+                float alpha = timestep.alpha();
+
+                Ball ball = m.sim.ball;
+                Paddle left = m.sim.player, right = m.sim.cpu;
+                ball.p = glm::mix(m.prevBall, m.sim.ball.p, alpha);
+                left.p = glm::mix(m.prevPlayer, m.sim.player.p, alpha);
+                right.p = glm::mix(m.prevCpu, m.sim.cpu.p, alpha);
+
+                ball.render(batch, WHITE);
+                left.render(batch, WHITE);
+                right.render(batch, WHITE);
+
+                for (unsigned int i = 0; i < m.arena.obstacles.size(); ++i) {
+                    m.arena.obstacles[i].render(batch, PURP);
+                }
+
+                for (unsigned int i = 0; i < m.balls.size(); ++i) {
+                    batch.circle(m.balls.x[i], m.balls.y[i], m.balls.r[i], WHITE);
+                }
 
                 if (debug) {
-                    vita2d_pgf_draw_textf(pgf, SCREEN_W - 160, 30, GREEN, 1.0f, "FPS: %.2f", fps);
+                    renderProfileGraph();
                 }
 
-                vita2d_pgf_draw_textf(pgf, SCREEN_W / 2 + 20, 30, WHITE, 2.0f, "%d", cpu.score);
-                vita2d_pgf_draw_textf(pgf, SCREEN_W / 2 - 20, 30, WHITE, 2.0f, "%d", player.score);
+                // Text is drawn over the shapes
+                batch.flush();
+
+                if (debug) {
+                    debugLine(0, "FPS: %.2f", fps);
+                    debugLine(1, "Tick: %u Hz", timestep.hz);
+                    debugLine(2, "Caught up: %llu", (unsigned long long) timestep.caughtUp);
+                    debugLine(3, "Dropped: %llu", (unsigned long long) timestep.dropped);
+
+                    vitaAudioStats audio;
+                    vitaWavGetStats(&audio);
+                    debugLine(4, "Audio: %u smp", audio.period);
+                    debugLine(5, "Latency: %.1f/%.1f ms",
+                              audio.plays ? audio.latencySum / 1000.0f / audio.plays : 0.0f,
+                              audio.latencyMax / 1000.0f);
+                    debugLine(6, "Underruns: %lu", audio.underruns);
+
+                    debugLine(7, "Assets: %.1f ms %lu KB", assetMicros / 1000.0f, assets.size / 1024);
+                    debugLine(8, "Text layouts: %u", text.layoutsLastFrame);
+                    debugLine(9, "Draws: %u (%u verts)", batch.drawCallsLastFrame, batch.verticesLastFrame);
+                    debugLine(10, "Idle: %u wake/s %u draw/s", throttle.idleWakeups, throttle.idleDraws);
+                    debugLine(11, "Skipped: %llu", (unsigned long long) throttle.framesSkipped);
+                    debugLine(12, "Input: %.1f/%.1f ms %u smp",
+                              latency.count ? latency.sum / 1000.0f / latency.count : 0.0f,
+                              latency.max / 1000.0f, input.buffer.samplesLastFrame);
+
+                    renderProfileText();
+
+                    if (music) {
+                        vitaStreamStats stream;
+                        vitaWavStreamGetStats(music, &stream);
+                        debugLine(13, "Music: %u%% (min %u%%)",
+                                  100 * stream.fill / stream.capacity,
+                                  100 * stream.minFill / stream.capacity);
+                        debugLine(14, "Starved: %lu", stream.starvations);
+                    }
+                }
+
+                // Formatted and laid out again only when they change
+                atlas.draw(scoreText[1].number(text, m.sim.cpu.score, 2.0f), SCREEN_W / 2 + 20, 30, WHITE);
+                atlas.draw(scoreText[0].number(text, m.sim.player.score, 2.0f), SCREEN_W / 2 - 20, 30, WHITE);
+
+                // Seconds left before the serve: 3, 2, 1
+                if (m.serving()) {
+                    unsigned int seconds = (m.serveTicks + m.hz - 1) / m.hz;
+                    atlas.draw(countdownText.number(text, seconds, 2.0f),
+                               SCREEN_W / 2, SCREEN_H / 2 - 60, WHITE, TEXT_CENTER, TEXT_CENTER);
+                }
+
+                if (state == GameState::Replay) {
+                    char buf[96];
+                    snprintf(buf, sizeof(buf), "Replay x%u%s  %.1f / %.1f s%s",
+                             replaySpeeds[replaySpeed], replayPaused ? " (paused)" : "",
+                             float(m.ticks) / m.hz, float(replay.header.ticks) / m.hz,
+                             player.desyncs ? "  DESYNC" : "");
+                    atlas.draw(replayText.set(text, buf, 1.0f),
+                               SCREEN_W / 2, SCREEN_H - 30, WHITE, TEXT_CENTER, TEXT_CENTER);
+                }
                 break;
+            }
 
             case GameState::Pause:
-                vita2d_pgf_draw_aligned_text(pgf, SCREEN_W / 2, SCREEN_H / 2,
-                                             WHITE, 1.0f,
-                                             TEXT_CENTER, TEXT_CENTER,
-                                             "Press Start to resume");
-                vita2d_pgf_draw_aligned_text(pgf, SCREEN_W / 2, SCREEN_H / 2 + 20,
-                                             WHITE, 1.0f,
-                                             TEXT_CENTER, TEXT_CENTER,
-                                             "Press Circle to return to Menu");
+                atlas.draw(text.get("Press Start to resume", 1.0f),
+                           SCREEN_W / 2, SCREEN_H / 2, WHITE, TEXT_CENTER, TEXT_CENTER);
+                atlas.draw(text.get("Press Circle to return to Menu", 1.0f),
+                           SCREEN_W / 2, SCREEN_H / 2 + 20, WHITE, TEXT_CENTER, TEXT_CENTER);
                 break;
 
             case GameState::GameOver:
-                vita2d_pgf_draw_text(pgf,
-                                      SCREEN_W / 2 - 100, SCREEN_H / 2, WHITE, 1.0f, "Press Start to restart");
+                atlas.draw(text.get("Press Start to restart", 1.0f), SCREEN_W / 2 - 100, SCREEN_H / 2, WHITE);
                 break;
         }
     }
 
+    // Stacked time of each phase over the last PROFILER_FRAMES frames, one
+    // pixel per frame, in the bottom left corner, with a line at 60 fps
+    void renderProfileGraph () const {
+        static const int colors[PHASES] = { CYAN, LIME, PURP, RED, BLUE };
+        const float bottom = SCREEN_H - 10, scale = float(PROFILE_GRAPH_H) / PROFILE_GRAPH_MICROS;
+
+        for (unsigned int i = 0; i < profiler.size(); ++i) {
+            float y = bottom;
+            for (unsigned int p = 0; p < PHASES && y > bottom - PROFILE_GRAPH_H; ++p) {
+                float h = fminf(profiler.at(p, i) * scale, y - (bottom - PROFILE_GRAPH_H));
+                batch.rect(10 + i, y - h, 1, h, colors[p]);
+                y -= h;
+            }
+        }
+
+        batch.rect(10, bottom - 16667 * scale, PROFILER_FRAMES, 1, WHITE);
+    }
+
+    // p50/p95/p99 of each phase and of the frame, above the graph
+    void renderProfileText () const {
+        const float x = 10, y = SCREEN_H - 20 - PROFILE_GRAPH_H - 20 * (PHASES + 2);
+
+        atlas.draw(text.get("Phase  p50 / p95 / p99 ms", 1.0f), x, y, GREEN);
+        for (unsigned int p = 0; p <= PHASES; ++p) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s: %.2f / %.2f / %.2f",
+                     p < PHASES ? FrameProfiler::phaseNames[p] : "frame",
+                     phaseStats[p][0] / 1000.0f, phaseStats[p][1] / 1000.0f, phaseStats[p][2] / 1000.0f);
+            atlas.draw(phaseText[p].set(text, buf, 1.0f), x, y + 20 * (p + 1), GREEN);
+        }
+
+        const char* csv = profileSaved > 0 ? "Circle: CSV (saved)" : profileSaved < 0 ? "Circle: CSV (failed)" : "Circle: CSV";
+        atlas.draw(text.get(csv, 1.0f), x, y + 20 * (PHASES + 2), GREEN);
+    }
+
+    // One line of the debug overlay, in the top right corner
+    void debugLine (unsigned int line, const char* fmt, ...) const __attribute__((format(printf, 3, 4))) {
+        char buf[128];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, args);
+        va_end(args);
+
+        atlas.draw(debugText[line].set(text, buf, 1.0f), SCREEN_W - 160, 30 + 20 * line, GREEN);
+    }
+
     void run () {
         while (! exit) {
-            // Update
+            profiler.beginFrame(sceKernelGetProcessTimeWide());
+
+            // Update: input edges once per frame, then as many fixed
+            // simulation ticks as the elapsed time requires
             input.update();
-            update();
+            profiler.mark(PHASE_INPUT, sceKernelGetProcessTimeWide());
+
+            // Time the player's presses until the paddle is seen moving
+            if (state == GameState::Play) {
+                latency.input(input.buffer.firstPress(SCE_CTRL_UP | SCE_CTRL_DOWN));
+            }
+            handleInput();
+
+            unsigned int ticks = timestep.advance(sceKernelGetProcessTimeWide());
+            for (unsigned int i = 0; i < ticks; ++i) {
+                // Sounds are timed by the tick that triggered them
+                vitaWavSetTick(tick++);
+                update();
+            }
+
+            bool inputChanged = input.changed();
             input.endUpdate();
+            profiler.mark(PHASE_UPDATE, sceKernelGetProcessTimeWide());
+
+            // Menu, pause and game over only change on input: once shown,
+            // they are neither redrawn nor swapped: the loop only waits for
+            // the next vblank, so an input still shows within a frame
+            bool idleState = state != GameState::Play && state != GameState::Serve &&
+                             state != GameState::Replay;
+            uint64_t screenKey = (uint64_t(state) << 32) | (level << 16) | menu.current;
+            cur_micros = sceKernelGetProcessTimeWide();
+            if (! throttle.frame(cur_micros, idleState, screenKey, inputChanged)) {
+                sceDisplayWaitVblankStart();
+                continue;
+            }
+
+            // Percentiles are sorted out a few times per second only
+            if (debug && profiler.frames % PROFILE_REFRESH == 0) {
+                const float ps[3] = { 50.0f, 95.0f, 99.0f };
+                for (unsigned int p = 0; p <= PHASES; ++p) {
+                    profiler.percentiles(p, ps, phaseStats[p], 3);
+                }
+            }
 
             // Render
+            text.beginFrame();
+            batch.beginFrame();
             vita2d_start_drawing();
                 vita2d_clear_screen();
                 render();
@@ -451,6 +598,7 @@ struct Game {
 
             // Calculate FPS
             cur_micros = sceKernelGetProcessTimeWide();
+            profiler.mark(PHASE_RENDER, cur_micros);
 
             if (cur_micros >= (last_micros + 1000000)) {
                 dt_micros = cur_micros - last_micros;
@@ -462,14 +610,23 @@ struct Game {
             frames++;
 
             vita2d_wait_rendering_done();
+            profiler.mark(PHASE_WAIT, sceKernelGetProcessTimeWide());
             vita2d_swap_buffers();
-        }
-        vita2d_fini();
 
+            uint64_t end = sceKernelGetProcessTimeWide();
+            profiler.mark(PHASE_SWAP, end);
+            profiler.endFrame(end);
+            latency.shown(end);
+        }
         // Cleanup
+        stopRecording();
+        atlas.fini();
         vita2d_free_pgf(pgf);
+        vita2d_fini();
 
+        vitaWavStreamClose(music);
         vitaWavShutdown();
+        vitaPackClose(&assets);
     }
 
     // FPS counting
@@ -478,21 +635,50 @@ struct Game {
     float fps = 0.0f;
 
     InputState input;
+    InputLatency latency;
     bool exit = false;
 
     // Objects
-    Paddle player, cpu;
-    Ball ball;
+    Match match;
+    Rng seeds; // One per match
+    FixedTimestep timestep;
+    IdleThrottle throttle;
+    FrameProfiler profiler;
+    uint32_t phaseStats[PHASES + 1][3] = {};
+    int profileSaved = 0; // 1 once the CSV is written, -1 if it failed
+    unsigned int tick = 0;
     Menu menu;
+    unsigned int level = AI_NORMAL; // Of the CPU in One Player mode
+    NeuralNet opponent;             // Of AI_LEARNED
+
+    // Every match is recorded, the last one can be played back
+    ReplayRecorder recorder;
+    Replay replay;
+    ReplayPlayer player;
+    unsigned int replaySpeed = 0; // In replaySpeeds
+    bool replayPaused = false;
 
     // Sounds
-    vitaWav *beep = nullptr, *boop = nullptr;
+    vitaPack assets;
+    vitaWav beep, boop;
+    uint64_t assetMicros = 0;
+    vitaStream *music = nullptr;
 
     GameState state = GameState::Menu;
-    GameMode mode;
+    GameState pausedFrom = GameState::Play;
 
     bool debug = false;
     vita2d_pgf* pgf;
+    TextAtlas atlas;
+
+    // Text and shape drawing cache and batch: render() stays const
+    mutable TextCache text;
+    mutable TextSlot scoreText[2];
+    mutable TextSlot countdownText;
+    mutable TextSlot replayText;
+    mutable TextSlot debugText[15];
+    mutable TextSlot phaseText[PHASES + 1];
+    mutable Batch batch;
 };
 
 int main (void) {
@@ -0,0 +1,220 @@
+#include <cstdlib>
+
+#include "match.h"
+
+void matchApplyRules (Simulation& sim, MatchRules const& rules) {
+    sim.ball.serveSpeed = rules.ballSpeed;
+    sim.ball.maxBounceAngle = rules.maxBounceAngle;
+}
+
+void matchMovePaddle (Paddle& paddle, Simulation const& sim, MatchRules const& rules, int stick, bool up,
+                      bool down) {
+    float speed = rules.paddleSpeed * sim.dt;
+
+    if (abs(stick) > MATCH_DEADZONE) {
+        paddle.moveY(speed * stick / 50.0f);
+    }
+
+    if (up) {
+        paddle.moveY(-speed);
+    } else if (down) {
+        paddle.moveY(speed);
+    }
+}
+
+unsigned int matchServeTicks (unsigned int hz, bool point) {
+    return (point ? MATCH_SERVE_POINT : MATCH_SERVE_START) * hz;
+}
+
+bool matchServing (unsigned int& serveTicks) {
+    if (serveTicks) {
+        --serveTicks;
+        return true;
+    }
+
+    return false;
+}
+
+Match::Match (Match const& other) {
+    *this = other;
+}
+
+Match& Match::operator= (Match const& other) {
+    sim = other.sim;
+    balls = other.balls;
+    arena = other.arena;
+    sim.arena = other.sim.arena ? &arena : nullptr;
+    ai = other.ai;
+    playerAi = other.playerAi;
+    rules = other.rules;
+    net = other.net;
+
+    mode = other.mode;
+    seed = other.seed;
+    level = other.level;
+    playerLevel = other.playerLevel;
+    hz = other.hz;
+    ticks = other.ticks;
+    serveTicks = other.serveTicks;
+
+    prevBall = other.prevBall;
+    prevPlayer = other.prevPlayer;
+    prevCpu = other.prevCpu;
+    return *this;
+}
+
+void Match::start (GameMode mode, uint32_t seed, unsigned int level, unsigned int playerLevel) {
+    this->mode = mode;
+    this->seed = seed;
+    this->level = level < AI_LEVELS ? level : AI_NORMAL;
+    this->playerLevel = playerLevel < AI_LEVELS ? playerLevel : AI_NORMAL;
+
+    matchApplyRules(sim, rules);
+    balls.maxBounceAngle = rules.maxBounceAngle;
+
+    sim.rng.seed(seed);
+    sim.restart();
+    balls.clear();
+    arena.clear();
+    sim.arena = nullptr;
+    ai.reset(aiLevels[this->level], hz, seed);
+    ai.paddleSpeed = rules.paddleSpeed;
+    ai.net = this->level == AI_LEARNED ? net : nullptr;
+    playerAi.reset(aiLevels[this->playerLevel], hz, seed, true);
+    playerAi.paddleSpeed = rules.paddleSpeed;
+    playerAi.net = this->playerLevel == AI_LEARNED ? net : nullptr;
+
+    switch (mode) {
+        case GameMode::Multiball:
+            balls.spawn(sim.rng, MATCH_MULTIBALL_COUNT);
+            break;
+
+        case GameMode::Arena:
+            arena.spawn(sim.rng, MATCH_ARENA_OBSTACLES);
+            sim.arena = &arena;
+            break;
+
+        default:
+            break;
+    }
+
+    ticks = 0;
+    serveTicks = matchServeTicks(hz, false);
+
+    prevBall = sim.ball.p;
+    prevPlayer = sim.player.p;
+    prevCpu = sim.cpu.p;
+}
+
+void Match::movePaddles (TickInput const& input) {
+    if (mode == GameMode::Demo) {
+        sim.player.moveY(playerAi.update(sim));
+        sim.cpu.moveY(ai.update(sim));
+        return;
+    }
+
+    // Player moves with the left analog stick or Up / Down arrows
+    matchMovePaddle(sim.player, sim, rules, input.ly, input.buttons & MATCH_UP, input.buttons & MATCH_DOWN);
+
+    switch (mode) {
+        case GameMode::OnePlayer:
+            sim.cpu.moveY(ai.update(sim));
+            break;
+
+        case GameMode::TwoPlayers:
+        case GameMode::Multiball:
+        case GameMode::Arena:
+            // CPU (or Player 2) moves with the right analog stick or Triangle / Cross
+            matchMovePaddle(sim.cpu, sim, rules, input.ry, input.buttons & MATCH_TRIANGLE,
+                            input.buttons & MATCH_CROSS);
+            break;
+
+        default:
+            break;
+    }
+}
+
+unsigned int Match::tick (TickInput const& input) {
+    // Keep the previous state for render interpolation
+    prevBall = sim.ball.p;
+    prevPlayer = sim.player.p;
+    prevCpu = sim.cpu.p;
+    ++ticks;
+
+    if (matchServing(serveTicks)) {
+        return 0;
+    }
+
+    if (over()) {
+        return 0;
+    }
+
+    movePaddles(input);
+    unsigned int events = sim.step();
+
+    if (mode == GameMode::Multiball) {
+        balls.step(sim.player, sim.cpu, sim.dt);
+
+        if (balls.hitsPlayer) {
+            events |= SIM_HIT_PLAYER;
+        } else if (balls.hitsCpu) {
+            events |= SIM_HIT_CPU;
+        }
+
+        sim.player.score += balls.goalsPlayer;
+        sim.cpu.score += balls.goalsCpu;
+    }
+
+    if (events & SIM_SCORE) {
+        // The ball was served again: do not interpolate from the goal, and
+        // give the players a moment
+        prevBall = sim.ball.p;
+        serveTicks = matchServeTicks(hz, true);
+    }
+
+    return events;
+}
+
+// FNV-1a
+static uint32_t hash (uint32_t h, const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*) data;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+template <typename T>
+static uint32_t hash (uint32_t h, T const& value) {
+    return hash(h, &value, sizeof(value));
+}
+
+uint32_t Match::checksum () const {
+    uint32_t h = 2166136261u;
+
+    h = hash(h, ticks);
+    h = hash(h, serveTicks);
+    h = hash(h, sim.rng.state);
+    h = hash(h, sim.ball.p);
+    h = hash(h, sim.ball.v);
+    h = hash(h, sim.player.p);
+    h = hash(h, sim.player.score);
+    h = hash(h, sim.cpu.p);
+    h = hash(h, sim.cpu.score);
+    h = hash(h, ai.rng.state);
+    h = hash(h, ai.offset);
+
+    if (balls.size()) {
+        h = hash(h, &balls.x[0], balls.size() * sizeof(float));
+        h = hash(h, &balls.y[0], balls.size() * sizeof(float));
+        h = hash(h, &balls.vx[0], balls.size() * sizeof(float));
+        h = hash(h, &balls.vy[0], balls.size() * sizeof(float));
+    }
+
+    for (unsigned int i = 0; i < arena.obstacles.size(); ++i) {
+        h = hash(h, arena.obstacles[i].p);
+        h = hash(h, arena.obstacles[i].v);
+    }
+
+    return h;
+}
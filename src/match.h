@@ -0,0 +1,143 @@
+#ifndef _MATCH_H_
+#define _MATCH_H_
+
+#include <stdint.h>
+
+#include "simulation.h"
+#include "multiball.h"
+#include "arena.h"
+#include "ai.h"
+
+#define MATCH_MULTIBALL_COUNT (1024)
+#define MATCH_ARENA_OBSTACLES (200)
+#define MATCH_SERVE_START (3) // Seconds of countdown before the first serve
+#define MATCH_SERVE_POINT (1) // and after a point
+#define MATCH_DEADZONE (50)   // Stick values ignored around the centre
+
+enum class GameMode {
+    OnePlayer,
+    TwoPlayers,
+    Multiball,
+    Arena,
+    Demo, // CPU against CPU, not recorded
+};
+
+// Tunables of the game, the constants of simulation.h unless balancing
+struct MatchRules {
+    float paddleSpeed = PADDLE_SPEED;
+    float ballSpeed = BALL_SPEED;
+    float maxBounceAngle = M_PI / 6;
+};
+
+// The controller buttons a match reads, with the values of SCE_CTRL_*
+enum {
+    MATCH_UP       = 0x0010,
+    MATCH_DOWN     = 0x0040,
+    MATCH_TRIANGLE = 0x1000,
+    MATCH_CROSS    = 0x4000,
+};
+
+// What one simulation tick reads from the controller. Sticks are centred on
+// 0 and zeroed inside the dead zone: noise around the centre moves nothing,
+// so it does not have to be recorded either. The touch fields (front panel,
+// first report) are only filled when the touchscreens are on.
+struct TickInput {
+    static int8_t stick (int v) {
+        return v > MATCH_DEADZONE || v < -MATCH_DEADZONE ? int8_t(v) : 0;
+    }
+
+    bool operator== (TickInput const& o) const {
+        return buttons == o.buttons && lx == o.lx && ly == o.ly && rx == o.rx && ry == o.ry &&
+               touches == o.touches && tx == o.tx && ty == o.ty;
+    }
+
+    bool operator!= (TickInput const& o) const {
+        return ! (*this == o);
+    }
+
+    uint32_t buttons = 0;
+    int8_t lx = 0, ly = 0, rx = 0, ry = 0;
+    uint8_t touches = 0;
+    uint16_t tx = 0, ty = 0;
+};
+
+// The rules of a match that the dedicated server (src/host/server.h) plays
+// too, on its own plain data matches: both call these, so they cannot drift
+// apart.
+
+// The ball's rules, before Simulation::restart
+void matchApplyRules (Simulation& sim, MatchRules const& rules);
+
+// Moves a paddle with a stick value, zeroed inside the dead zone, and the
+// up and down buttons, at the rules' speed
+void matchMovePaddle (Paddle& paddle, Simulation const& sim, MatchRules const& rules, int stick, bool up,
+                      bool down);
+
+// Countdown to the first serve of a match, or to the serve after a point
+unsigned int matchServeTicks (unsigned int hz, bool point);
+
+// One tick of a serve countdown: true while it runs, and nothing moves
+bool matchServing (unsigned int& serveTicks);
+
+// One game from the serve to the final score, platform-free: the paddles
+// moved from the input, the simulation stepped, the balls and obstacles of
+// the mode, the countdowns to the serves. Everything follows from the seed
+// and the inputs, tick by tick, so a match can be recorded and played again
+// (see replay.h).
+struct Match {
+    Match () {
+    }
+
+    // The arena is the simulation's own, once copied
+    Match (Match const& other);
+    Match& operator= (Match const& other);
+
+    void setTickRate (unsigned int hz) {
+        this->hz = hz;
+        sim.setTickRate(hz);
+    }
+
+    // Serves the first ball of a new match, after the countdown. The level
+    // is the right CPU's, in One Player and Demo modes, playerLevel the left
+    // one's in Demo mode. AI_LEARNED plays with net, if it is set.
+    void start (GameMode mode, uint32_t seed, unsigned int level = AI_NORMAL,
+                unsigned int playerLevel = AI_NORMAL);
+
+    // One simulation tick with this input. Returns a mask of SIM_* events.
+    unsigned int tick (TickInput const& input);
+
+    // Counting down to a serve: nothing moves
+    bool serving () const {
+        return serveTicks > 0;
+    }
+
+    // Multiball is endless: it is left from the pause menu
+    bool over () const {
+        return sim.finished() && mode != GameMode::Multiball;
+    }
+
+    // Hash of the whole state, to tell two runs apart
+    uint32_t checksum () const;
+
+    Simulation sim;
+    MultiBall balls;
+    Arena arena;
+    CpuPlayer ai, playerAi;
+    MatchRules rules; // Applied by start()
+    NeuralNet const* net = nullptr; // Of AI_LEARNED, not owned
+
+    GameMode mode = GameMode::OnePlayer;
+    uint32_t seed = 1;
+    unsigned int level = AI_NORMAL, playerLevel = AI_NORMAL;
+    unsigned int hz = SIM_REFERENCE_HZ;
+    unsigned int ticks = 0;      // Since the start
+    unsigned int serveTicks = 0; // Left before the serve
+
+    // State before the last tick, for render interpolation
+    glm::vec2 prevBall, prevPlayer, prevCpu;
+
+private:
+    void movePaddles (TickInput const& input);
+};
+
+#endif
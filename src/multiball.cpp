@@ -0,0 +1,255 @@
+#include "multiball.h"
+
+// Four-wide lanes: NEON, SSE or plain scalar code
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+typedef float32x4_t f4;
+typedef uint32x4_t m4;
+
+static inline f4 load4 (float const* p) { return vld1q_f32(p); }
+static inline void store4 (float* p, f4 a) { vst1q_f32(p, a); }
+static inline f4 dup4 (float a) { return vdupq_n_f32(a); }
+static inline f4 add4 (f4 a, f4 b) { return vaddq_f32(a, b); }
+static inline f4 sub4 (f4 a, f4 b) { return vsubq_f32(a, b); }
+static inline f4 mul4 (f4 a, f4 b) { return vmulq_f32(a, b); }
+static inline f4 madd4 (f4 a, f4 b, f4 c) { return vmlaq_f32(a, b, c); } // a + b * c
+static inline f4 min4 (f4 a, f4 b) { return vminq_f32(a, b); }
+static inline f4 max4 (f4 a, f4 b) { return vmaxq_f32(a, b); }
+static inline f4 neg4 (f4 a) { return vnegq_f32(a); }
+static inline m4 lt4 (f4 a, f4 b) { return vcltq_f32(a, b); }
+static inline m4 gt4 (f4 a, f4 b) { return vcgtq_f32(a, b); }
+static inline m4 ge4 (f4 a, f4 b) { return vcgeq_f32(a, b); }
+static inline m4 le4 (f4 a, f4 b) { return vcleq_f32(a, b); }
+static inline m4 and4 (m4 a, m4 b) { return vandq_u32(a, b); }
+static inline m4 or4 (m4 a, m4 b) { return vorrq_u32(a, b); }
+static inline m4 andnot4 (m4 a, m4 b) { return vbicq_u32(b, a); } // ~a & b
+static inline f4 select4 (m4 m, f4 a, f4 b) { return vbslq_f32(m, a, b); }
+static inline bool any4 (m4 m) {
+    uint32x2_t o = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+    return (vget_lane_u32(o, 0) | vget_lane_u32(o, 1)) != 0;
+}
+static inline float sum4 (f4 a) {
+    float32x2_t s = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+    return vget_lane_f32(vpadd_f32(s, s), 0);
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+typedef __m128 f4;
+typedef __m128 m4;
+
+static inline f4 load4 (float const* p) { return _mm_loadu_ps(p); }
+static inline void store4 (float* p, f4 a) { _mm_storeu_ps(p, a); }
+static inline f4 dup4 (float a) { return _mm_set1_ps(a); }
+static inline f4 add4 (f4 a, f4 b) { return _mm_add_ps(a, b); }
+static inline f4 sub4 (f4 a, f4 b) { return _mm_sub_ps(a, b); }
+static inline f4 mul4 (f4 a, f4 b) { return _mm_mul_ps(a, b); }
+static inline f4 madd4 (f4 a, f4 b, f4 c) { return _mm_add_ps(a, _mm_mul_ps(b, c)); }
+static inline f4 min4 (f4 a, f4 b) { return _mm_min_ps(a, b); }
+static inline f4 max4 (f4 a, f4 b) { return _mm_max_ps(a, b); }
+static inline f4 neg4 (f4 a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+static inline m4 lt4 (f4 a, f4 b) { return _mm_cmplt_ps(a, b); }
+static inline m4 gt4 (f4 a, f4 b) { return _mm_cmpgt_ps(a, b); }
+static inline m4 ge4 (f4 a, f4 b) { return _mm_cmpge_ps(a, b); }
+static inline m4 le4 (f4 a, f4 b) { return _mm_cmple_ps(a, b); }
+static inline m4 and4 (m4 a, m4 b) { return _mm_and_ps(a, b); }
+static inline m4 or4 (m4 a, m4 b) { return _mm_or_ps(a, b); }
+static inline m4 andnot4 (m4 a, m4 b) { return _mm_andnot_ps(a, b); } // ~a & b
+static inline f4 select4 (m4 m, f4 a, f4 b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline bool any4 (m4 m) { return _mm_movemask_ps(m) != 0; }
+static inline float sum4 (f4 a) {
+    __m128 s = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+
+#else
+
+struct f4 {
+    float v[4];
+};
+typedef f4 m4;
+
+#define LANES(expr) f4 o; for (int i = 0; i < 4; ++i) { o.v[i] = (expr); } return o
+#define MASK(cond) ((cond) ? maskTrue() : 0.0f)
+
+static inline float maskTrue () {
+    union { uint32_t u; float f; } t;
+    t.u = 0xffffffffu;
+    return t.f;
+}
+
+static inline bool isSet (float m) {
+    union { float f; uint32_t u; } t;
+    t.f = m;
+    return t.u != 0;
+}
+
+static inline f4 load4 (float const* p) { LANES(p[i]); }
+static inline void store4 (float* p, f4 a) { for (int i = 0; i < 4; ++i) p[i] = a.v[i]; }
+static inline f4 dup4 (float a) { LANES(a); }
+static inline f4 add4 (f4 a, f4 b) { LANES(a.v[i] + b.v[i]); }
+static inline f4 sub4 (f4 a, f4 b) { LANES(a.v[i] - b.v[i]); }
+static inline f4 mul4 (f4 a, f4 b) { LANES(a.v[i] * b.v[i]); }
+static inline f4 madd4 (f4 a, f4 b, f4 c) { LANES(a.v[i] + b.v[i] * c.v[i]); }
+static inline f4 min4 (f4 a, f4 b) { LANES(minf(a.v[i], b.v[i])); }
+static inline f4 max4 (f4 a, f4 b) { LANES(maxf(a.v[i], b.v[i])); }
+static inline f4 neg4 (f4 a) { LANES(-a.v[i]); }
+static inline m4 lt4 (f4 a, f4 b) { LANES(MASK(a.v[i] < b.v[i])); }
+static inline m4 gt4 (f4 a, f4 b) { LANES(MASK(a.v[i] > b.v[i])); }
+static inline m4 ge4 (f4 a, f4 b) { LANES(MASK(a.v[i] >= b.v[i])); }
+static inline m4 le4 (f4 a, f4 b) { LANES(MASK(a.v[i] <= b.v[i])); }
+static inline m4 and4 (m4 a, m4 b) { LANES(MASK(isSet(a.v[i]) && isSet(b.v[i]))); }
+static inline m4 or4 (m4 a, m4 b) { LANES(MASK(isSet(a.v[i]) || isSet(b.v[i]))); }
+static inline m4 andnot4 (m4 a, m4 b) { LANES(MASK(! isSet(a.v[i]) && isSet(b.v[i]))); }
+static inline f4 select4 (m4 m, f4 a, f4 b) { LANES(isSet(m.v[i]) ? a.v[i] : b.v[i]); }
+static inline bool any4 (m4 m) {
+    return isSet(m.v[0]) || isSet(m.v[1]) || isSet(m.v[2]) || isSet(m.v[3]);
+}
+static inline float sum4 (f4 a) { return a.v[0] + a.v[1] + a.v[2] + a.v[3]; }
+
+#undef LANES
+#undef MASK
+
+#endif
+
+void MultiBall::clear () {
+    x.clear();
+    y.clear();
+    vx.clear();
+    vy.clear();
+    r.clear();
+    speed.clear();
+    count = 0;
+}
+
+void MultiBall::add (glm::vec2 const& p, glm::vec2 const& v, float radius) {
+    if (count == x.size()) {
+        // Grow by one lane of inert balls: still, at the centre, radius 0
+        unsigned int n = count + 4;
+        x.resize(n, SCREEN_W / 2);
+        y.resize(n, SCREEN_H / 2);
+        vx.resize(n, 0.0f);
+        vy.resize(n, 0.0f);
+        r.resize(n, 0.0f);
+        speed.resize(n, 0.0f);
+    }
+
+    x[count] = p.x;
+    y[count] = p.y;
+    vx[count] = v.x;
+    vy[count] = v.y;
+    r[count] = radius;
+    speed[count] = glm::length(v);
+    ++count;
+}
+
+void MultiBall::spawn (Rng& rng, unsigned int n) {
+    Ball ball;
+
+    for (unsigned int i = 0; i < n; ++i) {
+        ball.setRandomSpeed(rng);
+        add(glm::vec2(rng.uniform(SCREEN_W / 4, 3 * SCREEN_W / 4),
+                      rng.uniform(SCREEN_H / 4, 3 * SCREEN_H / 4)),
+            ball.speed(), rng.uniform(3.0f, 8.0f));
+    }
+}
+
+// Intersection<Circle, Rectangle> for four balls: the closest point of the
+// paddle is within reach of the centre
+static inline m4 touches (f4 cx, f4 cy, f4 rr, f4 left, f4 right, f4 top, f4 bottom) {
+    f4 dx = sub4(cx, max4(left, min4(cx, right))),
+       dy = sub4(cy, max4(top, min4(cy, bottom)));
+    return le4(add4(mul4(dx, dx), mul4(dy, dy)), rr);
+}
+
+void MultiBall::step (Paddle const& player, Paddle const& cpu, float dt) {
+    f4 fdt = dup4(dt),
+       zero = dup4(0.0f),
+       two = dup4(2.0f),
+       screenW = dup4(SCREEN_W),
+       screenH = dup4(SCREEN_H),
+       centreX = dup4(SCREEN_W / 2),
+       centreY = dup4(SCREEN_H / 2),
+       one = dup4(1.0f);
+    f4 plL = dup4(player.left()), plR = dup4(player.right()),
+       plT = dup4(player.top()),  plB = dup4(player.bottom()),
+       cpL = dup4(cpu.left()),    cpR = dup4(cpu.right()),
+       cpT = dup4(cpu.top()),     cpB = dup4(cpu.bottom());
+
+    // Event counters, one per lane
+    f4 nHitsPlayer = zero, nHitsCpu = zero,
+       nGoalsPlayer = zero, nGoalsCpu = zero;
+
+    unsigned int n = x.size();
+    for (unsigned int i = 0; i < n; i += 4) {
+        f4 px = load4(&x[i]), py = load4(&y[i]),
+           pvx = load4(&vx[i]), pvy = load4(&vy[i]),
+           pr = load4(&r[i]);
+
+        // Move
+        px = madd4(px, pvx, fdt);
+        py = madd4(py, pvy, fdt);
+
+        f4 d = mul4(pr, two),
+           right = add4(px, d),
+           bottom = add4(py, d);
+
+        // Walls
+        m4 top = lt4(py, zero),
+           low = gt4(bottom, screenH),
+           wall = or4(top, low);
+        py = select4(top, zero, py);
+        py = select4(low, sub4(screenH, d), py);
+        pvy = select4(wall, neg4(pvy), pvy);
+
+        // Goals: serve again from the centre, towards the scorer
+        m4 goalCpu = andnot4(wall, lt4(px, zero)),
+           goalPlayer = andnot4(wall, gt4(right, screenW)),
+           goal = or4(goalCpu, goalPlayer);
+
+        if (any4(goal)) {
+            px = select4(goal, centreX, px);
+            py = select4(goal, centreY, py);
+            pvx = select4(goal, neg4(pvx), pvx);
+            nGoalsCpu = add4(nGoalsCpu, select4(goalCpu, one, zero));
+            nGoalsPlayer = add4(nGoalsPlayer, select4(goalPlayer, one, zero));
+        }
+
+        // Paddles (discrete test, as in Ball::collide)
+        f4 cx = add4(px, pr),
+           cy = add4(py, pr),
+           rr = mul4(pr, pr);
+        m4 hitPlayer = touches(cx, cy, rr, plL, plR, plT, plB);
+        m4 hitCpu = andnot4(hitPlayer, touches(cx, cy, rr, cpL, cpR, cpT, cpB));
+
+        store4(&x[i], px);
+        store4(&y[i], py);
+        store4(&vx[i], pvx);
+        store4(&vy[i], pvy);
+
+        // Hits are rare: aimed one ball at a time, with Ball's own code
+        if (any4(or4(hitPlayer, hitCpu))) {
+            float lanesPlayer[4], lanesCpu[4];
+            store4(lanesPlayer, select4(hitPlayer, one, zero));
+            store4(lanesCpu, select4(hitCpu, one, zero));
+            nHitsPlayer = add4(nHitsPlayer, load4(lanesPlayer));
+            nHitsCpu = add4(nHitsCpu, load4(lanesCpu));
+
+            for (unsigned int j = i; j < i + 4; ++j) {
+                if (lanesPlayer[j - i] != 0.0f || lanesCpu[j - i] != 0.0f) {
+                    glm::vec2 v = aimSpeed(lanesPlayer[j - i] != 0.0f ? player : cpu,
+                                           y[j], r[j], speed[j], maxBounceAngle);
+                    vx[j] = v.x;
+                    vy[j] = v.y;
+                }
+            }
+        }
+    }
+
+    hitsPlayer = sum4(nHitsPlayer);
+    hitsCpu = sum4(nHitsCpu);
+    goalsPlayer = sum4(nGoalsPlayer);
+    goalsCpu = sum4(nGoalsCpu);
+}
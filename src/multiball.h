@@ -0,0 +1,45 @@
+#ifndef _MULTIBALL_H_
+#define _MULTIBALL_H_
+
+#include <vector>
+
+#include "simulation.h"
+
+// Many balls at once, stored as a structure of arrays so that they can be
+// moved and collided four at a time (NEON on the Vita, SSE on x86 hosts).
+//
+// Each ball moves as a Ball stepped with move() and the discrete collide()
+// test, to the bit (bench_multiball checks it): balls bounce off the walls,
+// are aimed by the paddles and are served again from the centre after a
+// goal. Unlike Simulation::step, nothing is swept: a ball moving more than
+// a paddle width in one step goes through it.
+struct MultiBall {
+    // Removes every ball
+    void clear ();
+
+    void add (glm::vec2 const& p, glm::vec2 const& v, float r);
+
+    // Adds n balls around the centre, in random directions
+    void spawn (Rng& rng, unsigned int n);
+
+    // Moves every ball by dt reference frames and collides it with the walls
+    // and the paddles. The per-step counters below are updated.
+    void step (Paddle const& player, Paddle const& cpu, float dt);
+
+    unsigned int size () const {
+        return count;
+    }
+
+    // Positions (top-left corner, see Circle), velocities, radii and speed
+    // norm, padded with inert balls to a multiple of 4
+    std::vector<float> x, y, vx, vy, r, speed;
+    unsigned int count = 0;
+
+    // Last step
+    unsigned int hitsPlayer = 0, hitsCpu = 0;
+    unsigned int goalsPlayer = 0, goalsCpu = 0;
+
+    float maxBounceAngle = M_PI / 6;
+};
+
+#endif
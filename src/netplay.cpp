@@ -0,0 +1,226 @@
+#include "netplay.h"
+
+static const uint8_t netMagic[2] = { 'V', 'N' };
+
+NetInput netInput (TickInput const& pad) {
+    NetInput in;
+    in.buttons = (pad.buttons & MATCH_UP ? NET_UP : 0) | (pad.buttons & MATCH_DOWN ? NET_DOWN : 0);
+    in.stick = pad.ly;
+    return in;
+}
+
+TickInput netTickInput (NetInput const& left, NetInput const& right) {
+    TickInput in;
+    in.buttons = (left.buttons & NET_UP ? MATCH_UP : 0) | (left.buttons & NET_DOWN ? MATCH_DOWN : 0) |
+                 (right.buttons & NET_UP ? MATCH_TRIANGLE : 0) | (right.buttons & NET_DOWN ? MATCH_CROSS : 0);
+    in.ly = left.stick;
+    in.ry = right.stick;
+    return in;
+}
+
+void RollbackSession::start (GameMode mode, uint32_t seed, unsigned int side, unsigned int delay,
+                             unsigned int hz) {
+    this->side = side ? 1 : 0;
+    this->delay = delay < NET_MAX_DELAY ? delay : NET_MAX_DELAY;
+
+    match.setTickRate(hz);
+    match.start(mode, seed);
+
+    // Nothing pressed for the first delay ticks, on both sides
+    for (unsigned int i = 0; i < NET_RING; ++i) {
+        inputs[0][i] = inputs[1][i] = predicted[i] = NetInput();
+    }
+    localTicks = this->delay;
+    remoteTicks = 0;
+    remoteAck = 0;
+    ticks = 0;
+    redo = 0;
+
+    checked = 0;
+    remoteChecked = 0;
+    compared = true;
+    stats = NetStats();
+}
+
+NetInput RollbackSession::remoteInput (unsigned int tick) const {
+    const NetInput* remote = inputs[1 - side];
+    if (tick < remoteTicks) {
+        return remote[tick % NET_RING];
+    }
+
+    // Held until heard otherwise
+    return remoteTicks ? remote[(remoteTicks - 1) % NET_RING] : NetInput();
+}
+
+TickInput RollbackSession::played (unsigned int tick) const {
+    return netTickInput(inputs[0][tick % NET_RING], inputs[1][tick % NET_RING]);
+}
+
+unsigned int RollbackSession::play () {
+    snapshots[ticks % (NET_MAX_ROLLBACK + 1)] = match;
+
+    NetInput remote = remoteInput(ticks);
+    predicted[ticks % NET_RING] = remote;
+
+    NetInput const& local = inputs[side][ticks % NET_RING];
+    ++ticks;
+    return match.tick(side ? netTickInput(remote, local) : netTickInput(local, remote));
+}
+
+// Packets, little endian:
+//
+//   "VN", count (uint8), 0
+//   first: tick of the first input (uint32)
+//   ack: remote inputs received without a gap (uint32)
+//   check: index of the latest checksum (uint32), and the checksum (uint32)
+//   count inputs: buttons (uint8), stick (int8)
+
+static void put32 (uint8_t* p, uint32_t v) {
+    p[0] = uint8_t(v);
+    p[1] = uint8_t(v >> 8);
+    p[2] = uint8_t(v >> 16);
+    p[3] = uint8_t(v >> 24);
+}
+
+static uint32_t get32 (const uint8_t* p) {
+    return p[0] | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+void RollbackSession::send (NetTransport& transport) {
+    uint8_t packet[NET_PACKET_MAX];
+    unsigned int count = localTicks - remoteAck;
+    if (count > 255) {
+        count = 255;
+    }
+
+    packet[0] = netMagic[0];
+    packet[1] = netMagic[1];
+    packet[2] = uint8_t(count);
+    packet[3] = 0;
+    put32(packet + 4, remoteAck);
+    put32(packet + 8, remoteTicks);
+    put32(packet + 12, checked);
+    put32(packet + 16, checked ? checks[checked % NET_CHECKS] : 0);
+
+    uint8_t* p = packet + 20;
+    for (unsigned int i = 0; i < count; ++i) {
+        NetInput const& in = inputs[side][(remoteAck + i) % NET_RING];
+        *p++ = in.buttons;
+        *p++ = uint8_t(in.stick);
+    }
+
+    transport.send(packet, p - packet);
+    ++stats.packetsSent;
+    stats.bytesSent += p - packet;
+}
+
+void RollbackSession::receive (const uint8_t* data, size_t size) {
+    if (size < 20 || data[0] != netMagic[0] || data[1] != netMagic[1] || size != 20 + 2u * data[2]) {
+        return;
+    }
+    ++stats.packetsReceived;
+
+    unsigned int count = data[2];
+    uint32_t first = get32(data + 4), ack = get32(data + 8), check = get32(data + 12);
+
+    // New inputs, in order only: a gap is filled by a later packet
+    NetInput* remote = inputs[1 - side];
+    for (unsigned int i = 0; i < count; ++i) {
+        uint32_t tick = first + i;
+        if (tick < remoteTicks) {
+            continue;
+        }
+        if (tick > remoteTicks || tick >= ticks + NET_RING / 2) {
+            break;
+        }
+
+        NetInput in;
+        in.buttons = data[20 + 2 * i];
+        in.stick = int8_t(data[21 + 2 * i]);
+        remote[tick % NET_RING] = in;
+        ++remoteTicks;
+
+        // Played with another input: the past is wrong from there on
+        if (tick < ticks && in != predicted[tick % NET_RING] && tick < redo) {
+            redo = tick;
+        }
+    }
+
+    if (ack > remoteAck && ack <= localTicks) {
+        remoteAck = ack;
+    }
+
+    if (check > remoteChecked) {
+        remoteChecked = check;
+        remoteCheck = get32(data + 16);
+        compared = false;
+    }
+}
+
+void RollbackSession::rollback () {
+    if (redo < ticks) {
+        unsigned int now = ticks;
+        unsigned int depth = now - redo;
+
+        match = snapshots[redo % (NET_MAX_ROLLBACK + 1)];
+        ticks = redo;
+        while (ticks < now) {
+            play();
+        }
+
+        ++stats.rollbacks;
+        stats.resimulated += depth;
+        stats.maxDepth = depth > stats.maxDepth ? depth : stats.maxDepth;
+    }
+    redo = ticks;
+}
+
+void RollbackSession::check () {
+    // Final states only, the present one or a snapshot
+    while ((checked + 1) * NET_CHECK_TICKS <= confirmed()) {
+        unsigned int tick = ++checked * NET_CHECK_TICKS;
+        Match const& m = tick == ticks ? match : snapshots[tick % (NET_MAX_ROLLBACK + 1)];
+        checks[checked % NET_CHECKS] = m.checksum();
+    }
+
+    // The other side's latest, once we have ours, if still kept
+    if (! compared && remoteChecked <= checked) {
+        compared = true;
+        if (remoteChecked + NET_CHECKS > checked) {
+            ++stats.checks;
+            stats.desyncs += checks[remoteChecked % NET_CHECKS] != remoteCheck;
+        }
+    }
+}
+
+void RollbackSession::poll (NetTransport& transport) {
+    uint8_t packet[NET_PACKET_MAX];
+    size_t size;
+    while ((size = transport.receive(packet, sizeof(packet))) > 0) {
+        receive(packet, size);
+    }
+
+    rollback();
+    check();
+}
+
+unsigned int RollbackSession::advance (TickInput const& local, NetTransport& transport) {
+    poll(transport);
+
+    // Too far ahead of the other side: the snapshots would not reach back,
+    // or the inputs it still needs be overwritten
+    if (ticks >= remoteTicks + NET_MAX_ROLLBACK || localTicks + 1 - remoteAck >= NET_RING) {
+        ++stats.stalls;
+        send(transport);
+        return 0;
+    }
+
+    inputs[side][localTicks++ % NET_RING] = netInput(local);
+    unsigned int events = play();
+    redo = ticks;
+    ++stats.ticks;
+
+    check();
+    send(transport);
+    return events;
+}
@@ -0,0 +1,142 @@
+#ifndef _NETPLAY_H_
+#define _NETPLAY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "match.h"
+
+#define NET_MAX_ROLLBACK (32) // Ticks played ahead of the remote input, at most
+#define NET_MAX_DELAY (15)    // Ticks of input delay, at most
+#define NET_RING (128)        // Inputs kept per side, power of two
+#define NET_CHECK_TICKS (30)  // Ticks between two checksums of a confirmed state
+#define NET_CHECKS (8)        // Our latest checksums kept, to compare
+#define NET_PACKET_MAX (20 + 2 * 255)
+
+// What one player sends for a tick: the d-pad and the left stick, whichever
+// side they play
+struct NetInput {
+    bool operator== (NetInput const& o) const {
+        return buttons == o.buttons && stick == o.stick;
+    }
+
+    bool operator!= (NetInput const& o) const {
+        return ! (*this == o);
+    }
+
+    uint8_t buttons = 0; // NET_UP, NET_DOWN
+    int8_t stick = 0;    // Left stick y, dead zone zeroed
+};
+
+enum {
+    NET_UP   = 1 << 0,
+    NET_DOWN = 1 << 1,
+};
+
+// The local controller's part of a tick
+NetInput netInput (TickInput const& pad);
+
+// The Two Players input of a tick: the left paddle's controls from left,
+// the right paddle's from right
+TickInput netTickInput (NetInput const& left, NetInput const& right);
+
+// Unreliable datagrams to the other player, e.g. UDP (src/host/udp.h)
+// Packets may be lost, duplicated or reordered.
+struct NetTransport {
+    virtual ~NetTransport () {
+    }
+
+    virtual void send (const uint8_t* data, size_t size) = 0;
+
+    // The next datagram received into data, and its size, or 0 if none
+    virtual size_t receive (uint8_t* data, size_t size) = 0;
+};
+
+struct NetStats {
+    uint64_t ticks = 0;
+    uint64_t rollbacks = 0;   // Mispredictions corrected
+    uint64_t resimulated = 0; // Ticks played again
+    uint64_t maxDepth = 0;    // Most ticks played again at once
+    uint64_t stalls = 0;      // Ticks waited for the remote input
+    uint64_t checks = 0, desyncs = 0;
+    uint64_t packetsSent = 0, packetsReceived = 0, bytesSent = 0;
+};
+
+// Rollback netcode for a Two Players match between two consoles. Both run
+// the whole match. Each tick, the local input goes out at once, to be
+// played delay ticks later on both sides; the remote input of a tick not
+// heard of yet is predicted, as the last one received. When the real one
+// arrives and differs, the match is put back to the snapshot before that
+// tick and played again to the present, within the same frame: the local
+// paddle answers without lag, the remote one with the network's.
+//
+// Every packet repeats the inputs the other side has not acknowledged, so
+// losses cost nothing but a later correction. A side more than
+// NET_MAX_ROLLBACK ticks ahead of the other's input waits for it. Both sides
+// send the checksum of the match at each NET_CHECK_TICKS tick once its
+// inputs are all known, which tells a desync.
+//
+// Platform-free: the transport is given, and the match seeded by the
+// caller, the same on both sides.
+struct RollbackSession {
+    // side 0 plays the left paddle, 1 the right one
+    void start (GameMode mode, uint32_t seed, unsigned int side, unsigned int delay, unsigned int hz);
+
+    // Reads the packets received, corrects the past if needed, then plays
+    // one tick with this local input and sends it. Returns the SIM_* events
+    // of the tick, or 0 without a tick when waiting for the other side.
+    unsigned int advance (TickInput const& local, NetTransport& transport);
+
+    // Reads the packets received and corrects the past, without playing
+    void poll (NetTransport& transport);
+
+    // Ticks whose inputs are all known: their state is final
+    unsigned int confirmed () const {
+        return remoteTicks < ticks ? remoteTicks : ticks;
+    }
+
+    Match match; // At tick ticks, remote inputs predicted past confirmed()
+    unsigned int side = 0, delay = 0;
+    unsigned int ticks = 0;
+    NetStats stats;
+
+    // The input of a tick, both sides', once confirmed: what a replay would
+    // record. Kept for the last NET_RING / 2 ticks.
+    TickInput played (unsigned int tick) const;
+
+    // Checksum of the confirmed state at tick index * NET_CHECK_TICKS, for
+    // the last NET_CHECKS indices up to checksums()
+    uint32_t checksum (unsigned int index) const {
+        return checks[index % NET_CHECKS];
+    }
+
+    unsigned int checksums () const {
+        return checked;
+    }
+
+private:
+    void receive (const uint8_t* data, size_t size);
+    void rollback ();
+    void check ();
+    void send (NetTransport& transport);
+    NetInput remoteInput (unsigned int tick) const;
+    unsigned int play ();
+
+    NetInput inputs[2][NET_RING];   // By tick, of the left and right paddles
+    NetInput predicted[NET_RING];   // The remote input each tick was played with
+    Match snapshots[NET_MAX_ROLLBACK + 1]; // Before each tick from confirmed() on
+    unsigned int localTicks = 0;    // Local inputs known: ticks + delay
+    unsigned int remoteTicks = 0;   // Remote inputs received, without a gap
+    unsigned int remoteAck = 0;     // Local inputs the other side has
+    unsigned int redo = 0;          // Earliest misprediction, ticks if none
+
+    // Checksums of the confirmed states at each NET_CHECK_TICKS tick: ours,
+    // by index, and the latest of the other side
+    uint32_t checks[NET_CHECKS];
+    unsigned int checked = 0;       // Our checks so far
+    unsigned int remoteChecked = 0; // Index of the remote one, 0 if none
+    uint32_t remoteCheck = 0;
+    bool compared = true;
+};
+
+#endif
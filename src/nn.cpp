@@ -0,0 +1,394 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "nn.h"
+#include "graphics_constants.h"
+
+// Int8 dot products, 16 lanes at a time. Weights and inputs stay within
+// [-127, 127], so two products fit an int16 lane before widening.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+static inline int32x4_t dot16 (int32x4_t s, int8x16_t w, int8x16_t x) {
+    int16x8_t p = vmull_s8(vget_low_s8(w), vget_low_s8(x));
+    p = vmlal_s8(p, vget_high_s8(w), vget_high_s8(x));
+    return vpadalq_s16(s, p);
+}
+
+static inline int32_t sum4 (int32x4_t s) {
+    int32x2_t t = vadd_s32(vget_low_s32(s), vget_high_s32(s));
+    return vget_lane_s32(vpadd_s32(t, t), 0);
+}
+
+void nnMatVec (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols) {
+    unsigned int i = 0;
+
+    // Four rows at once share the loads of x
+    for (; i + 4 <= rows; i += 4) {
+        const int8_t* w0 = w + i * cols;
+        int32x4_t s0 = vdupq_n_s32(0), s1 = s0, s2 = s0, s3 = s0;
+        for (unsigned int j = 0; j < cols; j += NN_LANES) {
+            int8x16_t xv = vld1q_s8(x + j);
+            s0 = dot16(s0, vld1q_s8(w0 + j), xv);
+            s1 = dot16(s1, vld1q_s8(w0 + cols + j), xv);
+            s2 = dot16(s2, vld1q_s8(w0 + 2 * cols + j), xv);
+            s3 = dot16(s3, vld1q_s8(w0 + 3 * cols + j), xv);
+        }
+        y[i] = sum4(s0);
+        y[i + 1] = sum4(s1);
+        y[i + 2] = sum4(s2);
+        y[i + 3] = sum4(s3);
+    }
+
+    for (; i < rows; ++i) {
+        int32x4_t s = vdupq_n_s32(0);
+        for (unsigned int j = 0; j < cols; j += NN_LANES) {
+            s = dot16(s, vld1q_s8(w + i * cols + j), vld1q_s8(x + j));
+        }
+        y[i] = sum4(s);
+    }
+}
+
+// Rounded half away from zero, then truncated, with saturating narrows
+static inline int32x4_t round4 (float32x4_t a, float32x4_t inverse) {
+    const float32x4_t top = vdupq_n_f32(127.0f);
+    float32x4_t q = vmaxq_f32(vminq_f32(vmulq_f32(a, inverse), top), vnegq_f32(top));
+    float32x4_t half = vbslq_f32(vcltq_f32(q, vdupq_n_f32(0.0f)), vdupq_n_f32(-0.5f), vdupq_n_f32(0.5f));
+    return vcvtq_s32_f32(vaddq_f32(q, half));
+}
+
+void nnQuantizeRow (const float* a, float inverse, int8_t* x, unsigned int n) {
+    float32x4_t v = vdupq_n_f32(inverse);
+    for (unsigned int j = 0; j < n; j += NN_LANES) {
+        int16x8_t lo = vcombine_s16(vqmovn_s32(round4(vld1q_f32(a + j), v)),
+                                    vqmovn_s32(round4(vld1q_f32(a + j + 4), v)));
+        int16x8_t hi = vcombine_s16(vqmovn_s32(round4(vld1q_f32(a + j + 8), v)),
+                                    vqmovn_s32(round4(vld1q_f32(a + j + 12), v)));
+        vst1q_s8(x + j, vcombine_s8(vqmovn_s16(lo), vqmovn_s16(hi)));
+    }
+}
+
+const char* nnKernelName () {
+    return "NEON";
+}
+
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+// Sign extension of the low and high bytes to int16: each byte paired with
+// itself, then shifted down
+static inline __m128i lo16 (__m128i v) {
+    return _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+}
+
+static inline __m128i hi16 (__m128i v) {
+    return _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+}
+
+static inline __m128i dot16 (__m128i s, const int8_t* w, __m128i xlo, __m128i xhi) {
+    __m128i wv = _mm_loadu_si128((const __m128i*) w);
+    s = _mm_add_epi32(s, _mm_madd_epi16(lo16(wv), xlo));
+    return _mm_add_epi32(s, _mm_madd_epi16(hi16(wv), xhi));
+}
+
+static inline int32_t sum4 (__m128i s) {
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+void nnMatVec (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols) {
+    unsigned int i = 0;
+
+    // Four rows at once share the loads of x, and their sums are transposed
+    // into one vector
+    for (; i + 4 <= rows; i += 4) {
+        const int8_t* w0 = w + i * cols;
+        __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+        for (unsigned int j = 0; j < cols; j += NN_LANES) {
+            __m128i xv = _mm_loadu_si128((const __m128i*) (x + j));
+            __m128i xlo = lo16(xv), xhi = hi16(xv);
+            s0 = dot16(s0, w0 + j, xlo, xhi);
+            s1 = dot16(s1, w0 + cols + j, xlo, xhi);
+            s2 = dot16(s2, w0 + 2 * cols + j, xlo, xhi);
+            s3 = dot16(s3, w0 + 3 * cols + j, xlo, xhi);
+        }
+        __m128i t0 = _mm_add_epi32(_mm_unpacklo_epi32(s0, s1), _mm_unpackhi_epi32(s0, s1));
+        __m128i t1 = _mm_add_epi32(_mm_unpacklo_epi32(s2, s3), _mm_unpackhi_epi32(s2, s3));
+        __m128i s = _mm_add_epi32(_mm_unpacklo_epi64(t0, t1), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((__m128i*) (y + i), s);
+    }
+
+    for (; i < rows; ++i) {
+        __m128i s = _mm_setzero_si128();
+        for (unsigned int j = 0; j < cols; j += NN_LANES) {
+            __m128i xv = _mm_loadu_si128((const __m128i*) (x + j));
+            s = dot16(s, w + i * cols + j, lo16(xv), hi16(xv));
+        }
+        y[i] = sum4(s);
+    }
+}
+
+static inline __m128i round4 (__m128 a, __m128 inverse) {
+    const __m128 top = _mm_set1_ps(127.0f);
+    __m128 q = _mm_max_ps(_mm_min_ps(_mm_mul_ps(a, inverse), top), _mm_set1_ps(-127.0f));
+    __m128 half = _mm_or_ps(_mm_and_ps(q, _mm_set1_ps(-0.0f)), _mm_set1_ps(0.5f));
+    return _mm_cvttps_epi32(_mm_add_ps(q, half));
+}
+
+void nnQuantizeRow (const float* a, float inverse, int8_t* x, unsigned int n) {
+    __m128 v = _mm_set1_ps(inverse);
+    for (unsigned int j = 0; j < n; j += NN_LANES) {
+        __m128i lo = _mm_packs_epi32(round4(_mm_loadu_ps(a + j), v), round4(_mm_loadu_ps(a + j + 4), v));
+        __m128i hi = _mm_packs_epi32(round4(_mm_loadu_ps(a + j + 8), v), round4(_mm_loadu_ps(a + j + 12), v));
+        _mm_storeu_si128((__m128i*) (x + j), _mm_packs_epi16(lo, hi));
+    }
+}
+
+const char* nnKernelName () {
+    return "SSE2";
+}
+
+#else
+
+void nnMatVec (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols) {
+    nnMatVecScalar(w, x, y, rows, cols);
+}
+
+void nnQuantizeRow (const float* a, float inverse, int8_t* x, unsigned int n) {
+    for (unsigned int j = 0; j < n; ++j) {
+        x[j] = nnQuantize(a[j], inverse);
+    }
+}
+
+const char* nnKernelName () {
+    return "scalar";
+}
+
+#endif
+
+void nnMatVecScalar (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols) {
+    for (unsigned int i = 0; i < rows; ++i) {
+        int32_t s = 0;
+        for (unsigned int j = 0; j < cols; ++j) {
+            s += int32_t(w[i * cols + j]) * x[j];
+        }
+        y[i] = s;
+    }
+}
+
+static inline float clamp1 (float v) {
+    return v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v);
+}
+
+void nnFeatures (glm::vec2 const& p, glm::vec2 const& v, float r, Paddle const& paddle, bool left,
+                 float offset, float* f) {
+    // Along x, positive towards the paddle
+    float face = left ? paddle.right() : paddle.left() - 2 * r;
+    float dx = left ? p.x - face : face - p.x;
+    float vx = left ? -v.x : v.x;
+    float ball = p.y + r, centre = paddle.y() + paddle.height() / 2;
+
+    f[0] = dx / SCREEN_W;
+    f[1] = clamp1(vx / (2 * BALL_SPEED));
+    f[2] = ball / SCREEN_H * 2 - 1;
+    f[3] = clamp1(v.y / (2 * BALL_SPEED));
+
+    // The walls fold this line back into the screen: left to the network
+    if (vx > 0.0f && dx > 0.0f) {
+        f[4] = clamp1((ball + v.y * dx / vx - SCREEN_H / 2) / (2 * SCREEN_H));
+        f[5] = 1.0f;
+    } else {
+        f[4] = 0.0f;
+        f[5] = -1.0f;
+    }
+
+    f[6] = centre / SCREEN_H * 2 - 1;
+    f[7] = (ball - centre) / SCREEN_H;
+    f[8] = clamp1(offset / PADDLE_H);
+}
+
+float NeuralNet::forward (const float* features) const {
+    float a[NN_MAX_WIDTH] = {};
+    int8_t x[NN_MAX_WIDTH];
+    int32_t s[NN_MAX_WIDTH];
+    memcpy(a, features, NN_FEATURES * sizeof(float));
+
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        NeuralLayer const& layer = layers[l];
+        nnQuantizeRow(a, 1.0f / layer.inScale, x, layer.inputs);
+        nnMatVec(&layer.weights[0], x, s, layer.outputs, layer.inputs);
+
+        bool last = l + 1 == layers.size();
+        for (unsigned int i = 0; i < layer.outputs; ++i) {
+            float y = s[i] * (layer.scales[i] * layer.inScale) + layer.biases[i];
+            a[i] = last || y > 0.0f ? y : 0.0f;
+        }
+
+        // The padding of the next layer's inputs
+        unsigned int next = last ? 0 : layers[l + 1].inputs;
+        for (unsigned int i = layer.outputs; i < next; ++i) {
+            a[i] = 0.0f;
+        }
+    }
+
+    return clamp1(a[0]);
+}
+
+float NeuralNet::forwardFloat (const float* features) const {
+    float a[NN_MAX_WIDTH] = {}, b[NN_MAX_WIDTH];
+    memcpy(a, features, NN_FEATURES * sizeof(float));
+
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        NeuralLayer const& layer = layers[l];
+        bool last = l + 1 == layers.size();
+
+        for (unsigned int i = 0; i < layer.outputs; ++i) {
+            float y = 0.0f;
+            for (unsigned int j = 0; j < layer.inputs; ++j) {
+                y += layer.weights[i * layer.inputs + j] * a[j];
+            }
+            y = y * layer.scales[i] + layer.biases[i];
+            b[i] = last || y > 0.0f ? y : 0.0f;
+        }
+
+        memcpy(a, b, layer.outputs * sizeof(float));
+        for (unsigned int i = layer.outputs; i < NN_MAX_WIDTH; ++i) {
+            a[i] = 0.0f;
+        }
+    }
+
+    return clamp1(a[0]);
+}
+
+// File
+
+struct NeuralNetHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t layers;
+    uint32_t features;
+};
+
+struct NeuralLayerHeader {
+    uint32_t inputs, outputs;
+    float inScale;
+};
+
+template <typename T>
+static void put (std::vector<uint8_t>& out, const T* data, size_t count) {
+    const uint8_t* p = (const uint8_t*) data;
+    out.insert(out.end(), p, p + count * sizeof(T));
+}
+
+template <typename T>
+static bool get (const uint8_t*& p, const uint8_t* end, T* data, size_t count) {
+    size_t size = count * sizeof(T);
+    if (size_t(end - p) < size) {
+        return false;
+    }
+    memcpy(data, p, size);
+    p += size;
+    return true;
+}
+
+void NeuralNet::write (std::vector<uint8_t>& out) const {
+    NeuralNetHeader h;
+    memcpy(h.magic, NN_MAGIC, sizeof(h.magic));
+    h.version = NN_VERSION;
+    h.layers = layers.size();
+    h.features = NN_FEATURES;
+    out.clear();
+    put(out, &h, 1);
+
+    for (unsigned int l = 0; l < layers.size(); ++l) {
+        NeuralLayer const& layer = layers[l];
+        NeuralLayerHeader lh = { layer.inputs, layer.outputs, layer.inScale };
+        put(out, &lh, 1);
+        put(out, &layer.scales[0], layer.outputs);
+        put(out, &layer.biases[0], layer.outputs);
+        put(out, &layer.weights[0], layer.weights.size());
+    }
+}
+
+bool NeuralNet::read (const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*) data;
+    const uint8_t* end = p + size;
+    layers.clear();
+
+    NeuralNetHeader h;
+    if (! get(p, end, &h, 1) || memcmp(h.magic, NN_MAGIC, sizeof(h.magic)) || h.version != NN_VERSION ||
+        h.features != NN_FEATURES || ! h.layers || h.layers > NN_MAX_LAYERS) {
+        return false;
+    }
+
+    // Each layer reads its padded inputs from the outputs of the one before
+    unsigned int width = NN_FEATURES;
+    std::vector<NeuralLayer> read(h.layers);
+    for (unsigned int l = 0; l < h.layers; ++l) {
+        NeuralLayer& layer = read[l];
+        NeuralLayerHeader lh;
+        if (! get(p, end, &lh, 1) || lh.inputs % NN_LANES || lh.inputs < width || lh.inputs > NN_MAX_WIDTH ||
+            ! lh.outputs || lh.outputs > NN_MAX_WIDTH || ! (lh.inScale > 0.0f)) {
+            return false;
+        }
+
+        layer.inputs = lh.inputs;
+        layer.outputs = lh.outputs;
+        layer.inScale = lh.inScale;
+        layer.scales.resize(layer.outputs);
+        layer.biases.resize(layer.outputs);
+        layer.weights.resize(layer.outputs * layer.inputs);
+        if (! get(p, end, &layer.scales[0], layer.outputs) || ! get(p, end, &layer.biases[0], layer.outputs) ||
+            ! get(p, end, &layer.weights[0], layer.weights.size())) {
+            return false;
+        }
+
+        // -128 would overflow the int16 pairs of the kernels
+        for (unsigned int i = 0; i < layer.weights.size(); ++i) {
+            if (layer.weights[i] == -128) {
+                return false;
+            }
+        }
+        width = layer.outputs;
+    }
+
+    if (width != 1 || p != end) {
+        return false;
+    }
+
+    layers.swap(read);
+    return true;
+}
+
+bool NeuralNet::save (const char* path) const {
+    std::vector<uint8_t> out;
+    write(out);
+
+    FILE* f = fopen(path, "wb");
+    if (! f) {
+        return false;
+    }
+
+    bool ok = fwrite(&out[0], 1, out.size(), f) == out.size();
+    return fclose(f) == 0 && ok;
+}
+
+bool NeuralNet::load (const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (! f) {
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    bool ok = ! ferror(f);
+    fclose(f);
+
+    return ok && ! data.empty() && read(&data[0], data.size());
+}
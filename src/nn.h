@@ -0,0 +1,85 @@
+#ifndef _NN_H_
+#define _NN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "simulation.h"
+
+// Small multilayer perceptron playing a paddle (see CpuPlayer), trained
+// offline from self-play (tools/pongtrain) and quantized to int8: each layer
+// holds int8 weights with one scale per row, its input is rounded to int8
+// steps of inScale, and the products are summed in int32 by a NEON, SSE2 or
+// scalar kernel. All three give the same sums, so a match played by the
+// network is as deterministic as any other. Platform-free.
+
+#define NN_MAGIC "VPNN"
+#define NN_VERSION 1
+#define NN_FEATURES 9    // Inputs of the network, see nnFeatures
+#define NN_LANES 16      // Inputs of a layer are padded to a multiple of this
+#define NN_MAX_WIDTH 64  // Widest layer
+#define NN_MAX_LAYERS 4
+
+// One fully connected layer, ReLU on every one but the last
+struct NeuralLayer {
+    unsigned int inputs = 0;  // Padded to NN_LANES, the padding weights are 0
+    unsigned int outputs = 0;
+    float inScale = 1.0f;     // Input value of one int8 step
+    std::vector<int8_t> weights; // outputs rows of inputs
+    std::vector<float> scales;   // Weight value of one int8 step, per row
+    std::vector<float> biases;
+};
+
+struct NeuralNet {
+    // The file format, little-endian: a header, then for each layer its
+    // inputs, outputs and inScale (uint32, uint32, float), the row scales,
+    // the biases and the int8 weights, row by row
+    bool read (const void* data, size_t size);
+    bool load (const char* path);
+    void write (std::vector<uint8_t>& out) const;
+    bool save (const char* path) const;
+
+    // Output of the last layer for NN_FEATURES features, clamped to [-1, 1]:
+    // the paddle speed, as a fraction of its top speed, down positive
+    float forward (const float* features) const;
+
+    // The same with float activations, for checking the quantization
+    float forwardFloat (const float* features) const;
+
+    bool empty () const {
+        return layers.empty();
+    }
+
+    std::vector<NeuralLayer> layers;
+};
+
+// The network's view of a paddle and a ball: distance to the paddle face,
+// speed towards it, ball height and vertical speed, where the ball would
+// cross the face without the walls, the paddle centre and its distance to
+// the ball, and how far off it should aim (AiSettings::error), all scaled
+// to about [-1, 1]. Mirrored for the left paddle, so one network plays
+// both sides.
+void nnFeatures (glm::vec2 const& p, glm::vec2 const& v, float r, Paddle const& paddle, bool left,
+                 float offset, float* features);
+
+// y[i] = sum of w[i * cols + j] * x[j], cols a multiple of NN_LANES: with
+// the SIMD of the target, and in plain C++
+void nnMatVec (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols);
+void nnMatVecScalar (const int8_t* w, const int8_t* x, int32_t* y, unsigned int rows, unsigned int cols);
+
+// x[j] = nnQuantize(a[j], inverse) for n values, n a multiple of NN_LANES
+void nnQuantizeRow (const float* a, float inverse, int8_t* x, unsigned int n);
+
+// "NEON", "SSE2" or "scalar"
+const char* nnKernelName ();
+
+// v / scale rounded to the nearest int8 step, within [-127, 127]; given
+// 1 / scale, as it runs for every input of every layer
+static inline int8_t nnQuantize (float v, float inverse) {
+    float q = v * inverse;
+    q = q > 127.0f ? 127.0f : (q < -127.0f ? -127.0f : q);
+    return int8_t(int(q + (q < 0.0f ? -0.5f : 0.5f)));
+}
+
+#endif
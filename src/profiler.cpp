@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "profiler.h"
+
+const char* const FrameProfiler::phaseNames[PHASES] = { "input", "update", "render", "wait", "swap" };
+
+void FrameProfiler::percentiles (unsigned int phase, const float* ps, uint32_t* out, unsigned int count) const {
+    uint32_t sorted[PROFILER_FRAMES];
+    unsigned int n = size();
+
+    for (unsigned int i = 0; i < n; ++i) {
+        sorted[i] = at(phase, i);
+    }
+    std::sort(sorted, sorted + n);
+
+    // Nearest rank
+    for (unsigned int k = 0; k < count; ++k) {
+        if (! n) {
+            out[k] = 0;
+            continue;
+        }
+
+        unsigned int rank = (unsigned int) (ps[k] / 100.0f * n + 0.999f);
+        rank = rank < 1 ? 1 : (rank > n ? n : rank);
+        out[k] = sorted[rank - 1];
+    }
+}
+
+bool FrameProfiler::writeCsv (FILE* f) const {
+    fprintf(f, "frame");
+    for (unsigned int p = 0; p < PHASES; ++p) {
+        fprintf(f, ",%s_us", phaseNames[p]);
+    }
+    fprintf(f, ",total_us\n");
+
+    unsigned int n = size();
+    for (unsigned int i = 0; i < n; ++i) {
+        fprintf(f, "%llu", (unsigned long long) (frames - n + i));
+        for (unsigned int p = 0; p <= PHASES; ++p) {
+            fprintf(f, ",%u", (unsigned int) at(p, i));
+        }
+        fprintf(f, "\n");
+    }
+
+    return ! ferror(f);
+}
+
+bool FrameProfiler::writeCsv (const char* path) const {
+    FILE* f = fopen(path, "w");
+    if (! f) {
+        return false;
+    }
+
+    bool ok = writeCsv(f);
+    return fclose(f) == 0 && ok;
+}
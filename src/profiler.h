@@ -0,0 +1,78 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <stdint.h>
+#include <cstdio>
+
+// Phases of a frame of Game::run, in order
+enum {
+    PHASE_INPUT,  // input.update
+    PHASE_UPDATE, // handleInput and the simulation ticks
+    PHASE_RENDER, // Drawing, from vita2d_start_drawing to vita2d_end_drawing
+    PHASE_WAIT,   // vita2d_wait_rendering_done
+    PHASE_SWAP,   // vita2d_swap_buffers (vblank wait included)
+    PHASES,
+};
+
+// Frames kept, power of two
+#define PROFILER_FRAMES 256
+
+// Per-phase timings of the last PROFILER_FRAMES frames, in a ring.
+// Platform-free: the caller passes the time (sceKernelGetProcessTimeWide
+// on the Vita) at the start of the frame and at the end of each phase.
+struct FrameProfiler {
+    static const char* const phaseNames[PHASES];
+
+    void beginFrame (uint64_t nowMicros) {
+        start = last = nowMicros;
+        for (unsigned int p = 0; p < PHASES; ++p) {
+            current[p] = 0;
+        }
+    }
+
+    // Ends a phase: the time since the previous mark goes to it
+    void mark (unsigned int phase, uint64_t nowMicros) {
+        current[phase] += uint32_t(nowMicros - last);
+        last = nowMicros;
+    }
+
+    // Records the frame; frames that are not ended (skipped) are not
+    void endFrame (uint64_t nowMicros) {
+        unsigned int i = frames & (PROFILER_FRAMES - 1);
+        for (unsigned int p = 0; p < PHASES; ++p) {
+            history[p][i] = current[p];
+        }
+        total[i] = uint32_t(nowMicros - start);
+        ++frames;
+    }
+
+    // Frames in the ring
+    unsigned int size () const {
+        return frames < PROFILER_FRAMES ? frames : PROFILER_FRAMES;
+    }
+
+    // Microseconds of the phase (PHASES for the whole frame) in the i-th
+    // frame of the ring, oldest first
+    uint32_t at (unsigned int phase, unsigned int i) const {
+        unsigned int j = (frames - size() + i) & (PROFILER_FRAMES - 1);
+        return phase == PHASES ? total[j] : history[phase][j];
+    }
+
+    // Percentiles (0 to 100) of the phase (PHASES for the whole frame) over
+    // the ring
+    void percentiles (unsigned int phase, const float* ps, uint32_t* out, unsigned int count) const;
+
+    // Writes the ring as CSV, oldest frame first. Returns false on error.
+    bool writeCsv (FILE* f) const;
+    bool writeCsv (const char* path) const;
+
+    uint64_t frames = 0;
+
+private:
+    uint64_t start = 0, last = 0;
+    uint32_t current[PHASES];
+    uint32_t history[PHASES][PROFILER_FRAMES];
+    uint32_t total[PROFILER_FRAMES];
+};
+
+#endif
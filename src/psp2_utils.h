@@ -3,9 +3,5 @@
 
 #include <psp2/kernel/processmgr.h>
 
-static inline void sleep (float sec) {
-    sceKernelDelayThread(sec * 1000 * 1000);
-}
-
 #endif
 
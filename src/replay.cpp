@@ -0,0 +1,310 @@
+#include <cstring>
+
+#include "replay.h"
+
+static const char replayMagic[4] = { 'V', 'P', 'R', 'P' };
+
+bool Replay::write (FILE* f) const {
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    if (ok && ! stream.empty()) {
+        ok = fwrite(&stream[0], 1, stream.size(), f) == stream.size();
+    }
+    if (ok && ! keyframes.empty()) {
+        ok = fwrite(&keyframes[0], sizeof(ReplayKeyframe), keyframes.size(), f) == keyframes.size();
+    }
+    return ok && ! ferror(f);
+}
+
+bool Replay::save (const char* path) const {
+    FILE* f = fopen(path, "wb");
+    if (! f) {
+        return false;
+    }
+
+    bool ok = write(f);
+    return fclose(f) == 0 && ok;
+}
+
+bool Replay::read (FILE* f) {
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, replayMagic, sizeof(replayMagic)) ||
+        header.version != REPLAY_VERSION || ! header.tickHz || ! header.keyframeTicks ||
+        header.mode > uint32_t(GameMode::Arena) || header.level >= AI_LEVELS ||
+        header.keyframes != (header.ticks + header.keyframeTicks - 1) / header.keyframeTicks) {
+        return false;
+    }
+
+    stream.resize(header.streamBytes);
+    keyframes.resize(header.keyframes);
+
+    if (! stream.empty() && fread(&stream[0], 1, stream.size(), f) != stream.size()) {
+        return false;
+    }
+    if (! keyframes.empty() &&
+        fread(&keyframes[0], sizeof(ReplayKeyframe), keyframes.size(), f) != keyframes.size()) {
+        return false;
+    }
+
+    for (unsigned int k = 0; k < keyframes.size(); ++k) {
+        if (keyframes[k].tick != k * header.keyframeTicks || keyframes[k].offset > stream.size()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Replay::load (const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (! f) {
+        return false;
+    }
+
+    bool ok = read(f);
+    fclose(f);
+    return ok;
+}
+
+// Recorder
+
+static void putVarint (std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+
+void ReplayRecorder::begin (Match const& match, unsigned int flags) {
+    ReplayHeader& h = replay.header;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, replayMagic, sizeof(replayMagic));
+    h.version = REPLAY_VERSION;
+    h.flags = flags;
+    h.tickHz = match.hz;
+    h.seed = match.seed;
+    h.mode = uint32_t(match.mode);
+    h.level = match.level;
+    h.keyframeTicks = REPLAY_KEYFRAME_SECONDS * match.hz;
+
+    replay.stream.clear();
+    replay.keyframes.clear();
+    last = TickInput();
+    run = 0;
+    active = true;
+}
+
+void ReplayRecorder::record (TickInput const& input, Match const& match) {
+    if (! active) {
+        return;
+    }
+
+    ReplayHeader& h = replay.header;
+    if (h.ticks % h.keyframeTicks == 0) {
+        flush();
+        ReplayKeyframe k = { h.ticks, uint32_t(replay.stream.size()), match.checksum() };
+        replay.keyframes.push_back(k);
+        last = TickInput();
+    }
+    ++h.ticks;
+
+    TickInput in = input;
+    if (! (h.flags & REPLAY_TOUCH) || ! in.touches) {
+        in.touches = 0;
+        in.tx = in.ty = 0;
+    }
+
+    if (in == last) {
+        if (++run == 0x80) {
+            flush();
+        }
+        return;
+    }
+
+    flush();
+
+    uint8_t mask = (in.buttons != last.buttons) |
+                   (in.lx != last.lx) << 1 | (in.ly != last.ly) << 2 |
+                   (in.rx != last.rx) << 3 | (in.ry != last.ry) << 4 |
+                   (in.touches != last.touches || in.tx != last.tx || in.ty != last.ty) << 5;
+
+    std::vector<uint8_t>& out = replay.stream;
+    out.push_back(0x80 | mask);
+    if (mask & 1) {
+        putVarint(out, in.buttons ^ last.buttons);
+    }
+    if (mask & 2) out.push_back(uint8_t(in.lx));
+    if (mask & 4) out.push_back(uint8_t(in.ly));
+    if (mask & 8) out.push_back(uint8_t(in.rx));
+    if (mask & 16) out.push_back(uint8_t(in.ry));
+    if (mask & 32) {
+        out.push_back(in.touches);
+        if (in.touches) {
+            putVarint(out, in.tx);
+            putVarint(out, in.ty);
+        }
+    }
+
+    last = in;
+}
+
+void ReplayRecorder::flush () {
+    if (run) {
+        replay.stream.push_back(uint8_t(run - 1));
+        run = 0;
+    }
+}
+
+void ReplayRecorder::finish (Match const& match) {
+    if (! active) {
+        return;
+    }
+
+    flush();
+    replay.header.streamBytes = replay.stream.size();
+    replay.header.keyframes = replay.keyframes.size();
+    replay.header.checksum = match.checksum();
+    active = false;
+}
+
+// Decoder
+
+void ReplayDecoder::seek (Replay const* replay, unsigned int keyframe) {
+    this->replay = replay;
+    if (keyframe < replay->keyframes.size()) {
+        offset = replay->keyframes[keyframe].offset;
+        tick = replay->keyframes[keyframe].tick;
+    } else {
+        offset = 0;
+        tick = 0;
+    }
+    last = TickInput();
+    run = 0;
+}
+
+unsigned int ReplayDecoder::varint () {
+    const std::vector<uint8_t>& in = replay->stream;
+    unsigned int v = 0;
+    for (unsigned int shift = 0; offset < in.size() && shift < 32; shift += 7) {
+        uint8_t b = in[offset++];
+        v |= uint32_t(b & 0x7F) << shift;
+        if (! (b & 0x80)) {
+            break;
+        }
+    }
+    return v;
+}
+
+TickInput ReplayDecoder::next () {
+    const std::vector<uint8_t>& in = replay->stream;
+
+    // The coding starts over at each keyframe
+    if (tick % replay->header.keyframeTicks == 0) {
+        last = TickInput();
+        run = 0;
+    }
+    ++tick;
+
+    if (run) {
+        --run;
+        return last;
+    }
+
+    if (offset >= in.size()) {
+        return last;
+    }
+
+    uint8_t op = in[offset++];
+    if (! (op & 0x80)) {
+        run = op;
+        return last;
+    }
+
+    if (op & 1) {
+        last.buttons ^= varint();
+    }
+    if (op & 2 && offset < in.size()) last.lx = int8_t(in[offset++]);
+    if (op & 4 && offset < in.size()) last.ly = int8_t(in[offset++]);
+    if (op & 8 && offset < in.size()) last.rx = int8_t(in[offset++]);
+    if (op & 16 && offset < in.size()) last.ry = int8_t(in[offset++]);
+    if (op & 32 && offset < in.size()) {
+        last.touches = in[offset++];
+        last.tx = last.touches ? varint() : 0;
+        last.ty = last.touches ? varint() : 0;
+    }
+
+    return last;
+}
+
+// Player
+
+bool ReplayPlayer::open (Replay const* replay) {
+    if (! replay->header.tickHz || ! replay->header.keyframeTicks) {
+        return false;
+    }
+    this->replay = replay;
+
+    match.setTickRate(replay->header.tickHz);
+    match.start(GameMode(replay->header.mode), replay->header.seed, replay->header.level);
+    decoder.seek(replay, 0);
+
+    snapshots.clear();
+    desyncs = 0;
+    ticksPlayed = 0;
+    ended = false;
+
+    verify();
+    return true;
+}
+
+void ReplayPlayer::verify () {
+    unsigned int k = match.ticks / replay->header.keyframeTicks;
+
+    // Each keyframe is checked once, the first time through
+    if (match.ticks % replay->header.keyframeTicks == 0 && k == snapshots.size() &&
+        (k < replay->keyframes.size() || ! k)) {
+        if (k < replay->keyframes.size() && match.checksum() != replay->keyframes[k].checksum) {
+            ++desyncs;
+        }
+        snapshots.push_back(match);
+    }
+
+    if (finished() && ! ended) {
+        if (match.checksum() != replay->header.checksum) {
+            ++desyncs;
+        }
+        ended = true;
+    }
+}
+
+unsigned int ReplayPlayer::step (unsigned int n) {
+    unsigned int events = 0;
+
+    for (unsigned int i = 0; i < n && ! finished(); ++i) {
+        events |= match.tick(decoder.next());
+        ++ticksPlayed;
+        verify();
+    }
+
+    return events;
+}
+
+void ReplayPlayer::seek (unsigned int tick) {
+    if (tick > replay->header.ticks) {
+        tick = replay->header.ticks;
+    }
+
+    // From the last keyframe before the tick, unless the match is already
+    // between it and the tick
+    unsigned int k = tick / replay->header.keyframeTicks;
+    if (k >= snapshots.size()) {
+        k = snapshots.size() - 1;
+    }
+
+    if (match.ticks > tick || snapshots[k].ticks > match.ticks) {
+        match = snapshots[k];
+        decoder.seek(replay, k);
+    }
+
+    step(tick - match.ticks);
+}
@@ -0,0 +1,146 @@
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+
+#include "match.h"
+
+#define REPLAY_VERSION (2)
+#define REPLAY_KEYFRAME_SECONDS (10)
+
+// Header flags
+enum {
+    REPLAY_TOUCH = 1 << 0, // The touch fields of the inputs are recorded
+};
+
+// A recorded match: the seed, then the input of every tick, delta and run
+// length coded. Each operation of the stream is one byte, then its fields:
+//
+//   0nnnnnnn  the previous input again, for n + 1 ticks
+//   1fffffff  a new input, for one tick, followed by the fields that changed
+//             in the mask f, in this order: buttons (bit 0, LEB128 of the
+//             XOR with the previous ones), lx, ly, rx, ry (bits 1 to 4, one
+//             byte each) and touch (bit 5: the count, then x and y in
+//             LEB128 if there is one)
+//
+// Held buttons and centred sticks cost a byte per 128 ticks, a press or a
+// release two or three bytes. Every keyframeTicks ticks the coding starts
+// over from an empty input, and the table at the end of the file gives
+// where in the stream, with a checksum of the match at that tick: playback
+// can start at any keyframe, and a desync shows within keyframeTicks.
+//
+// File layout (little endian): ReplayHeader, the stream, the keyframes.
+struct ReplayHeader {
+    char magic[4]; // "VPRP"
+    uint16_t version;
+    uint16_t flags;
+    uint32_t tickHz;
+    uint32_t seed;
+    uint32_t mode; // GameMode
+    uint32_t level; // Of the CPU, see Match::start
+    uint32_t ticks;
+    uint32_t keyframeTicks;
+    uint32_t keyframes;
+    uint32_t streamBytes;
+    uint32_t checksum; // Of the match after the last tick
+};
+
+struct ReplayKeyframe {
+    uint32_t tick; // Multiple of keyframeTicks
+    uint32_t offset; // In the stream
+    uint32_t checksum; // Of the match before the tick
+};
+
+struct Replay {
+    bool write (FILE* f) const;
+    bool save (const char* path) const;
+
+    bool read (FILE* f);
+    bool load (const char* path);
+
+    // Stream and table size
+    size_t bytes () const {
+        return sizeof(header) + stream.size() + keyframes.size() * sizeof(ReplayKeyframe);
+    }
+
+    ReplayHeader header = {};
+    std::vector<uint8_t> stream;
+    std::vector<ReplayKeyframe> keyframes;
+};
+
+// Records a match as it is played: begin() once started, record() before
+// each of its ticks, finish() once over.
+struct ReplayRecorder {
+    void begin (Match const& match, unsigned int flags = 0);
+
+    void record (TickInput const& input, Match const& match);
+
+    void finish (Match const& match);
+
+    bool recording () const {
+        return active;
+    }
+
+    Replay replay;
+
+private:
+    void flush ();
+
+    bool active = false;
+    TickInput last;
+    unsigned int run = 0; // Ticks of last not written yet
+};
+
+// Reads the inputs back, one tick at a time
+struct ReplayDecoder {
+    // Positions at a keyframe
+    void seek (Replay const* replay, unsigned int keyframe);
+
+    // Input of the next tick, the last one again past the end
+    TickInput next ();
+
+    Replay const* replay = nullptr;
+    size_t offset = 0;
+    unsigned int tick = 0;
+
+private:
+    unsigned int varint ();
+
+    TickInput last;
+    unsigned int run = 0; // Ticks of last still to return
+};
+
+// Plays a recording through Match::tick, as fast as asked: fast-forward is
+// stepping more ticks per frame. The match is kept at each keyframe it goes
+// through, so that seeking back only replays from the keyframe before.
+struct ReplayPlayer {
+    bool open (Replay const* replay);
+
+    // Up to n ticks, fewer at the end. Returns the SIM_* events.
+    unsigned int step (unsigned int n);
+
+    // Stops at the given tick, from the nearest known state before it
+    void seek (unsigned int tick);
+
+    bool finished () const {
+        return match.ticks >= replay->header.ticks;
+    }
+
+    Replay const* replay = nullptr;
+    Match match;
+    ReplayDecoder decoder;
+    std::vector<Match> snapshots; // At the keyframes played so far
+
+    // Keyframes, and the end, whose checksum differed from the recording
+    unsigned int desyncs = 0;
+    unsigned int ticksPlayed = 0;
+
+private:
+    void verify ();
+
+    bool ended = false;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stdint.h>
+
+// Small xorshift32 generator: unlike rand(), every simulation owns its state,
+// so runs are reproducible from a seed and can be played in parallel.
+struct Rng {
+    Rng (uint32_t s = 1) {
+        seed(s);
+    }
+
+    void seed (uint32_t s) {
+        state = s ? s : 0x9E3779B9u;
+    }
+
+    uint32_t next () {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // Uniform float in [a, b]
+    float uniform (float a, float b) {
+        float r = (next() >> 8) * (1.0f / 16777215.0f);
+        return a + (b - a) * r;
+    }
+
+    // Uniform integer in [a, b]
+    int range (int a, int b) {
+        return a + int(next() % uint32_t(b - a + 1));
+    }
+
+    uint32_t state;
+};
+
+#endif
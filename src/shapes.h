@@ -0,0 +1,239 @@
+#ifndef _SHAPES_H_
+#define _SHAPES_H_
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+// Platform-free geometry: rendering lives in graphics.h
+//
+// Statically dispatched (CRTP): Shape provides left(), right(), top() and
+// bottom(), there are no virtual calls and no vtable pointer per object.
+
+template <typename A, typename B>
+struct Intersection;
+
+struct Batch;
+
+// Unlike fminf/fmaxf, which must handle NaNs, these compile to single
+// min/max instructions instead of library calls
+static inline float minf (float a, float b) {
+    return a < b ? a : b;
+}
+
+static inline float maxf (float a, float b) {
+    return a > b ? a : b;
+}
+
+template <typename Shape>
+struct Sprite {
+    Sprite (float x0 = 0.0f, float y0 = 0.0f) : p(x0, y0) {
+    }
+
+    Sprite (glm::vec2 const& p) : p(p) {
+    }
+
+    void init (float x0, float y0) {
+        p.x = x0;
+        p.y = y0;
+    }
+
+    void init (glm::vec2 const& p) {
+        this->p = p;
+    }
+
+    void move (float dx, float dy) {
+        p.x += dx;
+        p.y += dy;
+    }
+
+    void move (glm::vec2 const& dp) {
+        p += dp;
+    }
+
+    void moveX (float dx) {
+        move(dx, 0.0f);
+    }
+
+    void moveY (float dy) {
+        move(0.0f, dy);
+    }
+
+    float x () const {
+        return p.x;
+    }
+
+    float y () const {
+        return p.y;
+    }
+
+    float& x () {
+        return p.x;
+    }
+
+    float& y () {
+        return p.y;
+    }
+
+    Shape const& shape () const {
+        return static_cast<Shape const&>(*this);
+    }
+
+    // Exact test for each pair of shapes, see Intersection below
+    template <typename Other>
+    bool intersects (Sprite<Other> const& other) const {
+        return Intersection<Shape, Other>::test(shape(), other.shape());
+    }
+
+    glm::vec2 p;
+};
+
+// Bounding boxes overlap (no short-circuit: cheaper than mispredicted branches)
+template <typename A, typename B>
+inline bool overlaps (A const& a, B const& b) {
+    return (a.right()  >= b.left()) & (a.left() <= b.right()) &
+           (a.bottom() >= b.top())  & (a.top()  <= b.bottom());
+}
+
+struct Rectangle : Sprite<Rectangle> {
+    Rectangle (float x0 = 0.0f, float y0 = 0.0f, float w = 0.0f, float h = 0.0f) : Sprite(x0, y0), dims(w, h) {
+    }
+
+    Rectangle (glm::vec2 const& p0, float w, float h) : Rectangle(p0.x, p0.y, w, h) {
+    }
+
+    Rectangle (glm::vec2 const& p0, glm::vec2 const& dims0) : Rectangle(p0, dims0.x, dims0.y) {
+    }
+
+    void init (float x0, float y0, float w, float h) {
+        p.x = x0;
+        p.y = y0;
+        dims.x = w;
+        dims.y = h;
+    }
+
+    void init (glm::vec2 const& p0, float w, float h) {
+        init(p0.x, p0.y, w, h);
+    }
+
+    void init (glm::vec2 const& p0, glm::vec2 const& dims0) {
+        init(p0, dims0.x, dims0.y);
+    }
+
+    // Defined in graphics.h
+    void render (uint32_t colour) const;
+    void render (Batch& batch, uint32_t colour) const;
+
+    float width () const {
+        return dims.x;
+    }
+
+    float height () const {
+        return dims.y;
+    }
+
+    float left () const {
+        return x();
+    }
+
+    float right () const {
+        return x() + width();
+    }
+
+    float top () const {
+        return y();
+    }
+
+    float bottom () const {
+        return y() + height();
+    }
+
+
+    glm::vec2 dims;
+};
+
+struct Circle : Sprite<Circle> {
+    Circle (float x0 = 0.0f, float y0 = 0.0f, float r = 0.0f) : Sprite(x0, y0), r(r) {
+    }
+
+    Circle (glm::vec2 const& p0, float r) : Circle(p0.x, p0.y, r) {
+    }
+
+    void init (float x0, float y0, float r) {
+        p.x = x0;
+        p.y = y0;
+        this->r = r;
+    }
+
+    void init (glm::vec2 const& p0, float r) {
+        init(p0.x, p0.y, r);
+    }
+
+    // Defined in graphics.h
+    void render (uint32_t colour) const;
+    void render (Batch& batch, uint32_t colour) const;
+
+    float radius () const {
+        return r;
+    }
+
+    float left () const {
+        return x();
+    }
+
+    float right () const {
+        return x() + 2 * radius();
+    }
+
+    float top () const {
+        return y();
+    }
+
+    float bottom () const {
+        return y() + 2 * radius();
+    }
+
+    float r;
+};
+
+// Rectangle - rectangle: boxes overlap
+template <>
+struct Intersection<Rectangle, Rectangle> {
+    static bool test (Rectangle const& a, Rectangle const& b) {
+        return overlaps(a, b);
+    }
+};
+
+// Circle - rectangle: the closest point of the rectangle is within reach
+template <>
+struct Intersection<Circle, Rectangle> {
+    static bool test (Circle const& c, Rectangle const& rect) {
+        float r = c.radius(),
+              cx = c.x() + r,
+              cy = c.y() + r,
+              qx = maxf(rect.left(), minf(cx, rect.right())),
+              qy = maxf(rect.top(),  minf(cy, rect.bottom())),
+              dx = cx - qx,
+              dy = cy - qy;
+        return dx * dx + dy * dy <= r * r;
+    }
+};
+
+template <>
+struct Intersection<Rectangle, Circle> {
+    static bool test (Rectangle const& rect, Circle const& c) {
+        return Intersection<Circle, Rectangle>::test(c, rect);
+    }
+};
+
+// Circle - circle: centres closer than the sum of the radii
+template <>
+struct Intersection<Circle, Circle> {
+    static bool test (Circle const& a, Circle const& b) {
+        float dx = (a.x() + a.radius()) - (b.x() + b.radius()),
+              dy = (a.y() + a.radius()) - (b.y() + b.radius()),
+              rr = a.radius() + b.radius();
+        return dx * dx + dy * dy <= rr * rr;
+    }
+};
+
+#endif
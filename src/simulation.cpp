@@ -0,0 +1,111 @@
+#include "simulation.h"
+#include "collision.h"
+#include "arena.h"
+
+static void clampToScreen (Paddle& paddle) {
+    if (paddle.y() < 0.0f) {
+        paddle.y() = 0.0f;
+    } else if (paddle.y() + paddle.height() > SCREEN_H) {
+        paddle.y() = SCREEN_H - paddle.height();
+    }
+}
+
+void Simulation::restart () {
+    // Ball
+    ball.init(glm::vec2(SCREEN_W / 2, SCREEN_H / 2),
+              BALL_R, rng);
+
+    // Paddles
+    player.init(glm::vec2(10, SCREEN_H / 2 - PADDLE_H / 2),
+                glm::vec2(PADDLE_W, PADDLE_H));
+    player.player = true;
+    player.clear();
+
+    cpu.init(glm::vec2(SCREEN_W - 10 - PADDLE_W, SCREEN_H / 2 - PADDLE_H / 2),
+             glm::vec2(PADDLE_W, PADDLE_H));
+    cpu.player = false;
+    cpu.clear();
+}
+
+unsigned int Simulation::step () {
+    unsigned int events = 0;
+
+    // Paddles with screen boundaries
+    clampToScreen(player);
+    clampToScreen(cpu);
+
+    if (arena) {
+        arena->step(dt, ball);
+    }
+
+    // Move the ball, stopping at each contact to bounce off it
+    float remaining = 1.0f;
+    for (int i = 0; i < SIM_MAX_BOUNCES && remaining > 0.0f; ++i) {
+        glm::vec2 d = ball.v * (dt * remaining);
+        Contact contact, first;
+        glm::vec2 moved;
+        Paddle const* paddle = nullptr;
+        bool hit = false, obstacle = false;
+
+        // Screen boundaries
+        if (sweepWalls(ball, d, 0.0f, SCREEN_H, contact)) {
+            first = contact;
+            hit = true;
+        }
+
+        // Paddles
+        if (sweep(ball, d, player, contact) && (! hit || contact.t < first.t)) {
+            first = contact;
+            paddle = &player;
+            hit = true;
+        }
+
+        if (sweep(ball, d, cpu, contact) && (! hit || contact.t < first.t)) {
+            first = contact;
+            paddle = &cpu;
+            hit = true;
+        }
+
+        // Obstacles
+        if (arena && arena->sweep(ball, d, remaining, contact, moved) && (! hit || contact.t < first.t)) {
+            first = contact;
+            paddle = nullptr;
+            obstacle = true;
+            hit = true;
+        }
+
+        if (! hit) {
+            ball.move(d);
+            break;
+        }
+
+        ball.move(d * first.t);
+        remaining *= 1.0f - first.t;
+
+        if (paddle) {
+            ball.bounce(*paddle, first.normal);
+            events |= paddle->player ? SIM_HIT_PLAYER : SIM_HIT_CPU;
+        } else if (obstacle) {
+            // Off the obstacle as it moves, so that the ball leaves it
+            glm::vec2 relative = ball.speed() - moved / dt;
+            ball.speed() -= 2.0f * glm::dot(relative, first.normal) * first.normal;
+            events |= SIM_HIT_OBSTACLE;
+        } else {
+            ball.speed().y = -ball.speed().y;
+            events |= SIM_HIT_WALL;
+        }
+    }
+
+    // Goals
+    if (ball.x() < 0.0f) {
+        cpu.score++;
+        ball.clear(rng);
+        events |= SIM_SCORE_CPU;
+    } else if (ball.x() + 2 * ball.radius() > SCREEN_W) {
+        player.score++;
+        ball.clear(rng);
+        events |= SIM_SCORE_PLAYER;
+    }
+
+    return events;
+}
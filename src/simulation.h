@@ -0,0 +1,182 @@
+#ifndef _SIMULATION_H_
+#define _SIMULATION_H_
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#include <cmath>
+
+#include "shapes.h"
+#include "rng.h"
+#include "graphics_constants.h"
+
+// Headless game logic: no vita2d, sceKernel or audio calls in here so that
+// it also builds on the host (see bench/).
+
+// Constants
+// Speeds are in pixels per reference frame (SIM_REFERENCE_HZ), the
+// simulation scales them by its tick length.
+#define SIM_REFERENCE_HZ (60)
+#define PADDLE_W (20.0f)
+#define PADDLE_H (120.0f)
+#define PADDLE_SPEED (7.5f)
+#define BALL_SPEED (10.0f)
+#define BALL_R (10.0f)
+#define SCORE_WIN (10)
+#define SIM_MAX_BOUNCES (4)
+
+struct Paddle : Rectangle {
+    Paddle () : Rectangle() {
+    }
+
+    Paddle (glm::vec2 const& p0, glm::vec2 const& dims0) : Rectangle(p0, dims0) {
+    }
+
+    void clear () {
+        score = 0;
+    }
+
+    bool player = true;
+    int score = 0;
+};
+
+// Speed of n0 back towards the opponent, for a ball of radius r whose top
+// is at y when it hits the paddle: the angle depends on where it hit it.
+// Shared by Ball and MultiBall, so that both bounce the same to the bit.
+inline glm::vec2 aimSpeed (Paddle const& paddle, float y, float r, float n0, float maxBounceAngle) {
+    // Y coordinate of the intersection point (between -1 and 1)
+    float interY = y + r / 2,
+          relativeInterY = interY - paddle.top(),
+          normalizedInterY = relativeInterY / paddle.height();
+    normalizedInterY = 2 * normalizedInterY - 1;
+
+    // Angle
+    float bounceAngle = normalizedInterY * maxBounceAngle;
+
+    return glm::vec2((paddle.player ? n0 : -n0) * cos(bounceAngle), n0 * sin(bounceAngle));
+}
+
+struct Ball : Circle {
+    Ball () : Circle() {
+    }
+
+    void init (glm::vec2 const& p0, float r, Rng& rng) {
+        this->p = p0;
+        this->r = r;
+        setRandomSpeed(rng);
+    }
+
+    void clear (Rng& rng) {
+        x() = SCREEN_W / 2;
+        y() = SCREEN_H / 2;
+
+        setRandomSpeed(rng);
+    }
+
+    void setRandomSpeed (Rng& rng) {
+        float theta = 0.0f;
+        if (rng.range(0, 1) == 0) {
+            theta = rng.uniform(-M_PI / 4, M_PI / 4);
+        } else {
+            theta = rng.uniform(3 * M_PI / 4, 5 * M_PI / 4);
+        }
+        v0 = serveSpeed * glm::vec2(cos(theta), sin(theta));
+        v = v0;
+    }
+
+    using Circle::move;
+
+    void move (float dt = 1.0f) {
+        Circle::move(v * dt);
+    }
+
+    glm::vec2 speed () const {
+        return v;
+    }
+
+    glm::vec2& speed () {
+        return v;
+    }
+
+    // Sends the ball back towards the opponent, with an angle depending on
+    // where it hit the paddle
+    void aim (Paddle const& paddle) {
+        v = aimSpeed(paddle, y(), radius(), glm::length(v0), maxBounceAngle);
+    }
+
+    // Response to a swept contact (see collision.h)
+    void bounce (Paddle const& paddle, glm::vec2 const& normal) {
+        if (paddle.player ? normal.x > 0.0f : normal.x < 0.0f) {
+            // Front face
+            aim(paddle);
+        } else {
+            // Top, bottom or corner: plain reflection
+            v -= 2.0f * glm::dot(v, normal) * normal;
+        }
+    }
+
+    // Discrete test, only valid while the ball moves less than a paddle
+    // width per tick
+    bool collide (Paddle const& paddle) {
+        if (intersects(paddle)) {
+            aim(paddle);
+            return true;
+        }
+
+        return false;
+    }
+
+    glm::vec2 v0, v;
+    float serveSpeed = BALL_SPEED;
+    float maxBounceAngle = M_PI / 6;
+};
+
+// Events reported by Simulation::step
+enum {
+    SIM_HIT_PLAYER   = 1 << 0,
+    SIM_HIT_CPU      = 1 << 1,
+    SIM_HIT_WALL     = 1 << 2,
+    SIM_SCORE_PLAYER = 1 << 3,
+    SIM_SCORE_CPU    = 1 << 4,
+    SIM_HIT_OBSTACLE = 1 << 5,
+
+    SIM_HIT   = SIM_HIT_PLAYER | SIM_HIT_CPU,
+    SIM_SCORE = SIM_SCORE_PLAYER | SIM_SCORE_CPU,
+};
+
+struct Arena;
+
+struct Simulation {
+    Simulation (uint32_t seed = 1) : rng(seed) {
+        restart();
+    }
+
+    // Puts the ball and the paddles back in place and resets the scores
+    void restart ();
+
+    // Keeps the paddles on screen, moves the obstacles, sweeps the ball along
+    // one tick of motion, bouncing up to SIM_MAX_BOUNCES times off walls,
+    // paddles and obstacles, then resolves goals. Returns a mask of SIM_* events.
+    unsigned int step ();
+
+    // Simulated ticks per second, independent of the rendering frame rate
+    void setTickRate (unsigned int hz) {
+        dt = float(SIM_REFERENCE_HZ) / hz;
+    }
+
+    bool finished () const {
+        return player.score >= SCORE_WIN || cpu.score >= SCORE_WIN;
+    }
+
+    Paddle player, cpu;
+    Ball ball;
+    Rng rng;
+
+    // Tick length, in reference frames
+    float dt = 1.0f;
+
+    // Optional obstacles
+    Arena* arena = nullptr;
+};
+
+#endif
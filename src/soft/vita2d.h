@@ -0,0 +1,116 @@
+/*
+ * vita2d.h: Software stand-in for the subset of vita2d the game uses
+ *
+ * Host only: draws into an in-memory SCREEN_W x SCREEN_H RGBA framebuffer
+ * so that frames can be compared against golden images and their cost
+ * measured without a Vita. Signatures match vita2d; the vita2d_soft_*
+ * calls at the end are extensions to read the result back.
+ *
+ * Not a rasterizer reference: pixels are covered when their centre is
+ * inside a shape, there is no antialiasing, triangles are flat shaded with
+ * the colour of their first vertex, and the PGF font is replaced by a
+ * built-in one with similar metrics.
+ */
+
+#ifndef __VITA2D_SOFT_H__
+#define __VITA2D_SOFT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RGBA8(r,g,b,a) ((((a)&0xFF)<<24) | (((b)&0xFF)<<16) | (((g)&0xFF)<<8) | (((r)&0xFF)<<0))
+
+typedef enum
+{
+	SCE_GXM_PRIMITIVE_TRIANGLES = 0
+} SceGxmPrimitiveType;
+
+typedef enum
+{
+	SCE_GXM_TEXTURE_FORMAT_A8B8G8R8 = 0
+} SceGxmTextureFormat;
+
+typedef struct vita2d_color_vertex
+{
+	float x;
+	float y;
+	float z;
+	unsigned int color;
+} vita2d_color_vertex;
+
+typedef struct vita2d_texture vita2d_texture;
+typedef struct vita2d_pgf vita2d_pgf;
+
+int vita2d_init(void);
+int vita2d_fini(void);
+
+void vita2d_set_clear_color(unsigned int color);
+void vita2d_set_vblank_wait(int enable);
+void vita2d_clear_screen(void);
+void vita2d_start_drawing(void);
+void vita2d_start_drawing_advanced(vita2d_texture *target, unsigned int flags);
+void vita2d_end_drawing(void);
+void vita2d_wait_rendering_done(void);
+void vita2d_swap_buffers(void);
+
+/**
+ * Frame memory, reclaimed when the next frame starts
+ *
+ * @returns NULL once the frame's 1 MiB (vita2d's default) is used.
+ */
+void *vita2d_pool_memalign(unsigned int size, unsigned int alignment);
+
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color);
+void vita2d_draw_fill_circle(float x, float y, float radius, unsigned int color);
+void vita2d_draw_array(SceGxmPrimitiveType mode, const vita2d_color_vertex *vertices, size_t count);
+
+vita2d_texture *vita2d_create_empty_texture(unsigned int w, unsigned int h);
+vita2d_texture *vita2d_create_empty_texture_rendertarget(unsigned int w, unsigned int h, SceGxmTextureFormat format);
+void vita2d_free_texture(vita2d_texture *texture);
+unsigned int vita2d_texture_get_width(const vita2d_texture *texture);
+unsigned int vita2d_texture_get_height(const vita2d_texture *texture);
+unsigned int vita2d_texture_get_stride(const vita2d_texture *texture);
+void *vita2d_texture_get_datap(const vita2d_texture *texture);
+void vita2d_draw_texture_tint_part_scale(const vita2d_texture *texture, float x, float y,
+	float tex_x, float tex_y, float tex_w, float tex_h, float x_scale, float y_scale, unsigned int color);
+
+vita2d_pgf *vita2d_load_default_pgf(void);
+void vita2d_free_pgf(vita2d_pgf *font);
+/* y is the baseline */
+int vita2d_pgf_draw_text(vita2d_pgf *font, int x, int y, unsigned int color, float scale, const char *text);
+int vita2d_pgf_draw_textf(vita2d_pgf *font, int x, int y, unsigned int color, float scale, const char *text, ...)
+	__attribute__((format(printf, 6, 7)));
+void vita2d_pgf_text_dimensions(vita2d_pgf *font, float scale, const char *text, int *width, int *height);
+int vita2d_pgf_text_width(vita2d_pgf *font, float scale, const char *text);
+int vita2d_pgf_text_height(vita2d_pgf *font, float scale, const char *text);
+
+/*
+ * Extensions
+ */
+
+/**
+ * The last frame passed to vita2d_swap_buffers, SCREEN_W x SCREEN_H pixels
+ * in RGBA8 order
+ */
+const uint32_t *vita2d_soft_framebuffer(void);
+
+/**
+ * Fill spans with SIMD (the default) or one pixel at a time, to check that
+ * both give the same image
+ */
+void vita2d_soft_set_simd(int enable);
+
+/**
+ * Pixels written since vita2d_init, for fill rate figures
+ */
+unsigned long long vita2d_soft_pixels(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
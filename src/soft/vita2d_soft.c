@@ -0,0 +1,595 @@
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vita2d.h"
+#include "graphics_constants.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define VITA2D_SOFT_POOL_SIZE (1 * 1024 * 1024)
+
+struct vita2d_texture
+{
+	unsigned int w, h;
+	uint32_t *data;
+};
+
+/* Built-in font: one per process, as vita2d's default PGF */
+struct vita2d_pgf
+{
+	int unused;
+};
+
+static uint32_t vita2dSoftScreens[2][SCREEN_W * SCREEN_H];
+static int vita2dSoftBack = 0;	/* Screen drawn to, the other one is shown */
+
+/* Current target */
+static uint32_t *vita2dSoftTarget = vita2dSoftScreens[0];
+static unsigned int vita2dSoftWidth = SCREEN_W;
+static unsigned int vita2dSoftHeight = SCREEN_H;
+
+static unsigned int vita2dSoftClearColor = 0;
+static int vita2dSoftSimd = 1;
+static unsigned long long vita2dSoftPixels = 0;
+
+static unsigned char *vita2dSoftPool = NULL;
+static unsigned int vita2dSoftPoolUsed = 0;
+
+static vita2d_pgf vita2dSoftFont;
+
+int vita2d_init(void)
+{
+	if(!vita2dSoftPool)
+		vita2dSoftPool = malloc(VITA2D_SOFT_POOL_SIZE);
+
+	memset(vita2dSoftScreens, 0, sizeof(vita2dSoftScreens));
+	vita2dSoftBack = 0;
+	vita2dSoftTarget = vita2dSoftScreens[0];
+	vita2dSoftWidth = SCREEN_W;
+	vita2dSoftHeight = SCREEN_H;
+	vita2dSoftPoolUsed = 0;
+	vita2dSoftPixels = 0;
+
+	return 1;
+}
+
+int vita2d_fini(void)
+{
+	free(vita2dSoftPool);
+	vita2dSoftPool = NULL;
+
+	return 1;
+}
+
+void vita2d_set_clear_color(unsigned int color)
+{
+	vita2dSoftClearColor = color;
+}
+
+void vita2d_set_vblank_wait(int enable)
+{
+	(void)enable;
+}
+
+void vita2d_start_drawing(void)
+{
+	vita2dSoftTarget = vita2dSoftScreens[vita2dSoftBack];
+	vita2dSoftWidth = SCREEN_W;
+	vita2dSoftHeight = SCREEN_H;
+	vita2dSoftPoolUsed = 0;
+}
+
+void vita2d_start_drawing_advanced(vita2d_texture *target, unsigned int flags)
+{
+	(void)flags;
+
+	if(!target)
+	{
+		vita2d_start_drawing();
+		return;
+	}
+
+	vita2dSoftTarget = target->data;
+	vita2dSoftWidth = target->w;
+	vita2dSoftHeight = target->h;
+}
+
+void vita2d_end_drawing(void)
+{
+}
+
+void vita2d_wait_rendering_done(void)
+{
+}
+
+void vita2d_swap_buffers(void)
+{
+	vita2dSoftBack ^= 1;
+}
+
+void *vita2d_pool_memalign(unsigned int size, unsigned int alignment)
+{
+	unsigned int offset;
+
+	if(!vita2dSoftPool || alignment == 0)
+		return NULL;
+
+	offset = (vita2dSoftPoolUsed + alignment - 1) / alignment * alignment;
+	if(offset + size > VITA2D_SOFT_POOL_SIZE)
+		return NULL;
+
+	vita2dSoftPoolUsed = offset + size;
+	return vita2dSoftPool + offset;
+}
+
+/*
+ * Spans
+ */
+
+/* x / 255, rounded, for x in [0, 255 * 255] */
+#define VITA2D_SOFT_DIV255(x) (((x) + 128 + (((x) + 128) >> 8)) >> 8)
+
+static void vita2dSoftSolid(uint32_t *dst, unsigned int n, uint32_t color)
+{
+	unsigned int i = 0;
+
+	if(vita2dSoftSimd)
+	{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		uint32x4_t c = vdupq_n_u32(color);
+		for(; i + 4 <= n; i += 4)
+			vst1q_u32(dst + i, c);
+#elif defined(__SSE2__)
+		__m128i c = _mm_set1_epi32((int)color);
+		for(; i + 4 <= n; i += 4)
+			_mm_storeu_si128((__m128i *)(dst + i), c);
+#endif
+	}
+
+	for(; i < n; i++)
+		dst[i] = color;
+}
+
+/* dst = src * a + dst * (1 - a), on every channel */
+static inline uint32_t vita2dSoftBlendPixel(uint32_t dst, uint32_t src, unsigned int a)
+{
+	uint32_t out = 0;
+	int shift;
+
+	for(shift = 0; shift < 32; shift += 8)
+	{
+		unsigned int s = (src >> shift) & 0xFF, d = (dst >> shift) & 0xFF;
+		unsigned int x = s * a + d * (255 - a);
+		out |= (uint32_t)VITA2D_SOFT_DIV255(x) << shift;
+	}
+
+	return out;
+}
+
+static void vita2dSoftBlend(uint32_t *dst, unsigned int n, uint32_t color)
+{
+	unsigned int a = color >> 24;
+	unsigned int i = 0;
+
+	if(vita2dSoftSimd)
+	{
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+		uint8x8_t src = vreinterpret_u8_u32(vdup_n_u32(color));
+		/* src * a + 128, for two pixels */
+		uint16x8_t sa = vmlal_u8(vdupq_n_u16(128), src, vdup_n_u8(a));
+		uint8x8_t ia = vdup_n_u8(255 - a);
+		for(; i + 4 <= n; i += 4)
+		{
+			uint8x16_t d = vld1q_u8((const uint8_t *)(dst + i));
+			uint16x8_t lo = vmlal_u8(sa, vget_low_u8(d), ia);
+			uint16x8_t hi = vmlal_u8(sa, vget_high_u8(d), ia);
+			lo = vaddq_u16(lo, vshrq_n_u16(lo, 8));
+			hi = vaddq_u16(hi, vshrq_n_u16(hi, 8));
+			vst1q_u8((uint8_t *)(dst + i), vcombine_u8(vshrn_n_u16(lo, 8), vshrn_n_u16(hi, 8)));
+		}
+#elif defined(__SSE2__)
+		__m128i zero = _mm_setzero_si128();
+		__m128i src = _mm_unpacklo_epi8(_mm_set1_epi32((int)color), zero);
+		/* src * a + 128, for two pixels */
+		__m128i sa = _mm_add_epi16(_mm_mullo_epi16(src, _mm_set1_epi16(a)), _mm_set1_epi16(128));
+		__m128i ia = _mm_set1_epi16(255 - a);
+		for(; i + 4 <= n; i += 4)
+		{
+			__m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+			__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), ia), sa);
+			__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), ia), sa);
+			lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+			hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+			_mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+		}
+#endif
+	}
+
+	for(; i < n; i++)
+		dst[i] = vita2dSoftBlendPixel(dst[i], color, a);
+}
+
+/* Pixels [x0, x1) of a row of the target */
+static void vita2dSoftSpan(int row, int x0, int x1, uint32_t color)
+{
+	unsigned int a = color >> 24;
+
+	if(row < 0 || row >= (int)vita2dSoftHeight)
+		return;
+	if(x0 < 0)
+		x0 = 0;
+	if(x1 > (int)vita2dSoftWidth)
+		x1 = vita2dSoftWidth;
+	if(x0 >= x1 || a == 0)
+		return;
+
+	if(a == 255)
+		vita2dSoftSolid(vita2dSoftTarget + row * vita2dSoftWidth + x0, x1 - x0, color);
+	else
+		vita2dSoftBlend(vita2dSoftTarget + row * vita2dSoftWidth + x0, x1 - x0, color);
+
+	vita2dSoftPixels += x1 - x0;
+}
+
+/*
+ * Shapes: a pixel is covered when its centre is, so that shapes sharing an
+ * edge never both cover a pixel
+ */
+
+/* First pixel whose centre is at or after p */
+static inline int vita2dSoftFirst(float p)
+{
+	return (int)ceilf(p - 0.5f);
+}
+
+void vita2d_clear_screen(void)
+{
+	unsigned int row;
+
+	for(row = 0; row < vita2dSoftHeight; row++)
+		vita2dSoftSolid(vita2dSoftTarget + row * vita2dSoftWidth, vita2dSoftWidth, vita2dSoftClearColor);
+}
+
+void vita2d_draw_rectangle(float x, float y, float w, float h, unsigned int color)
+{
+	int x0 = vita2dSoftFirst(x), x1 = vita2dSoftFirst(x + w);
+	int y0 = vita2dSoftFirst(y), y1 = vita2dSoftFirst(y + h);
+	int row;
+
+	if(y0 < 0)
+		y0 = 0;
+	if(y1 > (int)vita2dSoftHeight)
+		y1 = vita2dSoftHeight;
+
+	for(row = y0; row < y1; row++)
+		vita2dSoftSpan(row, x0, x1, color);
+}
+
+void vita2d_draw_fill_circle(float x, float y, float radius, unsigned int color)
+{
+	int y0 = vita2dSoftFirst(y - radius), y1 = vita2dSoftFirst(y + radius);
+	int row;
+
+	if(y0 < 0)
+		y0 = 0;
+	if(y1 > (int)vita2dSoftHeight)
+		y1 = vita2dSoftHeight;
+
+	for(row = y0; row < y1; row++)
+	{
+		float dy = row + 0.5f - y;
+		float hw = sqrtf(fmaxf(radius * radius - dy * dy, 0.0f));
+		vita2dSoftSpan(row, vita2dSoftFirst(x - hw), vita2dSoftFirst(x + hw), color);
+	}
+}
+
+static void vita2dSoftTriangle(const vita2d_color_vertex *v)
+{
+	float ymin = fminf(v[0].y, fminf(v[1].y, v[2].y));
+	float ymax = fmaxf(v[0].y, fmaxf(v[1].y, v[2].y));
+	int y0 = vita2dSoftFirst(ymin), y1 = vita2dSoftFirst(ymax);
+	int row, e;
+
+	if(y0 < 0)
+		y0 = 0;
+	if(y1 > (int)vita2dSoftHeight)
+		y1 = vita2dSoftHeight;
+
+	for(row = y0; row < y1; row++)
+	{
+		float yc = row + 0.5f;
+		float xl = 0.0f, xr = 0.0f;
+		int hits = 0;
+
+		/* Each edge covers [top, bottom): a row crosses exactly two */
+		for(e = 0; e < 3; e++)
+		{
+			const vita2d_color_vertex *a = &v[e], *b = &v[(e + 1) % 3];
+			float top = fminf(a->y, b->y), bottom = fmaxf(a->y, b->y);
+			float x;
+
+			if(yc < top || yc >= bottom)
+				continue;
+
+			x = a->x + (yc - a->y) * (b->x - a->x) / (b->y - a->y);
+			if(hits++ == 0)
+			{
+				xl = xr = x;
+			}
+			else
+			{
+				xl = fminf(xl, x);
+				xr = fmaxf(xr, x);
+			}
+		}
+
+		if(hits >= 2)
+			vita2dSoftSpan(row, vita2dSoftFirst(xl), vita2dSoftFirst(xr), v[0].color);
+	}
+}
+
+void vita2d_draw_array(SceGxmPrimitiveType mode, const vita2d_color_vertex *vertices, size_t count)
+{
+	size_t i;
+
+	if(mode != SCE_GXM_PRIMITIVE_TRIANGLES)
+		return;
+
+	for(i = 0; i + 3 <= count; i += 3)
+		vita2dSoftTriangle(vertices + i);
+}
+
+/*
+ * Textures
+ */
+
+vita2d_texture *vita2d_create_empty_texture(unsigned int w, unsigned int h)
+{
+	vita2d_texture *texture = malloc(sizeof(vita2d_texture));
+
+	if(!texture)
+		return NULL;
+
+	texture->w = w;
+	texture->h = h;
+	texture->data = calloc((size_t)w * h, sizeof(uint32_t));
+	if(!texture->data)
+	{
+		free(texture);
+		return NULL;
+	}
+
+	return texture;
+}
+
+vita2d_texture *vita2d_create_empty_texture_rendertarget(unsigned int w, unsigned int h, SceGxmTextureFormat format)
+{
+	(void)format;
+	return vita2d_create_empty_texture(w, h);
+}
+
+void vita2d_free_texture(vita2d_texture *texture)
+{
+	if(!texture)
+		return;
+
+	/* Back to the screen if it was being drawn to */
+	if(vita2dSoftTarget == texture->data)
+		vita2d_start_drawing();
+
+	free(texture->data);
+	free(texture);
+}
+
+unsigned int vita2d_texture_get_width(const vita2d_texture *texture)
+{
+	return texture->w;
+}
+
+unsigned int vita2d_texture_get_height(const vita2d_texture *texture)
+{
+	return texture->h;
+}
+
+unsigned int vita2d_texture_get_stride(const vita2d_texture *texture)
+{
+	return texture->w * sizeof(uint32_t);
+}
+
+void *vita2d_texture_get_datap(const vita2d_texture *texture)
+{
+	return texture->data;
+}
+
+/* Nearest texel, multiplied by the tint, blended over the target */
+void vita2d_draw_texture_tint_part_scale(const vita2d_texture *texture, float x, float y,
+	float tex_x, float tex_y, float tex_w, float tex_h, float x_scale, float y_scale, unsigned int color)
+{
+	int x0 = vita2dSoftFirst(x), x1 = vita2dSoftFirst(x + tex_w * x_scale);
+	int y0 = vita2dSoftFirst(y), y1 = vita2dSoftFirst(y + tex_h * y_scale);
+	int row, col, shift;
+
+	if(!texture || x_scale == 0.0f || y_scale == 0.0f)
+		return;
+
+	if(x0 < 0)
+		x0 = 0;
+	if(x1 > (int)vita2dSoftWidth)
+		x1 = vita2dSoftWidth;
+	if(y0 < 0)
+		y0 = 0;
+	if(y1 > (int)vita2dSoftHeight)
+		y1 = vita2dSoftHeight;
+
+	for(row = y0; row < y1; row++)
+	{
+		int ty = (int)(tex_y + (row + 0.5f - y) / y_scale);
+		uint32_t *dst = vita2dSoftTarget + row * vita2dSoftWidth;
+
+		if(ty < 0 || ty >= (int)texture->h)
+			continue;
+
+		for(col = x0; col < x1; col++)
+		{
+			int tx = (int)(tex_x + (col + 0.5f - x) / x_scale);
+			uint32_t texel, tinted = 0;
+
+			if(tx < 0 || tx >= (int)texture->w)
+				continue;
+
+			texel = texture->data[ty * texture->w + tx];
+			if(!(texel >> 24))
+				continue;
+
+			for(shift = 0; shift < 32; shift += 8)
+			{
+				unsigned int t = ((texel >> shift) & 0xFF) * ((color >> shift) & 0xFF);
+				tinted |= (uint32_t)VITA2D_SOFT_DIV255(t) << shift;
+			}
+
+			dst[col] = (tinted >> 24) == 255 ? tinted : vita2dSoftBlendPixel(dst[col], tinted, tinted >> 24);
+			vita2dSoftPixels++;
+		}
+	}
+}
+
+/*
+ * Font
+ *
+ * Not the PGF glyphs: each character is a 4x6 grid of square cells whose
+ * pattern is derived from its code, drawn 12 pixels tall at scale 1 over a
+ * 17 pixel line. Readable enough to check placement, deterministic, and
+ * with roughly the metrics of the default PGF font.
+ */
+
+#define VITA2D_SOFT_FONT_ADVANCE 10
+#define VITA2D_SOFT_FONT_SPACE 6
+#define VITA2D_SOFT_FONT_LINE 17
+#define VITA2D_SOFT_FONT_CELL 2
+#define VITA2D_SOFT_FONT_COLS 4
+#define VITA2D_SOFT_FONT_ROWS 6
+
+static unsigned int vita2dSoftGlyphBits(unsigned char c)
+{
+	unsigned int h = c * 2654435761u;
+
+	/* Never blank, so that every glyph shows */
+	return ((h >> 8) & 0xFFFFFF) | 1;
+}
+
+static int vita2dSoftGlyphDescends(unsigned char c)
+{
+	return c == 'g' || c == 'j' || c == 'p' || c == 'q' || c == 'y' || c == ',' || c == '_';
+}
+
+static float vita2dSoftAdvance(unsigned char c, float scale)
+{
+	return (c == ' ' ? VITA2D_SOFT_FONT_SPACE : VITA2D_SOFT_FONT_ADVANCE) * scale;
+}
+
+vita2d_pgf *vita2d_load_default_pgf(void)
+{
+	return &vita2dSoftFont;
+}
+
+void vita2d_free_pgf(vita2d_pgf *font)
+{
+	(void)font;
+}
+
+int vita2d_pgf_draw_text(vita2d_pgf *font, int x, int y, unsigned int color, float scale, const char *text)
+{
+	float pen = x;
+	float cell = VITA2D_SOFT_FONT_CELL * scale;
+	const unsigned char *c;
+	int row, col;
+
+	(void)font;
+
+	for(c = (const unsigned char *)text; *c; c++)
+	{
+		if(*c != ' ')
+		{
+			unsigned int bits = vita2dSoftGlyphBits(*c);
+			float top = y - VITA2D_SOFT_FONT_ROWS * cell;
+
+			if(vita2dSoftGlyphDescends(*c))
+				top += 2 * cell;
+
+			for(row = 0; row < VITA2D_SOFT_FONT_ROWS; row++)
+				for(col = 0; col < VITA2D_SOFT_FONT_COLS; col++)
+					if(bits & (1u << (row * VITA2D_SOFT_FONT_COLS + col)))
+						vita2d_draw_rectangle(pen + col * cell, top + row * cell, cell, cell, color);
+		}
+
+		pen += vita2dSoftAdvance(*c, scale);
+	}
+
+	return (int)(pen - x);
+}
+
+int vita2d_pgf_draw_textf(vita2d_pgf *font, int x, int y, unsigned int color, float scale, const char *text, ...)
+{
+	char buf[1024];
+	va_list args;
+
+	va_start(args, text);
+	vsnprintf(buf, sizeof(buf), text, args);
+	va_end(args);
+
+	return vita2d_pgf_draw_text(font, x, y, color, scale, buf);
+}
+
+void vita2d_pgf_text_dimensions(vita2d_pgf *font, float scale, const char *text, int *width, int *height)
+{
+	if(width)
+		*width = vita2d_pgf_text_width(font, scale, text);
+	if(height)
+		*height = vita2d_pgf_text_height(font, scale, text);
+}
+
+int vita2d_pgf_text_width(vita2d_pgf *font, float scale, const char *text)
+{
+	float width = 0.0f;
+	const unsigned char *c;
+
+	(void)font;
+
+	for(c = (const unsigned char *)text; *c; c++)
+		width += vita2dSoftAdvance(*c, scale);
+
+	return (int)width;
+}
+
+int vita2d_pgf_text_height(vita2d_pgf *font, float scale, const char *text)
+{
+	(void)font;
+	(void)text;
+
+	return (int)(VITA2D_SOFT_FONT_LINE * scale);
+}
+
+/*
+ * Extensions
+ */
+
+const uint32_t *vita2d_soft_framebuffer(void)
+{
+	return vita2dSoftScreens[vita2dSoftBack ^ 1];
+}
+
+void vita2d_soft_set_simd(int enable)
+{
+	vita2dSoftSimd = enable;
+}
+
+unsigned long long vita2d_soft_pixels(void)
+{
+	return vita2dSoftPixels;
+}
@@ -0,0 +1,93 @@
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "text.h"
+
+GlyphSet const* GlyphAtlas::find (float scale) const {
+    GlyphSet const* above = nullptr;
+    GlyphSet const* largest = nullptr;
+
+    for (unsigned int i = 0; i < sets.size(); ++i) {
+        GlyphSet const& set = sets[i];
+        if (set.scale >= scale && (! above || set.scale < above->scale)) {
+            above = &set;
+        }
+        if (! largest || set.scale > largest->scale) {
+            largest = &set;
+        }
+    }
+
+    return above ? above : largest;
+}
+
+void TextCache::layout (const char* text, float scale, TextLayout& out) {
+    ++layouts;
+    ++totalLayouts;
+
+    out.quads.clear();
+    out.set = atlas ? atlas->find(scale) : nullptr;
+    out.width = out.height = 0.0f;
+    if (! out.set) {
+        return;
+    }
+
+    out.ratio = scale / out.set->scale;
+    out.height = out.set->lineHeight * out.ratio;
+
+    float x = 0.0f;
+    for (const char* c = text; *c; ++c) {
+        if (*c != ' ') {
+            out.quads.push_back({ x, *c });
+        }
+        x += out.set->glyph(*c).advance * out.ratio;
+    }
+    out.width = x;
+}
+
+TextLayout const& TextCache::get (const char* text, float scale) {
+    // Key: the scale's bits, then the string. The key buffer is reused so
+    // that a hit does not allocate.
+    key.assign(reinterpret_cast<const char*>(&scale), sizeof(scale));
+    key += text;
+
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        it = entries.emplace(key, TextLayout()).first;
+        layout(text, scale, it->second);
+    }
+
+    return it->second;
+}
+
+TextLayout const& TextSlot::set (TextCache& cache, const char* text, float scale) {
+    if (! valid || scale != this->scale || this->text != text) {
+        this->text = text;
+        this->scale = scale;
+        valid = true;
+        cache.layout(text, scale, layout);
+    }
+
+    return layout;
+}
+
+TextLayout const& TextSlot::number (TextCache& cache, int value, float scale) {
+    if (! valid || value != this->value || scale != this->scale) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%d", value);
+        this->value = value;
+        return set(cache, buf, scale);
+    }
+
+    return layout;
+}
+
+TextLayout const& TextSlot::format (TextCache& cache, float scale, const char* fmt, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    return set(cache, buf, scale);
+}
@@ -0,0 +1,133 @@
+#ifndef _TEXT_H_
+#define _TEXT_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+enum {
+    TEXT_TOP    = 0,
+    TEXT_CENTER = 1,
+    TEXT_BOTTOM = 2,
+    TEXT_LEFT   = 3,
+    TEXT_RIGHT  = 4,
+};
+
+// Printable ASCII only
+#define TEXT_FIRST_GLYPH 32
+#define TEXT_LAST_GLYPH  126
+#define TEXT_GLYPHS      (TEXT_LAST_GLYPH - TEXT_FIRST_GLYPH + 1)
+
+// A pre-rasterized glyph: its cell in the atlas texture (pixels) and how
+// far it moves the pen
+struct Glyph {
+    float u, v, w, h;
+    float advance;
+};
+
+// Every glyph at one scale. Cells start pad pixels up and left of the
+// glyph's origin, so that nothing drawn around it is cut off.
+struct GlyphSet {
+    float scale;
+    float lineHeight;
+    float pad;
+    Glyph glyphs[TEXT_GLYPHS];
+
+    Glyph const& glyph (char c) const {
+        unsigned char i = c;
+        if (i < TEXT_FIRST_GLYPH || i > TEXT_LAST_GLYPH) i = '?';
+        return glyphs[i - TEXT_FIRST_GLYPH];
+    }
+};
+
+// Metrics of the glyphs in the atlas texture, one set per rasterized scale
+struct GlyphAtlas {
+    std::vector<GlyphSet> sets;
+
+    // The set rasterized at the smallest scale >= the given one (scaled
+    // down when drawn), or the largest
+    GlyphSet const* find (float scale) const;
+};
+
+// A string laid out on one line: the glyph and pen position of each
+// character, in pixels at the requested scale
+struct TextLayout {
+    struct Quad {
+        float x;
+        char c;
+    };
+
+    GlyphSet const* set = nullptr;
+    float ratio = 1.0f; // Requested scale / set scale
+    float width = 0.0f, height = 0.0f;
+    std::vector<Quad> quads;
+
+    // Top left corner for the given anchor and alignment
+    void align (float& x, float& y, int horiz, int vert) const {
+        // left (horizontal) and top (vertical) do not need any processing
+        if (horiz == TEXT_CENTER) {
+            x -= 0.5f * width;
+        } else if (horiz == TEXT_RIGHT) {
+            x -= width;
+        }
+
+        if (vert == TEXT_CENTER) {
+            y -= 0.5f * height;
+        } else if (vert == TEXT_BOTTOM) {
+            y -= height;
+        }
+    }
+};
+
+// Laid out strings keyed by (string, scale), for text that does not
+// change: menu entries, titles, prompts. Layouts are built once and kept.
+struct TextCache {
+    void init (GlyphAtlas const* atlas) {
+        this->atlas = atlas;
+        entries.clear();
+    }
+
+    TextLayout const& get (const char* text, float scale);
+
+    // Lays text out into out, counting it
+    void layout (const char* text, float scale, TextLayout& out);
+
+    // Starts counting the layouts of a new frame
+    void beginFrame () {
+        layoutsLastFrame = layouts;
+        layouts = 0;
+    }
+
+    GlyphAtlas const* atlas = nullptr;
+
+    // Layouts done this frame and the previous one: zero in steady state
+    unsigned int layouts = 0;
+    unsigned int layoutsLastFrame = 0;
+    uint64_t totalLayouts = 0;
+
+private:
+    std::unordered_map<std::string, TextLayout> entries;
+    std::string key;
+};
+
+// A string that changes now and then (scores, statistics): laid out again
+// only when its content does
+struct TextSlot {
+    TextLayout const& set (TextCache& cache, const char* text, float scale);
+
+    // Formats a number only when it changes
+    TextLayout const& number (TextCache& cache, int value, float scale);
+
+    // Formats every call, lays out only on change
+    TextLayout const& format (TextCache& cache, float scale, const char* fmt, ...)
+        __attribute__((format(printf, 4, 5)));
+
+    std::string text;
+    float scale = 0.0f;
+    int value = 0;
+    bool valid = false;
+    TextLayout layout;
+};
+
+#endif
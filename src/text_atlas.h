@@ -0,0 +1,103 @@
+#ifndef _TEXT_ATLAS_H_
+#define _TEXT_ATLAS_H_
+
+#include <cmath>
+#include <vita2d.h>
+
+#include "text.h"
+#include "graphics_constants.h"
+
+#define TEXT_ATLAS_W 1024
+#define TEXT_ATLAS_H 512
+
+// Glyph atlas texture: printable ASCII rasterized once with the PGF font,
+// at each scale the game draws text at. Drawing a laid out string is then
+// one textured quad per character, with no font lookups or measuring.
+struct TextAtlas {
+    void init (vita2d_pgf* font, const float* scales, unsigned int count) {
+        texture = vita2d_create_empty_texture_rendertarget(TEXT_ATLAS_W, TEXT_ATLAS_H,
+                                                           SCE_GXM_TEXTURE_FORMAT_A8B8G8R8);
+        atlas.sets.clear();
+
+        // Shelf packing, one row of cells after the other
+        float u = 0, v = 0, rowHeight = 0;
+        char str[2] = { 0, 0 };
+
+        vita2d_start_drawing_advanced(texture, 0);
+
+        for (unsigned int s = 0; s < count; ++s) {
+            GlyphSet set;
+            set.scale = scales[s];
+            set.lineHeight = 0;
+            for (int c = TEXT_FIRST_GLYPH; c <= TEXT_LAST_GLYPH; ++c) {
+                str[0] = c;
+                set.lineHeight = fmaxf(set.lineHeight, vita2d_pgf_text_height(font, set.scale, str));
+            }
+            // Room around the glyph for ink outside of its box
+            set.pad = ceilf(0.25f * set.lineHeight);
+
+            for (int c = TEXT_FIRST_GLYPH; c <= TEXT_LAST_GLYPH; ++c) {
+                Glyph& glyph = set.glyphs[c - TEXT_FIRST_GLYPH];
+                str[0] = c;
+                glyph.advance = vita2d_pgf_text_width(font, set.scale, str);
+                glyph.w = ceilf(glyph.advance) + 2 * set.pad;
+                glyph.h = ceilf(set.lineHeight) + 2 * set.pad;
+
+                if (u + glyph.w > TEXT_ATLAS_W) {
+                    u = 0;
+                    v += rowHeight;
+                    rowHeight = 0;
+                }
+                glyph.u = u;
+                glyph.v = v;
+                u += glyph.w;
+                rowHeight = fmaxf(rowHeight, glyph.h);
+
+                // PGF text is drawn on its baseline: one line down, with the
+                // descenders in the bottom padding
+                if (c != ' ' && glyph.v + glyph.h <= TEXT_ATLAS_H) {
+                    vita2d_pgf_draw_text(font, glyph.u + set.pad, glyph.v + set.pad + set.lineHeight,
+                                         WHITE, set.scale, str);
+                }
+            }
+
+            atlas.sets.push_back(set);
+        }
+
+        vita2d_end_drawing();
+        vita2d_wait_rendering_done();
+    }
+
+    void fini () {
+        if (texture) {
+            vita2d_free_texture(texture);
+            texture = nullptr;
+        }
+    }
+
+    // Same placement as vita2d_pgf_draw_text at (x, y) for TEXT_LEFT/TEXT_TOP
+    void draw (TextLayout const& layout, float x, float y, unsigned int color,
+               int horiz = TEXT_LEFT, int vert = TEXT_TOP) const {
+        if (! layout.set) {
+            return;
+        }
+
+        layout.align(x, y, horiz, vert);
+
+        GlyphSet const& set = *layout.set;
+        float pad = set.pad * layout.ratio;
+        float top = y - (set.lineHeight + set.pad) * layout.ratio;
+        for (unsigned int i = 0; i < layout.quads.size(); ++i) {
+            TextLayout::Quad const& quad = layout.quads[i];
+            Glyph const& glyph = set.glyph(quad.c);
+            vita2d_draw_texture_tint_part_scale(texture, x + quad.x - pad, top,
+                                                glyph.u, glyph.v, glyph.w, glyph.h,
+                                                layout.ratio, layout.ratio, color);
+        }
+    }
+
+    vita2d_texture* texture = nullptr;
+    GlyphAtlas atlas;
+};
+
+#endif
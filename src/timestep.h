@@ -0,0 +1,86 @@
+#ifndef _TIMESTEP_H_
+#define _TIMESTEP_H_
+
+#include <stdint.h>
+
+// Fixed-timestep accumulator: decouples the simulation tick rate from the
+// rendering frame rate. Platform-free, the caller feeds it the current time
+// (sceKernelGetProcessTimeWide on the Vita).
+struct FixedTimestep {
+    FixedTimestep (unsigned int hz = 60, unsigned int maxTicks = 8) {
+        init(hz, maxTicks);
+    }
+
+    void init (unsigned int hz, unsigned int maxTicks = 8) {
+        this->hz = hz;
+        tickMicros = 1000000 / hz;
+        maxTicksPerFrame = maxTicks;
+        reset();
+    }
+
+    // Forget the accumulated time (e.g. after a long stall on purpose)
+    void reset () {
+        started = false;
+        accumulator = 0;
+    }
+
+    // Accumulates the time elapsed since the last call and returns the number
+    // of ticks to simulate this frame. If more than maxTicksPerFrame ticks are
+    // due, the excess is dropped so that a long stall does not snowball.
+    unsigned int advance (uint64_t nowMicros) {
+        if (! started) {
+            started = true;
+            lastMicros = nowMicros;
+            return 0;
+        }
+
+        uint64_t elapsed = nowMicros - lastMicros;
+        lastMicros = nowMicros;
+
+        // Ticks a frame of the usual length would have given: more than
+        // that is catching up, not the tick rate being above the frame rate
+        if (frameMicros == 0) {
+            frameMicros = elapsed;
+        }
+        uint64_t usual = (accumulator + frameMicros) / tickMicros;
+        frameMicros = frameMicros - frameMicros / 16 + elapsed / 16;
+
+        accumulator += elapsed;
+
+        unsigned int n = accumulator / tickMicros;
+        accumulator -= uint64_t(n) * tickMicros;
+
+        if (n > maxTicksPerFrame) {
+            dropped += n - maxTicksPerFrame;
+            n = maxTicksPerFrame;
+        }
+
+        if (n > usual) {
+            caughtUp += n - usual;
+        }
+
+        ticks += n;
+        return n;
+    }
+
+    // Fraction of a tick elapsed since the last simulated tick, in [0, 1).
+    // Used to interpolate between the previous and the current state.
+    float alpha () const {
+        return float(accumulator) / tickMicros;
+    }
+
+    unsigned int hz;
+    uint64_t tickMicros;
+    unsigned int maxTicksPerFrame;
+
+    bool started = false;
+    uint64_t lastMicros = 0, accumulator = 0;
+    uint64_t frameMicros = 0; // Average time between two calls
+
+    // Stats
+    uint64_t ticks = 0;    // Simulated ticks
+    uint64_t caughtUp = 0; // Ticks beyond a usual frame's, run to catch up
+    uint64_t dropped = 0;  // Ticks skipped because the frame took too long
+};
+
+#endif
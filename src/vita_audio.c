@@ -1,21 +1,35 @@
 #include <psp2/audioout.h>
 #include <psp2/kernel/threadmgr.h>
+#include <psp2/kernel/processmgr.h>
 #include <psp2/io/fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <malloc.h>
 #include "vita_audio.h"
+#include "vita_mixer.h"
+#include "vita_stream.h"
+#include "vita_pack.h"
 
-static vitaWav vitaWavInfo[VITA_WAV_MAX_SLOTS];
-static int vitaWavPlaying[VITA_WAV_MAX_SLOTS];
-static int vitaWavId[VITA_WAV_MAX_SLOTS];
-
-static short *vitaWavSamples;
-static unsigned long vitaWavReq;
 static int vitaWavIdFlag = 0;
 
 static int vitaWavInitFlag = 0;
 
+static int vitaWavConvertFlag = 0;
+
+typedef struct
+{
+	vitaStream stream; /* First, so that a vitaStream * is the whole block */
+	int fd;
+} vitaWavStreamFile;
+
+#define VITA_WAV_STREAM_TIMEOUT	200000	/* Microseconds the game thread waits for the mixer */
+
+/* Open streams, guarded by vitaWavStreamLock against the I/O thread */
+static vitaStream *vitaWavStreams[VITA_MIXER_MAX_STREAMS];
+static SceUID vitaWavStreamLock = -1;
+static SceUID vitaWavStreamThreadHandle = -1;
+static volatile int vitaWavStreamTerminate = 0;
+
 typedef struct
 {
 	int threadHandle;
@@ -24,10 +38,17 @@ typedef struct
 	int volumeRight;
 	vitaAudioCallback callback;
 	void *data;
+	unsigned int period;
+	unsigned int requestedPeriod;
 
 } vitaAudioChannelInfo;
 
 static int vitaAudioReady = 0;
+/*
+ * sceAudioOutOutput returns once the port has taken the buffer, so at most
+ * one waits behind the one playing: two are enough, and more would not
+ * queue any deeper
+ */
 static short vitaAudioSoundBuffer[VITA_NUM_AUDIO_CHANNELS][2][VITA_NUM_AUDIO_SAMPLES][2];
 
 static vitaAudioChannelInfo vitaAudioStatus[VITA_NUM_AUDIO_CHANNELS];
@@ -40,7 +61,20 @@ void vitaAudioSetVolume(int channel, int left, int right) {
 }
 
 int vitaAudioSetFrequency(int channel, unsigned short freq) {
-	return sceAudioOutSetConfig(vitaAudioStatus[channel].handle, VITA_NUM_AUDIO_SAMPLES, freq, SCE_AUDIO_OUT_MODE_STEREO);
+	return sceAudioOutSetConfig(vitaAudioStatus[channel].handle, vitaAudioStatus[channel].period, freq, SCE_AUDIO_OUT_MODE_STEREO);
+}
+
+void vitaAudioSetPeriod(int channel, unsigned int samples)
+{
+	samples -= samples % VITA_MIN_AUDIO_SAMPLES;
+
+	if (samples < VITA_MIN_AUDIO_SAMPLES)
+		samples = VITA_MIN_AUDIO_SAMPLES;
+	else if (samples > VITA_NUM_AUDIO_SAMPLES)
+		samples = VITA_NUM_AUDIO_SAMPLES;
+
+	/* Picked up by the channel thread before its next buffer */
+	__atomic_store_n(&vitaAudioStatus[channel].requestedPeriod, samples, __ATOMIC_RELAXED);
 }
 
 void vitaAudioSetChannelCallback(int channel, vitaAudioCallback callback, void *data)
@@ -80,19 +114,31 @@ static int vitaAudioChannelThread(int args, void *argp)
 
 	int channel = *(int *) argp;
 
+	vitaAudioChannelInfo *info = &vitaAudioStatus[channel];
+
 	while (vitaAudioTerminate == 0)
 	{
+		unsigned int period = __atomic_load_n(&info->requestedPeriod, __ATOMIC_RELAXED);
+
+		if (period != info->period)
+		{
+			if (sceAudioOutSetConfig(info->handle, period, -1, -1) >= 0)
+				info->period = period;
+			else
+				info->requestedPeriod = info->period;
+		}
+
 		void *bufptr = &vitaAudioSoundBuffer[channel][bufidx];
 		vitaAudioCallback callback;
-		callback = vitaAudioStatus[channel].callback;
+		callback = info->callback;
 
 		if (callback)
 		{
-			callback(bufptr, VITA_NUM_AUDIO_SAMPLES, vitaAudioStatus[channel].data);
+			callback(bufptr, info->period, info->data);
 		} else {
 			unsigned int *ptr=bufptr;
-			int i;
-			for (i=0; i<VITA_NUM_AUDIO_SAMPLES; ++i) *(ptr++)=0;
+			unsigned int i;
+			for (i=0; i<info->period; ++i) *(ptr++)=0;
 		}
 
 		vitaAudioOutBlocking(channel, vitaAudioStatus[channel].volumeLeft, vitaAudioStatus[channel].volumeRight, bufptr);
@@ -122,11 +168,13 @@ int vitaAudioInit(int priority)
 		vitaAudioStatus[i].volumeLeft  = VITA_VOLUME_MAX;
 		vitaAudioStatus[i].callback = 0;
 		vitaAudioStatus[i].data = 0;
+		vitaAudioStatus[i].period = VITA_NUM_AUDIO_SAMPLES;
+		vitaAudioStatus[i].requestedPeriod = VITA_NUM_AUDIO_SAMPLES;
 	}
 
 	for (i = 0; i < VITA_NUM_AUDIO_CHANNELS; i++)
 	{
-		if ((vitaAudioStatus[i].handle = sceAudioOutOpenPort(SCE_AUDIO_OUT_PORT_TYPE_BGM, VITA_NUM_AUDIO_SAMPLES, 44100, SCE_AUDIO_OUT_MODE_STEREO)) < 0)
+		if ((vitaAudioStatus[i].handle = sceAudioOutOpenPort(SCE_AUDIO_OUT_PORT_TYPE_BGM, VITA_NUM_AUDIO_SAMPLES, VITA_AUDIO_FREQUENCY, SCE_AUDIO_OUT_MODE_STEREO)) < 0)
 			failed = 1;
 	}
 
@@ -216,100 +264,67 @@ void vitaAudioShutdown(void)
 	}
 }
 
+static unsigned long long vitaWavClock(void)
+{
+	return sceKernelGetProcessTimeWide();
+}
+
 static void wavout_snd_callback(void *_buf, unsigned int _reqn, void *pdata)
 {
-	int i,slot;
-	vitaWav *wi;
-	unsigned long ptr, frac;
-	short *buf = _buf;
+	/*
+	 * The port only returns from the previous output once it has started
+	 * playing the buffer before this one
+	 */
+	vitaMixerOutput(vitaWavClock(), _reqn);
 
-	vitaWavSamples = _buf;
-	vitaWavReq = _reqn;
+	vitaMixerMix((short *)_buf, _reqn);
+}
 
-	for(i = 0; i < _reqn; i++)
+/* Keeps the rings of the open streams full, reading and decoding ahead */
+static int vitaWavStreamThread(int args, void *argp)
+{
+	while(vitaWavStreamTerminate == 0)
 	{
-		int outr = 0, outl = 0;
+		unsigned int decoded = 0;
+		int i;
 
-		for(slot = 0; slot < VITA_WAV_MAX_SLOTS; slot++)
-		{
-			if(!vitaWavPlaying[slot]) continue;
-
-			wi = &vitaWavInfo[slot];
-			frac = wi->playPtr_frac + wi->rateRatio;
-			wi->playPtr = ptr = wi->playPtr + (frac>>16);
-			wi->playPtr_frac = (frac & 0xffff);
-
-			if(ptr >= wi->sampleCount)
-			{
-				if(wi->loop)
-				{
-					wi->playPtr = 0;
-					wi->playPtr_frac = 0;
-					ptr = 0;
-				}
-				else
-				{
-					vitaWavPlaying[slot] = 0;
-					break;
-				}
-			}
-
-			short *src16 = (short *)wi->data;
-			unsigned char *src8 = (unsigned char *)wi->data;
+		sceKernelWaitSema(vitaWavStreamLock, 1, NULL);
 
-			if(wi->channels == 1)
-			{
-				if(wi->bitPerSample == 8)
-				{
-					outl += (src8[ptr] * 256) - 32768;
-					outr += (src8[ptr] * 256) - 32768;
-				}
-				else
-				{
-					outl += src16[ptr];
-					outr += src16[ptr];
-				}
-			}
-			else
-			{
-				if(wi->bitPerSample == 8)
-				{
-					outl += (src8[ptr*2] * 256) - 32768;
-					outr += (src8[ptr*2+1] * 256) - 32768;
-				}
-				else
-				{
-					outl += src16[ptr*2];
-					outr += src16[ptr*2+1];
-				}
-			}
+		for(i = 0; i < VITA_MIXER_MAX_STREAMS; i++)
+		{
+			if(vitaWavStreams[i])
+				decoded += vitaStreamFill(vitaWavStreams[i], VITA_STREAM_RING_FRAMES / 4);
 		}
 
-		if(outl < -32768)
-			outl = -32768;
-		else if (outl > 32767)
-			outl = 32767;
+		sceKernelSignalSema(vitaWavStreamLock, 1);
 
-		if(outr < -32768)
-			outr = -32768;
-		else if (outr > 32767)
-			outr = 32767;
-
-		*(buf++) = outl;
-		*(buf++) = outr;
+		/* Every ring is full: a quarter of one lasts ~90 ms */
+		if(decoded == 0)
+			sceKernelDelayThread(10000);
 	}
+
+	sceKernelExitThread(0);
+
+	return(0);
 }
 
 int vitaWavInit(void)
 {
-	int i;
+	vitaMixerReset();
+	vitaMixerSetClock(vitaWavClock);
 
-	vitaAudioInit(0x40);
+	if(!vitaAudioInit(0x40))
+		return(0);
 
 	vitaAudioSetChannelCallback(0, wavout_snd_callback, 0);
 
-	for(i = 0; i < VITA_WAV_MAX_SLOTS; i++)
-		vitaWavPlaying[i] = 0;
+	memset(vitaWavStreams, 0, sizeof(vitaWavStreams));
+	vitaWavStreamTerminate = 0;
+	vitaWavStreamLock = sceKernelCreateSema("PgeStreamLock", 0, 1, 1, NULL);
+	vitaWavStreamThreadHandle = sceKernelCreateThread("PgeStreamThread", (void*)&vitaWavStreamThread, 0x50, 0x4000, 0, 0, NULL);
+
+	if(vitaWavStreamThreadHandle >= 0)
+		sceKernelStartThread(vitaWavStreamThreadHandle, 0, NULL);
 
 	vitaWavInitFlag = 1;
 
@@ -318,27 +333,37 @@ int vitaWavInit(void)
 
 void vitaWavShutdown(void)
 {
-	if(vitaWavInitFlag)
-		vitaAudioShutdown();
-}
+	if(!vitaWavInitFlag)
+		return;
 
-void vitaWavStop(vitaWav *wav)
-{
-	int i;
+	vitaWavStreamTerminate = 1;
+
+	if(vitaWavStreamThreadHandle >= 0)
+	{
+		sceKernelWaitThreadEnd(vitaWavStreamThreadHandle, NULL, NULL);
+		sceKernelDeleteThread(vitaWavStreamThreadHandle);
+		vitaWavStreamThreadHandle = -1;
+	}
+
+	vitaAudioShutdown();
 
-	for(i = 0; i < VITA_WAV_MAX_SLOTS; i++)
+	if(vitaWavStreamLock >= 0)
 	{
-		if(wav->id == vitaWavId[i])
-			vitaWavPlaying[i] = 0;
+		sceKernelDeleteSema(vitaWavStreamLock);
+		vitaWavStreamLock = -1;
 	}
+
+	vitaWavInitFlag = 0;
 }
 
-void vitaWavStopAll(void)
+void vitaWavStop(vitaWav *wav)
 {
-	int i;
+	vitaMixerStop(wav->id);
+}
 
-	for(i = 0; i < VITA_WAV_MAX_SLOTS; i++)
-		vitaWavPlaying[i] = 0;
+void vitaWavStopAll(void)
+{
+	vitaMixerStopAll();
 }
 
 void vitaWavLoop(vitaWav *wav, unsigned int loop)
@@ -348,40 +373,208 @@ void vitaWavLoop(vitaWav *wav, unsigned int loop)
 
 int vitaWavPlay(vitaWav *wav)
 {
-	if(!vitaWavInitFlag)
+	if(!vitaWavInitFlag || wav->data == NULL)
 		return(0);
 
-	int i;
+	return vitaMixerPlay(wav, VITA_VOLUME_MAX);
+}
 
-	vitaWav *wid;
+void vitaWavSetVolume(vitaWav *wav, int volume)
+{
+	if(volume < 0)
+		volume = 0;
+	else if(volume > VITA_VOLUME_MAX)
+		volume = VITA_VOLUME_MAX;
 
-	for(i = 0;i < VITA_WAV_MAX_SLOTS;i++)
+	vitaMixerSetVolume(wav->id, volume);
+}
+
+void vitaWavSetTick(unsigned int tick)
+{
+	vitaMixerSetTick(tick);
+}
+
+void vitaWavSetTickRate(unsigned int hz)
+{
+	vitaMixerSetTickRate(hz);
+}
+
+static int vitaWavStreamRead(void *file, void *buf, unsigned int size, unsigned long offset)
+{
+	return sceIoPread(*(int *)file, buf, size, offset);
+}
+
+vitaStream *vitaWavStreamOpen(const char *filename)
+{
+	vitaWavStreamFile *file;
+	unsigned char header[0x12c];
+	int i, n;
+
+	if(!vitaWavInitFlag)
+		return NULL;
+
+	int fd = sceIoOpen(filename, SCE_O_RDONLY, 0777);
+
+	if(fd < 0)
+		return NULL;
+
+	n = sceIoRead(fd, header, sizeof(header));
+
+	file = malloc(sizeof(vitaWavStreamFile));
+
+	if(file == NULL || n < 0 || !vitaStreamOpen(&file->stream, header, n, vitaWavStreamRead, &file->fd))
 	{
-		if(vitaWavPlaying[i] == 0)
+		free(file);
+		sceIoClose(fd);
+		return NULL;
+	}
+
+	file->fd = fd;
+	vitaStreamRewind(&file->stream, 0);
+
+	/* Hand it over to the I/O thread, which starts reading ahead */
+	sceKernelWaitSema(vitaWavStreamLock, 1, NULL);
+
+	for(i = 0; i < VITA_MIXER_MAX_STREAMS; i++)
+	{
+		if(vitaWavStreams[i] == NULL)
+		{
+			vitaWavStreams[i] = &file->stream;
 			break;
+		}
 	}
 
-	if(i == VITA_WAV_MAX_SLOTS)
-		return(0);
+	sceKernelSignalSema(vitaWavStreamLock, 1);
+
+	if(i == VITA_MIXER_MAX_STREAMS)
+	{
+		free(file);
+		sceIoClose(fd);
+		return NULL;
+	}
+
+	return &file->stream;
+}
 
-	wid = &vitaWavInfo[i];
-	wid->channels = wav->channels;
-	wid->sampleRate = wav->sampleRate;
-	wid->sampleCount = wav->sampleCount;
-	wid->dataLength = wav->dataLength;
-	wid->data = wav->data;
-	wid->rateRatio = wav->rateRatio;
-	wid->playPtr = 0;
-	wid->playPtr_frac = 0;
-	wid->loop = wav->loop;
-	wid->id = wav->id;
-	vitaWavPlaying[i] = 1;
-	vitaWavId[i] = wav->id;
-	wid->bitPerSample = wav->bitPerSample;
+/*
+ * Waits for the audio thread to let go of the stream, at most
+ * VITA_WAV_STREAM_TIMEOUT
+ *
+ * @returns 1 once it has, 0 on timeout.
+ */
+static int vitaWavStreamWait(vitaStream *stream)
+{
+	unsigned int waited = 0;
+
+	while(!vitaMixerStreamIdle(stream))
+	{
+		if(waited >= VITA_WAV_STREAM_TIMEOUT)
+			return(0);
+
+		sceKernelDelayThread(1000);
+		waited += 1000;
+	}
 
 	return(1);
 }
 
+int vitaWavStreamPlay(vitaStream *stream, unsigned int loop)
+{
+	if(!vitaWavStreamStop(stream))
+		return(0);
+
+	/* The I/O thread decodes the start, the mixer waits until it has */
+	sceKernelWaitSema(vitaWavStreamLock, 1, NULL);
+	vitaStreamRewind(stream, loop);
+	sceKernelSignalSema(vitaWavStreamLock, 1);
+
+	return vitaMixerPlayStream(stream);
+}
+
+int vitaWavStreamStop(vitaStream *stream)
+{
+	unsigned int waited = 0;
+
+	/* No audio thread: nothing reads the ring, nothing would answer */
+	if(!vitaAudioReady || vitaMixerStreamIdle(stream))
+		return(1);
+
+	/* A full command queue is drained by the next buffer */
+	while(!vitaMixerStopStream(stream))
+	{
+		if(waited >= VITA_WAV_STREAM_TIMEOUT)
+			return(0);
+
+		sceKernelDelayThread(1000);
+		waited += 1000;
+	}
+
+	return vitaWavStreamWait(stream);
+}
+
+void vitaWavStreamClose(vitaStream *stream)
+{
+	vitaWavStreamFile *file = (vitaWavStreamFile *)stream;
+	int i, stopped;
+
+	if(stream == NULL)
+		return;
+
+	stopped = vitaWavStreamStop(stream);
+
+	sceKernelWaitSema(vitaWavStreamLock, 1, NULL);
+
+	for(i = 0; i < VITA_MIXER_MAX_STREAMS; i++)
+	{
+		if(vitaWavStreams[i] == stream)
+			vitaWavStreams[i] = NULL;
+	}
+
+	sceKernelSignalSema(vitaWavStreamLock, 1);
+
+	sceIoClose(file->fd);
+
+	/* Still attached: the mixer may read the ring, so the block is leaked */
+	if(stopped)
+		free(file);
+}
+
+void vitaWavStreamSetVolume(vitaStream *stream, int volume)
+{
+	if(volume < 0)
+		volume = 0;
+	else if(volume > VITA_VOLUME_MAX)
+		volume = VITA_VOLUME_MAX;
+
+	__atomic_store_n(&stream->volume, volume, __ATOMIC_RELAXED);
+}
+
+void vitaWavStreamGetStats(vitaStream *stream, vitaStreamStats *stats)
+{
+	stats->capacity = __atomic_load_n(&stream->stats.capacity, __ATOMIC_RELAXED);
+	stats->fill = __atomic_load_n(&stream->stats.fill, __ATOMIC_RELAXED);
+	stats->minFill = __atomic_load_n(&stream->stats.minFill, __ATOMIC_RELAXED);
+	stats->buffers = __atomic_load_n(&stream->stats.buffers, __ATOMIC_RELAXED);
+	stats->starvations = __atomic_load_n(&stream->stats.starvations, __ATOMIC_RELAXED);
+	stats->loops = __atomic_load_n(&stream->stats.loops, __ATOMIC_RELAXED);
+	stats->decoded = __atomic_load_n(&stream->stats.decoded, __ATOMIC_RELAXED);
+}
+
+void vitaWavSetPeriod(unsigned int samples)
+{
+	vitaAudioSetPeriod(0, samples);
+}
+
+void vitaWavGetStats(vitaAudioStats *stats)
+{
+	vitaMixerGetStats(stats);
+}
+
+void vitaWavResetStats(void)
+{
+	vitaMixerResetStats();
+}
+
 static vitaWav *vitaWavLoadInternal(vitaWav *wav, unsigned char *wavfile, int size)
 {
 	unsigned long channels;
@@ -461,9 +654,52 @@ static vitaWav *vitaWavLoadInternal(vitaWav *wav, unsigned char *wavfile, int si
 	wav->id = vitaWavIdFlag;
 	wav->bitPerSample = bitpersample;
 
+	if(vitaWavConvertFlag)
+	{
+		vitaWav *native = vitaWavConvert(wav);
+
+		if(native != wav)
+			free(wav);
+
+		return native;
+	}
+
 	return wav;
 }
 
+void vitaWavSetConvertOnLoad(int convert)
+{
+	vitaWavConvertFlag = convert;
+}
+
+vitaWav *vitaWavConvert(vitaWav *wav)
+{
+	vitaWav *native;
+	unsigned long frames;
+
+	if(wav == NULL)
+		return NULL;
+
+	frames = vitaMixerConvertedFrames(wav);
+
+	native = malloc(sizeof(vitaWav) + frames * 2 * sizeof(short));
+	if(native == NULL)
+		return wav;
+
+	*native = *wav;
+	native->data = (unsigned char *)(native) + sizeof(vitaWav);
+	vitaMixerConvert(wav, (short *)native->data);
+
+	native->channels = 2;
+	native->bitPerSample = 16;
+	native->sampleRate = VITA_AUDIO_FREQUENCY;
+	native->sampleCount = frames;
+	native->dataLength = frames * 2 * sizeof(short);
+	native->rateRatio = 0x10000;
+
+	return native;
+}
+
 vitaWav *vitaWavLoad(const char *filename)
 {
 	unsigned long filelen;
@@ -496,14 +732,30 @@ vitaWav *vitaWavLoadMemory(const unsigned char *buffer, int size)
 	unsigned char *wavfile;
 	vitaWav *wav;
 
-	wav = malloc(size + sizeof(wav));
-	wavfile = (unsigned char*)(wav) + sizeof(wav);
+	wav = malloc(size + sizeof(vitaWav));
+	wavfile = (unsigned char*)(wav) + sizeof(vitaWav);
 
 	memcpy(wavfile, (unsigned char*)buffer, size);
 
 	return(vitaWavLoadInternal(wav, wavfile, size));
 }
 
+int vitaWavLoadPack(vitaWav *wav, const vitaPack *pack, const char *name)
+{
+	const vitaPackEntry *entry = vitaPackFind(pack, name);
+
+	if(entry == NULL || !vitaPackParseWav(wav, vitaPackData(pack, entry), entry->size))
+	{
+		memset(wav, 0, sizeof(*wav));
+		return(0);
+	}
+
+	vitaWavIdFlag++;
+	wav->id = vitaWavIdFlag;
+
+	return(1);
+}
+
 void vitaWavUnload(vitaWav *wav)
 {
 	if(wav != NULL)
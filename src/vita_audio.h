@@ -17,8 +17,10 @@ extern "C" {
 #define VITA_WAV_MAX_SLOTS 128
 
 #define VITA_NUM_AUDIO_CHANNELS	1 // 4
-#define VITA_NUM_AUDIO_SAMPLES	1024
+#define VITA_NUM_AUDIO_SAMPLES	1024 // Longest period
+#define VITA_MIN_AUDIO_SAMPLES	64
 #define VITA_VOLUME_MAX			0x8000
+#define VITA_AUDIO_FREQUENCY	44100
 
 typedef void (* vitaAudioCallback)(void *buf, unsigned int reqn, void *pdata);
 
@@ -44,6 +46,39 @@ typedef struct
 	unsigned int bitPerSample;	/**<  The bit rate of the WAV */
 } vitaWav;
 
+/**
+ * Playback statistics, for tuning the period
+ */
+typedef struct
+{
+	unsigned long plays;			/**<  Plays measured */
+	unsigned long long latencySum;	/**<  Sum of their latencies (us) */
+	unsigned int latencyMin;		/**<  Shortest latency (us) */
+	unsigned int latencyMax;		/**<  Longest latency (us) */
+	unsigned long buffers;			/**<  Buffers output */
+	unsigned long underruns;		/**<  Buffers output late */
+	unsigned int period;			/**<  Current period (frames) */
+} vitaAudioStats;
+
+/**
+ * A WAV file played as it is read, see vitaWavStreamOpen
+ */
+typedef struct vitaStream vitaStream;
+
+/**
+ * Streaming statistics, in native frames
+ */
+typedef struct
+{
+	unsigned int capacity;			/**<  Size of the ring */
+	unsigned int fill;				/**<  Frames buffered after the last mix */
+	unsigned int minFill;			/**<  Fewest frames left after a mix */
+	unsigned long buffers;			/**<  Buffers mixed */
+	unsigned long starvations;		/**<  Buffers the ring could not fill */
+	unsigned long loops;			/**<  Times the stream looped */
+	unsigned long long decoded;		/**<  Frames decoded */
+} vitaStreamStats;
+
 /**
  * Initialise the WAV playback
  *
@@ -76,6 +111,48 @@ vitaWav *vitaWavLoad(const char *filename);
  */
 vitaWav *vitaWavLoadMemory(const unsigned char *buffer, int size);
 
+/**
+ * Convert WAV files to the mixer's native format when they are loaded
+ *
+ * Loading then resamples them once to VITA_AUDIO_FREQUENCY stereo s16,
+ * with cubic interpolation, instead of stepping through the original
+ * samples every time they are mixed.
+ *
+ * @param convert - Set to 1 to convert, 0 to keep the files as they are.
+ */
+void vitaWavSetConvertOnLoad(int convert);
+
+/**
+ * Convert a loaded WAV to the mixer's native format
+ *
+ * The input is left as it is, whether it came from vitaWavLoad,
+ * vitaWavLoadMemory or vitaWavLoadPack: once the result differs from it, the
+ * caller may unload or drop it. Unload the result with vitaWavUnload.
+ *
+ * @param wav - A valid ::vitaWav.
+ *
+ * @returns The converted ::vitaWav, or wav itself if out of memory.
+ */
+vitaWav *vitaWavConvert(vitaWav *wav);
+
+typedef struct vitaPack vitaPack;
+
+/**
+ * Describe a WAV stored in an asset pack, without allocating or copying
+ *
+ * The ::vitaWav points at the samples inside the pack, which must stay
+ * open while it is played. Do not vitaWavUnload it.
+ *
+ * @param wav - The ::vitaWav to fill in.
+ *
+ * @param pack - An open pack, see vita_pack.h.
+ *
+ * @param name - Name of the asset in the pack.
+ *
+ * @returns 1 on success, 0 if there is no such WAV in the pack.
+ */
+int vitaWavLoadPack(vitaWav *wav, const vitaPack *pack, const char *name);
+
 /**
  * Unload a previously loaded WAV file
  *
@@ -115,10 +192,125 @@ void vitaWavStopAll(void);
  */
 void vitaWavLoop(vitaWav *wav, unsigned int loop);
 
+/**
+ * Set the volume of every playing instance of a WAV
+ *
+ * @param wav - A pointer to a valid ::vitaWav struct.
+ *
+ * @param volume - 0 to VITA_VOLUME_MAX.
+ */
+void vitaWavSetVolume(vitaWav *wav, int volume);
+
+/**
+ * Set the game tick stamped on the following play/stop requests
+ *
+ * Requests are applied by the audio thread at its next buffer; with a
+ * tick rate set, sounds requested on later ticks start proportionally
+ * later within that buffer.
+ *
+ * @param tick - Current game tick.
+ */
+void vitaWavSetTick(unsigned int tick);
+
+/**
+ * Set the rate of the ticks given to vitaWavSetTick
+ *
+ * @param hz - Ticks per second, 0 to start every sound on the buffer boundary.
+ */
+void vitaWavSetTickRate(unsigned int hz);
+
+/**
+ * Open a WAV file for streaming
+ *
+ * Unlike vitaWavLoad, only a ring of ~370 ms of decoded frames is kept in
+ * memory: a background thread reads and decodes the file ahead of the
+ * mixer. At most VITA_MIXER_MAX_STREAMS streams can be open at once.
+ *
+ * @param filename - Path of the file to stream.
+ *
+ * @returns A pointer to a ::vitaStream or NULL on error.
+ */
+vitaStream *vitaWavStreamOpen(const char *filename);
+
+/**
+ * Play a stream from the start
+ *
+ * @param stream - A valid ::vitaStream.
+ *
+ * @param loop - Set to 1 to loop without a gap, 0 to playback once.
+ *
+ * @returns 1 on success, 0 if the stream could not be stopped or the
+ * command queue is full. The background thread decodes the start, so
+ * the sound begins a buffer or two later.
+ */
+int vitaWavStreamPlay(vitaStream *stream, unsigned int loop);
+
+/**
+ * Stop playing a stream, waiting for the audio thread to let go of it
+ *
+ * Gives up after 200 ms if the audio thread does not answer.
+ *
+ * @param stream - A valid ::vitaStream.
+ *
+ * @returns 1 once stopped, 0 on timeout: the stream is still playing.
+ */
+int vitaWavStreamStop(vitaStream *stream);
+
+/**
+ * Stop and close a stream
+ *
+ * @param stream - A valid ::vitaStream.
+ */
+void vitaWavStreamClose(vitaStream *stream);
+
+/**
+ * Set the volume of a stream
+ *
+ * @param stream - A valid ::vitaStream.
+ *
+ * @param volume - 0 to VITA_VOLUME_MAX.
+ */
+void vitaWavStreamSetVolume(vitaStream *stream, int volume);
+
+/**
+ * Read the fill level and starvation count of a stream
+ *
+ * @param stream - A valid ::vitaStream.
+ *
+ * @param stats - Filled with the statistics since the stream was last played.
+ */
+void vitaWavStreamGetStats(vitaStream *stream, vitaStreamStats *stats);
+
+/**
+ * Set the period of the WAV playback
+ *
+ * Shorter periods cut the delay between vitaWavPlay and the sound being
+ * heard (a sound waits for the buffer being played and the one being
+ * mixed), at the cost of mixing more often. Applied by the audio thread
+ * between two buffers.
+ *
+ * @param samples - Frames per buffer, rounded down to a multiple of
+ * VITA_MIN_AUDIO_SAMPLES, up to VITA_NUM_AUDIO_SAMPLES.
+ */
+void vitaWavSetPeriod(unsigned int samples);
+
+/**
+ * Read the trigger to output latency of the WAVs played, and the underruns
+ *
+ * @param stats - Filled with the statistics since the last reset.
+ */
+void vitaWavGetStats(vitaAudioStats *stats);
+
+/**
+ * Clear the playback statistics
+ */
+void vitaWavResetStats(void);
+
 /** @} */
 
 void vitaAudioSetVolume(int channel, int left, int right);
 int vitaAudioSetFrequency(int channel, unsigned short freq);
+void vitaAudioSetPeriod(int channel, unsigned int samples);
 void vitaAudioSetChannelCallback(int channel, vitaAudioCallback callback, void *data);
 int vitaAudioInit(int priority);
 void vitaAudioShutdown(void);
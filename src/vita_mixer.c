@@ -0,0 +1,741 @@
+#include <string.h>
+#include "vita_mixer.h"
+#include "vita_stream.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define VITA_MIX_INLINE static inline __attribute__((always_inline))
+
+typedef struct
+{
+	vitaWav wav;
+	int volume;			/* 0 to VITA_VOLUME_MAX */
+	unsigned int delay;	/* Silent frames before the first sample */
+} vitaMixerVoice;
+
+static vitaMixerVoice vitaMixerVoices[VITA_WAV_MAX_SLOTS];
+
+/* Slots of the playing voices, and of the free ones */
+static int vitaMixerActive[VITA_WAV_MAX_SLOTS];
+static int vitaMixerActiveCount = 0;
+static int vitaMixerFree[VITA_WAV_MAX_SLOTS];
+static int vitaMixerFreeCount = 0;
+
+/* 32 bit accumulator, saturated once every voice has been mixed */
+static int vitaMixerBuffer[VITA_NUM_AUDIO_SAMPLES * 2];
+
+enum
+{
+	VITA_MIXER_PLAY,
+	VITA_MIXER_STOP,
+	VITA_MIXER_STOP_ALL,
+	VITA_MIXER_VOLUME,
+	VITA_MIXER_TICK_RATE,
+	VITA_MIXER_RESET_STATS,
+	VITA_MIXER_STREAM_PLAY,
+	VITA_MIXER_STREAM_STOP
+};
+
+typedef struct
+{
+	int op;
+	unsigned int tick;	/* Game tick the command was issued at */
+	unsigned long long micros;	/* Clock time it was issued at */
+	unsigned long id;
+	int volume;
+	vitaStream *stream;
+	vitaWav wav;		/* Copy of the WAV to play */
+} vitaMixerCommand;
+
+/*
+ * Single producer (game thread), single consumer (audio thread) ring.
+ * Each index is written by one side only, and published with a release
+ * store once the slot it covers is written (or read), so neither side
+ * ever waits on the other.
+ */
+#define VITA_MIXER_QUEUE_SIZE 256 /* Power of two */
+#define VITA_MIX_ALIGNED __attribute__((aligned(64)))
+
+static vitaMixerCommand vitaMixerQueue[VITA_MIXER_QUEUE_SIZE];
+static unsigned int vitaMixerQueueHead VITA_MIX_ALIGNED = 0; /* Next to read, written by the consumer */
+static unsigned int vitaMixerQueueTail VITA_MIX_ALIGNED = 0; /* Next to write, written by the producer */
+
+/* Producer side state */
+static unsigned int vitaMixerTick VITA_MIX_ALIGNED = 0;
+static unsigned long vitaMixerDropped = 0;
+static vitaMixerClock vitaMixerNow = NULL;
+
+/* Consumer side state */
+static unsigned int vitaMixerTickHz = 0;
+static int vitaMixerActiveShared = 0;
+
+/* Streams being mixed */
+static vitaStream *vitaMixerStreams[VITA_MIXER_MAX_STREAMS];
+static int vitaMixerStreamCount = 0;
+
+/* Plays started in the last buffer mixed, waiting for it to be output */
+static unsigned long long vitaMixerStartMicros[VITA_WAV_MAX_SLOTS];
+static unsigned int vitaMixerStartDelay[VITA_WAV_MAX_SLOTS];
+static int vitaMixerStartCount = 0;
+static unsigned long long vitaMixerLastOutput = 0;
+static unsigned int vitaMixerLastFrames = 0;
+
+/* Written by the audio thread, read field by field by the game thread */
+static vitaAudioStats vitaMixerStats;
+
+#define VITA_MIX_STORE(field, value) __atomic_store_n(&vitaMixerStats.field, (value), __ATOMIC_RELAXED)
+
+void vitaMixerReset(void)
+{
+	int i;
+
+	vitaMixerActiveCount = 0;
+	vitaMixerActiveShared = 0;
+	vitaMixerFreeCount = VITA_WAV_MAX_SLOTS;
+
+	vitaMixerQueueHead = 0;
+	vitaMixerQueueTail = 0;
+	vitaMixerTick = 0;
+	vitaMixerTickHz = 0;
+	vitaMixerDropped = 0;
+
+	vitaMixerStreamCount = 0;
+	vitaMixerStartCount = 0;
+	vitaMixerLastOutput = 0;
+	vitaMixerLastFrames = 0;
+	memset(&vitaMixerStats, 0, sizeof(vitaMixerStats));
+
+	for(i = 0; i < VITA_WAV_MAX_SLOTS; i++)
+		vitaMixerFree[i] = VITA_WAV_MAX_SLOTS - 1 - i;
+}
+
+static int vitaMixerPush(vitaMixerCommand *cmd)
+{
+	unsigned int tail = vitaMixerQueueTail;
+
+	if(tail - __atomic_load_n(&vitaMixerQueueHead, __ATOMIC_ACQUIRE) == VITA_MIXER_QUEUE_SIZE)
+	{
+		vitaMixerDropped++;
+		return(0);
+	}
+
+	cmd->tick = vitaMixerTick;
+	cmd->micros = vitaMixerNow ? vitaMixerNow() : 0;
+	vitaMixerQueue[tail & (VITA_MIXER_QUEUE_SIZE - 1)] = *cmd;
+	__atomic_store_n(&vitaMixerQueueTail, tail + 1, __ATOMIC_RELEASE);
+
+	return(1);
+}
+
+int vitaMixerPlay(const vitaWav *wav, int volume)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_PLAY;
+	cmd.id = wav->id;
+	cmd.volume = volume;
+	cmd.wav = *wav;
+
+	return vitaMixerPush(&cmd);
+}
+
+int vitaMixerStop(unsigned long id)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_STOP;
+	cmd.id = id;
+
+	return vitaMixerPush(&cmd);
+}
+
+int vitaMixerStopAll(void)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_STOP_ALL;
+
+	return vitaMixerPush(&cmd);
+}
+
+int vitaMixerSetVolume(unsigned long id, int volume)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_VOLUME;
+	cmd.id = id;
+	cmd.volume = volume;
+
+	return vitaMixerPush(&cmd);
+}
+
+int vitaMixerPlayStream(vitaStream *stream)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_STREAM_PLAY;
+	cmd.stream = stream;
+
+	if(!vitaMixerPush(&cmd))
+		return(0);
+
+	stream->commands++;
+	return(1);
+}
+
+int vitaMixerStopStream(vitaStream *stream)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_STREAM_STOP;
+	cmd.stream = stream;
+
+	if(!vitaMixerPush(&cmd))
+		return(0);
+
+	stream->commands++;
+	return(1);
+}
+
+int vitaMixerStreamIdle(const vitaStream *stream)
+{
+	return __atomic_load_n(&stream->applied, __ATOMIC_ACQUIRE) == stream->commands &&
+	       !__atomic_load_n(&stream->attached, __ATOMIC_ACQUIRE);
+}
+
+int vitaMixerSetTickRate(unsigned int hz)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_TICK_RATE;
+	cmd.volume = hz;
+
+	return vitaMixerPush(&cmd);
+}
+
+void vitaMixerSetTick(unsigned int tick)
+{
+	vitaMixerTick = tick;
+}
+
+void vitaMixerSetClock(vitaMixerClock clock)
+{
+	vitaMixerNow = clock;
+}
+
+int vitaMixerResetStats(void)
+{
+	vitaMixerCommand cmd;
+
+	cmd.op = VITA_MIXER_RESET_STATS;
+
+	return vitaMixerPush(&cmd);
+}
+
+void vitaMixerGetStats(vitaAudioStats *stats)
+{
+	stats->plays = __atomic_load_n(&vitaMixerStats.plays, __ATOMIC_RELAXED);
+	stats->latencySum = __atomic_load_n(&vitaMixerStats.latencySum, __ATOMIC_RELAXED);
+	stats->latencyMin = __atomic_load_n(&vitaMixerStats.latencyMin, __ATOMIC_RELAXED);
+	stats->latencyMax = __atomic_load_n(&vitaMixerStats.latencyMax, __ATOMIC_RELAXED);
+	stats->buffers = __atomic_load_n(&vitaMixerStats.buffers, __ATOMIC_RELAXED);
+	stats->underruns = __atomic_load_n(&vitaMixerStats.underruns, __ATOMIC_RELAXED);
+	stats->period = __atomic_load_n(&vitaMixerStats.period, __ATOMIC_RELAXED);
+}
+
+unsigned long vitaMixerDroppedCommands(void)
+{
+	return vitaMixerDropped;
+}
+
+int vitaMixerActiveVoices(void)
+{
+	return __atomic_load_n(&vitaMixerActiveShared, __ATOMIC_RELAXED);
+}
+
+/* Everything below runs on the audio thread */
+
+static void vitaMixerStart(const vitaMixerCommand *cmd, unsigned int delay)
+{
+	int slot;
+	vitaMixerVoice *voice;
+
+	if(vitaMixerFreeCount == 0)
+		return;
+
+	slot = vitaMixerFree[--vitaMixerFreeCount];
+
+	voice = &vitaMixerVoices[slot];
+	voice->wav = cmd->wav;
+	voice->wav.playPtr = 0;
+	voice->wav.playPtr_frac = 0;
+	voice->volume = cmd->volume;
+	voice->delay = delay;
+
+	vitaMixerActive[vitaMixerActiveCount++] = slot;
+
+	if(cmd->micros != 0 && vitaMixerStartCount < VITA_WAV_MAX_SLOTS)
+	{
+		vitaMixerStartMicros[vitaMixerStartCount] = cmd->micros;
+		vitaMixerStartDelay[vitaMixerStartCount] = delay;
+		vitaMixerStartCount++;
+	}
+}
+
+static void vitaMixerRemove(int i)
+{
+	vitaMixerFree[vitaMixerFreeCount++] = vitaMixerActive[i];
+	vitaMixerActive[i] = vitaMixerActive[--vitaMixerActiveCount];
+}
+
+/* Once detached, the game thread may rewind or free the stream */
+static void vitaMixerDetach(int i)
+{
+	__atomic_store_n(&vitaMixerStreams[i]->attached, 0, __ATOMIC_RELEASE);
+	vitaMixerStreams[i] = vitaMixerStreams[--vitaMixerStreamCount];
+}
+
+static void vitaMixerStreamCommand(const vitaMixerCommand *cmd)
+{
+	int i;
+
+	for(i = 0; i < vitaMixerStreamCount; i++)
+	{
+		if(vitaMixerStreams[i] == cmd->stream)
+			break;
+	}
+
+	if(cmd->op == VITA_MIXER_STREAM_PLAY)
+	{
+		if(i == vitaMixerStreamCount && vitaMixerStreamCount < VITA_MIXER_MAX_STREAMS)
+		{
+			__atomic_store_n(&cmd->stream->attached, 1, __ATOMIC_RELAXED);
+			vitaMixerStreams[vitaMixerStreamCount++] = cmd->stream;
+		}
+	}
+	else if(i < vitaMixerStreamCount)
+	{
+		vitaMixerDetach(i);
+	}
+
+	__atomic_store_n(&cmd->stream->applied, cmd->stream->applied + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Applies the pending commands at the start of a buffer. With a tick rate
+ * set, a play is delayed by the ticks between it and the first command of
+ * the batch, so that sounds triggered on successive game ticks keep their
+ * spacing instead of all starting on the buffer boundary.
+ */
+static void vitaMixerDrain(unsigned int frames)
+{
+	unsigned int head = vitaMixerQueueHead;
+	unsigned int tail = __atomic_load_n(&vitaMixerQueueTail, __ATOMIC_ACQUIRE);
+	unsigned int base = 0;
+	int i;
+
+	if(head != tail)
+		base = vitaMixerQueue[head & (VITA_MIXER_QUEUE_SIZE - 1)].tick;
+
+	for(; head != tail; head++)
+	{
+		const vitaMixerCommand *cmd = &vitaMixerQueue[head & (VITA_MIXER_QUEUE_SIZE - 1)];
+		unsigned int delay = 0;
+
+		switch(cmd->op)
+		{
+			case VITA_MIXER_PLAY:
+				if(vitaMixerTickHz > 0 && frames > 0)
+				{
+					unsigned long long d = (unsigned long long)(cmd->tick - base) * VITA_AUDIO_FREQUENCY / vitaMixerTickHz;
+					delay = d < frames ? (unsigned int)d : frames - 1;
+				}
+				vitaMixerStart(cmd, delay);
+				break;
+
+			case VITA_MIXER_STOP:
+				for(i = vitaMixerActiveCount - 1; i >= 0; i--)
+				{
+					if(vitaMixerVoices[vitaMixerActive[i]].wav.id == cmd->id)
+						vitaMixerRemove(i);
+				}
+				break;
+
+			case VITA_MIXER_STOP_ALL:
+				while(vitaMixerActiveCount > 0)
+					vitaMixerRemove(vitaMixerActiveCount - 1);
+				break;
+
+			case VITA_MIXER_VOLUME:
+				for(i = 0; i < vitaMixerActiveCount; i++)
+				{
+					if(vitaMixerVoices[vitaMixerActive[i]].wav.id == cmd->id)
+						vitaMixerVoices[vitaMixerActive[i]].volume = cmd->volume;
+				}
+				break;
+
+			case VITA_MIXER_TICK_RATE:
+				vitaMixerTickHz = cmd->volume;
+				break;
+
+			case VITA_MIXER_STREAM_PLAY:
+			case VITA_MIXER_STREAM_STOP:
+				vitaMixerStreamCommand(cmd);
+				break;
+
+			case VITA_MIXER_RESET_STATS:
+				VITA_MIX_STORE(plays, 0);
+				VITA_MIX_STORE(latencySum, 0);
+				VITA_MIX_STORE(latencyMin, 0);
+				VITA_MIX_STORE(latencyMax, 0);
+				VITA_MIX_STORE(buffers, 0);
+				VITA_MIX_STORE(underruns, 0);
+				break;
+		}
+	}
+
+	__atomic_store_n(&vitaMixerQueueHead, head, __ATOMIC_RELEASE);
+}
+
+/*
+ * Block kernel: adds n frames read at ptr.frac, ptr.frac + rate, ... to out,
+ * scaled by vol / VITA_VOLUME_MAX (exact at full volume).
+ * Always inlined with constant channels and bits, so that each format gets
+ * its own loop without per-sample checks.
+ */
+VITA_MIX_INLINE void vitaMixerBlock(int *out, const unsigned char *data,
+                                    unsigned long ptr, unsigned long frac, unsigned long rate,
+                                    unsigned int n, int vol, const int channels, const int bits)
+{
+	const short *src16 = (const short *)data;
+	const unsigned char *src8 = data;
+	unsigned int i;
+
+	if(rate == 0x10000)
+	{
+		/* Native rate: contiguous reads */
+		if(channels == 1 && bits == 16)
+		{
+			for(i = 0; i < n; i++)
+			{
+				int s = (src16[ptr + i] * vol) >> 15;
+				out[2 * i] += s;
+				out[2 * i + 1] += s;
+			}
+		}
+		else if(channels == 1)
+		{
+			for(i = 0; i < n; i++)
+			{
+				int s = (((src8[ptr + i] * 256) - 32768) * vol) >> 15;
+				out[2 * i] += s;
+				out[2 * i + 1] += s;
+			}
+		}
+		else if(bits == 16)
+		{
+			/* The native format: a plain add, saturated with the rest */
+			src16 += ptr * 2;
+			if(vol == VITA_VOLUME_MAX)
+			{
+				for(i = 0; i < 2 * n; i++)
+					out[i] += src16[i];
+			}
+			else
+			{
+				for(i = 0; i < 2 * n; i++)
+					out[i] += (src16[i] * vol) >> 15;
+			}
+		}
+		else
+		{
+			src8 += ptr * 2;
+			for(i = 0; i < 2 * n; i++)
+				out[i] += (((src8[i] * 256) - 32768) * vol) >> 15;
+		}
+
+		return;
+	}
+
+	for(i = 0; i < n; i++)
+	{
+		if(channels == 1)
+		{
+			int s = (bits == 8) ? (src8[ptr] * 256) - 32768 : src16[ptr];
+			s = (s * vol) >> 15;
+			out[2 * i] += s;
+			out[2 * i + 1] += s;
+		}
+		else if(bits == 8)
+		{
+			out[2 * i] += (((src8[ptr * 2] * 256) - 32768) * vol) >> 15;
+			out[2 * i + 1] += (((src8[ptr * 2 + 1] * 256) - 32768) * vol) >> 15;
+		}
+		else
+		{
+			out[2 * i] += (src16[ptr * 2] * vol) >> 15;
+			out[2 * i + 1] += (src16[ptr * 2 + 1] * vol) >> 15;
+		}
+
+		frac += rate;
+		ptr += frac >> 16;
+		frac &= 0xffff;
+	}
+}
+
+static void vitaMixerDispatch(int *out, const vitaWav *wi, unsigned long long pos, unsigned int n, int vol)
+{
+	unsigned long ptr = (unsigned long)(pos >> 16), frac = (unsigned long)(pos & 0xffff);
+
+	if(wi->channels == 1)
+	{
+		if(wi->bitPerSample == 8)
+			vitaMixerBlock(out, wi->data, ptr, frac, wi->rateRatio, n, vol, 1, 8);
+		else
+			vitaMixerBlock(out, wi->data, ptr, frac, wi->rateRatio, n, vol, 1, 16);
+	}
+	else
+	{
+		if(wi->bitPerSample == 8)
+			vitaMixerBlock(out, wi->data, ptr, frac, wi->rateRatio, n, vol, 2, 8);
+		else
+			vitaMixerBlock(out, wi->data, ptr, frac, wi->rateRatio, n, vol, 2, 16);
+	}
+}
+
+/*
+ * Mixes up to frames frames of a voice into out, in as few blocks as
+ * possible (one, plus one per loop). Returns 0 once the voice is over.
+ */
+static int vitaMixerVoiceMix(vitaMixerVoice *voice, int *out, unsigned int frames)
+{
+	vitaWav *wi = &voice->wav;
+	unsigned long long end = (unsigned long long)wi->sampleCount << 16;
+	unsigned long long pos = ((unsigned long long)wi->playPtr << 16) | wi->playPtr_frac;
+	unsigned long rate = wi->rateRatio;
+	int playing = 1;
+
+	if(voice->delay >= frames)
+	{
+		voice->delay -= frames;
+		return(1);
+	}
+
+	out += 2 * voice->delay;
+	frames -= voice->delay;
+	voice->delay = 0;
+
+	while(frames > 0)
+	{
+		unsigned long long next = pos + rate;
+		unsigned int n;
+
+		if(next < end)
+		{
+			/* Every read until the end of the data */
+			unsigned long long avail = (end - 1 - next) / rate + 1;
+			n = avail < frames ? (unsigned int)avail : frames;
+
+			vitaMixerDispatch(out, wi, next, n, voice->volume);
+			pos = next + (unsigned long long)(n - 1) * rate;
+		}
+		else if(wi->loop)
+		{
+			/* Wrap around to the first sample */
+			n = 1;
+			pos = 0;
+			vitaMixerDispatch(out, wi, pos, n, voice->volume);
+		}
+		else
+		{
+			playing = 0;
+			break;
+		}
+
+		out += 2 * n;
+		frames -= n;
+	}
+
+	wi->playPtr = (unsigned long)(pos >> 16);
+	wi->playPtr_frac = (unsigned long)(pos & 0xffff);
+
+	return playing;
+}
+
+/* Sample of channel c at frame i, as s16, with the frame clamped to the data */
+static int vitaMixerSample(const vitaWav *wav, long i, int c)
+{
+	unsigned long n = i < 0 ? 0 : (unsigned long)i;
+
+	if(n >= wav->sampleCount)
+		n = wav->sampleCount - 1;
+
+	n = n * wav->channels + (wav->channels == 2 ? c : 0);
+
+	if(wav->bitPerSample == 8)
+		return (wav->data[n] * 256) - 32768;
+
+	return ((const short *)wav->data)[n];
+}
+
+unsigned long vitaMixerConvertedFrames(const vitaWav *wav)
+{
+	if(wav->sampleCount == 0)
+		return(0);
+
+	return (unsigned long)(((unsigned long long)(wav->sampleCount - 1) * VITA_AUDIO_FREQUENCY) / wav->sampleRate) + 1;
+}
+
+/*
+ * Resamples with a Catmull-Rom cubic through the four nearest frames; at
+ * the same rate every frame falls on a sample and is copied exactly.
+ */
+void vitaMixerConvert(const vitaWav *wav, short *dst)
+{
+	unsigned long frames = vitaMixerConvertedFrames(wav);
+	unsigned long long step = ((unsigned long long)wav->sampleRate << 32) / VITA_AUDIO_FREQUENCY;
+	unsigned long long pos = 0;
+	unsigned long j;
+	int c;
+
+	for(j = 0; j < frames; j++, pos += step)
+	{
+		long i = (long)(pos >> 32);
+		float t = (float)(pos & 0xffffffffULL) * (1.0f / 4294967296.0f);
+
+		for(c = 0; c < 2; c++)
+		{
+			float p0 = vitaMixerSample(wav, i - 1, c);
+			float p1 = vitaMixerSample(wav, i, c);
+			float p2 = vitaMixerSample(wav, i + 1, c);
+			float p3 = vitaMixerSample(wav, i + 2, c);
+			float s = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 + t * (3.0f * (p1 - p2) + p3 - p0)));
+			int v = (int)(s < 0 ? s - 0.5f : s + 0.5f);
+
+			if(v < -32768)
+				v = -32768;
+			else if(v > 32767)
+				v = 32767;
+
+			dst[2 * j + c] = v;
+		}
+	}
+}
+
+/* Clamps the 32 bit accumulator to s16 */
+static void vitaMixerSaturate(short *dst, const int *src, unsigned int n)
+{
+	unsigned int i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for(; i + 8 <= n; i += 8)
+	{
+		int16x4_t lo = vqmovn_s32(vld1q_s32(src + i));
+		int16x4_t hi = vqmovn_s32(vld1q_s32(src + i + 4));
+		vst1q_s16(dst + i, vcombine_s16(lo, hi));
+	}
+#elif defined(__SSE2__)
+	for(; i + 8 <= n; i += 8)
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hi = _mm_loadu_si128((const __m128i *)(src + i + 4));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+#endif
+
+	for(; i < n; i++)
+	{
+		int s = src[i];
+
+		if(s < -32768)
+			s = -32768;
+		else if(s > 32767)
+			s = 32767;
+
+		dst[i] = s;
+	}
+}
+
+void vitaMixerOutput(unsigned long long nowMicros, unsigned int frames)
+{
+	unsigned long long periodMicros = (unsigned long long)frames * 1000000 / VITA_AUDIO_FREQUENCY;
+	int i;
+
+	/*
+	 * The buffer before the last one mixed has just started: the last one
+	 * starts a period from now, and each play is heard delay frames later
+	 */
+	for(i = 0; i < vitaMixerStartCount; i++)
+	{
+		unsigned long long heard = nowMicros + periodMicros +
+			(unsigned long long)vitaMixerStartDelay[i] * 1000000 / VITA_AUDIO_FREQUENCY;
+		unsigned int latency = heard > vitaMixerStartMicros[i] ? (unsigned int)(heard - vitaMixerStartMicros[i]) : 0;
+
+		if(vitaMixerStats.plays == 0 || latency < vitaMixerStats.latencyMin)
+			VITA_MIX_STORE(latencyMin, latency);
+		if(latency > vitaMixerStats.latencyMax)
+			VITA_MIX_STORE(latencyMax, latency);
+		VITA_MIX_STORE(latencySum, vitaMixerStats.latencySum + latency);
+		VITA_MIX_STORE(plays, vitaMixerStats.plays + 1);
+	}
+	vitaMixerStartCount = 0;
+
+	/*
+	 * Buffers are handed over one period apart when the output keeps up.
+	 * A longer gap means the port ran dry: count it, with a quarter period
+	 * of slack for scheduling jitter. The first buffer after a period
+	 * change has nothing to compare with.
+	 */
+	if(vitaMixerLastOutput != 0 && frames == vitaMixerLastFrames &&
+	   nowMicros - vitaMixerLastOutput > periodMicros + periodMicros / 4)
+		VITA_MIX_STORE(underruns, vitaMixerStats.underruns + 1);
+
+	vitaMixerLastOutput = nowMicros;
+	vitaMixerLastFrames = frames;
+
+	VITA_MIX_STORE(buffers, vitaMixerStats.buffers + 1);
+	VITA_MIX_STORE(period, frames);
+}
+
+void vitaMixerMix(short *buf, unsigned int frames)
+{
+	int i;
+
+	if(frames > VITA_NUM_AUDIO_SAMPLES)
+		frames = VITA_NUM_AUDIO_SAMPLES;
+
+	vitaMixerDrain(frames);
+
+	if(vitaMixerActiveCount == 0 && vitaMixerStreamCount == 0)
+	{
+		__atomic_store_n(&vitaMixerActiveShared, 0, __ATOMIC_RELAXED);
+		memset(buf, 0, frames * 2 * sizeof(short));
+		return;
+	}
+
+	memset(vitaMixerBuffer, 0, frames * 2 * sizeof(int));
+
+	for(i = 0; i < vitaMixerActiveCount; )
+	{
+		if(vitaMixerVoiceMix(&vitaMixerVoices[vitaMixerActive[i]], vitaMixerBuffer, frames))
+			i++;
+		else
+			vitaMixerRemove(i); /* The last voice takes its place */
+	}
+
+	for(i = 0; i < vitaMixerStreamCount; )
+	{
+		if(vitaStreamMix(vitaMixerStreams[i], vitaMixerBuffer, frames))
+			i++;
+		else
+			vitaMixerDetach(i);
+	}
+
+	__atomic_store_n(&vitaMixerActiveShared, vitaMixerActiveCount, __ATOMIC_RELAXED);
+
+	vitaMixerSaturate(buf, vitaMixerBuffer, frames * 2);
+}
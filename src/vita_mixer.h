@@ -0,0 +1,155 @@
+/*
+ * vita_mixer.h: Software mixer behind the WAV playback
+ *
+ * Platform-free (no sce* calls) so that it can be benchmarked on the host.
+ */
+
+#ifndef __VITA_MIXER_H__
+#define __VITA_MIXER_H__
+
+#include "vita_audio.h"
+
+#define VITA_MIXER_MAX_STREAMS 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Stop every voice and empty the command queue
+ *
+ * Not thread safe: call it before the audio thread starts mixing.
+ */
+void vitaMixerReset(void);
+
+/*
+ * Commands: called from the game thread only. They are queued without
+ * blocking and applied by the audio thread at the start of its next buffer.
+ * Each returns 0 if the queue was full and the command dropped.
+ */
+
+/**
+ * Start a voice playing a copy of the given WAV
+ *
+ * @param volume - 0 to VITA_VOLUME_MAX.
+ */
+int vitaMixerPlay(const vitaWav *wav, int volume);
+
+/**
+ * Stop every voice playing the WAV with the given id
+ */
+int vitaMixerStop(unsigned long id);
+
+/**
+ * Stop every voice
+ */
+int vitaMixerStopAll(void);
+
+/**
+ * Change the volume of every voice playing the WAV with the given id
+ */
+int vitaMixerSetVolume(unsigned long id, int volume);
+
+/**
+ * Start mixing a stream, from wherever its ring is
+ */
+int vitaMixerPlayStream(vitaStream *stream);
+
+/**
+ * Stop mixing a stream
+ */
+int vitaMixerStopStream(vitaStream *stream);
+
+/**
+ * Whether the mixer has applied every command sent for the stream and no
+ * longer reads it, so that it can be rewound or freed
+ */
+int vitaMixerStreamIdle(const vitaStream *stream);
+
+/**
+ * Rate of the game ticks stamped on commands
+ *
+ * Once set, sounds started on different ticks are offset within the buffer
+ * that starts them by the time between those ticks.
+ */
+int vitaMixerSetTickRate(unsigned int hz);
+
+/**
+ * Game tick stamped on the following commands
+ */
+void vitaMixerSetTick(unsigned int tick);
+
+/**
+ * Clock in microseconds
+ */
+typedef unsigned long long (* vitaMixerClock)(void);
+
+/**
+ * Clock used to stamp commands, so that the latency of each play can be
+ * measured. Set it before the audio thread starts.
+ */
+void vitaMixerSetClock(vitaMixerClock clock);
+
+/**
+ * Clear the latency and underrun statistics
+ */
+int vitaMixerResetStats(void);
+
+/**
+ * Read the latency and underrun statistics
+ */
+void vitaMixerGetStats(vitaAudioStats *stats);
+
+/**
+ * Number of commands dropped because the queue was full
+ */
+unsigned long vitaMixerDroppedCommands(void);
+
+/**
+ * Number of voices playing at the end of the last buffer
+ */
+int vitaMixerActiveVoices(void);
+
+/**
+ * Number of frames of a WAV once converted by vitaMixerConvert
+ */
+unsigned long vitaMixerConvertedFrames(const vitaWav *wav);
+
+/**
+ * Convert a WAV to the mixer's native format: stereo s16 at
+ * VITA_AUDIO_FREQUENCY, so that mixing it needs no resampling
+ *
+ * @param dst - Output, vitaMixerConvertedFrames(wav) * 2 samples.
+ */
+void vitaMixerConvert(const vitaWav *wav, short *dst);
+
+/**
+ * Apply the queued commands, then mix the active voices into an interleaved stereo s16 buffer
+ *
+ * @param buf - Output buffer (frames * 2 samples).
+ *
+ * @param frames - Number of stereo frames, at most VITA_NUM_AUDIO_SAMPLES.
+ *
+ * Called from the audio thread only.
+ */
+void vitaMixerMix(short *buf, unsigned int frames);
+
+/**
+ * Record that the port has taken the last buffer mixed
+ *
+ * Called from the audio thread once the port has accepted that buffer: it
+ * has then just started playing the buffer before, and the last one waits
+ * behind it for a period. Completes the latency of the plays the last
+ * buffer starts, and checks the time since the previous call for underruns.
+ *
+ * @param nowMicros - Clock time, as given by the ::vitaMixerClock.
+ *
+ * @param frames - Period of the port, in frames.
+ */
+void vitaMixerOutput(unsigned long long nowMicros, unsigned int frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __VITA_MIXER_H__
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "vita_pack.h"
+
+int vitaPackOpen(vitaPack *pack, const void *data, unsigned long size)
+{
+	const vitaPackHeader *header = (const vitaPackHeader *)data;
+	const vitaPackEntry *entries;
+	unsigned int i;
+
+	memset(pack, 0, sizeof(*pack));
+
+	if(size < VITA_PACK_ALIGN || ((uintptr_t)data % VITA_PACK_ALIGN) != 0)
+		return(0);
+
+	if(memcmp(header->magic, VITA_PACK_MAGIC, 4) != 0 || header->version != VITA_PACK_VERSION)
+		return(0);
+
+	if(header->size > size || header->count > (size - VITA_PACK_ALIGN) / sizeof(vitaPackEntry))
+		return(0);
+
+	entries = (const vitaPackEntry *)((const unsigned char *)data + VITA_PACK_ALIGN);
+
+	for(i = 0; i < header->count; i++)
+	{
+		const vitaPackEntry *entry = &entries[i];
+
+		if(memchr(entry->name, 0, VITA_PACK_NAME_MAX) == NULL)
+			return(0);
+
+		if(entry->offset % VITA_PACK_ALIGN != 0 || entry->offset > header->size ||
+		   entry->size > header->size - entry->offset)
+			return(0);
+
+		if(i > 0 && strcmp(entries[i - 1].name, entry->name) >= 0)
+			return(0);
+	}
+
+	pack->base = (const unsigned char *)data;
+	pack->size = header->size;
+	pack->entries = entries;
+	pack->count = header->count;
+
+	return(1);
+}
+
+int vitaPackLoad(vitaPack *pack, const char *filename)
+{
+	FILE *file;
+	void *data;
+	long size;
+
+	memset(pack, 0, sizeof(*pack));
+
+	file = fopen(filename, "rb");
+	if(file == NULL)
+		return(0);
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = size > 0 ? memalign(VITA_PACK_ALIGN, size) : NULL;
+
+	if(data == NULL || fread(data, 1, size, file) != (size_t)size || !vitaPackOpen(pack, data, size))
+	{
+		free(data);
+		fclose(file);
+		return(0);
+	}
+
+	fclose(file);
+
+	pack->owned = data;
+
+	return(1);
+}
+
+void vitaPackClose(vitaPack *pack)
+{
+	free(pack->owned);
+	memset(pack, 0, sizeof(*pack));
+}
+
+const vitaPackEntry *vitaPackFind(const vitaPack *pack, const char *name)
+{
+	unsigned int lo = 0, hi = pack->count;
+
+	while(lo < hi)
+	{
+		unsigned int mid = (lo + hi) / 2;
+		int cmp = strcmp(pack->entries[mid].name, name);
+
+		if(cmp == 0)
+			return &pack->entries[mid];
+
+		if(cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return NULL;
+}
+
+const unsigned char *vitaPackData(const vitaPack *pack, const vitaPackEntry *entry)
+{
+	return pack->base + entry->offset;
+}
+
+int vitaPackParseWav(vitaWav *wav, const unsigned char *buffer, unsigned long size)
+{
+	unsigned long channels, samplerate, bitpersample, datalength, frameBytes;
+	unsigned int i;
+
+	memset(wav, 0, sizeof(*wav));
+
+	if(size < 0x2c || memcmp(buffer, "RIFF", 4) != 0)
+		return(0);
+
+	channels = *(const uint16_t *)(buffer + 0x16);
+	samplerate = *(const uint32_t *)(buffer + 0x18);
+	bitpersample = *(const uint16_t *)(buffer + 0x22);
+
+	for(i = 0; memcmp(buffer + 0x24 + i, "data", 4) != 0; i++)
+	{
+		if(i == 0xFF || 0x2c + i >= size)
+			return(0);
+	}
+
+	datalength = *(const uint32_t *)(buffer + 0x28 + i);
+
+	if(datalength > size - (0x2c + i))
+		return(0);
+
+	if(channels != 2 && channels != 1)
+		return(0);
+
+	if(bitpersample != 8 && bitpersample != 16)
+		return(0);
+
+	if(samplerate > 100000 || samplerate < 2000)
+		return(0);
+
+	frameBytes = channels * bitpersample / 8;
+
+	if(datalength < frameBytes)
+		return(0);
+
+	wav->channels = channels;
+	wav->sampleRate = samplerate;
+	wav->sampleCount = datalength / frameBytes;
+	wav->dataLength = datalength;
+	wav->data = (unsigned char *)(buffer + 0x2c + i);
+	wav->rateRatio = (samplerate * 0x4000) / 11025;
+	wav->bitPerSample = bitpersample;
+
+	return(1);
+}
@@ -0,0 +1,104 @@
+/*
+ * vita_pack.h: Packed asset archive
+ *
+ * A pack is one file holding every asset, built by tools/vitapack:
+ *
+ *   vitaPackHeader                      at 0
+ *   vitaPackEntry[count], sorted        at VITA_PACK_ALIGN
+ *   asset data, each VITA_PACK_ALIGN aligned
+ *
+ * It is read into memory once; assets are then used in place.
+ * Platform-free, so that the packer and the benchmarks share it.
+ */
+
+#ifndef __VITA_PACK_H__
+#define __VITA_PACK_H__
+
+#include <stdint.h>
+#include "vita_audio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VITA_PACK_MAGIC		"VPAK"
+#define VITA_PACK_VERSION	1
+#define VITA_PACK_ALIGN		64
+#define VITA_PACK_NAME_MAX	48
+
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t count;					/**<  Number of entries */
+	uint32_t size;					/**<  Size of the whole pack */
+	uint8_t reserved[VITA_PACK_ALIGN - 16];
+} vitaPackHeader;
+
+typedef struct
+{
+	char name[VITA_PACK_NAME_MAX];	/**<  NUL terminated, e.g. "beep.wav" */
+	uint32_t offset;				/**<  From the start of the pack */
+	uint32_t size;
+	uint32_t reserved[2];
+} vitaPackEntry;
+
+/**
+ * A pack in memory
+ */
+struct vitaPack
+{
+	const unsigned char *base;
+	unsigned long size;
+	const vitaPackEntry *entries;
+	unsigned int count;
+	void *owned;					/**<  Buffer allocated by vitaPackLoad */
+};
+
+/**
+ * Read a pack file into memory, with a single read, and open it
+ *
+ * @returns 1 on success, 0 on error.
+ */
+int vitaPackLoad(vitaPack *pack, const char *filename);
+
+/**
+ * Free a pack read by vitaPackLoad; its assets can no longer be used
+ */
+void vitaPackClose(vitaPack *pack);
+
+/**
+ * Check a pack and index it, without copying it
+ *
+ * @param data - The whole pack, VITA_PACK_ALIGN aligned. Must outlive the pack.
+ *
+ * @returns 1 on success, 0 if the data is not a valid pack.
+ */
+int vitaPackOpen(vitaPack *pack, const void *data, unsigned long size);
+
+/**
+ * Find an asset by name (binary search)
+ *
+ * @returns The entry, or NULL if the pack has no such asset.
+ */
+const vitaPackEntry *vitaPackFind(const vitaPack *pack, const char *name);
+
+/**
+ * Data of an entry, in place
+ */
+const unsigned char *vitaPackData(const vitaPack *pack, const vitaPackEntry *entry);
+
+/**
+ * Describe a WAV file in memory, pointing at its samples in place
+ *
+ * @param wav - Filled in; its id is left to the caller.
+ *
+ * @returns 1 on success, 0 if the buffer is not a supported WAV.
+ */
+int vitaPackParseWav(vitaWav *wav, const unsigned char *buffer, unsigned long size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __VITA_PACK_H__
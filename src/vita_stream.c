@@ -0,0 +1,245 @@
+#include <string.h>
+#include "vita_stream.h"
+
+#define VITA_STREAM_MASK (VITA_STREAM_RING_FRAMES - 1)
+#define VITA_STREAM_STORE(field, value) __atomic_store_n(&stream->stats.field, (value), __ATOMIC_RELAXED)
+
+int vitaStreamOpen(vitaStream *stream, const unsigned char *header, unsigned int size,
+                   vitaStreamReader read, void *file)
+{
+	unsigned int i;
+
+	memset(stream, 0, sizeof(*stream));
+
+	if(size < 0x2c || memcmp(header, "RIFF", 4) != 0)
+		return(0);
+
+	stream->channels = *(short *)(header + 0x16);
+	stream->sampleRate = *(int *)(header + 0x18);
+	stream->bitPerSample = *(short *)(header + 0x22);
+
+	for(i = 0; memcmp(header + 0x24 + i, "data", 4) != 0; i++)
+	{
+		if(i == 0xFF || 0x2c + i >= size)
+			return(0);
+	}
+
+	stream->dataLength = *(unsigned int *)(header + 0x28 + i);
+	stream->dataOffset = 0x2c + i;
+
+	if(stream->channels != 2 && stream->channels != 1)
+		return(0);
+
+	if(stream->bitPerSample != 8 && stream->bitPerSample != 16)
+		return(0);
+
+	if(stream->sampleRate > 100000 || stream->sampleRate < 2000)
+		return(0);
+
+	stream->read = read;
+	stream->file = file;
+	stream->step = ((unsigned long long)stream->sampleRate << 32) / VITA_AUDIO_FREQUENCY;
+	stream->volume = VITA_VOLUME_MAX;
+	stream->stats.capacity = VITA_STREAM_RING_FRAMES;
+
+	return(1);
+}
+
+void vitaStreamRewind(vitaStream *stream, unsigned int loop)
+{
+	stream->head = 0;
+	stream->tail = 0;
+	stream->ended = 0;
+	stream->buffered = 0;
+	stream->loop = loop;
+
+	stream->chunkSize = 0;
+	stream->chunkPos = 0;
+	stream->readPos = 0;
+	stream->sourceEnded = 0;
+	stream->primed = 0;
+
+	memset(&stream->stats, 0, sizeof(stream->stats));
+	stream->stats.capacity = VITA_STREAM_RING_FRAMES;
+}
+
+/*
+ * Next source frame into cur, reading a chunk when the last one is used
+ * up. Wrapping to the first sample at the end of a looped stream happens
+ * here, so the interpolation runs across the loop point without a gap.
+ */
+static int vitaStreamNextFrame(vitaStream *stream)
+{
+	unsigned int frameBytes = stream->channels * stream->bitPerSample / 8;
+
+	if(stream->chunkPos + frameBytes > stream->chunkSize)
+	{
+		unsigned int size = VITA_STREAM_CHUNK_BYTES - VITA_STREAM_CHUNK_BYTES % frameBytes;
+		int n;
+
+		if(stream->readPos + frameBytes > stream->dataLength)
+		{
+			if(!stream->loop)
+				return(0);
+
+			stream->readPos = 0;
+			VITA_STREAM_STORE(loops, stream->stats.loops + 1);
+		}
+
+		if(size > stream->dataLength - stream->readPos)
+			size = stream->dataLength - stream->readPos;
+
+		n = stream->read(stream->file, stream->chunk, size, stream->dataOffset + stream->readPos);
+		if(n < (int)frameBytes)
+			return(0);
+
+		stream->chunkSize = n - n % frameBytes;
+		stream->chunkPos = 0;
+		stream->readPos += stream->chunkSize;
+	}
+
+	if(stream->bitPerSample == 8)
+	{
+		const unsigned char *src = stream->chunk + stream->chunkPos;
+		stream->cur[0] = (src[0] * 256) - 32768;
+		stream->cur[1] = stream->channels == 2 ? (src[1] * 256) - 32768 : stream->cur[0];
+	}
+	else
+	{
+		const short *src = (const short *)(stream->chunk + stream->chunkPos);
+		stream->cur[0] = src[0];
+		stream->cur[1] = stream->channels == 2 ? src[1] : stream->cur[0];
+	}
+
+	stream->chunkPos += frameBytes;
+
+	return(1);
+}
+
+unsigned int vitaStreamFill(vitaStream *stream, unsigned int maxFrames)
+{
+	unsigned int tail = stream->tail;
+	unsigned int head = __atomic_load_n(&stream->head, __ATOMIC_ACQUIRE);
+	unsigned int space = VITA_STREAM_RING_FRAMES - (tail - head);
+	unsigned int n;
+
+	if(stream->ended)
+		return(0);
+
+	if(!stream->primed)
+	{
+		/* prev and cur hold the two source frames around the output frame */
+		if(!vitaStreamNextFrame(stream))
+		{
+			__atomic_store_n(&stream->ended, 1, __ATOMIC_RELEASE);
+			__atomic_store_n(&stream->buffered, 1, __ATOMIC_RELEASE);
+			return(0);
+		}
+
+		stream->prev[0] = stream->cur[0];
+		stream->prev[1] = stream->cur[1];
+		stream->sourceEnded = !vitaStreamNextFrame(stream);
+		stream->phase = 0;
+		stream->primed = 1;
+	}
+
+	if(maxFrames > space)
+		maxFrames = space;
+
+	for(n = 0; n < maxFrames; n++)
+	{
+		short *dst = &stream->ring[((tail + n) & VITA_STREAM_MASK) * 2];
+		int t;
+
+		while(stream->phase >= (1ULL << 32) && !stream->ended)
+		{
+			if(stream->sourceEnded)
+			{
+				__atomic_store_n(&stream->ended, 1, __ATOMIC_RELEASE);
+				break;
+			}
+
+			stream->prev[0] = stream->cur[0];
+			stream->prev[1] = stream->cur[1];
+			stream->sourceEnded = !vitaStreamNextFrame(stream);
+
+			stream->phase -= 1ULL << 32;
+		}
+
+		if(stream->ended)
+			break;
+
+		/* Linear interpolation, with a 15 bit fraction */
+		t = (int)(stream->phase >> 17);
+		dst[0] = stream->prev[0] + (((stream->cur[0] - stream->prev[0]) * t) >> 15);
+		dst[1] = stream->prev[1] + (((stream->cur[1] - stream->prev[1]) * t) >> 15);
+
+		stream->phase += stream->step;
+	}
+
+	__atomic_store_n(&stream->tail, tail + n, __ATOMIC_RELEASE);
+
+	if(!stream->buffered && (tail + n - head >= VITA_STREAM_START_FRAMES || stream->ended))
+		__atomic_store_n(&stream->buffered, 1, __ATOMIC_RELEASE);
+
+	VITA_STREAM_STORE(decoded, stream->stats.decoded + n);
+
+	return(n);
+}
+
+int vitaStreamMix(vitaStream *stream, int *out, unsigned int frames)
+{
+	unsigned int head, tail, avail, n, i;
+	int ended, vol;
+
+	/* Still filling from a rewind: not starved, just not started */
+	if(!__atomic_load_n(&stream->buffered, __ATOMIC_ACQUIRE))
+		return(1);
+
+	head = stream->head;
+	tail = __atomic_load_n(&stream->tail, __ATOMIC_ACQUIRE);
+	ended = __atomic_load_n(&stream->ended, __ATOMIC_ACQUIRE);
+	vol = __atomic_load_n(&stream->volume, __ATOMIC_RELAXED);
+	avail = tail - head;
+	n = avail < frames ? avail : frames;
+
+	/* Ran dry before the end: the rest of this buffer is silent */
+	if(n < frames && !ended)
+		VITA_STREAM_STORE(starvations, stream->stats.starvations + 1);
+
+	/* At most two runs: up to the end of the ring, then from its start */
+	while(n > 0)
+	{
+		unsigned int at = head & VITA_STREAM_MASK;
+		unsigned int run = VITA_STREAM_RING_FRAMES - at;
+		const short *src = &stream->ring[at * 2];
+
+		if(run > n)
+			run = n;
+
+		if(vol == VITA_VOLUME_MAX)
+		{
+			for(i = 0; i < 2 * run; i++)
+				out[i] += src[i];
+		}
+		else
+		{
+			for(i = 0; i < 2 * run; i++)
+				out[i] += (src[i] * vol) >> 15;
+		}
+
+		out += 2 * run;
+		head += run;
+		n -= run;
+	}
+
+	__atomic_store_n(&stream->head, head, __ATOMIC_RELEASE);
+
+	avail = tail - head;
+	if(avail < stream->stats.minFill || stream->stats.buffers == 0)
+		VITA_STREAM_STORE(minFill, avail);
+	VITA_STREAM_STORE(fill, avail);
+	VITA_STREAM_STORE(buffers, stream->stats.buffers + 1);
+
+	return !(ended && avail == 0);
+}
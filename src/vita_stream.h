@@ -0,0 +1,114 @@
+/*
+ * vita_stream.h: Streamed WAV playback
+ *
+ * A stream decodes a WAV file a chunk at a time into a ring of native
+ * frames (stereo s16 at VITA_AUDIO_FREQUENCY): the I/O thread fills the
+ * ring, the mixer drains it. Platform-free, the file is read through a
+ * callback.
+ */
+
+#ifndef __VITA_STREAM_H__
+#define __VITA_STREAM_H__
+
+#include "vita_audio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VITA_STREAM_RING_FRAMES		16384	/* Power of two, ~370 ms */
+#define VITA_STREAM_CHUNK_BYTES		8192
+#define VITA_STREAM_START_FRAMES	(VITA_NUM_AUDIO_SAMPLES * 4)	/* Decoded before the mixer reads */
+
+/**
+ * Reads size bytes at offset in the file
+ *
+ * @returns The number of bytes read, < 0 on error.
+ */
+typedef int (* vitaStreamReader)(void *file, void *buf, unsigned int size, unsigned long offset);
+
+struct vitaStream
+{
+	/* Ring of native frames: tail written by the filler, head by the mixer */
+	short ring[VITA_STREAM_RING_FRAMES * 2];
+	unsigned int head __attribute__((aligned(64)));
+	unsigned int tail __attribute__((aligned(64)));
+	int ended;							/* No frame after tail */
+	int buffered;						/* VITA_STREAM_START_FRAMES decoded, or all */
+
+	/* Source */
+	vitaStreamReader read;
+	void *file;
+	unsigned long dataOffset;			/* Samples in the file */
+	unsigned long dataLength;
+	unsigned long sampleRate;
+	unsigned int channels;
+	unsigned int bitPerSample;
+	unsigned int loop;
+
+	/* Decoder, owned by the filler */
+	unsigned char chunk[VITA_STREAM_CHUNK_BYTES];
+	unsigned int chunkSize;
+	unsigned int chunkPos;
+	unsigned long readPos;				/* Next byte to read, from dataOffset */
+	unsigned long long phase;			/* 32.32 position between prev and cur */
+	unsigned long long step;
+	int prev[2];
+	int cur[2];
+	int primed;
+	int sourceEnded;					/* cur is the last frame */
+
+	/* Set by the game thread, read by the mixer */
+	int volume;
+
+	/* Command handshake with the mixer */
+	unsigned int commands;				/* Sent by the game thread */
+	unsigned int applied;				/* Applied by the mixer */
+	int attached;						/* The mixer is reading the ring */
+
+	vitaStreamStats stats;
+};
+
+/**
+ * Parse the WAV header and prepare the stream
+ *
+ * @param header - The start of the file, up to the "data" chunk.
+ *
+ * @returns 1 on success, 0 if the file is not a supported WAV.
+ */
+int vitaStreamOpen(vitaStream *stream, const unsigned char *header, unsigned int size,
+                   vitaStreamReader read, void *file);
+
+/**
+ * Restart decoding from the first sample, with an empty ring and cleared
+ * statistics
+ *
+ * Not thread safe: the mixer must not be attached.
+ */
+void vitaStreamRewind(vitaStream *stream, unsigned int loop);
+
+/**
+ * Decode up to maxFrames frames into the ring, as space allows (filler)
+ *
+ * Marks the stream buffered once VITA_STREAM_START_FRAMES frames are in
+ * the ring after a rewind, or the whole source if shorter.
+ *
+ * @returns The number of frames decoded.
+ */
+unsigned int vitaStreamFill(vitaStream *stream, unsigned int maxFrames);
+
+/**
+ * Add up to frames frames from the ring to a mixer accumulator (mixer)
+ *
+ * Adds nothing until the stream is buffered: the start of a stream plays
+ * late rather than stuttering.
+ *
+ * @returns 0 once the stream has ended and its ring is empty.
+ */
+int vitaStreamMix(vitaStream *stream, int *out, unsigned int frames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __VITA_STREAM_H__
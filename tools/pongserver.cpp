@@ -0,0 +1,96 @@
+// Dedicated server for online Two Players (see src/host/server.h): one
+// PongServer shard per thread, all on the same UDP port, until SIGINT or
+// SIGTERM. Prints each shard's matches and tick times every interval.
+//
+// Usage: pongserver [-p port] [-j shards] [-m matches per shard] [-t tick Hz]
+//                   [-i seconds between reports]
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "server.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop (int) {
+    stopping = 1;
+}
+
+int main (int argc, char** argv) {
+    unsigned int port = 7777, shards = std::thread::hardware_concurrency(), matches = 10000;
+    unsigned int hz = SERVER_TICK_HZ, interval = 10;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (! v || a[0] != '-') {
+            fprintf(stderr, "usage: pongserver [-p port] [-j shards] [-m matches per shard] [-t tick Hz]\n"
+                            "                  [-i seconds between reports]\n");
+            return EXIT_FAILURE;
+        }
+        ++i;
+
+        switch (a[1]) {
+            case 'p': port = strtoul(v, nullptr, 10); break;
+            case 'j': shards = strtoul(v, nullptr, 10); break;
+            case 'm': matches = strtoul(v, nullptr, 10); break;
+            case 't': hz = strtoul(v, nullptr, 10); break;
+            case 'i': interval = strtoul(v, nullptr, 10); break;
+            default:
+                fprintf(stderr, "pongserver: bad argument %s\n", a);
+                return EXIT_FAILURE;
+        }
+    }
+    shards = shards ? shards : 1;
+    hz = hz ? hz : SERVER_TICK_HZ;
+    interval = interval ? interval : 10;
+
+    std::vector<PongServer*> servers;
+    for (unsigned int s = 0; s < shards; ++s) {
+        servers.push_back(new PongServer);
+        if (! servers[s]->open(port, matches, hz)) {
+            fprintf(stderr, "pongserver: cannot bind UDP port %u\n", port);
+            return EXIT_FAILURE;
+        }
+    }
+
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    printf("pongserver: port %u, %u shards of %u matches, %u Hz\n", port, shards, matches, hz);
+    fflush(stdout);
+
+    // Each shard reports on its own thread, from its own stats
+    std::vector<std::thread> threads;
+    for (unsigned int s = 0; s < shards; ++s) {
+        threads.push_back(std::thread([&, s] {
+            PongServer& server = *servers[s];
+            uint64_t report = uint64_t(interval) * hz;
+            while (! stopping) {
+                server.poll(100);
+                if (server.stats.ticks >= report) {
+                    report += uint64_t(interval) * hz;
+                    ServerStats const& st = server.stats;
+                    printf("shard %u: %u playing, %llu started, %llu timeouts, ticks %llu us median, "
+                           "%llu us p99, %llu us max, %llu late, %llu skipped, %llu dropped\n",
+                           s, server.playing(), (unsigned long long) st.started,
+                           (unsigned long long) st.timeouts,
+                           (unsigned long long) st.tickMicros.percentile(50.0),
+                           (unsigned long long) st.tickMicros.percentile(99.0),
+                           (unsigned long long) st.tickMicros.max, (unsigned long long) st.late,
+                           (unsigned long long) st.skipped, (unsigned long long) st.dropped);
+                    fflush(stdout);
+                    server.stats.tickMicros.clear();
+                }
+            }
+        }));
+    }
+
+    for (unsigned int s = 0; s < shards; ++s) {
+        threads[s].join();
+        delete servers[s];
+    }
+    return EXIT_SUCCESS;
+}
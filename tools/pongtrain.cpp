@@ -0,0 +1,110 @@
+// Trains the network of the learned CPU (see src/nn.h) from headless
+// self-play, and writes it quantized, ready for pkg/data.
+//
+// Usage: pongtrain [-o opponent.nn] [-n matches per round] [-r rounds]
+//                  [-e epochs per round] [-q of them on int8 inputs] [-s seed]
+//                  [-t threads]
+//
+// The first round learns from CPUs of every level, each later one adds the
+// matches the network of the round before played itself.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "nn_train.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double seconds (Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static float quantizedLoss (NeuralNet const& net, std::vector<NnSample> const& samples) {
+    double total = 0.0;
+    for (unsigned int s = 0; s < samples.size(); ++s) {
+        float e = net.forward(samples[s].f) - samples[s].label;
+        total += e * e;
+    }
+    return samples.empty() ? 0.0f : float(total / samples.size());
+}
+
+int main (int argc, char** argv) {
+    NnTrainConfig config;
+    const char* output = "opponent.nn";
+    unsigned int rounds = 2, threads = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (! v || a[0] != '-') {
+            fprintf(stderr, "usage: pongtrain [-o opponent.nn] [-n matches] [-r rounds] [-e epochs] [-q epochs]\n"
+                            "                 [-s seed] [-t threads]\n");
+            return EXIT_FAILURE;
+        }
+        ++i;
+
+        switch (a[1]) {
+            case 'o': output = v; break;
+            case 'n': config.matches = strtoull(v, nullptr, 10); break;
+            case 'r': rounds = strtoul(v, nullptr, 10); break;
+            case 'e': config.epochs = strtoul(v, nullptr, 10); break;
+            case 'q': config.tuning = strtoul(v, nullptr, 10); break;
+            case 's': config.seed = strtoul(v, nullptr, 10); break;
+            case 't': threads = strtoul(v, nullptr, 10); break;
+            default:
+                fprintf(stderr, "pongtrain: bad argument %s\n", a);
+                return EXIT_FAILURE;
+        }
+    }
+
+    ThreadPool pool(threads);
+    NnTrainer trainer;
+    trainer.init(config, config.seed);
+    NeuralNet net;
+
+    // Matches of their own for the validation loss
+    NnTrainConfig held = config;
+    held.matches = config.matches / 10 ? config.matches / 10 : 1;
+    std::vector<NnSample> samples, validation;
+    nnCollect(pool, held, ~config.seed, nullptr, validation);
+
+    // Decays over all the rounds: later ones fine-tune
+    float rate = config.rate;
+    for (unsigned int round = 0; round < rounds; ++round) {
+        Clock::time_point start = Clock::now();
+        nnCollect(pool, config, config.seed + round, round ? &net : nullptr, samples);
+        printf("round %u: %zu samples from %llu matches in %.1f s\n", round, samples.size(),
+               (unsigned long long) config.matches, seconds(start));
+
+        for (unsigned int e = 0; e < config.epochs; ++e) {
+            if (e + config.tuning == config.epochs) {
+                trainer.calibrate(samples);
+                printf("  int8 inputs from now on\n");
+            }
+
+            start = Clock::now();
+            float train = trainer.epoch(samples, rate);
+            printf("  epoch %2u: loss %.5f, validation %.5f, %.1f s\n", e, train, trainer.loss(validation),
+                   seconds(start));
+            if (e % 4 == 3) {
+                rate /= 2;
+            }
+        }
+
+        trainer.quantize(net);
+        printf("  quantized validation loss %.5f\n", quantizedLoss(net, validation));
+    }
+
+    if (! net.save(output)) {
+        fprintf(stderr, "pongtrain: cannot write %s\n", output);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> bytes;
+    net.write(bytes);
+    printf("%s: %zu bytes\n", output, bytes.size());
+    return EXIT_SUCCESS;
+}
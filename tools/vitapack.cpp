@@ -0,0 +1,159 @@
+// Builds an asset pack (see src/vita_pack.h) from a list of files.
+//
+// Usage: vitapack [-n] -o assets.pak file...
+//
+//   -n  Convert WAV files to the mixer's native format (stereo s16 at
+//       VITA_AUDIO_FREQUENCY), so that the game plays them as they are.
+//
+// Assets are named after their file name, without the directory.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "vita_pack.h"
+#include "vita_mixer.h"
+
+struct Asset {
+    std::string name;
+    std::vector<unsigned char> data;
+
+    bool operator< (Asset const& other) const {
+        return strcmp(name.c_str(), other.name.c_str()) < 0;
+    }
+};
+
+static bool readFile (const char* path, std::vector<unsigned char>& data) {
+    FILE* file = fopen(path, "rb");
+    if (! file) return false;
+
+    fseek(file, 0, SEEK_END);
+    data.resize(ftell(file));
+    fseek(file, 0, SEEK_SET);
+    bool ok = fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return ok;
+}
+
+static void put16 (unsigned char* at, uint16_t v) { memcpy(at, &v, 2); }
+static void put32 (unsigned char* at, uint32_t v) { memcpy(at, &v, 4); }
+
+// Same WAV, resampled to stereo s16 at the output rate
+static bool convertWav (std::vector<unsigned char>& data) {
+    vitaWav wav;
+    if (! vitaPackParseWav(&wav, data.data(), data.size())) return false;
+
+    std::vector<short> samples(vitaMixerConvertedFrames(&wav) * 2);
+    vitaMixerConvert(&wav, samples.data());
+
+    uint32_t length = samples.size() * sizeof(short);
+    std::vector<unsigned char> out(0x2c + length);
+    memcpy(&out[0], "RIFF", 4);
+    put32(&out[4], 0x24 + length);
+    memcpy(&out[8], "WAVEfmt ", 8);
+    put32(&out[0x10], 16);
+    put16(&out[0x14], 1);
+    put16(&out[0x16], 2);
+    put32(&out[0x18], VITA_AUDIO_FREQUENCY);
+    put32(&out[0x1c], VITA_AUDIO_FREQUENCY * 4);
+    put16(&out[0x20], 4);
+    put16(&out[0x22], 16);
+    memcpy(&out[0x24], "data", 4);
+    put32(&out[0x28], length);
+    memcpy(&out[0x2c], samples.data(), length);
+
+    data.swap(out);
+    return true;
+}
+
+static uint32_t align (uint32_t offset) {
+    return (offset + VITA_PACK_ALIGN - 1) / VITA_PACK_ALIGN * VITA_PACK_ALIGN;
+}
+
+int main (int argc, char** argv) {
+    const char* output = nullptr;
+    bool native = false;
+    std::vector<Asset> assets;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0) {
+            native = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else {
+            Asset asset;
+            const char* slash = strrchr(argv[i], '/');
+            asset.name = slash ? slash + 1 : argv[i];
+
+            if (asset.name.size() >= VITA_PACK_NAME_MAX) {
+                fprintf(stderr, "vitapack: name too long: %s\n", asset.name.c_str());
+                return EXIT_FAILURE;
+            }
+            if (! readFile(argv[i], asset.data)) {
+                fprintf(stderr, "vitapack: cannot read %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+
+            bool wav = asset.name.size() > 4 && asset.name.compare(asset.name.size() - 4, 4, ".wav") == 0;
+            if (native && wav && ! convertWav(asset.data)) {
+                fprintf(stderr, "vitapack: unsupported WAV %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+
+            assets.push_back(asset);
+        }
+    }
+
+    if (! output) {
+        fprintf(stderr, "usage: vitapack [-n] -o assets.pak file...\n");
+        return EXIT_FAILURE;
+    }
+
+    // Sorted, for the binary search of the loader
+    std::sort(assets.begin(), assets.end());
+    for (unsigned int i = 1; i < assets.size(); ++i) {
+        if (assets[i].name == assets[i - 1].name) {
+            fprintf(stderr, "vitapack: duplicate asset %s\n", assets[i].name.c_str());
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<vitaPackEntry> entries(assets.size());
+    uint32_t offset = align(VITA_PACK_ALIGN + assets.size() * sizeof(vitaPackEntry));
+    for (unsigned int i = 0; i < assets.size(); ++i) {
+        memset(&entries[i], 0, sizeof(vitaPackEntry));
+        strcpy(entries[i].name, assets[i].name.c_str());
+        entries[i].offset = offset;
+        entries[i].size = assets[i].data.size();
+        offset = align(offset + entries[i].size);
+    }
+
+    vitaPackHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VITA_PACK_MAGIC, 4);
+    header.version = VITA_PACK_VERSION;
+    header.count = assets.size();
+    header.size = offset;
+
+    std::vector<unsigned char> pack(offset, 0);
+    memcpy(&pack[0], &header, sizeof(header));
+    if (! entries.empty()) {
+        memcpy(&pack[VITA_PACK_ALIGN], entries.data(), entries.size() * sizeof(vitaPackEntry));
+    }
+    for (unsigned int i = 0; i < assets.size(); ++i) {
+        memcpy(&pack[entries[i].offset], assets[i].data.data(), assets[i].data.size());
+    }
+
+    FILE* file = fopen(output, "wb");
+    if (! file || fwrite(pack.data(), 1, pack.size(), file) != pack.size()) {
+        fprintf(stderr, "vitapack: cannot write %s\n", output);
+        return EXIT_FAILURE;
+    }
+    fclose(file);
+
+    printf("vitapack: %u assets, %u bytes\n", (unsigned int) assets.size(), offset);
+    return EXIT_SUCCESS;
+}